@@ -66,7 +66,7 @@ public class MainActivity extends Activity {
     private void loadPreferences() {
         SharedPreferences prefs = getSharedPreferences(PREFS_NAME, MODE_PRIVATE);
         cbShaderCache.setChecked(prefs.getBoolean("shader_cache", true));
-        cbDrawCallBatching.setChecked(prefs.getBoolean("draw_call_batching", true));
+        cbDrawCallBatching.setChecked(prefs.getBoolean("draw_call_batching", false));
         cbAdaptiveRes.setChecked(prefs.getBoolean("adaptive_res", true));
         cbAsyncTexture.setChecked(prefs.getBoolean("async_texture", true));
         sbResScale.setProgress(prefs.getInt("res_scale", 100));
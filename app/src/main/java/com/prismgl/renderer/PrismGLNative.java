@@ -65,4 +65,99 @@ public class PrismGLNative {
      * @return Function pointer address, or 0 if not found
      */
     public static native long nativeGetProcAddress(String name);
+
+    /**
+     * Mark the end of a frame when presentation does not go through
+     * the eglSwapBuffers override.
+     */
+    public static native void nativeFrameEnd();
+
+    /**
+     * Replay GL calls on a dedicated thread that owns the EGL context.
+     * Must be set before the renderer resolves its GL entry points.
+     */
+    public static native void nativeSetThreadedDispatch(boolean enabled);
+
+    /**
+     * Collapse runs of identical draws separated only by uniform updates
+     * into instanced draws. Must be set before the renderer resolves its
+     * GL entry points; has no effect with threaded dispatch.
+     */
+    public static native void nativeSetAutoInstancing(boolean enabled);
+
+    /**
+     * Encode large textures loaded asynchronously as ETC2 on worker threads.
+     * Results are cached on disk under the cache directory's textures folder.
+     */
+    public static native void nativeSetTextureCompression(boolean enabled);
+
+    /**
+     * Allocate textures defined level by level with glTexImage2D as one
+     * immutable glTexStorage allocation once GL_TEXTURE_MAX_LEVEL is known.
+     */
+    public static native void nativeSetImmutableTextures(boolean enabled);
+
+    /**
+     * Stage small glTexSubImage2D calls, such as animated texture updates, and
+     * submit them together from one pixel unpack buffer before the next draw.
+     */
+    public static native void nativeSetTextureUploadBatching(boolean enabled);
+
+    /**
+     * Limit the estimated texture memory. Over the limit, large textures are
+     * allocated a mip level smaller and cold ones lose their top level.
+     * @param megabytes budget in MB, 0 to derive it from the GPU and RAM, negative for none
+     */
+    public static native void nativeSetTextureBudget(int megabytes);
+
+    /**
+     * Let occlusion query results lag behind by a few frames instead of
+     * waiting for the GPU. Objects keep their last visibility for that long,
+     * and answer visible until their first result arrives.
+     * @param frames most frames a result may lag, 0 to wait for exact results, at most 6
+     */
+    public static native void nativeSetOcclusionQueryLatency(int frames);
+
+    /**
+     * Get redundant GL state call statistics for the last frame.
+     * @return {filtered, forwarded} call counts
+     */
+    public static native int[] nativeGetStateStats();
+
+    /**
+     * Get draw batching statistics for the last frame.
+     * @return {draws recorded, driver draw calls issued}
+     */
+    public static native int[] nativeGetBatchStats();
+
+    /**
+     * Get statistics of GL work queued by threads without a context.
+     * @return {jobs finished last frame, jobs still queued}
+     */
+    public static native int[] nativeGetJobStats();
+
+    /**
+     * Get statistics of automatic instancing for the last frame.
+     * @return {draws held back, driver draw calls issued for them}
+     */
+    public static native int[] nativeGetInstanceStats();
+
+    /**
+     * Get the GPU time per frame, measured with timer queries and smoothed
+     * over recent frames. Needs EXT_disjoint_timer_query and adaptive resolution.
+     * @return milliseconds, or 0 while unknown
+     */
+    public static native float nativeGetGpuFrameTime();
+
+    /**
+     * Get statistics of batched texture uploads for the last frame.
+     * @return {glTexSubImage2D calls staged, driver uploads issued, bytes uploaded}
+     */
+    public static native int[] nativeGetTextureUploadStats();
+
+    /**
+     * Get the estimated memory of all textures.
+     * @return {bytes in use, most bytes used so far, budget in bytes or 0 if unlimited}
+     */
+    public static native long[] nativeGetTextureMemoryStats();
 }
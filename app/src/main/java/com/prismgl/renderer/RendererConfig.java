@@ -25,7 +25,7 @@ public class RendererConfig {
     public String glVersion = "4.6";
     public String glslVersion = "460";
     public boolean shaderCacheEnabled = true;
-    public boolean drawCallBatching = true;
+    public boolean drawCallBatching = false;
     public boolean adaptiveResolution = true;
     public boolean asyncTextureLoading = true;
     public float resolutionScale = 1.0f;
@@ -104,7 +104,7 @@ public class RendererConfig {
             JSONObject opts = json.optJSONObject("optimizations");
             if (opts != null) {
                 config.shaderCacheEnabled = opts.optBoolean("shader_cache", true);
-                config.drawCallBatching = opts.optBoolean("draw_call_batching", true);
+                config.drawCallBatching = opts.optBoolean("draw_call_batching", false);
                 config.adaptiveResolution = opts.optBoolean("adaptive_resolution", true);
                 config.asyncTextureLoading = opts.optBoolean("async_texture_loading", true);
                 config.resolutionScale = (float) opts.optDouble("resolution_scale", 1.0);
@@ -0,0 +1,50 @@
+/*
+ * PrismGL Client Arrays
+ * glVertexPointer/glColorPointer/... emulation on top of streamed buffers
+ */
+
+#ifndef CLIENT_ARRAYS_H
+#define CLIENT_ARRAYS_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* glEnableClientState/glDisableClientState */
+void client_arrays_enable(GLenum array, bool enable);
+
+/* gl*Pointer; `array` is GL_VERTEX_ARRAY, GL_COLOR_ARRAY, ... */
+void client_arrays_pointer(GLenum array, GLint size, GLenum type,
+                           GLsizei stride, const void* pointer);
+
+/* True when an enabled array sources client memory, i.e. the next draw
+ * has to go through client_arrays_draw_* */
+bool client_arrays_active(void);
+
+/*
+ * Copy the referenced vertex range of every enabled client array into the
+ * stream buffer (interleaved, one pass) and draw from it. Return false if
+ * the draw could not be emulated.
+ */
+bool client_arrays_draw_arrays(GLenum mode, GLint first, GLsizei count);
+bool client_arrays_draw_elements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+
+/* Min/max index referenced by an index array (SIMD for 16/32-bit) */
+void client_arrays_index_range(GLenum type, const void* indices, GLsizei count,
+                               GLuint* out_min, GLuint* out_max);
+
+/* Per-context array state, see context.h */
+void* client_arrays_create_state(void);
+void client_arrays_destroy_state(void* state);
+
+/* Release the stream buffers and VAO of the current context */
+void client_arrays_shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CLIENT_ARRAYS_H */
@@ -0,0 +1,87 @@
+/*
+ * PrismGL Context Registry
+ * Wrapper state owned by one EGL context, found through a thread-local
+ * pointer to the context current on the calling thread
+ */
+
+#ifndef PRISMGL_CONTEXT_H
+#define PRISMGL_CONTEXT_H
+
+#include <EGL/egl.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per-context state blocks, one per subsystem, created on first use */
+typedef enum {
+    PRISMGL_STATE_WRAPPER = 0,      /* gl_wrapper.c: immediate mode, batching, emulated caps */
+    PRISMGL_STATE_SHADOW,           /* state_shadow.c */
+    PRISMGL_STATE_MATRICES,         /* matrix_stack.c */
+    PRISMGL_STATE_CLIENT_ARRAYS,    /* client_arrays.c */
+    PRISMGL_STATE_QUADS,            /* quad_convert.c */
+    PRISMGL_STATE_MULTI_DRAW,       /* multi_draw.c */
+    PRISMGL_STATE_BATCH,            /* draw_batch.c */
+    PRISMGL_STATE_INSTANCE,         /* draw_instance.c */
+    PRISMGL_STATE_READBACK,         /* texture_readback.c */
+    PRISMGL_STATE_TEXTURE_BATCH,    /* texture_batch.c */
+    PRISMGL_STATE_TIMER,            /* gpu_timer.c */
+    PRISMGL_STATE_OCCLUSION,        /* occlusion_query.c */
+    PRISMGL_STATE_DISPLAY_LISTS,    /* display_list.c */
+    PRISMGL_STATE_COUNT
+} PrismGLStateSlot;
+
+typedef struct PrismGLContext {
+    EGLDisplay display;
+    EGLContext egl_context;         /* EGL_NO_CONTEXT for the fallback context */
+    EGLContext share_context;
+    void* state[PRISMGL_STATE_COUNT];
+    int bind_count;                 /* Threads the context is current on */
+    bool destroy_pending;           /* eglDestroyContext while still current */
+    struct PrismGLContext* next;
+} PrismGLContext;
+
+/* Context current on this thread, NULL until the first lookup */
+extern _Thread_local PrismGLContext* prismgl_tls_context;
+
+/*
+ * Context current on the calling thread: adopts a context made current
+ * without going through prismgl_eglMakeCurrent, or returns the fallback
+ * context when none is current.
+ */
+PrismGLContext* prismgl_context_resolve(void);
+
+/*
+ * Slow path of prismgl_context_state(): resolves the context when the
+ * thread has none bound and allocates the block for `slot`. Blocks of the
+ * fallback context, shared by every thread without one, are only ever read
+ * here under the registry lock.
+ */
+void* prismgl_context_create_state(PrismGLContext* ctx, PrismGLStateSlot slot);
+
+/* State block of the calling thread's current context */
+static inline void* prismgl_context_state(PrismGLStateSlot slot) {
+    PrismGLContext* ctx = prismgl_tls_context;
+    void* state = ctx ? ctx->state[slot] : NULL;
+    return state ? state : prismgl_context_create_state(ctx, slot);
+}
+
+/*
+ * Registry updates driven by the EGL overrides. A context destroyed while
+ * current is released when the last thread unbinds it. State blocks only
+ * free client memory: GL objects die with the EGL context itself.
+ */
+void prismgl_context_created(EGLDisplay display, EGLContext context, EGLContext share);
+void prismgl_context_make_current(EGLDisplay display, EGLContext context);
+void prismgl_context_destroyed(EGLDisplay display, EGLContext context);
+
+/* `context` is known and has not been destroyed */
+bool prismgl_context_alive(EGLDisplay display, EGLContext context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PRISMGL_CONTEXT_H */
@@ -0,0 +1,63 @@
+/*
+ * PrismGL Display Lists
+ * Records legacy glNewList/glEndList content into static GPU buffers
+ */
+
+#ifndef DISPLAY_LIST_H
+#define DISPLAY_LIST_H
+
+#include "prismgl_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Commands that may be recorded into a display list */
+typedef enum {
+    DL_CMD_DRAW = 0,
+    DL_CMD_ENABLE,
+    DL_CMD_DISABLE,
+    DL_CMD_COLOR,
+    DL_CMD_NORMAL,
+    DL_CMD_TEXCOORD,
+    DL_CMD_BIND_TEXTURE,
+    DL_CMD_MATRIX_MODE,
+    DL_CMD_PUSH_MATRIX,
+    DL_CMD_POP_MATRIX,
+    DL_CMD_LOAD_IDENTITY,
+    DL_CMD_TRANSLATE,
+    DL_CMD_ROTATE,
+    DL_CMD_SCALE,
+    DL_CMD_MULT_MATRIX,
+    DL_CMD_LOAD_MATRIX,
+    DL_CMD_ORTHO,
+    DL_CMD_FRUSTUM,
+    DL_CMD_CALL_LIST
+} DisplayListOp;
+
+/* Per-context list names and compilation state, see context.h */
+void* display_list_create_state(void);
+void display_list_destroy_state(void* state);
+
+/* True while a glNewList/glEndList pair is open */
+bool display_list_is_compiling(void);
+
+/*
+ * Recording hooks called by the GL wrappers. Each returns true when the
+ * call must not be executed now (GL_COMPILE), false when it should run
+ * as usual (not compiling, or GL_COMPILE_AND_EXECUTE).
+ */
+bool display_list_record_primitive(GLenum mode, const ImmediateVertex* vertices, int count);
+bool display_list_record_op(DisplayListOp op);
+bool display_list_record_enum(DisplayListOp op, GLenum value);
+bool display_list_record_floats(DisplayListOp op, const GLfloat* values, int count);
+bool display_list_record_texture(GLenum target, GLuint texture);
+
+/* Release every list of the current context and its GPU buffers */
+void display_list_shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISPLAY_LIST_H */
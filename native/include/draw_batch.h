@@ -0,0 +1,63 @@
+/*
+ * PrismGL Draw Batching
+ * Draws recorded between prismgl_batch_begin() and prismgl_batch_flush(),
+ * grouped by the state they were recorded with
+ */
+
+#ifndef DRAW_BATCH_H
+#define DRAW_BATCH_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t draws_in;      /* Draws recorded through prismgl_batch_draw */
+    uint32_t draws_out;     /* Driver draw calls they were submitted as */
+} DrawBatchStats;
+
+/* Per-context batch storage, see context.h */
+void* draw_batch_create_state(void);
+void draw_batch_destroy_state(void* state);
+
+/*
+ * Entry points that must reach the batch without running the call hook:
+ * the captured draws and the state their keys hold
+ */
+bool draw_batch_records(const char* name);
+
+/*
+ * Record an indexed draw if a batch is open and the draw can be replayed.
+ * Returns false if the caller must draw it now.
+ */
+bool draw_batch_record_elements(GLenum mode, GLsizei count, GLenum type,
+                                const void* indices, GLint basevertex);
+
+/* A batch is open on the current context */
+bool draw_batch_active(void);
+
+/*
+ * Submit recorded draws before state they read changes: buffers, vertex
+ * arrays, or anything outside their keys. Also the call hook while draws
+ * are pending.
+ */
+void draw_batch_invalidate(void);
+
+/* Submit recorded draws of `program` before its uniforms change */
+void draw_batch_uniforms_changed(GLuint program);
+
+/* Close the current frame's counters */
+void draw_batch_frame_end(void);
+
+/* Counters of the last frame completed by any context */
+void draw_batch_get_stats(DrawBatchStats* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DRAW_BATCH_H */
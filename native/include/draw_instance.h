@@ -0,0 +1,85 @@
+/*
+ * PrismGL Draw Instancing
+ * Runs of identical draws separated only by glUniform* calls, collapsed
+ * into one instanced draw of a program variant that reads the changing
+ * uniforms per instance
+ */
+
+#ifndef DRAW_INSTANCE_H
+#define DRAW_INSTANCE_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Uniform calls the instancer can hold back; count 1, no transpose */
+typedef enum {
+    INSTANCE_UNIFORM_1F = 0,
+    INSTANCE_UNIFORM_2F,
+    INSTANCE_UNIFORM_3F,
+    INSTANCE_UNIFORM_4F,
+    INSTANCE_UNIFORM_1I,
+    INSTANCE_UNIFORM_2I,
+    INSTANCE_UNIFORM_3I,
+    INSTANCE_UNIFORM_4I,
+    INSTANCE_UNIFORM_MAT2,
+    INSTANCE_UNIFORM_MAT3,
+    INSTANCE_UNIFORM_MAT4
+} InstanceUniformKind;
+
+typedef struct {
+    uint32_t draws_in;      /* Draws held back to look for a run */
+    uint32_t draws_out;     /* Driver draw calls they were submitted as */
+} DrawInstanceStats;
+
+/* Per-context run, program sources and variants, see context.h */
+void* draw_instance_create_state(void);
+void draw_instance_destroy_state(void* state);
+
+/*
+ * Requested through PrismGLConfig.auto_instancing. Needs every entry point
+ * to be a trampoline that flushes held draws (gl_thread.h), so it stays
+ * off with threaded dispatch or after a lookup that bypassed them.
+ */
+bool draw_instance_enabled(void);
+
+/* Entry points the instancer records; they must reach it without a flush */
+bool draw_instance_records(const char* name);
+
+/*
+ * Hold back a draw, or a uniform write between held draws, of the current
+ * program. Return false if the caller must issue the call now; anything
+ * held before it has been submitted by then.
+ */
+bool draw_instance_record_arrays(GLenum mode, GLint first, GLsizei count);
+bool draw_instance_record_elements(GLenum mode, GLsizei count, GLenum type,
+                                   const void* indices, GLint basevertex);
+bool draw_instance_record_uniform(GLint location, InstanceUniformKind kind,
+                                  GLsizei count, const void* value);
+
+/* Submit held draws; runs as the call hook before any other GL call */
+void draw_instance_flush(void);
+
+/* Keep shader sources for variants, and drop variants of a relinked or
+ * deleted program */
+void draw_instance_program_linked(GLuint program);
+void draw_instance_program_deleted(GLuint program);
+
+/* Release the current context's variants and instance buffer */
+void draw_instance_shutdown(void);
+
+/* Close the current frame's counters */
+void draw_instance_frame_end(void);
+
+/* Counters of the last frame completed by any context */
+void draw_instance_get_stats(DrawInstanceStats* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DRAW_INSTANCE_H */
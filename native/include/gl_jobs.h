@@ -0,0 +1,84 @@
+/*
+ * PrismGL GL Jobs
+ * GL work submitted from any thread, including threads without a
+ * context, and run on the presenting context at the end of its frame
+ */
+
+#ifndef GL_JOBS_H
+#define GL_JOBS_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct GLJob GLJob;
+
+typedef enum {
+    GL_JOB_DONE = 0,
+    GL_JOB_RETRY            /* Run again at the end of the next frame */
+} GLJobStatus;
+
+/*
+ * Runs with the presenting context current. Bindings must be changed
+ * through the state_shadow_* functions; the ones a draw depends on are
+ * restored after each frame's jobs.
+ */
+typedef GLJobStatus (*GLJobFunc)(void* data);
+
+/*
+ * Called once per job on the thread that ran it. `completed` is false
+ * when the job was dropped at shutdown without running to completion.
+ */
+typedef void (*GLJobCallback)(void* data, bool completed);
+
+/* Queue a job without a handle. `done` may be NULL. */
+bool gl_job_post(GLJobFunc run, GLJobCallback done, void* data);
+
+/*
+ * Queue a job and return a handle to wait on, or NULL if out of memory.
+ * The handle must be released with gl_job_release().
+ */
+GLJob* gl_job_submit(GLJobFunc run, GLJobCallback done, void* data);
+
+bool gl_job_is_done(const GLJob* job);
+
+/*
+ * Wait up to `timeout_ns` (UINT64_MAX for no limit) for the job to finish.
+ * Must not be called from a thread that presents frames.
+ */
+bool gl_job_wait(GLJob* job, uint64_t timeout_ns);
+
+void gl_job_release(GLJob* job);
+
+/* ===== Common jobs ===== */
+
+/* Delete shared objects; the name list is copied */
+bool gl_jobs_delete_textures(GLsizei n, const GLuint* textures);
+bool gl_jobs_delete_buffers(GLsizei n, const GLuint* buffers);
+
+/*
+ * Completes once the GPU has finished all work submitted up to the end of
+ * the frame the fence was inserted in. `done` may be NULL.
+ */
+GLJob* gl_jobs_fence(GLJobCallback done, void* data);
+
+/* ===== Frame integration ===== */
+
+/* Run queued jobs within the per-frame budget; called from prismgl_frame_end */
+void gl_jobs_run_pending(void);
+
+/* Drop every queued job, calling its callback with completed = false */
+void gl_jobs_shutdown(void);
+
+/* Jobs finished in the last frame, and jobs still waiting */
+void gl_jobs_get_stats(uint32_t* completed, uint32_t* pending);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GL_JOBS_H */
@@ -0,0 +1,94 @@
+/*
+ * PrismGL Threaded Dispatch
+ * GL calls recorded on the render thread and replayed on a dedicated
+ * thread that owns the EGL context
+ */
+
+#ifndef GL_THREAD_H
+#define GL_THREAD_H
+
+#include <EGL/egl.h>
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Replays one recorded call from its argument block */
+typedef void (*GLThreadExec)(const void* args);
+
+/* True on the thread whose context currently lives on the GL thread */
+extern _Thread_local bool gl_thread_tls_remote;
+
+static inline bool gl_thread_remote(void) {
+    return gl_thread_tls_remote;
+}
+
+/*
+ * Run by every trampoline on the calling thread before the real entry
+ * point, unless the context lives on the GL thread. Set while a module
+ * holds back work that the next call must not overtake.
+ */
+extern _Thread_local void (*gl_thread_tls_call_hook)(void);
+
+/* Threaded dispatch requested in the config and available on this ABI */
+bool gl_thread_enabled(void);
+
+/* Every entry point handed out so far is a trampoline */
+bool gl_thread_calls_observed(void);
+
+/*
+ * Entry point handed out by prismgl_get_proc_address for a function that
+ * is not marshalled. With threaded dispatch, automatic instancing or draw
+ * batching enabled this is a trampoline that runs the call hook, or moves the
+ * context back to the calling thread, before jumping to `func`; otherwise
+ * `func` itself.
+ */
+void* gl_thread_wrap_proc(const char* name, void* func);
+
+/* ===== Recording (render thread, gl_thread_remote() only) ===== */
+
+/*
+ * Reserve `size` bytes of arguments for a call replayed by `exec`. The
+ * block is 16-byte aligned and must be filled before the next call into
+ * this module.
+ */
+void* gl_thread_enqueue(GLThreadExec exec, size_t size);
+
+/* Largest argument block gl_thread_enqueue accepts; bigger payloads sync */
+size_t gl_thread_max_payload(void);
+
+/* Run `exec(args)` on the GL thread after everything queued, and wait */
+void gl_thread_call(GLThreadExec exec, void* args);
+
+/* Wait until every queued call has executed */
+void gl_thread_finish(void);
+
+/* ===== EGL on the render thread ===== */
+
+EGLBoolean gl_thread_swap_buffers(EGLDisplay display, EGLSurface surface);
+EGLBoolean gl_thread_make_current(EGLDisplay display, EGLSurface draw,
+                                  EGLSurface read, EGLContext context);
+EGLContext gl_thread_get_current_context(void);
+EGLDisplay gl_thread_get_current_display(void);
+EGLSurface gl_thread_get_current_surface(EGLint readdraw);
+
+/* Stop the GL thread; the context is released, not handed back */
+void gl_thread_shutdown(void);
+
+/* ===== gl_marshal.c ===== */
+
+/* Marshalled entry point for `name`, or NULL if it is not marshalled */
+void* gl_marshal_get_proc(const char* name);
+
+/* Reload the bindings the marshalling code tracks on the render thread;
+ * called with the context current on that thread */
+void gl_marshal_sync_bindings(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GL_THREAD_H */
@@ -40,12 +40,31 @@ typedef struct {
     int max_texture_units;
     int max_vertex_attribs;
     int max_uniform_components;
+    int max_fragment_texture_units;
+    int max_vertex_texture_units;
+    int max_fragment_uniform_components;
+    int max_varying_vectors;
+    int max_3d_texture_size;
+    int max_cube_map_texture_size;
+    int max_array_texture_layers;
+    int max_renderbuffer_size;
+    int max_viewport_dims[2];
+    int max_draw_buffers;
+    int max_color_attachments;
+    int max_samples;
+    int max_uniform_buffer_bindings;
+    int max_uniform_block_size;
+    int uniform_buffer_offset_alignment;
+    int max_elements_vertices;
+    int max_elements_indices;
     bool supports_compute_shaders;
     bool supports_tessellation;
     bool supports_geometry_shaders;
     bool supports_astc;
     bool supports_etc2;
     bool supports_pvrtc;
+    bool supports_multi_draw;           /* GL_EXT_multi_draw_arrays */
+    bool supports_multi_draw_indirect;  /* GL_EXT_multi_draw_indirect */
     float recommended_resolution_scale;
 } GPUInfo;
 
@@ -58,6 +77,12 @@ void gpu_apply_optimizations(const GPUInfo* info);
 /* Get recommended resolution scale based on GPU tier */
 float gpu_get_recommended_scale(const GPUInfo* info);
 
+/*
+ * Answer an implementation-limit query (GL_MAX_TEXTURE_SIZE, ...) from the
+ * values captured by gpu_detect(). Returns false if `pname` is not cached.
+ */
+bool gpu_get_limit(unsigned int pname, int* params);
+
 /* Check extension support */
 bool gpu_has_extension(const char* extension);
 
@@ -0,0 +1,50 @@
+/*
+ * PrismGL GPU Timer
+ * Desktop timer queries (GL_TIME_ELAPSED, GL_TIMESTAMP, 64-bit results)
+ * on EXT_disjoint_timer_query, and a GPU frame time for adaptive resolution
+ */
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Load the extension entry points; called from prismgl_init */
+void gpu_timer_init(void);
+
+/* Per-context disjoint tracking and frame queries, see context.h */
+void* gpu_timer_create_state(void);
+void gpu_timer_destroy_state(void* state);
+
+/* The application begins or ends a GL_TIME_ELAPSED query */
+void gpu_timer_begin_elapsed(GLuint id);
+void gpu_timer_end_elapsed(void);
+
+/* glQueryCounter; only GL_TIMESTAMP exists */
+void gpu_timer_query_counter(GLuint id, GLenum target);
+
+/*
+ * glGetQueryObjectui64v of any query. Elapsed times measured across a
+ * disjoint operation (frequency change, context loss) read as 0.
+ */
+void gpu_timer_get_result(GLuint id, GLenum pname, GLuint64* params);
+
+/* GL_GPU_DISJOINT: whether a disjoint happened since the last call */
+bool gpu_timer_disjoint(void);
+
+/* Time the GPU spends on each frame; called from prismgl_frame_end */
+void gpu_timer_frame_end(void);
+
+/* Smoothed GPU time of recent frames in ms, 0 while unknown */
+float gpu_timer_frame_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GPU_TIMER_H */
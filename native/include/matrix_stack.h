@@ -0,0 +1,56 @@
+/*
+ * PrismGL Matrix Stack
+ * Fixed-function modelview/projection/texture matrix emulation
+ */
+
+#ifndef MATRIX_STACK_H
+#define MATRIX_STACK_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Uniforms the shader translator declares for legacy matrix built-ins */
+#define PRISMGL_UNIFORM_MODELVIEW       "prismgl_ModelViewMatrix"
+#define PRISMGL_UNIFORM_PROJECTION      "prismgl_ProjectionMatrix"
+#define PRISMGL_UNIFORM_MVP             "prismgl_ModelViewProjectionMatrix"
+#define PRISMGL_UNIFORM_TEXTURE         "prismgl_TextureMatrix"
+#define PRISMGL_UNIFORM_NORMAL          "prismgl_NormalMatrix"
+
+/* Per-context stacks and program cache, see context.h */
+void* matrix_stack_create_state(void);
+void matrix_stack_destroy_state(void* state);
+
+/* Stack operations on the stack selected by matrix_stack_set_mode */
+void matrix_stack_set_mode(GLenum mode);
+GLenum matrix_stack_get_mode(void);
+void matrix_stack_push(void);
+void matrix_stack_pop(void);
+void matrix_stack_load_identity(void);
+void matrix_stack_load(const GLfloat* m);
+void matrix_stack_mult(const GLfloat* m);
+void matrix_stack_translate(GLfloat x, GLfloat y, GLfloat z);
+void matrix_stack_rotate(GLfloat angle, GLfloat x, GLfloat y, GLfloat z);
+void matrix_stack_scale(GLfloat x, GLfloat y, GLfloat z);
+void matrix_stack_ortho(GLfloat l, GLfloat r, GLfloat b, GLfloat t, GLfloat n, GLfloat f);
+void matrix_stack_frustum(GLfloat l, GLfloat r, GLfloat b, GLfloat t, GLfloat n, GLfloat f);
+
+/* Top of the stack for GL_MODELVIEW, GL_PROJECTION or GL_TEXTURE */
+const GLfloat* matrix_stack_top(GLenum mode);
+
+/* Program tracking for the lazy uniform upload */
+void matrix_stack_use_program(GLuint program);
+void matrix_stack_program_linked(GLuint program);
+
+/* Upload changed matrices to the current program. Called right before a
+ * draw; does nothing when neither the matrices nor the program changed. */
+void matrix_stack_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MATRIX_STACK_H */
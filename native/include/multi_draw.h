@@ -0,0 +1,59 @@
+/*
+ * PrismGL Multi-Draw
+ * Many draws sharing the same state submitted in as few driver calls as
+ * the device allows
+ */
+
+#ifndef MULTI_DRAW_H
+#define MULTI_DRAW_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+
+#include "gpu_detect.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Resolve the multi-draw entry points the device exposes */
+void multi_draw_init(const GPUInfo* info);
+
+/* Per-context indirect command buffer, see context.h */
+void* multi_draw_create_state(void);
+void multi_draw_destroy_state(void* state);
+
+/*
+ * Draw `drawcount` ranges with an ES primitive mode. Uses
+ * glMultiDrawArraysEXT, else glMultiDrawArraysIndirectEXT from a streamed
+ * command buffer, else one glDrawArrays per range. Returns the number of
+ * driver draw calls issued.
+ */
+GLsizei multi_draw_arrays(GLenum mode, const GLint* first, const GLsizei* count,
+                       GLsizei drawcount);
+
+/*
+ * Indexed variant. `basevertex` may be NULL. Client-memory indices are
+ * only supported by the EXT_multi_draw_arrays and per-draw paths. Without
+ * a base-vertex multi-draw, list-mode draws from the bound element buffer
+ * are rebased into one merged index range. Returns the number of driver
+ * draw calls issued.
+ */
+GLsizei multi_draw_elements(GLenum mode, const GLsizei* count, GLenum type,
+                            const void* const* indices, GLsizei drawcount,
+                            const GLint* basevertex);
+
+/* Drop index copies read from the buffer bound to `target` after a write */
+void multi_draw_invalidate_target(GLenum target);
+
+/* Drop index copies read from deleted buffers */
+void multi_draw_invalidate_buffers(GLsizei n, const GLuint* buffers);
+
+/* Release the command buffer of the current context */
+void multi_draw_shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MULTI_DRAW_H */
@@ -0,0 +1,72 @@
+/*
+ * PrismGL Occlusion Queries
+ * Occlusion queries pipelined over a few frames on pooled query objects,
+ * so reading a result never waits for the GPU to catch up, with real
+ * GL_SAMPLES_PASSED counts and GL_PRIMITIVES_GENERATED counted on the CPU
+ */
+
+#ifndef OCCLUSION_QUERY_H
+#define OCCLUSION_QUERY_H
+
+#include "gpu_detect.h"
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Most frames PrismGL.occlusion_query_latency may be set to */
+#define OCCLUSION_MAX_LATENCY 6
+
+/* Enable sample counting in the shader translator if fragment shaders
+ * have atomic counters */
+void occlusion_query_init(const GPUInfo* info);
+
+/* Per-context query pool and results, see context.h */
+void* occlusion_query_create_state(void);
+void occlusion_query_destroy_state(void* state);
+
+/*
+ * glBeginQuery of GL_SAMPLES_PASSED, GL_ANY_SAMPLES_PASSED(_CONSERVATIVE)
+ * or GL_PRIMITIVES_GENERATED, issued by PrismGL. Returns false if the
+ * caller must begin `id` itself, with GL_SAMPLES_PASSED mapped to
+ * GL_ANY_SAMPLES_PASSED.
+ */
+bool occlusion_query_begin(GLenum target, GLuint id);
+
+/* glEndQuery of the same; false if the caller must end it itself */
+bool occlusion_query_end(GLenum target);
+
+/*
+ * glGetQueryObject* of a query begun through occlusion_query_begin.
+ * Returns the newest result that is ready or at least `latency` frames
+ * old, otherwise the last one read, or visible (GL_TRUE) before the first.
+ * GL_QUERY_RESULT_AVAILABLE is true unless latency is 0. Returns false for
+ * other ids.
+ */
+bool occlusion_query_result(GLuint id, GLenum pname, GLuint64* params);
+
+/* Forget deleted ids and return their query objects to the pool */
+void occlusion_query_delete(GLsizei n, const GLuint* ids);
+
+/*
+ * Draws of `drawcount` times `instances` ranges of counts[] vertices, as
+ * the application issued them. Adds to an active GL_PRIMITIVES_GENERATED
+ * query and turns sample counting on in the current program.
+ */
+void occlusion_query_draw(GLenum mode, const GLsizei* counts, GLsizei drawcount,
+                          GLsizei instances);
+
+/* Relinked or deleted program; forget its counting uniform */
+void occlusion_query_program_changed(GLuint program);
+
+/* Advance the frame count results age by; called from prismgl_frame_end */
+void occlusion_query_frame_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OCCLUSION_QUERY_H */
@@ -40,6 +40,19 @@ extern "C" {
 /* Quads */
 #define GL_QUADS                    0x0007
 #define GL_QUAD_STRIP               0x0008
+#define GL_POLYGON                  0x0009
+
+/* Fixed-function matrices */
+#define GL_MODELVIEW                0x1700
+#define GL_PROJECTION               0x1701
+#define GL_MATRIX_MODE              0x0BA0
+#define GL_MODELVIEW_MATRIX         0x0BA6
+#define GL_PROJECTION_MATRIX        0x0BA7
+#define GL_TEXTURE_MATRIX           0x0BA8
+
+/* Display lists */
+#define GL_COMPILE                  0x1300
+#define GL_COMPILE_AND_EXECUTE      0x1301
 
 /* Texture targets */
 #define GL_TEXTURE_1D               0x0DE0
@@ -64,6 +77,8 @@ extern "C" {
 #ifndef GL_READ_FRAMEBUFFER
 #define GL_READ_FRAMEBUFFER         0x8CA8
 #endif
+#define GL_FRONT_LEFT               0x0400
+#define GL_BACK_LEFT                0x0402
 
 /* Clip distance */
 #define GL_CLIP_DISTANCE0           0x3000
@@ -120,6 +135,34 @@ extern "C" {
 #endif
 #define GL_TEXTURE_SWIZZLE_RGBA     0x8E46
 
+/* Desktop pixel formats, converted on upload, see texture_convert.h */
+#ifndef GL_BGR
+#define GL_BGR                      0x80E0
+#endif
+#ifndef GL_BGRA
+#define GL_BGRA                     0x80E1
+#endif
+#define GL_UNSIGNED_INT_8_8_8_8     0x8035
+#define GL_UNSIGNED_INT_8_8_8_8_REV 0x8367
+#define GL_UNSIGNED_SHORT_5_6_5_REV 0x8364
+#define GL_ALPHA8                   0x803C
+#define GL_ALPHA16                  0x803E
+#define GL_LUMINANCE8               0x8040
+#define GL_LUMINANCE16              0x8042
+#define GL_LUMINANCE8_ALPHA8        0x8045
+#define GL_LUMINANCE16_ALPHA16      0x8048
+#define GL_INTENSITY                0x8049
+#define GL_INTENSITY8               0x804B
+#define GL_INTENSITY16              0x804D
+#define GL_RGB16                    0x8054
+#define GL_RGBA16                   0x805B
+#ifndef GL_R16
+#define GL_R16                      0x822A
+#endif
+#ifndef GL_RG16
+#define GL_RG16                     0x822C
+#endif
+
 /* Program binary */
 #ifndef GL_PROGRAM_BINARY_LENGTH
 #define GL_PROGRAM_BINARY_LENGTH    0x8741
@@ -194,12 +237,19 @@ extern "C" {
 
 typedef struct {
     bool shader_cache_enabled;
-    bool draw_call_batching;
+    bool draw_call_batching;      /* Trampolines every entry point, so opt-in; see draw_batch.h */
     bool adaptive_resolution;
     bool async_texture_loading;
     bool vulkan_backend;          /* Use Vulkan via ANGLE/Zink if available */
+    bool threaded_dispatch;       /* Replay GL calls on a dedicated thread, see gl_thread.h */
+    bool auto_instancing;         /* Collapse repeated draws into instanced ones, see draw_instance.h */
+    bool texture_compression;     /* ETC2-encode large async uploads, see texture_compress.h */
+    bool immutable_textures;      /* Promote per-level definitions to glTexStorage, see texture_storage.h */
+    bool texture_upload_batching; /* Stage small glTexSubImage2D calls, see texture_batch.h */
     float resolution_scale;       /* 0.25 - 1.0 */
     int max_cached_shaders;
+    int texture_budget_mb;        /* 0 = from GPU tier and RAM, < 0 = unlimited, see texture_budget.h */
+    int occlusion_query_latency;  /* Frames an occlusion result may lag, 0 = wait, see occlusion_query.h */
     int gpu_vendor;               /* 0=unknown, 1=Adreno, 2=Mali, 3=PowerVR */
     char cache_dir[512];
 } PrismGLConfig;
@@ -223,21 +273,69 @@ void prismgl_shader_cache_put(uint64_t hash, GLuint program);
 uint64_t prismgl_hash_shader_source(const char* vertex_src, const char* fragment_src);
 
 /* ===== Draw Call Batching ===== */
+/* Draws between begin and flush are grouped by program, VAO, textures and
+ * blend/depth state. Other GL calls made through PrismGL's entry points,
+ * and matrix changes, submit the recorded draws first; uniforms set
+ * behind its back must stay fixed for the whole batch. glDrawElements and
+ * glDrawElementsBaseVertex calls made while a batch is open are recorded
+ * as well, when every entry point is observed (see draw_batch.c). */
 void prismgl_batch_begin(void);
 void prismgl_batch_flush(void);
 void prismgl_batch_draw(GLenum mode, GLint first, GLsizei count);
+void prismgl_batch_draw_elements(GLenum mode, GLsizei count, GLenum type,
+                                 const void* indices, GLint basevertex);
+
+/* ===== Frame Boundary ===== */
+/* Called once per presented frame (eglSwapBuffers override or launcher) */
+void prismgl_frame_end(void);
+/* Redundant state calls filtered vs. forwarded to the driver last frame */
+void prismgl_get_state_stats(uint32_t* filtered, uint32_t* forwarded);
+/* Draws recorded by the batcher vs. driver draw calls they became last frame */
+void prismgl_get_batch_stats(uint32_t* draws_in, uint32_t* draws_out);
+/* GL jobs (gl_jobs.h) finished last frame vs. still queued */
+void prismgl_get_job_stats(uint32_t* completed, uint32_t* pending);
+/* Draws held for automatic instancing vs. driver draw calls they became
+ * last frame */
+void prismgl_get_instance_stats(uint32_t* draws_in, uint32_t* draws_out);
+/* glTexSubImage2D calls staged vs. driver uploads they became, and their
+ * bytes, last frame */
+void prismgl_get_texture_upload_stats(uint32_t* uploads_in, uint32_t* uploads_out,
+                                      uint32_t* bytes);
+/* Estimated texture memory now, at most so far, and the budget (0 if unlimited) */
+void prismgl_get_texture_memory(size_t* usage, size_t* peak, size_t* budget);
+/* Cross-check glGet answers served from the state shadow against the
+ * driver (on by default in debug builds) */
+void prismgl_set_state_validation(bool enable);
 
 /* ===== Adaptive Resolution ===== */
 void prismgl_set_resolution_scale(float scale);
 float prismgl_get_resolution_scale(void);
 void prismgl_update_adaptive_resolution(float current_fps, float target_fps);
+/* Smoothed GPU time per frame in ms from timer queries, 0 while unknown */
+float prismgl_get_gpu_frame_time(void);
 
 /* ===== Async Texture Loading ===== */
+/*
+ * With async_texture_loading the texture is created over the next frames
+ * and `cb` runs on the presenting thread once it is resident; `data` must
+ * stay valid until then. Otherwise it is created before returning.
+ */
 typedef void (*prismgl_texture_callback)(GLuint texture_id, void* userdata);
 void prismgl_async_texture_load(const void* data, int width, int height,
                                  GLenum format, prismgl_texture_callback cb,
                                  void* userdata);
 
+/* ===== Texture Readback ===== */
+/*
+ * glGetTexImage without stalling: the bound texture's level is read into a
+ * pixel pack buffer and `cb` runs from a later prismgl_frame_end, once the
+ * GPU is done, with tightly packed pixels valid only during the call. On
+ * context loss `cb` receives NULL. Returns false if the level is unknown.
+ */
+typedef void (*prismgl_readback_callback)(const void* pixels, size_t size, void* userdata);
+bool prismgl_get_tex_image_async(GLenum target, GLint level, GLenum format, GLenum type,
+                                 prismgl_readback_callback cb, void* userdata);
+
 /* ===== OpenGL Function Wrappers ===== */
 /* These are the main entry points that translate GL 4.x calls to GLES 3.x */
 void prismgl_glPolygonMode(GLenum face, GLenum mode);
@@ -273,6 +371,32 @@ void prismgl_glTexImage3D_wrapper(GLenum target, GLint level, GLint internalform
                                    GLsizei width, GLsizei height, GLsizei depth,
                                    GLint border, GLenum format, GLenum type,
                                    const void* pixels);
+void prismgl_glTexImage2D_wrapper(GLenum target, GLint level, GLint internalformat,
+                                   GLsizei width, GLsizei height, GLint border,
+                                   GLenum format, GLenum type, const void* pixels);
+void prismgl_glTexSubImage2D_wrapper(GLenum target, GLint level, GLint xoffset,
+                                      GLint yoffset, GLsizei width, GLsizei height,
+                                      GLenum format, GLenum type, const void* pixels);
+void prismgl_glCompressedTexImage2D_wrapper(GLenum target, GLint level, GLenum internalformat,
+                                             GLsizei width, GLsizei height, GLint border,
+                                             GLsizei image_size, const void* data);
+void prismgl_glCopyTexImage2D_wrapper(GLenum target, GLint level, GLenum internalformat,
+                                       GLint x, GLint y, GLsizei width, GLsizei height,
+                                       GLint border);
+void prismgl_glCompressedTexSubImage2D_wrapper(GLenum target, GLint level, GLint xoffset,
+                                                GLint yoffset, GLsizei width, GLsizei height,
+                                                GLenum format, GLsizei image_size,
+                                                const void* data);
+void prismgl_glCopyTexSubImage2D_wrapper(GLenum target, GLint level, GLint xoffset,
+                                          GLint yoffset, GLint x, GLint y,
+                                          GLsizei width, GLsizei height);
+void prismgl_glTexStorage2D_wrapper(GLenum target, GLsizei levels, GLenum internalformat,
+                                     GLsizei width, GLsizei height);
+void prismgl_glTexStorage3D_wrapper(GLenum target, GLsizei levels, GLenum internalformat,
+                                     GLsizei width, GLsizei height, GLsizei depth);
+void prismgl_glTexParameteri_wrapper(GLenum target, GLenum pname, GLint param);
+void prismgl_glGenerateMipmap_wrapper(GLenum target);
+void prismgl_glPixelStorei_wrapper(GLenum pname, GLint param);
 void prismgl_glPushMatrix(void);
 void prismgl_glPopMatrix(void);
 void prismgl_glLoadIdentity(void);
@@ -292,16 +416,116 @@ void prismgl_glVertexPointer(GLint size, GLenum type, GLsizei stride, const void
 void prismgl_glColorPointer(GLint size, GLenum type, GLsizei stride, const void* pointer);
 void prismgl_glTexCoordPointer(GLint size, GLenum type, GLsizei stride, const void* pointer);
 void prismgl_glNormalPointer(GLenum type, GLsizei stride, const void* pointer);
+void prismgl_glBindTexture_wrapper(GLenum target, GLuint texture);
+void prismgl_glUseProgram_wrapper(GLuint program);
+void prismgl_glLinkProgram_wrapper(GLuint program);
+void prismgl_glDeleteProgram_wrapper(GLuint program);
+void prismgl_glUniform1f_wrapper(GLint location, GLfloat v0);
+void prismgl_glUniform2f_wrapper(GLint location, GLfloat v0, GLfloat v1);
+void prismgl_glUniform3f_wrapper(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+void prismgl_glUniform4f_wrapper(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+void prismgl_glUniform1i_wrapper(GLint location, GLint v0);
+void prismgl_glUniform2i_wrapper(GLint location, GLint v0, GLint v1);
+void prismgl_glUniform3i_wrapper(GLint location, GLint v0, GLint v1, GLint v2);
+void prismgl_glUniform4i_wrapper(GLint location, GLint v0, GLint v1, GLint v2, GLint v3);
+void prismgl_glUniform1fv_wrapper(GLint location, GLsizei count, const GLfloat* value);
+void prismgl_glUniform2fv_wrapper(GLint location, GLsizei count, const GLfloat* value);
+void prismgl_glUniform3fv_wrapper(GLint location, GLsizei count, const GLfloat* value);
+void prismgl_glUniform4fv_wrapper(GLint location, GLsizei count, const GLfloat* value);
+void prismgl_glUniform1iv_wrapper(GLint location, GLsizei count, const GLint* value);
+void prismgl_glUniform2iv_wrapper(GLint location, GLsizei count, const GLint* value);
+void prismgl_glUniform3iv_wrapper(GLint location, GLsizei count, const GLint* value);
+void prismgl_glUniform4iv_wrapper(GLint location, GLsizei count, const GLint* value);
+void prismgl_glUniformMatrix2fv_wrapper(GLint location, GLsizei count, GLboolean transpose,
+                                        const GLfloat* value);
+void prismgl_glUniformMatrix3fv_wrapper(GLint location, GLsizei count, GLboolean transpose,
+                                        const GLfloat* value);
+void prismgl_glUniformMatrix4fv_wrapper(GLint location, GLsizei count, GLboolean transpose,
+                                        const GLfloat* value);
+void prismgl_glDrawArrays_wrapper(GLenum mode, GLint first, GLsizei count);
+void prismgl_glDrawElements_wrapper(GLenum mode, GLsizei count, GLenum type,
+                                    const void* indices);
+void prismgl_glDrawArraysInstanced_wrapper(GLenum mode, GLint first, GLsizei count,
+                                           GLsizei instancecount);
+void prismgl_glMultiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count,
+                               GLsizei drawcount);
+void prismgl_glMultiDrawElements(GLenum mode, const GLsizei* count, GLenum type,
+                                 const void* const* indices, GLsizei drawcount);
+void prismgl_glMultiDrawElementsBaseVertex(GLenum mode, const GLsizei* count, GLenum type,
+                                           const void* const* indices, GLsizei drawcount,
+                                           const GLint* basevertex);
+void prismgl_glDrawElementsInstanced_wrapper(GLenum mode, GLsizei count, GLenum type,
+                                             const void* indices, GLsizei instancecount);
+void prismgl_glDrawElementsBaseVertex_wrapper(GLenum mode, GLsizei count, GLenum type,
+                                              const void* indices, GLint basevertex);
+void prismgl_glBufferData_wrapper(GLenum target, GLsizeiptr size, const void* data,
+                                  GLenum usage);
+void prismgl_glBufferSubData_wrapper(GLenum target, GLintptr offset, GLsizeiptr size,
+                                     const void* data);
+void* prismgl_glMapBufferRange_wrapper(GLenum target, GLintptr offset, GLsizeiptr length,
+                                       GLbitfield access);
+void prismgl_glCopyBufferSubData_wrapper(GLenum read_target, GLenum write_target,
+                                         GLintptr read_offset, GLintptr write_offset,
+                                         GLsizeiptr size);
+void prismgl_glDeleteBuffers_wrapper(GLsizei n, const GLuint* buffers);
+void prismgl_glActiveTexture_wrapper(GLenum texture);
+void prismgl_glDeleteTextures_wrapper(GLsizei n, const GLuint* textures);
+void prismgl_glBindBuffer_wrapper(GLenum target, GLuint buffer);
+void prismgl_glBindBufferBase_wrapper(GLenum target, GLuint index, GLuint buffer);
+void prismgl_glBindBufferRange_wrapper(GLenum target, GLuint index, GLuint buffer,
+                                       GLintptr offset, GLsizeiptr size);
+void prismgl_glBindVertexArray_wrapper(GLuint array);
+void prismgl_glDeleteVertexArrays_wrapper(GLsizei n, const GLuint* arrays);
+void prismgl_glBlendFunc_wrapper(GLenum sfactor, GLenum dfactor);
+void prismgl_glBlendFuncSeparate_wrapper(GLenum src_rgb, GLenum dst_rgb,
+                                         GLenum src_alpha, GLenum dst_alpha);
+void prismgl_glDepthMask_wrapper(GLboolean flag);
+void prismgl_glBindFramebuffer_wrapper(GLenum target, GLuint framebuffer);
+void prismgl_glClear_wrapper(GLbitfield mask);
+void prismgl_glBlitFramebuffer_wrapper(GLint src_x0, GLint src_y0, GLint src_x1, GLint src_y1,
+                                       GLint dst_x0, GLint dst_y0, GLint dst_x1, GLint dst_y1,
+                                       GLbitfield mask, GLenum filter);
+void prismgl_glReadPixels_wrapper(GLint x, GLint y, GLsizei width, GLsizei height,
+                                  GLenum format, GLenum type, void* pixels);
+void prismgl_glFlush_wrapper(void);
+void prismgl_glFinish_wrapper(void);
+GLsync prismgl_glFenceSync_wrapper(GLenum condition, GLbitfield flags);
+void prismgl_glFramebufferTexture2D_wrapper(GLenum target, GLenum attachment, GLenum textarget,
+                                            GLuint texture, GLint level);
+void prismgl_glFramebufferTextureLayer_wrapper(GLenum target, GLenum attachment,
+                                               GLuint texture, GLint level, GLint layer);
+void prismgl_glDeleteFramebuffers_wrapper(GLsizei n, const GLuint* framebuffers);
+void prismgl_glViewport_wrapper(GLint x, GLint y, GLsizei width, GLsizei height);
+void prismgl_glScissor_wrapper(GLint x, GLint y, GLsizei width, GLsizei height);
+EGLBoolean prismgl_eglSwapBuffers(EGLDisplay display, EGLSurface surface);
+EGLContext prismgl_eglCreateContext(EGLDisplay display, EGLConfig config,
+                                    EGLContext share_context, const EGLint* attrib_list);
+EGLBoolean prismgl_eglMakeCurrent(EGLDisplay display, EGLSurface draw,
+                                  EGLSurface read, EGLContext context);
+EGLBoolean prismgl_eglDestroyContext(EGLDisplay display, EGLContext context);
+
+/* Display lists (legacy) */
+GLuint prismgl_glGenLists(GLsizei range);
+void prismgl_glDeleteLists(GLuint list, GLsizei range);
+GLboolean prismgl_glIsList(GLuint list);
+void prismgl_glNewList(GLuint list, GLenum mode);
+void prismgl_glEndList(void);
+void prismgl_glCallList(GLuint list);
+void prismgl_glCallLists(GLsizei n, GLenum type, const void* lists);
+void prismgl_glListBase(GLuint base);
 
 /* Depth clamp and point size */
 void prismgl_glEnable_wrapper(GLenum cap);
 void prismgl_glDisable_wrapper(GLenum cap);
 void prismgl_glGetIntegerv_wrapper(GLenum pname, GLint* params);
 void prismgl_glGetFloatv_wrapper(GLenum pname, GLfloat* params);
+void prismgl_glGetInteger64v_wrapper(GLenum pname, GLint64* params);
+void prismgl_glGetBooleanv_wrapper(GLenum pname, GLboolean* params);
+GLboolean prismgl_glIsEnabled_wrapper(GLenum cap);
 const GLubyte* prismgl_glGetString_wrapper(GLenum name);
 const GLubyte* prismgl_glGetStringi_wrapper(GLenum name, GLuint index);
 
-/* Query objects - stub implementation for Minecraft */
+/* Query objects; timer queries need EXT_disjoint_timer_query */
 void prismgl_glGenQueries(GLsizei n, GLuint* ids);
 void prismgl_glDeleteQueries(GLsizei n, const GLuint* ids);
 void prismgl_glBeginQuery_wrapper(GLenum target, GLuint id);
@@ -0,0 +1,60 @@
+/*
+ * PrismGL Internal Definitions
+ * Types and helpers shared between PrismGL translation units
+ */
+
+#ifndef PRISMGL_INTERNAL_H
+#define PRISMGL_INTERNAL_H
+
+#include "prismgl.h"
+
+/* SIMD selection for the CPU-side kernels */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PRISMGL_HAVE_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PRISMGL_HAVE_SSE2 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Vertex attribute locations used by fixed-function emulation */
+#define PRISMGL_ATTRIB_POSITION     0
+#define PRISMGL_ATTRIB_COLOR        1
+#define PRISMGL_ATTRIB_TEXCOORD     2
+#define PRISMGL_ATTRIB_NORMAL       3
+
+/* Interleaved vertex produced by glBegin/glEnd emulation */
+typedef struct {
+    GLfloat x, y, z;
+    GLfloat r, g, b, a;
+    GLfloat s, t;
+    GLfloat nx, ny, nz;
+} ImmediateVertex;
+
+/* Current (glColor/glTexCoord/glNormal) attribute values */
+typedef struct {
+    GLfloat r, g, b, a;
+    GLfloat s, t;
+    GLfloat nx, ny, nz;
+} ImmediateAttribs;
+
+/* Per-context gl_wrapper.c state, see context.h */
+void* prismgl_wrapper_create_state(void);
+void prismgl_wrapper_destroy_state(void* state);
+
+void prismgl_immediate_get_attribs(ImmediateAttribs* out);
+void prismgl_immediate_set_attribs(const ImmediateAttribs* attribs);
+
+/* Point the fixed-function attribute locations at an ImmediateVertex
+ * buffer bound to GL_ARRAY_BUFFER and enable them on the current VAO */
+void prismgl_immediate_setup_attribs(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PRISMGL_INTERNAL_H */
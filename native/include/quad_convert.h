@@ -0,0 +1,58 @@
+/*
+ * PrismGL Quad Conversion
+ * GL_QUADS / GL_QUAD_STRIP / GL_POLYGON draws rewritten for OpenGL ES
+ */
+
+#ifndef QUAD_CONVERT_H
+#define QUAD_CONVERT_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Draw `count` vertices starting at `first` with a legacy primitive mode.
+ * GL_QUADS is drawn as triangles through a shared quad index buffer,
+ * GL_QUAD_STRIP and GL_POLYGON are remapped to strip/fan. Returns false
+ * (and draws nothing) if `mode` is already a valid ES primitive.
+ */
+bool quad_convert_draw_arrays(GLenum mode, GLint first, GLsizei count,
+                              GLsizei instancecount);
+
+/*
+ * Indexed variant. Indices in the bound GL_ELEMENT_ARRAY_BUFFER are
+ * converted once and cached per (buffer, offset, count, type); client
+ * memory indices are converted into a stream buffer on every call.
+ */
+bool quad_convert_draw_elements(GLenum mode, GLsizei count, GLenum type,
+                                const void* indices, GLsizei instancecount,
+                                GLint basevertex);
+
+/*
+ * Name of the shared GL_UNSIGNED_SHORT quad index buffer, grown to cover
+ * at least `quads` quads (at most 16384). Callers may keep it bound in
+ * their own VAOs. Returns 0 on failure.
+ */
+GLuint quad_convert_shared_indices(GLsizei quads);
+
+/* Drop cached conversions of the buffer bound to `target` after a write */
+void quad_convert_invalidate_target(GLenum target);
+
+/* Drop cached conversions of deleted buffers */
+void quad_convert_invalidate_buffers(GLsizei n, const GLuint* buffers);
+
+/* Per-context index buffers and caches, see context.h */
+void* quad_convert_create_state(void);
+void quad_convert_destroy_state(void* state);
+
+/* Release the GL objects of the current context */
+void quad_convert_shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* QUAD_CONVERT_H */
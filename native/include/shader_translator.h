@@ -8,6 +8,7 @@
 
 #include <GLES3/gl32.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -39,6 +40,32 @@ char* shader_patch_extensions(const char* source);
 char* shader_patch_precision(const char* source, GLenum shader_type);
 char* shader_patch_samplers(const char* source);
 char* shader_patch_builtins(const char* source);
+char* shader_patch_fixed_function(const char* source, GLenum shader_type);
+
+/*
+ * Sample counting for GL_SAMPLES_PASSED (occlusion_query.c). Fragment
+ * shaders that neither discard nor write gl_FragDepth are given early
+ * fragment tests and increment the atomic counter at `binding` while the
+ * uniform prismgl_CountSamples is nonzero. Applied by shader_translate()
+ * once a binding is set; -1 turns it off. The patch returns NULL for
+ * shaders it does not apply to.
+ */
+void shader_translator_set_sample_counter(int binding);
+char* shader_patch_sample_counter(const char* source, int binding);
+
+/*
+ * Rewrites for automatic instancing (draw_instance.c). The uniform `name`
+ * must be declared as `uniform [precision] <type> <name>;`; it becomes the
+ * per-instance vertex input prismgl_Instance<index>, and in the fragment
+ * shader a flat input the vertex shader forwards when `forward` is set.
+ * The rewrites return NULL if the uniform is declared any other way.
+ */
+bool shader_declares_uniform(const char* source, const char* name);
+bool shader_uniform_type(const char* source, const char* name, char* type, size_t size);
+char* shader_instance_vertex(const char* source, const char* name, const char* type,
+                             int index, bool forward);
+char* shader_instance_fragment(const char* source, const char* name, const char* type,
+                               int index);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,132 @@
+/*
+ * PrismGL State Shadow
+ * Client-side copy of frequently toggled GL state used to drop
+ * redundant driver calls
+ */
+
+#ifndef STATE_SHADOW_H
+#define STATE_SHADOW_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STATE_KEY_TEXTURE_UNITS 4
+
+/*
+ * Draw state of the draw batcher's sort key. Names are stored like the
+ * shadow stores them, name + 1 with 0 meaning unknown; unknown fields
+ * are skipped by state_shadow_apply_key().
+ */
+typedef struct {
+    GLuint program;
+    GLuint vertex_array;
+    GLuint textures[STATE_KEY_TEXTURE_UNITS];   /* GL_TEXTURE_2D of units 0..3 */
+    GLuint depth_mask;
+    GLenum blend[4];                            /* All 0 when unknown */
+    uint32_t blend_known;                       /* blend[] holds a glBlendFuncSeparate */
+    uint32_t caps_known;
+    uint32_t caps_enabled;
+} StateDrawKey;
+
+typedef struct {
+    uint32_t filtered;      /* Calls dropped because the state already matched */
+    uint32_t forwarded;     /* Calls that reached the driver */
+} StateShadowStats;
+
+/* Per-context shadow storage, see context.h */
+void* state_shadow_create_state(void);
+void state_shadow_destroy_state(void* state);
+
+/* Forget all shadowed values; the next call of each kind is forwarded */
+void state_shadow_reset(void);
+
+/*
+ * Shadow-aware versions of the GL entry points. Each forwards to the
+ * driver only when the call would change state. PrismGL's own code uses
+ * these as well so the shadow never goes stale.
+ */
+void state_shadow_enable(GLenum cap, bool enable);
+void state_shadow_active_texture(GLenum unit);
+void state_shadow_bind_texture(GLenum target, GLuint texture);
+void state_shadow_bind_buffer(GLenum target, GLuint buffer);
+void state_shadow_bind_vertex_array(GLuint vao);
+void state_shadow_use_program(GLuint program);
+void state_shadow_blend_func(GLenum src_rgb, GLenum dst_rgb,
+                             GLenum src_alpha, GLenum dst_alpha);
+void state_shadow_depth_mask(GLboolean flag);
+void state_shadow_pixel_store(GLenum pname, GLint param);
+
+void state_shadow_bind_framebuffer(GLenum target, GLuint framebuffer);
+void state_shadow_framebuffer_texture_2d(GLenum target, GLenum attachment, GLenum textarget,
+                                         GLuint texture, GLint level);
+void state_shadow_framebuffer_texture_layer(GLenum target, GLenum attachment, GLuint texture,
+                                            GLint level, GLint layer);
+void state_shadow_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void state_shadow_scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+
+/* Binding query of a buffer target, e.g. GL_ARRAY_BUFFER_BINDING; 0 if none */
+GLenum state_shadow_buffer_binding(GLenum target);
+
+/* glBindBufferBase/Range also replace the generic binding of `target` */
+void state_shadow_buffer_bound_indexed(GLenum target, GLuint buffer);
+
+/* Whether `texture` is bound to any unit, as far as the shadow knows */
+bool state_shadow_texture_bound(GLuint texture);
+
+/* Delete objects and clear any shadowed binding that referenced them */
+void state_shadow_delete_buffers(GLsizei n, const GLuint* buffers);
+void state_shadow_delete_textures(GLsizei n, const GLuint* textures);
+void state_shadow_delete_vertex_arrays(GLsizei n, const GLuint* arrays);
+void state_shadow_delete_framebuffers(GLsizei n, const GLuint* framebuffers);
+
+/*
+ * Delete `texture`, bound to `target`, and put a fresh texture of the same
+ * name in its place: bound on every unit that held it and attached where it
+ * was attached through this context's framebuffers, as far as the shadow
+ * knows. Other contexts of the share group keep the old object attached.
+ */
+void state_shadow_recreate_texture(GLenum target, GLuint texture);
+
+/*
+ * glGetIntegerv / glIsEnabled answered from the shadow when the value is
+ * known. Otherwise the driver is queried once and the answer remembered.
+ * Pnames the shadow does not track are forwarded unchanged.
+ */
+void state_shadow_get_integerv(GLenum pname, GLint* params);
+
+/* Shadowed value only; returns false without querying when it is unknown */
+bool state_shadow_peek_integerv(GLenum pname, GLint* params);
+GLboolean state_shadow_is_enabled(GLenum cap);
+
+/* Debug aid: compare every shadow answer with the driver and log mismatches */
+void state_shadow_set_validation(bool enable);
+
+/* Snapshot the draw state that decides whether two draws can share a submission */
+void state_shadow_capture_key(StateDrawKey* key);
+
+/* Bind every known field of `key` through the shadow; the active unit is kept */
+void state_shadow_apply_key(const StateDrawKey* key);
+
+/* Whether draw keys capture `cap`, and a bind of `target` on the active unit */
+bool state_shadow_key_has_cap(GLenum cap);
+bool state_shadow_key_has_texture(GLenum target);
+
+/* Depth tested and unblended: draws with such keys may be reordered */
+bool state_shadow_key_opaque(const StateDrawKey* key);
+
+/* Close the current frame's counters */
+void state_shadow_frame_end(void);
+
+/* Counters of the last frame completed by any context */
+void state_shadow_get_stats(StateShadowStats* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATE_SHADOW_H */
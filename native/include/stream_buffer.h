@@ -0,0 +1,44 @@
+/*
+ * PrismGL Stream Buffer
+ * Ring-allocated GL buffer for per-draw vertex/index uploads
+ */
+
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    GLenum target;
+    GLuint buffer;
+    GLsizeiptr size;
+    GLsizeiptr offset;     /* Next free byte */
+    bool mapped;
+} StreamBuffer;
+
+/* Create the buffer object; `size` is the initial ring size in bytes */
+bool stream_buffer_init(StreamBuffer* sb, GLenum target, GLsizeiptr size);
+void stream_buffer_destroy(StreamBuffer* sb);
+
+/*
+ * Bind the buffer to its target and map `size` bytes for writing.
+ * Appends without synchronization while space remains and orphans the
+ * whole buffer when the ring wraps. Returns NULL on failure; on success
+ * *out_offset receives the byte offset of the mapped range.
+ */
+void* stream_buffer_map(StreamBuffer* sb, GLsizeiptr size, GLsizeiptr* out_offset);
+void stream_buffer_unmap(StreamBuffer* sb);
+
+/* Copy `size` bytes into the ring. Returns the offset, or -1 on failure. */
+GLsizeiptr stream_buffer_upload(StreamBuffer* sb, const void* data, GLsizeiptr size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STREAM_BUFFER_H */
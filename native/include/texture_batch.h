@@ -0,0 +1,55 @@
+/*
+ * PrismGL Texture Upload Batching
+ * Small glTexSubImage2D calls staged and submitted together from one pixel
+ * unpack buffer, with adjacent rectangles merged
+ */
+
+#ifndef TEXTURE_BATCH_H
+#define TEXTURE_BATCH_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t uploads_in;    /* glTexSubImage2D calls staged */
+    uint32_t uploads_out;   /* Driver uploads they were submitted as */
+    uint32_t bytes;         /* Pixel bytes submitted */
+} TextureBatchStats;
+
+/* Per-context staging memory and unpack buffer, see context.h */
+void* texture_batch_create_state(void);
+void texture_batch_destroy_state(void* state);
+
+/*
+ * Stage glTexSubImage2D of client memory into `texture`, bound to
+ * `target`. Returns false if the caller must upload it now.
+ */
+bool texture_batch_sub_image_2d(GLuint texture, GLenum target, GLint level, GLint xoffset,
+                                GLint yoffset, GLsizei width, GLsizei height, GLenum format,
+                                GLenum type, const void* pixels);
+
+/*
+ * Submit staged uploads. Called before anything that could observe them:
+ * draws and clears, redefinitions, copies, deletes and readbacks of
+ * textures, blits and glReadPixels, glFlush, glFinish and glFenceSync, and
+ * the end of the frame. Other contexts sharing the textures see them only
+ * after that.
+ */
+void texture_batch_flush(void);
+
+/* Close the current frame's counters */
+void texture_batch_frame_end(void);
+
+/* Counters of the last frame completed by any context */
+void texture_batch_get_stats(TextureBatchStats* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEXTURE_BATCH_H */
@@ -0,0 +1,49 @@
+/*
+ * PrismGL Texture Budget
+ * Keeps the estimated texture memory of the registry under a budget derived
+ * from the GPU tier and device RAM, by allocating large textures a level
+ * smaller and dropping the top level of cold ones
+ */
+
+#ifndef TEXTURE_BUDGET_H
+#define TEXTURE_BUDGET_H
+
+#include "gpu_detect.h"
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Smallest width or height a texture needs before it is ever reduced */
+#define TEXTURE_BUDGET_MIN_SIZE 256
+
+/* Derive the automatic budget; called from prismgl_init */
+void texture_budget_init(const GPUInfo* info);
+
+/*
+ * Budget in bytes, 0 when unlimited. Follows PrismGLConfig.texture_budget_mb:
+ * positive values are megabytes, 0 is the automatic budget, negative is none.
+ */
+size_t texture_budget_bytes(void);
+
+/* Mark `texture` as used this frame; called on every bind */
+void texture_budget_touch(GLuint texture);
+
+/*
+ * Whether a new width x height chain of `internal_format` should be
+ * allocated a level smaller to stay under the budget
+ */
+bool texture_budget_should_reduce(GLenum internal_format, GLsizei width, GLsizei height);
+
+/* Drop the top level of a cold texture while over budget; called from prismgl_frame_end */
+void texture_budget_frame_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEXTURE_BUDGET_H */
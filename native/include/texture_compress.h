@@ -0,0 +1,59 @@
+/*
+ * PrismGL Texture Compression
+ * CPU ETC2 encoding of large textures (atlases, skyboxes) before upload,
+ * with results cached on disk by content hash
+ */
+
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include "gpu_detect.h"
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Smallest width and height worth compressing */
+#define TEXTURE_COMPRESS_MIN_SIZE 256
+
+/* Pick the target format and open <cache_dir>/textures; called from prismgl_init */
+void texture_compress_init(const GPUInfo* info, const char* cache_dir);
+
+/*
+ * Whether an upload of tightly packed GL_RGB or GL_RGBA bytes should be
+ * compressed. Requested through PrismGLConfig.texture_compression.
+ */
+bool texture_compress_eligible(int width, int height, GLenum format);
+
+/* Compressed internal format used for `format` (GL_RGB or GL_RGBA) */
+GLenum texture_compress_format(GLenum format);
+
+/* Number of levels in a full mip chain */
+int texture_compress_levels(int width, int height);
+
+/* Bytes of one compressed level, and of a full chain of them */
+size_t texture_compress_level_size(int width, int height, GLenum format);
+size_t texture_compress_chain_size(int width, int height, GLenum format);
+
+/*
+ * Write the compressed mip chain of `pixels`, level 0 first, to `out`,
+ * which holds texture_compress_chain_size() bytes. Reads and fills the
+ * disk cache. Safe to call from any thread; returns false on failure.
+ */
+bool texture_compress_chain(const void* pixels, int width, int height, GLenum format,
+                            void* out, size_t size);
+
+/* Encode one 4x4 block of RGBA8 pixels, stored column by column (x * 4 + y) */
+void texture_compress_etc2_rgb(const uint8_t block[16][4], uint8_t out[8]);
+void texture_compress_eac_alpha(const uint8_t block[16][4], uint8_t out[8]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEXTURE_COMPRESS_H */
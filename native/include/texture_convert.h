@@ -0,0 +1,93 @@
+/*
+ * PrismGL Texture Convert
+ * Rewrites desktop-only glTexImage2D/glTexSubImage2D formats (BGRA,
+ * 8_8_8_8 packing, 16-bit normalized, luminance/alpha, 5_6_5_REV) into
+ * ES ones, with a texture swizzle where that alone suffices
+ */
+
+#ifndef TEXTURE_CONVERT_H
+#define TEXTURE_CONVERT_H
+
+#include "prismgl.h"
+#include "texture_registry.h"
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* CPU pass an upload needs before ES accepts it */
+typedef enum {
+    TEXTURE_CONVERT_NONE = 0,
+    TEXTURE_CONVERT_SWAP_RB,        /* 8-bit BGRA <-> RGBA */
+    TEXTURE_CONVERT_SWAP_RB_RGB,    /* 8-bit BGR <-> RGB */
+    TEXTURE_CONVERT_REVERSE,        /* Bytes ABGR -> RGBA */
+    TEXTURE_CONVERT_ROTATE,         /* Bytes ARGB -> RGBA */
+    TEXTURE_CONVERT_NARROW16,       /* 16-bit normalized components -> 8-bit */
+    TEXTURE_CONVERT_SWAP_565,       /* 5_6_5_REV -> 5_6_5 */
+} TextureConvertKernel;
+
+typedef struct {
+    GLint internal_format;          /* What ES is given */
+    GLenum format;
+    GLenum type;
+    TextureConvertKernel kernel;
+    TextureSwizzle swizzle;         /* The texture's swizzle after this upload */
+} TextureUploadPlan;
+
+/* Unpack state replaced while a converted copy is uploaded */
+typedef struct {
+    GLint buffer;
+    GLint alignment;
+    GLint row_length;
+    GLint skip_rows;
+    GLint skip_pixels;
+} TextureUnpackState;
+
+/*
+ * Plan an upload into a texture stored with swizzle `stored`. Level 0
+ * definitions pass `define` and may pick a new swizzle; sub-images and
+ * other levels follow the stored one. Returns false when the call can go
+ * to ES unchanged.
+ */
+bool texture_convert_plan(GLint internalformat, GLenum format, GLenum type,
+                          TextureSwizzle stored, bool define, TextureUploadPlan* out);
+
+/* Internal format for glTexStorage*, and the swizzle it needs */
+GLenum texture_convert_storage_format(GLenum internalformat, TextureSwizzle* swizzle);
+
+/* Set the swizzle of `texture`, bound to `target`, and record it */
+void texture_convert_set_swizzle(GLuint texture, GLenum target, TextureSwizzle swizzle);
+
+/*
+ * Save the unpack alignment, row length and skips into `saved`, if given,
+ * and set them up for tightly packed rows; restore puts them back. Both go
+ * through the state shadow, so neither queries the driver.
+ */
+void texture_convert_unpack_tight(TextureUnpackState* saved);
+void texture_convert_unpack_restore(const TextureUnpackState* saved);
+
+/*
+ * Run plan->kernel over a width x height image read with the current
+ * unpack state from `pixels`, a client pointer or unpack buffer offset.
+ * On success *out is a tightly packed copy and the unpack state is set up
+ * to upload it; texture_convert_end() frees it and restores the state.
+ */
+bool texture_convert_begin(const TextureUploadPlan* plan, GLenum format, GLenum type,
+                           GLsizei width, GLsizei height, const void* pixels,
+                           void** out, TextureUnpackState* saved);
+void texture_convert_end(void* converted, const TextureUnpackState* saved);
+
+/* Convert `count` pixels; src and dst may be the same memory */
+void texture_convert_pixels(TextureConvertKernel kernel, const void* src, void* dst,
+                            size_t count, int components);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEXTURE_CONVERT_H */
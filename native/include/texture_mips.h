@@ -0,0 +1,48 @@
+/*
+ * PrismGL Texture Mips
+ * CPU box-filter mip chains for textures created on worker threads,
+ * replacing glGenerateMipmap on the GL thread
+ */
+
+#ifndef TEXTURE_MIPS_H
+#define TEXTURE_MIPS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Levels of a full chain down to 1x1 */
+int texture_mips_levels(int width, int height);
+
+/* Dimensions of `level`, as glTexStorage2D computes them */
+void texture_mips_level_size(int width, int height, int level, int* level_width,
+                             int* level_height);
+
+/* Bytes of a tightly packed chain of `bpp` (3 or 4) byte texels */
+size_t texture_mips_chain_size(int width, int height, int bpp);
+
+/*
+ * Halve a tightly packed level with a 2x2 box filter; odd edges reuse the
+ * last row or column. With `srgb` the colour channels are averaged as
+ * linear light and re-encoded; alpha is always averaged as stored.
+ */
+void texture_mips_downsample(const uint8_t* src, int width, int height, int bpp,
+                             bool srgb, uint8_t* dst);
+
+/*
+ * Write level 0 followed by every smaller level to `out`, which holds
+ * texture_mips_chain_size() bytes and is only written. Safe to call from
+ * any thread; returns false if out of memory.
+ */
+bool texture_mips_build_chain(const uint8_t* pixels, int width, int height, int bpp,
+                              bool srgb, uint8_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEXTURE_MIPS_H */
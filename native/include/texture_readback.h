@@ -0,0 +1,41 @@
+/*
+ * PrismGL Texture Readback
+ * glGetTexImage through a framebuffer kept per context, and its
+ * asynchronous variant reading into a pixel pack buffer
+ */
+
+#ifndef TEXTURE_READBACK_H
+#define TEXTURE_READBACK_H
+
+#include "prismgl.h"
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Per-context readback framebuffer, buffer pool and pending reads, see context.h */
+void* texture_readback_create_state(void);
+void texture_readback_destroy_state(void* state);
+
+/*
+ * glGetTexImage of the texture bound to `target` (2D, cube face, 2D array
+ * or 3D). Honours the pack state, including a bound pixel pack buffer.
+ */
+void texture_readback_get_image(GLenum target, GLint level, GLenum format, GLenum type,
+                                void* pixels);
+
+/* Queue a read of the bound texture, see prismgl_get_tex_image_async */
+bool texture_readback_async(GLenum target, GLint level, GLenum format, GLenum type,
+                            prismgl_readback_callback cb, void* userdata);
+
+/* Deliver the reads whose fence has signalled; called from prismgl_frame_end */
+void texture_readback_frame_end(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEXTURE_READBACK_H */
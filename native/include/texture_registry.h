@@ -0,0 +1,121 @@
+/*
+ * PrismGL Texture Registry
+ * Target, immutability and per-level dimensions of every texture defined
+ * through PrismGL, so readback and memory accounting need no driver
+ * queries
+ */
+
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TEXTURE_REGISTRY_MAX_LEVELS 16
+
+typedef struct {
+    GLsizei width;              /* 0 while the level is undefined */
+    GLsizei height;
+    GLsizei depth;              /* Layers of array textures, 1 for 2D */
+    GLenum internal_format;
+} TextureLevel;
+
+/* Swizzle PrismGL put on a texture so an ES format samples like the desktop one */
+typedef enum {
+    TEXTURE_SWIZZLE_NONE = 0,
+    TEXTURE_SWIZZLE_BGRA,               /* Stored with red and blue swapped */
+    TEXTURE_SWIZZLE_LUMINANCE,          /* R8 sampled as (L, L, L, 1) */
+    TEXTURE_SWIZZLE_ALPHA,              /* R8 sampled as (0, 0, 0, A) */
+    TEXTURE_SWIZZLE_LUMINANCE_ALPHA,    /* RG8 sampled as (L, L, L, A) */
+    TEXTURE_SWIZZLE_INTENSITY,          /* R8 sampled as (I, I, I, I) */
+} TextureSwizzle;
+
+typedef struct {
+    GLuint name;
+    GLenum target;              /* Binding target, GL_TEXTURE_CUBE_MAP for faces */
+    bool immutable;             /* Defined by glTexStorage* */
+    bool promoted;              /* Storage allocated by texture_storage, not the application */
+    bool max_level_set;         /* GL_TEXTURE_MAX_LEVEL set by the application */
+    GLint max_level;
+    GLint dropped;              /* Top levels left out by the memory budget, see texture_budget.h */
+    TextureSwizzle swizzle;
+    size_t bytes;               /* Estimated memory of every defined level */
+    TextureLevel levels[TEXTURE_REGISTRY_MAX_LEVELS];
+} TextureInfo;
+
+/* Target a texture is bound to; cube faces map to the cube */
+GLenum texture_registry_binding_target(GLenum target);
+
+/* Texture bound to `target` on the active unit; cube faces map to the cube */
+GLuint texture_registry_bound(GLenum target);
+
+/* Record a glTexImage*, glCompressedTexImage* or glCopyTexImage2D level */
+void texture_registry_define(GLuint texture, GLenum target, GLint level,
+                             GLenum internal_format, GLsizei width, GLsizei height,
+                             GLsizei depth);
+
+/* Record glTexStorage* of `levels` levels */
+void texture_registry_define_storage(GLuint texture, GLenum target, GLsizei levels,
+                                     GLenum internal_format, GLsizei width,
+                                     GLsizei height, GLsizei depth);
+
+/* Derive every smaller level from level 0 after glGenerateMipmap */
+void texture_registry_generate_mipmaps(GLuint texture);
+
+/* Record GL_TEXTURE_MAX_LEVEL */
+void texture_registry_set_max_level(GLuint texture, GLenum target, GLint max_level);
+
+/*
+ * Mark storage as allocated by texture_storage; clearing it also forgets
+ * the levels, for a texture recreated as mutable
+ */
+void texture_registry_set_promoted(GLuint texture, bool promoted);
+
+/*
+ * Record that the storage of `texture` starts `dropped` levels below the
+ * ones the application defines
+ */
+void texture_registry_set_dropped(GLuint texture, GLint dropped);
+GLint texture_registry_dropped(GLuint texture);
+
+/* Swizzle set by texture_registry_set_swizzle, NONE for unknown textures */
+TextureSwizzle texture_registry_swizzle(GLuint texture);
+void texture_registry_set_swizzle(GLuint texture, GLenum target, TextureSwizzle swizzle);
+
+/* Copy out a texture's record; false if it was never defined through PrismGL */
+bool texture_registry_lookup(GLuint texture, TextureInfo* out);
+
+/* Dimensions of one level; false if unknown */
+bool texture_registry_level(GLuint texture, GLint level, TextureLevel* out);
+
+void texture_registry_delete(GLsizei n, const GLuint* textures);
+
+/* Estimated bytes of all registered textures, now and at most */
+void texture_registry_get_usage(size_t* usage, size_t* peak);
+
+/*
+ * Largest texture `filter` accepts, 0 if none. `filter` runs with the
+ * registry locked and must not call back into it.
+ */
+GLuint texture_registry_largest(bool (*filter)(const TextureInfo* info, void* ctx), void* ctx);
+
+/* Forget every texture; called from prismgl_shutdown */
+void texture_registry_shutdown(void);
+
+/* Bytes of one client pixel of format/type, 0 if not a plain layout */
+size_t texture_pixel_size(GLenum format, GLenum type);
+
+/* Estimated bytes a level of `internal_format` occupies in GPU memory */
+size_t texture_level_bytes(GLenum internal_format, GLsizei width, GLsizei height,
+                           GLsizei depth);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEXTURE_REGISTRY_H */
@@ -0,0 +1,54 @@
+/*
+ * PrismGL Texture Storage
+ * Promotes textures defined one glTexImage level at a time to a single
+ * immutable glTexStorage allocation
+ */
+
+#ifndef TEXTURE_STORAGE_H
+#define TEXTURE_STORAGE_H
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Define `level` of `texture`, bound to `target`, as glTexImage2D would.
+ * A smaller level that does not fit promoted storage is left out, and a
+ * level 0 that does not fit recreates the texture. Returns false when the
+ * texture is not promoted; the caller then issues glTexImage2D and records
+ * the level itself.
+ */
+bool texture_storage_image_2d(GLuint texture, GLenum target, GLint level,
+                              GLint internalformat, GLsizei width, GLsizei height,
+                              GLint border, GLenum format, GLenum type, const void* pixels);
+
+/* The same for glTexImage3D on 3D and 2D array textures */
+bool texture_storage_image_3d(GLuint texture, GLenum target, GLint level,
+                              GLint internalformat, GLsizei width, GLsizei height,
+                              GLsizei depth, GLint border, GLenum format, GLenum type,
+                              const void* pixels);
+
+/*
+ * glTexSubImage2D into a texture the memory budget allocated a level
+ * smaller. Returns false for every other texture; the caller then issues
+ * the call itself.
+ */
+bool texture_storage_sub_image_2d(GLuint texture, GLenum target, GLint level, GLint xoffset,
+                                  GLint yoffset, GLsizei width, GLsizei height, GLenum format,
+                                  GLenum type, const void* pixels);
+
+/*
+ * Reallocate a promoted 2D texture without its top level, keeping the
+ * contents of the others. Needs glCopyImageSubData (ES 3.2); false if the
+ * texture does not qualify.
+ */
+bool texture_storage_drop_level(GLuint texture);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEXTURE_STORAGE_H */
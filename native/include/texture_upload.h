@@ -0,0 +1,35 @@
+/*
+ * PrismGL Texture Upload
+ * Asynchronous texture creation behind prismgl_async_texture_load: pixels
+ * are copied into a pixel unpack buffer by a worker, the GL upload runs as
+ * a frame-end job (gl_jobs.h), and completion is reported once a fence
+ * behind the upload has signalled
+ */
+
+#ifndef TEXTURE_UPLOAD_H
+#define TEXTURE_UPLOAD_H
+
+#include "prismgl.h"
+
+#include <GLES3/gl32.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Queue the creation of a mipmapped GL_TEXTURE_2D from tightly packed
+ * GL_RGB or GL_RGBA bytes, ETC2 compressed if texture_compress_eligible().
+ * Colour is taken to be sRGB encoded when the smaller levels are filtered. `data` must stay valid until `cb` runs; it runs
+ * on the presenting thread, with texture 0 if the upload was dropped at
+ * shutdown. Returns false if nothing was queued.
+ */
+bool texture_upload_submit(const void* data, int width, int height, GLenum format,
+                           prismgl_texture_callback cb, void* userdata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TEXTURE_UPLOAD_H */
@@ -0,0 +1,35 @@
+/*
+ * PrismGL Worker Pool
+ * A few background threads, started on first use, for CPU work that must
+ * stay off the render thread. Workers have no GL context.
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*WorkerFunc)(void* data);
+
+/*
+ * Run `func(data)` on a worker. Returns false if no worker could be
+ * started or the task could not be queued; the caller then does the work
+ * itself.
+ */
+bool worker_pool_submit(WorkerFunc func, void* data);
+
+/* Number of workers, 0 before the first submission */
+int worker_pool_size(void);
+
+/* Finish every queued task and stop the workers; called from prismgl_shutdown */
+void worker_pool_shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WORKER_POOL_H */
@@ -0,0 +1,532 @@
+/*
+ * PrismGL Client Arrays
+ * ES 3 rejects client-memory vertex pointers on non-default VAOs, so the
+ * legacy gl*Pointer state is recorded here and, at draw time, only the
+ * vertex range the draw actually references is copied (interleaved, in a
+ * single pass) into a stream buffer and drawn through a private VAO.
+ */
+
+#include "client_arrays.h"
+#include "stream_buffer.h"
+#include "quad_convert.h"
+#include "state_shadow.h"
+#include "context.h"
+#include "prismgl_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-ClientArrays"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+#define STREAM_VERTEX_SIZE (4 * 1024 * 1024)
+#define STREAM_INDEX_SIZE  (1 * 1024 * 1024)
+
+enum { CA_VERTEX = 0, CA_COLOR, CA_TEXCOORD, CA_NORMAL, CA_COUNT };
+
+typedef struct {
+    bool enabled;
+    GLint size;
+    GLenum type;
+    GLsizei stride;         /* As specified; 0 means tightly packed */
+    const void* pointer;
+    GLuint buffer;          /* GL_ARRAY_BUFFER at pointer time, 0 = client memory */
+} ClientArray;
+
+/* One enabled client array as laid out in the interleaved stream vertex */
+typedef struct {
+    const uint8_t* src;
+    GLsizei src_stride;
+    int src_size;
+    int dst_size;
+    int dst_offset;
+    bool from_double;
+} CopyOp;
+
+static const GLuint g_locations[CA_COUNT] = {
+    PRISMGL_ATTRIB_POSITION, PRISMGL_ATTRIB_COLOR,
+    PRISMGL_ATTRIB_TEXCOORD, PRISMGL_ATTRIB_NORMAL
+};
+
+/* Client array state of one GL context */
+typedef struct {
+    ClientArray arrays[CA_COUNT];
+    bool active;            /* Any enabled array sources client memory */
+    GLuint vao;
+    StreamBuffer vertices;
+    StreamBuffer indices;
+    bool objects_created;
+} ClientState;
+
+static const ClientState g_client_defaults = {
+    .arrays = {
+        [CA_VERTEX]   = { .size = 4, .type = GL_FLOAT },
+        [CA_COLOR]    = { .size = 4, .type = GL_FLOAT },
+        [CA_TEXCOORD] = { .size = 4, .type = GL_FLOAT },
+        [CA_NORMAL]   = { .size = 3, .type = GL_FLOAT },
+    },
+    .active = false,
+    .objects_created = false
+};
+
+static inline ClientState* client_state(void) {
+    return (ClientState*)prismgl_context_state(PRISMGL_STATE_CLIENT_ARRAYS);
+}
+
+void* client_arrays_create_state(void) {
+    ClientState* ca = (ClientState*)malloc(sizeof(ClientState));
+    if (ca) *ca = g_client_defaults;
+    return ca;
+}
+
+void client_arrays_destroy_state(void* state) {
+    free(state);
+}
+
+static int array_index(GLenum array) {
+    switch (array) {
+        case GL_VERTEX_ARRAY:        return CA_VERTEX;
+        case GL_COLOR_ARRAY:         return CA_COLOR;
+        case GL_TEXTURE_COORD_ARRAY: return CA_TEXCOORD;
+        case GL_NORMAL_ARRAY:        return CA_NORMAL;
+        default:                     return -1;
+    }
+}
+
+static int type_size(GLenum type) {
+    switch (type) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:  return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:     return 2;
+        case GL_DOUBLE:         return 8;
+        default:                return 4;
+    }
+}
+
+static bool is_normalized(int index, GLenum type) {
+    /* Integer colors and normals are normalized, positions/texcoords are not */
+    if (index != CA_COLOR && index != CA_NORMAL) return false;
+    return type != GL_FLOAT && type != GL_HALF_FLOAT && type != GL_DOUBLE;
+}
+
+static void update_active(ClientState* ca) {
+    ca->active = false;
+    for (int i = 0; i < CA_COUNT; i++) {
+        if (ca->arrays[i].enabled && ca->arrays[i].buffer == 0) {
+            ca->active = true;
+        }
+    }
+}
+
+/* ===== State entry points ===== */
+
+void client_arrays_enable(GLenum array, bool enable) {
+    ClientState* ca = client_state();
+    int index = array_index(array);
+    if (index < 0) return;
+
+    ClientArray* a = &ca->arrays[index];
+    a->enabled = enable;
+
+    /* Buffer-backed arrays behave like generic attributes on the current VAO */
+    if (a->buffer != 0) {
+        if (enable) glEnableVertexAttribArray(g_locations[index]);
+        else glDisableVertexAttribArray(g_locations[index]);
+    }
+    update_active(ca);
+}
+
+void client_arrays_pointer(GLenum array, GLint size, GLenum type,
+                           GLsizei stride, const void* pointer) {
+    ClientState* ca = client_state();
+    int index = array_index(array);
+    if (index < 0) return;
+
+    GLint bound = 0;
+    state_shadow_get_integerv(GL_ARRAY_BUFFER_BINDING, &bound);
+
+    ClientArray* a = &ca->arrays[index];
+    a->size = size;
+    a->type = type;
+    a->stride = stride;
+    a->pointer = pointer;
+    a->buffer = (GLuint)bound;
+
+    if (a->buffer != 0) {
+        if (type == GL_DOUBLE) {
+            LOGW("GL_DOUBLE arrays in buffer objects are not supported in ES");
+        }
+        glVertexAttribPointer(g_locations[index], size, type,
+                              is_normalized(index, type) ? GL_TRUE : GL_FALSE,
+                              stride, pointer);
+        if (a->enabled) glEnableVertexAttribArray(g_locations[index]);
+    }
+    update_active(ca);
+}
+
+bool client_arrays_active(void) {
+    return client_state()->active;
+}
+
+/* ===== Index range scan ===== */
+
+static void range_u8(const GLubyte* p, GLsizei count, GLuint* out_min, GLuint* out_max) {
+    GLsizei i = 0;
+    GLubyte lo = 0xFF, hi = 0;
+#if defined(PRISMGL_HAVE_NEON)
+    if (count >= 16) {
+        uint8x16_t vmin = vdupq_n_u8(0xFF), vmax = vdupq_n_u8(0);
+        for (; i + 16 <= count; i += 16) {
+            uint8x16_t v = vld1q_u8(p + i);
+            vmin = vminq_u8(vmin, v);
+            vmax = vmaxq_u8(vmax, v);
+        }
+        GLubyte lanes_min[16], lanes_max[16];
+        vst1q_u8(lanes_min, vmin);
+        vst1q_u8(lanes_max, vmax);
+        for (int l = 0; l < 16; l++) {
+            if (lanes_min[l] < lo) lo = lanes_min[l];
+            if (lanes_max[l] > hi) hi = lanes_max[l];
+        }
+    }
+#elif defined(PRISMGL_HAVE_SSE2)
+    if (count >= 16) {
+        __m128i vmin = _mm_set1_epi8((char)0xFF), vmax = _mm_setzero_si128();
+        for (; i + 16 <= count; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+            vmin = _mm_min_epu8(vmin, v);
+            vmax = _mm_max_epu8(vmax, v);
+        }
+        GLubyte lanes_min[16], lanes_max[16];
+        _mm_storeu_si128((__m128i*)lanes_min, vmin);
+        _mm_storeu_si128((__m128i*)lanes_max, vmax);
+        for (int l = 0; l < 16; l++) {
+            if (lanes_min[l] < lo) lo = lanes_min[l];
+            if (lanes_max[l] > hi) hi = lanes_max[l];
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        if (p[i] < lo) lo = p[i];
+        if (p[i] > hi) hi = p[i];
+    }
+    *out_min = lo;
+    *out_max = hi;
+}
+
+static void range_u16(const GLushort* p, GLsizei count, GLuint* out_min, GLuint* out_max) {
+    GLsizei i = 0;
+    GLushort lo = 0xFFFF, hi = 0;
+#if defined(PRISMGL_HAVE_NEON)
+    if (count >= 8) {
+        uint16x8_t vmin = vdupq_n_u16(0xFFFF), vmax = vdupq_n_u16(0);
+        for (; i + 8 <= count; i += 8) {
+            uint16x8_t v = vld1q_u16(p + i);
+            vmin = vminq_u16(vmin, v);
+            vmax = vmaxq_u16(vmax, v);
+        }
+        GLushort lanes_min[8], lanes_max[8];
+        vst1q_u16(lanes_min, vmin);
+        vst1q_u16(lanes_max, vmax);
+        for (int l = 0; l < 8; l++) {
+            if (lanes_min[l] < lo) lo = lanes_min[l];
+            if (lanes_max[l] > hi) hi = lanes_max[l];
+        }
+    }
+#elif defined(PRISMGL_HAVE_SSE2)
+    if (count >= 8) {
+        /* SSE2 only has signed 16-bit min/max: bias into signed range */
+        const __m128i bias = _mm_set1_epi16((short)0x8000);
+        __m128i vmin = _mm_set1_epi16(0x7FFF), vmax = _mm_set1_epi16((short)0x8000);
+        for (; i + 8 <= count; i += 8) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p + i)), bias);
+            vmin = _mm_min_epi16(vmin, v);
+            vmax = _mm_max_epi16(vmax, v);
+        }
+        GLushort lanes_min[8], lanes_max[8];
+        _mm_storeu_si128((__m128i*)lanes_min, _mm_xor_si128(vmin, bias));
+        _mm_storeu_si128((__m128i*)lanes_max, _mm_xor_si128(vmax, bias));
+        for (int l = 0; l < 8; l++) {
+            if (lanes_min[l] < lo) lo = lanes_min[l];
+            if (lanes_max[l] > hi) hi = lanes_max[l];
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        if (p[i] < lo) lo = p[i];
+        if (p[i] > hi) hi = p[i];
+    }
+    *out_min = lo;
+    *out_max = hi;
+}
+
+static void range_u32(const GLuint* p, GLsizei count, GLuint* out_min, GLuint* out_max) {
+    GLsizei i = 0;
+    GLuint lo = 0xFFFFFFFFu, hi = 0;
+#if defined(PRISMGL_HAVE_NEON)
+    if (count >= 4) {
+        uint32x4_t vmin = vdupq_n_u32(0xFFFFFFFFu), vmax = vdupq_n_u32(0);
+        for (; i + 4 <= count; i += 4) {
+            uint32x4_t v = vld1q_u32(p + i);
+            vmin = vminq_u32(vmin, v);
+            vmax = vmaxq_u32(vmax, v);
+        }
+        GLuint lanes_min[4], lanes_max[4];
+        vst1q_u32(lanes_min, vmin);
+        vst1q_u32(lanes_max, vmax);
+        for (int l = 0; l < 4; l++) {
+            if (lanes_min[l] < lo) lo = lanes_min[l];
+            if (lanes_max[l] > hi) hi = lanes_max[l];
+        }
+    }
+#elif defined(PRISMGL_HAVE_SSE2)
+    if (count >= 4) {
+        /* Unsigned compare via signed compare on biased values */
+        const __m128i bias = _mm_set1_epi32((int)0x80000000u);
+        __m128i vmin = _mm_set1_epi32(0x7FFFFFFF), vmax = _mm_set1_epi32((int)0x80000000u);
+        for (; i + 4 <= count; i += 4) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p + i)), bias);
+            __m128i lt = _mm_cmplt_epi32(v, vmin);
+            __m128i gt = _mm_cmpgt_epi32(v, vmax);
+            vmin = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, vmin));
+            vmax = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, vmax));
+        }
+        GLuint lanes_min[4], lanes_max[4];
+        _mm_storeu_si128((__m128i*)lanes_min, _mm_xor_si128(vmin, bias));
+        _mm_storeu_si128((__m128i*)lanes_max, _mm_xor_si128(vmax, bias));
+        for (int l = 0; l < 4; l++) {
+            if (lanes_min[l] < lo) lo = lanes_min[l];
+            if (lanes_max[l] > hi) hi = lanes_max[l];
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        if (p[i] < lo) lo = p[i];
+        if (p[i] > hi) hi = p[i];
+    }
+    *out_min = lo;
+    *out_max = hi;
+}
+
+void client_arrays_index_range(GLenum type, const void* indices, GLsizei count,
+                               GLuint* out_min, GLuint* out_max) {
+    *out_min = 0;
+    *out_max = 0;
+    if (!indices || count <= 0) return;
+
+    switch (type) {
+        case GL_UNSIGNED_BYTE:  range_u8((const GLubyte*)indices, count, out_min, out_max); break;
+        case GL_UNSIGNED_SHORT: range_u16((const GLushort*)indices, count, out_min, out_max); break;
+        case GL_UNSIGNED_INT:   range_u32((const GLuint*)indices, count, out_min, out_max); break;
+        default: break;
+    }
+}
+
+/* ===== Emulated draws ===== */
+
+static void ensure_objects(ClientState* ca) {
+    if (ca->objects_created) return;
+    glGenVertexArrays(1, &ca->vao);
+    state_shadow_bind_vertex_array(ca->vao);
+    stream_buffer_init(&ca->vertices, GL_ARRAY_BUFFER, STREAM_VERTEX_SIZE);
+    stream_buffer_init(&ca->indices, GL_ELEMENT_ARRAY_BUFFER, STREAM_INDEX_SIZE);
+    ca->objects_created = true;
+}
+
+static int index_size(GLenum type) {
+    switch (type) {
+        case GL_UNSIGNED_BYTE:  return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        default:                return 4;
+    }
+}
+
+/*
+ * Bind the private VAO and point it at vertices [start, start + count) of
+ * every enabled array. Client arrays are interleaved into the stream
+ * buffer so that vertex `start` lands at index 0. Returns false when there
+ * is nothing to draw.
+ */
+static bool setup_vertex_range(GLuint start, GLuint count) {
+    ClientState* ca = client_state();
+    CopyOp ops[CA_COUNT];
+    int op_index[CA_COUNT];
+    int op_count = 0;
+    int vertex_size = 0;
+
+    if (!ca->arrays[CA_VERTEX].enabled || count == 0) return false;
+
+    for (int i = 0; i < CA_COUNT; i++) {
+        const ClientArray* a = &ca->arrays[i];
+        op_index[i] = -1;
+        if (!a->enabled || a->buffer != 0) continue;
+
+        CopyOp* op = &ops[op_count];
+        op->src_size = a->size * type_size(a->type);
+        op->src_stride = a->stride ? a->stride : op->src_size;
+        op->src = (const uint8_t*)a->pointer + (size_t)start * op->src_stride;
+        op->from_double = a->type == GL_DOUBLE;
+        op->dst_size = op->from_double ? a->size * (int)sizeof(GLfloat) : op->src_size;
+        op->dst_offset = vertex_size;
+        vertex_size += (op->dst_size + 3) & ~3;
+        op_index[i] = op_count++;
+    }
+
+    ensure_objects(ca);
+    state_shadow_bind_vertex_array(ca->vao);
+
+    GLsizeiptr base = 0;
+    if (op_count > 0) {
+        uint8_t* dst = (uint8_t*)stream_buffer_map(&ca->vertices,
+                                                   (GLsizeiptr)count * vertex_size, &base);
+        if (!dst) return false;
+
+        /* Single pass: each output vertex is written once, all arrays at a time */
+        for (GLuint v = 0; v < count; v++) {
+            uint8_t* out = dst + (size_t)v * vertex_size;
+            for (int o = 0; o < op_count; o++) {
+                const CopyOp* op = &ops[o];
+                const uint8_t* src = op->src + (size_t)v * op->src_stride;
+                if (op->from_double) {
+                    GLfloat* f = (GLfloat*)(out + op->dst_offset);
+                    int n = op->dst_size / (int)sizeof(GLfloat);
+                    for (int c = 0; c < n; c++) {
+                        double d;
+                        memcpy(&d, src + c * sizeof(double), sizeof(double));
+                        f[c] = (GLfloat)d;
+                    }
+                } else {
+                    memcpy(out + op->dst_offset, src, (size_t)op->src_size);
+                }
+            }
+        }
+        stream_buffer_unmap(&ca->vertices);
+    }
+
+    ImmediateAttribs current;
+    prismgl_immediate_get_attribs(&current);
+
+    for (int i = 0; i < CA_COUNT; i++) {
+        const ClientArray* a = &ca->arrays[i];
+        GLuint loc = g_locations[i];
+        GLboolean normalized = is_normalized(i, a->type) ? GL_TRUE : GL_FALSE;
+
+        if (!a->enabled) {
+            glDisableVertexAttribArray(loc);
+            if (i == CA_COLOR) {
+                glVertexAttrib4f(loc, current.r, current.g, current.b, current.a);
+            } else if (i == CA_TEXCOORD) {
+                glVertexAttrib4f(loc, current.s, current.t, 0.0f, 1.0f);
+            } else if (i == CA_NORMAL) {
+                glVertexAttrib4f(loc, current.nx, current.ny, current.nz, 1.0f);
+            }
+            continue;
+        }
+
+        glEnableVertexAttribArray(loc);
+        if (op_index[i] >= 0) {
+            const CopyOp* op = &ops[op_index[i]];
+            state_shadow_bind_buffer(GL_ARRAY_BUFFER, ca->vertices.buffer);
+            glVertexAttribPointer(loc, a->size, op->from_double ? GL_FLOAT : a->type,
+                                  normalized, vertex_size,
+                                  (const void*)(uintptr_t)(base + op->dst_offset));
+        } else {
+            /* Buffer-backed array: shift its offset so `start` is vertex 0 */
+            GLsizei stride = a->stride ? a->stride : a->size * type_size(a->type);
+            state_shadow_bind_buffer(GL_ARRAY_BUFFER, a->buffer);
+            glVertexAttribPointer(loc, a->size, a->type, normalized, a->stride,
+                                  (const uint8_t*)a->pointer + (size_t)start * stride);
+        }
+    }
+    return true;
+}
+
+static void restore_bindings(GLint vao, GLint array_buffer) {
+    state_shadow_bind_vertex_array((GLuint)vao);
+    state_shadow_bind_buffer(GL_ARRAY_BUFFER, (GLuint)array_buffer);
+}
+
+bool client_arrays_draw_arrays(GLenum mode, GLint first, GLsizei count) {
+    if (first < 0 || count <= 0) return true;
+
+    GLint prev_vao = 0, prev_array_buffer = 0;
+    state_shadow_get_integerv(GL_VERTEX_ARRAY_BINDING, &prev_vao);
+    state_shadow_get_integerv(GL_ARRAY_BUFFER_BINDING, &prev_array_buffer);
+
+    if (setup_vertex_range((GLuint)first, (GLuint)count) &&
+        !quad_convert_draw_arrays(mode, 0, count, 1)) {
+        glDrawArrays(mode, 0, count);
+    }
+
+    restore_bindings(prev_vao, prev_array_buffer);
+    return true;
+}
+
+bool client_arrays_draw_elements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    ClientState* ca = client_state();
+    if (count <= 0) return true;
+
+    GLint prev_vao = 0, prev_array_buffer = 0, element_buffer = 0;
+    state_shadow_get_integerv(GL_VERTEX_ARRAY_BINDING, &prev_vao);
+    state_shadow_get_integerv(GL_ARRAY_BUFFER_BINDING, &prev_array_buffer);
+    state_shadow_get_integerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &element_buffer);
+
+    GLsizeiptr bytes = (GLsizeiptr)count * index_size(type);
+    GLuint min_index = 0, max_index = 0;
+
+    if (element_buffer != 0) {
+        /* Indices live in a buffer object: read them back once for the scan */
+        const void* mapped = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER,
+                                              (GLintptr)(uintptr_t)indices, bytes,
+                                              GL_MAP_READ_BIT);
+        if (!mapped) {
+            LOGE("glDrawElements: cannot read index buffer %d", element_buffer);
+            return false;
+        }
+        client_arrays_index_range(type, mapped, count, &min_index, &max_index);
+        glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    } else {
+        client_arrays_index_range(type, indices, count, &min_index, &max_index);
+    }
+
+    if (setup_vertex_range(min_index, max_index - min_index + 1)) {
+        const void* offset = indices;
+        if (mode == GL_QUADS || mode == GL_QUAD_STRIP || mode == GL_POLYGON) {
+            /* The converter reads the source indices itself */
+            state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, (GLuint)element_buffer);
+            quad_convert_draw_elements(mode, count, type, indices, 1, -(GLint)min_index);
+            restore_bindings(prev_vao, prev_array_buffer);
+            return true;
+        }
+        if (element_buffer != 0) {
+            state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, (GLuint)element_buffer);
+        } else {
+            GLsizeiptr at = stream_buffer_upload(&ca->indices, indices, bytes);
+            if (at < 0) {
+                restore_bindings(prev_vao, prev_array_buffer);
+                return true;
+            }
+            offset = (const void*)(uintptr_t)at;
+        }
+        /* Vertices were rebased so that min_index is vertex 0 */
+        glDrawElementsBaseVertex(mode, count, type, offset, -(GLint)min_index);
+    }
+
+    restore_bindings(prev_vao, prev_array_buffer);
+    return true;
+}
+
+void client_arrays_shutdown(void) {
+    ClientState* ca = client_state();
+    if (ca->objects_created) {
+        stream_buffer_destroy(&ca->vertices);
+        stream_buffer_destroy(&ca->indices);
+        state_shadow_delete_vertex_arrays(1, &ca->vao);
+        ca->vao = 0;
+        ca->objects_created = false;
+    }
+}
@@ -0,0 +1,240 @@
+/*
+ * PrismGL Context Registry
+ * Every EGL context gets its own immediate-mode buffers, state shadow,
+ * matrix stacks, client arrays, quad conversion caches, indirect
+ * command buffer and draw batch, so shared upload contexts and worker threads never see
+ * each other's state. The hot path is one thread-local load; the registry
+ * itself is only locked when a context is created, made current or
+ * destroyed.
+ */
+
+#include "context.h"
+#include "prismgl.h"
+#include "prismgl_internal.h"
+#include "state_shadow.h"
+#include "matrix_stack.h"
+#include "client_arrays.h"
+#include "quad_convert.h"
+#include "multi_draw.h"
+#include "draw_batch.h"
+#include "draw_instance.h"
+#include "texture_readback.h"
+#include "texture_batch.h"
+#include "gpu_timer.h"
+#include "occlusion_query.h"
+#include "display_list.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Context"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+typedef struct {
+    void* (*create)(void);
+    void (*destroy)(void* state);
+} StateOps;
+
+static const StateOps g_state_ops[PRISMGL_STATE_COUNT] = {
+    [PRISMGL_STATE_WRAPPER]       = { prismgl_wrapper_create_state, prismgl_wrapper_destroy_state },
+    [PRISMGL_STATE_SHADOW]        = { state_shadow_create_state,    state_shadow_destroy_state },
+    [PRISMGL_STATE_MATRICES]      = { matrix_stack_create_state,    matrix_stack_destroy_state },
+    [PRISMGL_STATE_CLIENT_ARRAYS] = { client_arrays_create_state,   client_arrays_destroy_state },
+    [PRISMGL_STATE_QUADS]         = { quad_convert_create_state,    quad_convert_destroy_state },
+    [PRISMGL_STATE_MULTI_DRAW]    = { multi_draw_create_state,      multi_draw_destroy_state },
+    [PRISMGL_STATE_BATCH]         = { draw_batch_create_state,      draw_batch_destroy_state },
+    [PRISMGL_STATE_INSTANCE]      = { draw_instance_create_state,   draw_instance_destroy_state },
+    [PRISMGL_STATE_READBACK]      = { texture_readback_create_state, texture_readback_destroy_state },
+    [PRISMGL_STATE_TEXTURE_BATCH] = { texture_batch_create_state,   texture_batch_destroy_state },
+    [PRISMGL_STATE_TIMER]         = { gpu_timer_create_state,       gpu_timer_destroy_state },
+    [PRISMGL_STATE_OCCLUSION]     = { occlusion_query_create_state, occlusion_query_destroy_state },
+    [PRISMGL_STATE_DISPLAY_LISTS] = { display_list_create_state,    display_list_destroy_state },
+};
+
+_Thread_local PrismGLContext* prismgl_tls_context = NULL;
+
+static pthread_mutex_t g_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static PrismGLContext* g_contexts = NULL;
+
+/* Used by threads without a current context, where GL calls are no-ops */
+static PrismGLContext g_fallback = {
+    .display = EGL_NO_DISPLAY,
+    .egl_context = EGL_NO_CONTEXT,
+    .share_context = EGL_NO_CONTEXT
+};
+
+/* Unbinds the context of an exiting thread so pending destroys complete */
+static pthread_key_t g_thread_key;
+static pthread_once_t g_thread_key_once = PTHREAD_ONCE_INIT;
+
+/* ===== Registry (g_registry_lock held) ===== */
+
+static PrismGLContext* find_locked(EGLDisplay display, EGLContext context) {
+    for (PrismGLContext* ctx = g_contexts; ctx; ctx = ctx->next) {
+        if (ctx->egl_context == context && ctx->display == display) return ctx;
+    }
+    return NULL;
+}
+
+static PrismGLContext* register_locked(EGLDisplay display, EGLContext context,
+                                       EGLContext share) {
+    PrismGLContext* ctx = (PrismGLContext*)calloc(1, sizeof(PrismGLContext));
+    if (!ctx) {
+        LOGE("Failed to allocate context state");
+        return NULL;
+    }
+    ctx->display = display;
+    ctx->egl_context = context;
+    ctx->share_context = share;
+    ctx->next = g_contexts;
+    g_contexts = ctx;
+    return ctx;
+}
+
+static void unlink_locked(PrismGLContext* ctx) {
+    for (PrismGLContext** it = &g_contexts; *it; it = &(*it)->next) {
+        if (*it == ctx) {
+            *it = ctx->next;
+            ctx->next = NULL;
+            return;
+        }
+    }
+}
+
+static void free_context(PrismGLContext* ctx) {
+    for (int i = 0; i < PRISMGL_STATE_COUNT; i++) {
+        if (ctx->state[i]) g_state_ops[i].destroy(ctx->state[i]);
+    }
+    free(ctx);
+}
+
+static void unbind_locked(PrismGLContext* ctx) {
+    if (!ctx || ctx == &g_fallback) return;
+    ctx->bind_count--;
+    if (ctx->destroy_pending && ctx->bind_count <= 0) {
+        free_context(ctx);
+    }
+}
+
+static void thread_exit(void* value) {
+    pthread_mutex_lock(&g_registry_lock);
+    unbind_locked((PrismGLContext*)value);
+    pthread_mutex_unlock(&g_registry_lock);
+}
+
+static void create_thread_key(void) {
+    pthread_key_create(&g_thread_key, thread_exit);
+}
+
+/* ===== Lookup ===== */
+
+PrismGLContext* prismgl_context_resolve(void) {
+    EGLContext current = eglGetCurrentContext();
+    if (current == EGL_NO_CONTEXT) return &g_fallback;
+
+    prismgl_context_make_current(eglGetCurrentDisplay(), current);
+    return prismgl_tls_context ? prismgl_tls_context : &g_fallback;
+}
+
+void* prismgl_context_create_state(PrismGLContext* ctx, PrismGLStateSlot slot) {
+    if (!ctx) ctx = prismgl_context_resolve();
+
+    /* Locked because threads without a context share the fallback */
+    pthread_mutex_lock(&g_registry_lock);
+    if (!ctx->state[slot]) {
+        ctx->state[slot] = g_state_ops[slot].create();
+    }
+    void* state = ctx->state[slot];
+    pthread_mutex_unlock(&g_registry_lock);
+
+    if (!state) {
+        LOGE("Out of memory creating context state %d", slot);
+        abort();
+    }
+    return state;
+}
+
+/* ===== EGL lifecycle ===== */
+
+void prismgl_context_created(EGLDisplay display, EGLContext context, EGLContext share) {
+    pthread_mutex_lock(&g_registry_lock);
+    if (!find_locked(display, context)) {
+        register_locked(display, context, share);
+    }
+    pthread_mutex_unlock(&g_registry_lock);
+}
+
+void prismgl_context_make_current(EGLDisplay display, EGLContext context) {
+    pthread_once(&g_thread_key_once, create_thread_key);
+
+    PrismGLContext* ctx = NULL;
+    pthread_mutex_lock(&g_registry_lock);
+    if (context != EGL_NO_CONTEXT) {
+        /* Contexts created before PrismGL was loaded are adopted here */
+        ctx = find_locked(display, context);
+        if (!ctx) ctx = register_locked(display, context, EGL_NO_CONTEXT);
+        if (ctx) ctx->bind_count++;
+    }
+    unbind_locked(prismgl_tls_context);
+    pthread_mutex_unlock(&g_registry_lock);
+
+    prismgl_tls_context = ctx;
+    pthread_setspecific(g_thread_key, ctx);
+}
+
+void prismgl_context_destroyed(EGLDisplay display, EGLContext context) {
+    pthread_mutex_lock(&g_registry_lock);
+    PrismGLContext* ctx = find_locked(display, context);
+    if (ctx) {
+        /* Unlinked right away: EGL may hand the same handle out again */
+        unlink_locked(ctx);
+        if (ctx->bind_count > 0) {
+            ctx->destroy_pending = true;
+        } else {
+            free_context(ctx);
+        }
+    }
+    pthread_mutex_unlock(&g_registry_lock);
+}
+
+bool prismgl_context_alive(EGLDisplay display, EGLContext context) {
+    pthread_mutex_lock(&g_registry_lock);
+    bool alive = find_locked(display, context) != NULL;
+    pthread_mutex_unlock(&g_registry_lock);
+    return alive;
+}
+
+/* ===== EGL overrides ===== */
+
+EGLContext prismgl_eglCreateContext(EGLDisplay display, EGLConfig config,
+                                    EGLContext share_context, const EGLint* attrib_list) {
+    EGLContext context = eglCreateContext(display, config, share_context, attrib_list);
+    if (context != EGL_NO_CONTEXT) {
+        prismgl_context_created(display, context, share_context);
+        LOGI("Context %p created (shares with %p)", context, share_context);
+    }
+    return context;
+}
+
+EGLBoolean prismgl_eglMakeCurrent(EGLDisplay display, EGLSurface draw,
+                                  EGLSurface read, EGLContext context) {
+    /* Held draws and staged uploads belong to the context being released */
+    draw_instance_flush();
+    draw_batch_invalidate();
+    texture_batch_flush();
+    EGLBoolean result = eglMakeCurrent(display, draw, read, context);
+    if (result == EGL_TRUE) {
+        prismgl_context_make_current(display, context);
+    }
+    return result;
+}
+
+EGLBoolean prismgl_eglDestroyContext(EGLDisplay display, EGLContext context) {
+    EGLBoolean result = eglDestroyContext(display, context);
+    if (result == EGL_TRUE) {
+        prismgl_context_destroyed(display, context);
+    }
+    return result;
+}
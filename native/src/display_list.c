@@ -0,0 +1,639 @@
+/*
+ * PrismGL Display Lists
+ * glNewList/glCallList emulation: immediate-mode geometry recorded inside a
+ * list is baked into one static VBO/IBO at glEndList, so glCallList replays
+ * a handful of indexed draws instead of thousands of per-vertex calls.
+ */
+
+#include "display_list.h"
+#include "context.h"
+#include "draw_batch.h"
+#include "matrix_stack.h"
+#include "state_shadow.h"
+#include "texture_batch.h"
+#include "occlusion_query.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-DisplayList"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+#define MAX_LIST_NESTING 64
+
+typedef struct {
+    uint32_t op;
+    union {
+        struct { GLenum mode; GLuint first; GLuint count; } draw;
+        struct { GLenum target; GLuint texture; } tex;
+        GLenum value;
+        GLuint list;
+        GLfloat f[4];
+        uint32_t param_offset;   /* Into DisplayList.params for >4 floats */
+    } u;
+} DisplayListCmd;
+
+typedef struct {
+    DisplayListCmd* cmds;
+    int cmd_count;
+    int cmd_capacity;
+    GLfloat* params;
+    int param_count;
+    int param_capacity;
+    GLuint vao;
+    GLuint vbo;
+    GLuint ibo;
+    GLenum index_type;
+} DisplayList;
+
+static DisplayList g_empty_list_sentinel;
+#define EMPTY_LIST (&g_empty_list_sentinel)
+
+/* Compilation state (only valid between glNewList and glEndList) */
+typedef struct {
+    bool active;
+    GLuint name;
+    GLenum mode;
+    DisplayList* list;
+    ImmediateVertex* vertices;
+    int vertex_count;
+    int vertex_capacity;
+    uint32_t* indices;
+    int index_count;
+    int index_capacity;
+    ImmediateAttribs saved_attribs;
+} CompileState;
+
+/* Per-context: a list holds a VAO, which contexts never share */
+typedef struct {
+    /* Name table: slot is NULL when free, EMPTY_LIST when reserved but empty */
+    DisplayList** lists;
+    GLuint list_capacity;
+    GLuint list_base;
+    CompileState compile;
+    int call_depth;
+} DisplayListState;
+
+static inline DisplayListState* list_state(void) {
+    return (DisplayListState*)prismgl_context_state(PRISMGL_STATE_DISPLAY_LISTS);
+}
+
+/* ===== Growable arrays ===== */
+
+static bool grow_array(void** data, int* capacity, int needed, size_t elem_size) {
+    if (needed <= *capacity) return true;
+    int new_capacity = *capacity ? *capacity : 64;
+    while (new_capacity < needed) new_capacity *= 2;
+    void* p = realloc(*data, (size_t)new_capacity * elem_size);
+    if (!p) {
+        LOGE("Display list allocation failed (%d elements)", new_capacity);
+        return false;
+    }
+    *data = p;
+    *capacity = new_capacity;
+    return true;
+}
+
+static DisplayListCmd* push_cmd(DisplayList* list, DisplayListOp op) {
+    if (!grow_array((void**)&list->cmds, &list->cmd_capacity,
+                    list->cmd_count + 1, sizeof(DisplayListCmd))) {
+        return NULL;
+    }
+    DisplayListCmd* cmd = &list->cmds[list->cmd_count++];
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->op = (uint32_t)op;
+    return cmd;
+}
+
+static void free_list_memory(DisplayList* list) {
+    if (!list || list == EMPTY_LIST) return;
+    free(list->cmds);
+    free(list->params);
+    free(list);
+}
+
+static void free_list(DisplayList* list) {
+    if (!list || list == EMPTY_LIST) return;
+    if (list->vao) state_shadow_delete_vertex_arrays(1, &list->vao);
+    if (list->vbo) state_shadow_delete_buffers(1, &list->vbo);
+    if (list->ibo) state_shadow_delete_buffers(1, &list->ibo);
+    free_list_memory(list);
+}
+
+static bool ensure_name_capacity(DisplayListState* ls, GLuint needed) {
+    if (needed <= ls->list_capacity) return true;
+    GLuint new_capacity = ls->list_capacity ? ls->list_capacity : 256;
+    while (new_capacity < needed) new_capacity *= 2;
+    DisplayList** p = (DisplayList**)realloc(ls->lists, new_capacity * sizeof(DisplayList*));
+    if (!p) return false;
+    memset(p + ls->list_capacity, 0, (new_capacity - ls->list_capacity) * sizeof(DisplayList*));
+    ls->lists = p;
+    ls->list_capacity = new_capacity;
+    return true;
+}
+
+void* display_list_create_state(void) {
+    return calloc(1, sizeof(DisplayListState));
+}
+
+void display_list_destroy_state(void* state) {
+    DisplayListState* ls = (DisplayListState*)state;
+    if (!ls) return;
+    /* List VAOs and buffers go with the context */
+    free_list_memory(ls->compile.list);
+    free(ls->compile.vertices);
+    free(ls->compile.indices);
+    for (GLuint i = 0; i < ls->list_capacity; i++) {
+        free_list_memory(ls->lists[i]);
+    }
+    free(ls->lists);
+    free(ls);
+}
+
+/* ===== Primitive conversion ===== */
+
+/* Collapse every legacy primitive to points, lines or triangles so that
+ * consecutive primitives can share a single indexed draw. */
+static GLenum base_primitive(GLenum mode) {
+    switch (mode) {
+        case GL_POINTS:
+            return GL_POINTS;
+        case GL_LINES:
+        case GL_LINE_STRIP:
+        case GL_LINE_LOOP:
+            return GL_LINES;
+        default:
+            return GL_TRIANGLES;
+    }
+}
+
+static int primitive_index_count(GLenum mode, int count) {
+    switch (mode) {
+        case GL_POINTS:         return count;
+        case GL_LINES:          return (count / 2) * 2;
+        case GL_LINE_STRIP:     return count >= 2 ? (count - 1) * 2 : 0;
+        case GL_LINE_LOOP:      return count >= 2 ? count * 2 : 0;
+        case GL_TRIANGLES:      return (count / 3) * 3;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:
+        case GL_POLYGON:        return count >= 3 ? (count - 2) * 3 : 0;
+        case GL_QUADS:          return (count / 4) * 6;
+        case GL_QUAD_STRIP:     return count >= 4 ? ((count - 2) / 2) * 6 : 0;
+        default:                return 0;
+    }
+}
+
+static void write_primitive_indices(GLenum mode, uint32_t base, int count, uint32_t* out) {
+    int n = 0;
+    switch (mode) {
+        case GL_POINTS:
+        case GL_LINES:
+        case GL_TRIANGLES: {
+            int used = primitive_index_count(mode, count);
+            for (int i = 0; i < used; i++) out[n++] = base + i;
+            break;
+        }
+        case GL_LINE_STRIP:
+        case GL_LINE_LOOP:
+            for (int i = 0; i + 1 < count; i++) {
+                out[n++] = base + i;
+                out[n++] = base + i + 1;
+            }
+            if (mode == GL_LINE_LOOP) {
+                out[n++] = base + count - 1;
+                out[n++] = base;
+            }
+            break;
+        case GL_TRIANGLE_STRIP:
+            for (int i = 0; i + 2 < count; i++) {
+                /* Alternate winding to keep strip orientation */
+                out[n++] = base + ((i & 1) ? i + 1 : i);
+                out[n++] = base + ((i & 1) ? i : i + 1);
+                out[n++] = base + i + 2;
+            }
+            break;
+        case GL_TRIANGLE_FAN:
+        case GL_POLYGON:
+            for (int i = 1; i + 1 < count; i++) {
+                out[n++] = base;
+                out[n++] = base + i;
+                out[n++] = base + i + 1;
+            }
+            break;
+        case GL_QUADS:
+            for (int i = 0; i + 3 < count; i += 4) {
+                out[n++] = base + i + 0;
+                out[n++] = base + i + 1;
+                out[n++] = base + i + 2;
+                out[n++] = base + i + 0;
+                out[n++] = base + i + 2;
+                out[n++] = base + i + 3;
+            }
+            break;
+        case GL_QUAD_STRIP:
+            for (int i = 0; i + 3 < count; i += 2) {
+                out[n++] = base + i + 0;
+                out[n++] = base + i + 1;
+                out[n++] = base + i + 2;
+                out[n++] = base + i + 2;
+                out[n++] = base + i + 1;
+                out[n++] = base + i + 3;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* ===== Recording hooks ===== */
+
+bool display_list_is_compiling(void) {
+    return list_state()->compile.active;
+}
+
+static bool skip_execution(const DisplayListState* ls) {
+    return ls->compile.mode == GL_COMPILE;
+}
+
+/* Commands issued while replaying a list are never recorded themselves */
+static bool recording(const DisplayListState* ls) {
+    return ls->compile.active && ls->call_depth == 0;
+}
+
+bool display_list_record_primitive(GLenum mode, const ImmediateVertex* vertices, int count) {
+    DisplayListState* ls = list_state();
+    if (!recording(ls)) return false;
+    CompileState* c = &ls->compile;
+
+    int idx_count = primitive_index_count(mode, count);
+    if (idx_count == 0) return skip_execution(ls);
+
+    if (!grow_array((void**)&c->vertices, &c->vertex_capacity,
+                    c->vertex_count + count, sizeof(ImmediateVertex)) ||
+        !grow_array((void**)&c->indices, &c->index_capacity,
+                    c->index_count + idx_count, sizeof(uint32_t))) {
+        return skip_execution(ls);
+    }
+
+    memcpy(&c->vertices[c->vertex_count], vertices,
+           (size_t)count * sizeof(ImmediateVertex));
+    write_primitive_indices(mode, (uint32_t)c->vertex_count, count,
+                            &c->indices[c->index_count]);
+
+    GLenum draw_mode = base_primitive(mode);
+    DisplayList* list = c->list;
+    DisplayListCmd* last = list->cmd_count > 0 ? &list->cmds[list->cmd_count - 1] : NULL;
+
+    if (last && last->op == DL_CMD_DRAW && last->u.draw.mode == draw_mode) {
+        /* Nothing recorded in between: extend the previous draw */
+        last->u.draw.count += (GLuint)idx_count;
+    } else {
+        DisplayListCmd* cmd = push_cmd(list, DL_CMD_DRAW);
+        if (cmd) {
+            cmd->u.draw.mode = draw_mode;
+            cmd->u.draw.first = (GLuint)c->index_count;
+            cmd->u.draw.count = (GLuint)idx_count;
+        }
+    }
+
+    c->vertex_count += count;
+    c->index_count += idx_count;
+    return skip_execution(ls);
+}
+
+bool display_list_record_op(DisplayListOp op) {
+    DisplayListState* ls = list_state();
+    if (!recording(ls)) return false;
+    push_cmd(ls->compile.list, op);
+    return skip_execution(ls);
+}
+
+bool display_list_record_enum(DisplayListOp op, GLenum value) {
+    DisplayListState* ls = list_state();
+    if (!recording(ls)) return false;
+    DisplayListCmd* cmd = push_cmd(ls->compile.list, op);
+    if (cmd) cmd->u.value = value;
+    return skip_execution(ls);
+}
+
+bool display_list_record_floats(DisplayListOp op, const GLfloat* values, int count) {
+    DisplayListState* ls = list_state();
+    if (!recording(ls)) return false;
+    DisplayList* list = ls->compile.list;
+    DisplayListCmd* cmd = push_cmd(list, op);
+    if (!cmd) return skip_execution(ls);
+
+    if (count <= 4) {
+        memcpy(cmd->u.f, values, (size_t)count * sizeof(GLfloat));
+    } else {
+        if (!grow_array((void**)&list->params, &list->param_capacity,
+                        list->param_count + count, sizeof(GLfloat))) {
+            list->cmd_count--;
+            return skip_execution(ls);
+        }
+        cmd->u.param_offset = (uint32_t)list->param_count;
+        memcpy(&list->params[list->param_count], values, (size_t)count * sizeof(GLfloat));
+        list->param_count += count;
+    }
+    return skip_execution(ls);
+}
+
+bool display_list_record_texture(GLenum target, GLuint texture) {
+    DisplayListState* ls = list_state();
+    if (!recording(ls)) return false;
+    DisplayListCmd* cmd = push_cmd(ls->compile.list, DL_CMD_BIND_TEXTURE);
+    if (cmd) {
+        cmd->u.tex.target = target;
+        cmd->u.tex.texture = texture;
+    }
+    return skip_execution(ls);
+}
+
+/* ===== Baking ===== */
+
+static void bake_geometry(CompileState* c, DisplayList* list) {
+    if (c->index_count == 0) return;
+
+    glGenVertexArrays(1, &list->vao);
+    glGenBuffers(1, &list->vbo);
+    glGenBuffers(1, &list->ibo);
+
+    state_shadow_bind_vertex_array(list->vao);
+    state_shadow_bind_buffer(GL_ARRAY_BUFFER, list->vbo);
+    glBufferData(GL_ARRAY_BUFFER,
+                 c->vertex_count * (GLsizeiptr)sizeof(ImmediateVertex),
+                 c->vertices, GL_STATIC_DRAW);
+    prismgl_immediate_setup_attribs();
+
+    state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, list->ibo);
+    if (c->vertex_count <= 65536) {
+        /* Narrow to 16-bit indices in place */
+        GLushort* narrow = (GLushort*)c->indices;
+        for (int i = 0; i < c->index_count; i++) {
+            narrow[i] = (GLushort)c->indices[i];
+        }
+        list->index_type = GL_UNSIGNED_SHORT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                     c->index_count * (GLsizeiptr)sizeof(GLushort),
+                     narrow, GL_STATIC_DRAW);
+    } else {
+        list->index_type = GL_UNSIGNED_INT;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                     c->index_count * (GLsizeiptr)sizeof(GLuint),
+                     c->indices, GL_STATIC_DRAW);
+    }
+
+    state_shadow_bind_vertex_array(0);
+    state_shadow_bind_buffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* ===== Replay ===== */
+
+/* Parameters of a command recorded with more than four floats */
+static inline const GLfloat* list_params(const DisplayList* list, const DisplayListCmd* cmd) {
+    return &list->params[cmd->u.param_offset];
+}
+
+static void execute_list(DisplayList* list) {
+    bool vao_bound = false;
+    size_t index_size = list->index_type == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort);
+
+    for (int i = 0; i < list->cmd_count; i++) {
+        const DisplayListCmd* cmd = &list->cmds[i];
+        const GLfloat* f = cmd->u.f;
+
+        switch ((DisplayListOp)cmd->op) {
+            case DL_CMD_DRAW: {
+                /* Replayed straight to the driver, past the draw batch */
+                draw_batch_invalidate();
+                if (!vao_bound) {
+                    state_shadow_bind_vertex_array(list->vao);
+                    vao_bound = true;
+                }
+                GLsizei count = (GLsizei)cmd->u.draw.count;
+                texture_batch_flush();
+                occlusion_query_draw(cmd->u.draw.mode, &count, 1, 1);
+                matrix_stack_flush();
+                glDrawElements(cmd->u.draw.mode, count,
+                               list->index_type,
+                               (const void*)(cmd->u.draw.first * index_size));
+                break;
+            }
+            case DL_CMD_ENABLE:       prismgl_glEnable_wrapper(cmd->u.value); break;
+            case DL_CMD_DISABLE:      prismgl_glDisable_wrapper(cmd->u.value); break;
+            case DL_CMD_COLOR:        prismgl_glColor4f(f[0], f[1], f[2], f[3]); break;
+            case DL_CMD_NORMAL:       prismgl_glNormal3f(f[0], f[1], f[2]); break;
+            case DL_CMD_TEXCOORD:     prismgl_glTexCoord2f(f[0], f[1]); break;
+            case DL_CMD_BIND_TEXTURE:
+                prismgl_glBindTexture_wrapper(cmd->u.tex.target, cmd->u.tex.texture);
+                break;
+            case DL_CMD_MATRIX_MODE:  prismgl_glMatrixMode(cmd->u.value); break;
+            case DL_CMD_PUSH_MATRIX:  prismgl_glPushMatrix(); break;
+            case DL_CMD_POP_MATRIX:   prismgl_glPopMatrix(); break;
+            case DL_CMD_LOAD_IDENTITY: prismgl_glLoadIdentity(); break;
+            case DL_CMD_TRANSLATE:    prismgl_glTranslatef(f[0], f[1], f[2]); break;
+            case DL_CMD_ROTATE:       prismgl_glRotatef(f[0], f[1], f[2], f[3]); break;
+            case DL_CMD_SCALE:        prismgl_glScalef(f[0], f[1], f[2]); break;
+            case DL_CMD_MULT_MATRIX:
+                prismgl_glMultMatrixf(list_params(list, cmd));
+                break;
+            case DL_CMD_LOAD_MATRIX:
+                prismgl_glLoadMatrixf(list_params(list, cmd));
+                break;
+            case DL_CMD_ORTHO: {
+                const GLfloat* p = list_params(list, cmd);
+                prismgl_glOrtho(p[0], p[1], p[2], p[3], p[4], p[5]);
+                break;
+            }
+            case DL_CMD_FRUSTUM: {
+                const GLfloat* p = list_params(list, cmd);
+                prismgl_glFrustum(p[0], p[1], p[2], p[3], p[4], p[5]);
+                break;
+            }
+            case DL_CMD_CALL_LIST:
+                /* Nested calls may rebind state, so drop our VAO first */
+                if (vao_bound) {
+                    state_shadow_bind_vertex_array(0);
+                    vao_bound = false;
+                }
+                prismgl_glCallList(cmd->u.list);
+                break;
+        }
+    }
+
+    if (vao_bound) state_shadow_bind_vertex_array(0);
+}
+
+/* ===== GL entry points ===== */
+
+GLuint prismgl_glGenLists(GLsizei range) {
+    if (range <= 0) return 0;
+    DisplayListState* ls = list_state();
+
+    /* Find `range` consecutive free names, starting at 1 */
+    GLuint run_start = 1;
+    GLuint run_len = 0;
+    for (GLuint name = 1; name < ls->list_capacity && run_len < (GLuint)range; name++) {
+        if (ls->lists[name]) {
+            run_start = name + 1;
+            run_len = 0;
+        } else {
+            run_len++;
+        }
+    }
+
+    if (!ensure_name_capacity(ls, run_start + (GLuint)range)) {
+        LOGE("glGenLists(%d): out of memory", range);
+        return 0;
+    }
+    for (GLuint i = 0; i < (GLuint)range; i++) {
+        ls->lists[run_start + i] = EMPTY_LIST;
+    }
+    return run_start;
+}
+
+void prismgl_glDeleteLists(GLuint list, GLsizei range) {
+    DisplayListState* ls = list_state();
+    for (GLsizei i = 0; i < range; i++) {
+        GLuint name = list + (GLuint)i;
+        if (name == 0 || name >= ls->list_capacity) continue;
+        free_list(ls->lists[name]);
+        ls->lists[name] = NULL;
+    }
+}
+
+GLboolean prismgl_glIsList(GLuint list) {
+    const DisplayListState* ls = list_state();
+    return (list != 0 && list < ls->list_capacity && ls->lists[list]) ? GL_TRUE : GL_FALSE;
+}
+
+void prismgl_glNewList(GLuint list, GLenum mode) {
+    if (list == 0 || (mode != GL_COMPILE && mode != GL_COMPILE_AND_EXECUTE)) {
+        LOGW("glNewList(%u, 0x%x): invalid arguments", list, mode);
+        return;
+    }
+    DisplayListState* ls = list_state();
+    CompileState* c = &ls->compile;
+    if (c->active) {
+        LOGW("glNewList(%u) called while list %u is being compiled", list, c->name);
+        return;
+    }
+
+    DisplayList* dl = (DisplayList*)calloc(1, sizeof(DisplayList));
+    if (!dl) {
+        LOGE("glNewList(%u): out of memory", list);
+        return;
+    }
+
+    c->active = true;
+    c->name = list;
+    c->mode = mode;
+    c->list = dl;
+    c->vertex_count = 0;
+    c->index_count = 0;
+    prismgl_immediate_get_attribs(&c->saved_attribs);
+}
+
+void prismgl_glEndList(void) {
+    DisplayListState* ls = list_state();
+    CompileState* c = &ls->compile;
+    if (!c->active) {
+        LOGW("glEndList called without glNewList");
+        return;
+    }
+
+    DisplayList* dl = c->list;
+    bake_geometry(c, dl);
+
+    /* GL_COMPILE must not leave the current attributes modified */
+    if (c->mode == GL_COMPILE) {
+        prismgl_immediate_set_attribs(&c->saved_attribs);
+    }
+
+    if (ensure_name_capacity(ls, c->name + 1)) {
+        free_list(ls->lists[c->name]);
+        ls->lists[c->name] = dl;
+    } else {
+        free_list(dl);
+    }
+
+    LOGI("Display list %u compiled: %d vertices, %d indices, %d commands",
+         c->name, c->vertex_count, c->index_count, dl->cmd_count);
+
+    /* Staging arrays are kept around for the next compilation */
+    c->active = false;
+    c->list = NULL;
+}
+
+void prismgl_glCallList(GLuint list) {
+    DisplayListState* ls = list_state();
+    if (recording(ls)) {
+        DisplayListCmd* cmd = push_cmd(ls->compile.list, DL_CMD_CALL_LIST);
+        if (cmd) cmd->u.list = list;
+        if (skip_execution(ls)) return;
+    }
+
+    if (list == 0 || list >= ls->list_capacity) return;
+    DisplayList* dl = ls->lists[list];
+    if (!dl || dl == EMPTY_LIST) return;
+
+    if (ls->call_depth >= MAX_LIST_NESTING) {
+        LOGW("glCallList(%u): nesting limit %d reached", list, MAX_LIST_NESTING);
+        return;
+    }
+
+    ls->call_depth++;
+    execute_list(dl);
+    ls->call_depth--;
+}
+
+void prismgl_glCallLists(GLsizei n, GLenum type, const void* lists) {
+    if (!lists) return;
+    GLuint base = list_state()->list_base;
+    for (GLsizei i = 0; i < n; i++) {
+        GLuint offset;
+        switch (type) {
+            case GL_BYTE:           offset = (GLuint)((const GLbyte*)lists)[i]; break;
+            case GL_UNSIGNED_BYTE:  offset = ((const GLubyte*)lists)[i]; break;
+            case GL_SHORT:          offset = (GLuint)((const GLshort*)lists)[i]; break;
+            case GL_UNSIGNED_SHORT: offset = ((const GLushort*)lists)[i]; break;
+            case GL_INT:            offset = (GLuint)((const GLint*)lists)[i]; break;
+            case GL_UNSIGNED_INT:   offset = ((const GLuint*)lists)[i]; break;
+            case GL_FLOAT:          offset = (GLuint)((const GLfloat*)lists)[i]; break;
+            default:
+                LOGW("glCallLists: unsupported type 0x%x", type);
+                return;
+        }
+        prismgl_glCallList(base + offset);
+    }
+}
+
+void prismgl_glListBase(GLuint base) {
+    list_state()->list_base = base;
+}
+
+void display_list_shutdown(void) {
+    DisplayListState* ls = list_state();
+    CompileState* c = &ls->compile;
+    if (c->active) {
+        free_list(c->list);
+        c->active = false;
+        c->list = NULL;
+    }
+    free(c->vertices);
+    free(c->indices);
+    c->vertices = NULL;
+    c->indices = NULL;
+    c->vertex_capacity = 0;
+    c->index_capacity = 0;
+
+    for (GLuint i = 0; i < ls->list_capacity; i++) {
+        free_list(ls->lists[i]);
+    }
+    free(ls->lists);
+    ls->lists = NULL;
+    ls->list_capacity = 0;
+}
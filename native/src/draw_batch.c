@@ -0,0 +1,493 @@
+/*
+ * PrismGL Draw Batching
+ * Every recorded draw keeps a key of the state it was recorded with:
+ * program, VAO, 2D textures, blend and depth state. At flush time runs
+ * of opaque, depth-tested draws are sorted by that key so draws sharing
+ * state end up next to each other, touching ranges are merged, and each
+ * group goes to the driver as one multi-draw. Blended draws keep their
+ * submission order and bound the windows that may be reordered.
+ *
+ * Indexed draws are grouped by index type as well and keep their base
+ * vertex; ranges that touch and share a base vertex are merged. The
+ * element buffer belongs to the VAO, so while draws are pending each VAO
+ * must keep the element buffer they were recorded with.
+ *
+ * Nothing else is part of the key, so any other call must submit the
+ * pending draws before it reaches the driver. While draws are pending
+ * the batch owns the call hook (gl_thread.h), which every entry point but
+ * the draws and the key state runs first. Binds the key does not cover,
+ * such as textures on later units, and matrix uploads to a program with
+ * pending draws submit them explicitly. glDrawElements calls of the
+ * application are only captured while that holds: not with threaded
+ * dispatch, whose raw calls replay without the hook, and not after a
+ * lookup that bypassed the trampolines.
+ */
+
+#include "draw_batch.h"
+#include "draw_instance.h"
+#include "multi_draw.h"
+#include "occlusion_query.h"
+#include "state_shadow.h"
+#include "matrix_stack.h"
+#include "client_arrays.h"
+#include "texture_batch.h"
+#include "gl_thread.h"
+#include "context.h"
+#include "prismgl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Batch"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define BATCH_INITIAL_CAPACITY   256
+#define BATCH_MAX_CAPACITY       16384
+#define BATCH_STATS_LOG_INTERVAL 600
+#define BATCH_ELEMENT_SLOTS      64
+
+typedef struct {
+    StateDrawKey key;
+    GLenum mode;
+    GLenum type;                /* Index type, 0 for glDrawArrays draws */
+    GLint first;                /* First vertex, or base vertex of indexed draws */
+    GLsizei count;
+    GLintptr offset;            /* Byte offset of indexed draws in the element buffer */
+} BatchDraw;
+
+/* Recorded draws of one GL context; all arrays hold `capacity` entries */
+typedef struct {
+    BatchDraw* draws;
+    uint32_t* order;            /* Submission order after sorting */
+    uint32_t* scratch;          /* Merge sort buffer */
+    GLint* firsts;              /* Also base vertices of indexed groups */
+    GLsizei* counts;
+    const void** offsets;
+    int count;
+    int capacity;
+    uint32_t known;             /* Key fields known to the shadow when recording began */
+    struct {
+        GLuint vertex_array;    /* Shadow value, 0 = slot unused */
+        GLuint buffer;
+    } elements[BATCH_ELEMENT_SLOTS];    /* Element buffer each VAO was recorded with */
+    bool active;
+    DrawBatchStats frame;
+    DrawBatchStats last;
+    uint64_t frames;
+} DrawBatch;
+
+/* Counters of the last frame presented by any context, for JNI readers */
+static DrawBatchStats g_last_frame;
+
+static inline DrawBatch* draw_batch_state(void) {
+    return (DrawBatch*)prismgl_context_state(PRISMGL_STATE_BATCH);
+}
+
+void* draw_batch_create_state(void) {
+    return calloc(1, sizeof(DrawBatch));
+}
+
+void draw_batch_destroy_state(void* state) {
+    DrawBatch* b = (DrawBatch*)state;
+    free(b->draws);
+    free(b->order);
+    free(b->scratch);
+    free(b->firsts);
+    free(b->counts);
+    free(b->offsets);
+    free(b);
+}
+
+static bool grow(DrawBatch* b) {
+    int capacity = b->capacity ? b->capacity * 2 : BATCH_INITIAL_CAPACITY;
+    if (capacity > BATCH_MAX_CAPACITY) return false;
+
+    /* Arrays that did grow stay valid at the old capacity on failure */
+    BatchDraw* draws = (BatchDraw*)realloc(b->draws, (size_t)capacity * sizeof(BatchDraw));
+    if (!draws) return false;
+    b->draws = draws;
+    uint32_t* order = (uint32_t*)realloc(b->order, (size_t)capacity * sizeof(uint32_t));
+    if (!order) return false;
+    b->order = order;
+    uint32_t* scratch = (uint32_t*)realloc(b->scratch, (size_t)capacity * sizeof(uint32_t));
+    if (!scratch) return false;
+    b->scratch = scratch;
+    GLint* firsts = (GLint*)realloc(b->firsts, (size_t)capacity * sizeof(GLint));
+    if (!firsts) return false;
+    b->firsts = firsts;
+    GLsizei* counts = (GLsizei*)realloc(b->counts, (size_t)capacity * sizeof(GLsizei));
+    if (!counts) return false;
+    b->counts = counts;
+    const void** offsets = (const void**)realloc(b->offsets, (size_t)capacity * sizeof(void*));
+    if (!offsets) return false;
+    b->offsets = offsets;
+
+    b->capacity = capacity;
+    return true;
+}
+
+/* ===== Keys ===== */
+
+/* One bit per key field the shadow knew, plus the known capabilities */
+static uint32_t known_fields(const StateDrawKey* key) {
+    uint32_t known = 0;
+    if (key->program) known |= 1u << 0;
+    if (key->vertex_array) known |= 1u << 1;
+    for (int u = 0; u < STATE_KEY_TEXTURE_UNITS; u++) {
+        if (key->textures[u]) known |= 1u << (2 + u);
+    }
+    if (key->depth_mask) known |= 1u << 6;
+    if (key->blend_known) known |= 1u << 7;
+    return known | (key->caps_known << 8);
+}
+
+static void apply_key(const StateDrawKey* key) {
+    state_shadow_apply_key(key);
+    if (key->program) matrix_stack_use_program(key->program - 1);
+}
+
+static int compare_draws(const BatchDraw* a, const BatchDraw* b) {
+    int c = memcmp(&a->key, &b->key, sizeof(StateDrawKey));
+    if (c != 0) return c;
+    if (a->mode != b->mode) return a->mode < b->mode ? -1 : 1;
+    if (a->type != b->type) return a->type < b->type ? -1 : 1;
+    if (a->offset != b->offset) return a->offset < b->offset ? -1 : 1;
+    if (a->first != b->first) return a->first < b->first ? -1 : 1;
+    return 0;
+}
+
+static inline bool same_group(const BatchDraw* a, const BatchDraw* b) {
+    return a->mode == b->mode && a->type == b->type &&
+           memcmp(&a->key, &b->key, sizeof(StateDrawKey)) == 0;
+}
+
+static inline size_t index_size(GLenum type) {
+    switch (type) {
+        case GL_UNSIGNED_BYTE:  return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT:   return 4;
+        default:                return 0;
+    }
+}
+
+/* Stable bottom-up merge sort of order[lo, hi) */
+static void sort_window(DrawBatch* b, int lo, int hi) {
+    uint32_t* src = b->order;
+    uint32_t* dst = b->scratch;
+
+    for (int width = 1; width < hi - lo; width *= 2) {
+        for (int left = lo; left < hi; left += 2 * width) {
+            int mid = left + width < hi ? left + width : hi;
+            int right = left + 2 * width < hi ? left + 2 * width : hi;
+            int i = left, j = mid, k = left;
+            while (i < mid && j < right) {
+                if (compare_draws(&b->draws[src[j]], &b->draws[src[i]]) < 0) {
+                    dst[k++] = src[j++];
+                } else {
+                    dst[k++] = src[i++];
+                }
+            }
+            while (i < mid) dst[k++] = src[i++];
+            while (j < right) dst[k++] = src[j++];
+        }
+        uint32_t* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if (src != b->order) {
+        memcpy(b->order + lo, src + lo, (size_t)(hi - lo) * sizeof(uint32_t));
+    }
+}
+
+/* ===== Flush ===== */
+
+/* Submit the sorted draws order[lo, hi) of one group */
+static GLsizei submit_arrays(DrawBatch* b, const BatchDraw* head, int lo, int hi) {
+    GLsizei runs = 0;
+    for (int i = lo; i < hi; i++) {
+        const BatchDraw* d = &b->draws[b->order[i]];
+        if (runs > 0 && d->first == b->firsts[runs - 1] + b->counts[runs - 1]) {
+            b->counts[runs - 1] += d->count;
+        } else {
+            b->firsts[runs] = d->first;
+            b->counts[runs] = d->count;
+            runs++;
+        }
+    }
+    return multi_draw_arrays(head->mode, b->firsts, b->counts, runs);
+}
+
+static GLsizei submit_elements(DrawBatch* b, const BatchDraw* head, int lo, int hi) {
+    GLintptr elem = (GLintptr)index_size(head->type);
+    GLsizei runs = 0;
+    bool based = false;
+
+    for (int i = lo; i < hi; i++) {
+        const BatchDraw* d = &b->draws[b->order[i]];
+        if (runs > 0 && d->first == b->firsts[runs - 1] &&
+            d->offset == (GLintptr)(uintptr_t)b->offsets[runs - 1] + b->counts[runs - 1] * elem) {
+            b->counts[runs - 1] += d->count;
+        } else {
+            b->offsets[runs] = (const void*)(uintptr_t)d->offset;
+            b->counts[runs] = d->count;
+            b->firsts[runs] = d->first;
+            based |= d->first != 0;
+            runs++;
+        }
+    }
+    return multi_draw_elements(head->mode, b->counts, head->type, b->offsets, runs,
+                               based ? b->firsts : NULL);
+}
+
+static void submit_pending(DrawBatch* b) {
+    if (b->count == 0) return;
+
+    StateDrawKey live;
+    state_shadow_capture_key(&live);
+
+    for (int i = 0; i < b->count; i++) b->order[i] = (uint32_t)i;
+
+    /* Only opaque depth-tested draws may change order */
+    for (int i = 0; i < b->count; ) {
+        if (!state_shadow_key_opaque(&b->draws[i].key)) {
+            i++;
+            continue;
+        }
+        int j = i + 1;
+        while (j < b->count && state_shadow_key_opaque(&b->draws[j].key)) j++;
+        if (j - i > 1) sort_window(b, i, j);
+        i = j;
+    }
+
+    for (int i = 0; i < b->count; ) {
+        const BatchDraw* head = &b->draws[b->order[i]];
+        int j = i;
+        while (j < b->count && same_group(&b->draws[b->order[j]], head)) j++;
+
+        apply_key(&head->key);
+        if (head->type) {
+            b->frame.draws_out += (uint32_t)submit_elements(b, head, i, j);
+        } else {
+            b->frame.draws_out += (uint32_t)submit_arrays(b, head, i, j);
+        }
+        i = j;
+    }
+
+    /* Leave the state the application last set */
+    apply_key(&live);
+    b->count = 0;
+    memset(b->elements, 0, sizeof(b->elements));
+    if (gl_thread_tls_call_hook == draw_batch_invalidate) gl_thread_tls_call_hook = NULL;
+}
+
+/* ===== Public API ===== */
+
+void prismgl_batch_begin(void) {
+    /* Draws held for instancing must not end up behind the batch */
+    draw_instance_flush();
+    DrawBatch* b = draw_batch_state();
+    if (b->active) submit_pending(b);
+    b->count = 0;
+    b->active = true;
+}
+
+void prismgl_batch_flush(void) {
+    DrawBatch* b = draw_batch_state();
+    if (b->active) submit_pending(b);
+    b->active = false;
+}
+
+/* Legacy modes and client arrays are rewritten per draw and cannot be replayed */
+static inline bool needs_direct_draw(GLenum mode) {
+    return mode == GL_QUADS || mode == GL_QUAD_STRIP || mode == GL_POLYGON ||
+           client_arrays_active();
+}
+
+/* Slot for a draw recorded with `key`, or NULL if the draw must go direct */
+static BatchDraw* append(DrawBatch* b, const StateDrawKey* key) {
+    uint32_t known = known_fields(key);
+
+    /*
+     * A field the shadow learns mid-batch was changed by the application,
+     * and earlier draws cannot be replayed with the value they saw.
+     */
+    if (b->count > 0 && known != b->known) submit_pending(b);
+    if (b->count == b->capacity && !grow(b)) submit_pending(b);
+    if (b->capacity == 0) {
+        LOGW("Out of memory for batched draws, drawing directly");
+        return NULL;
+    }
+    if (b->count == 0) {
+        b->known = known;
+        /* Anything the application calls next submits the batch first */
+        gl_thread_tls_call_hook = draw_batch_invalidate;
+    }
+
+    BatchDraw* d = &b->draws[b->count++];
+    d->key = *key;
+    return d;
+}
+
+void prismgl_batch_draw(GLenum mode, GLint first, GLsizei count) {
+    DrawBatch* b = draw_batch_state();
+    b->frame.draws_in++;
+
+    if (!b->active || needs_direct_draw(mode)) {
+        submit_pending(b);
+        prismgl_glDrawArrays_wrapper(mode, first, count);
+        b->frame.draws_out++;
+        return;
+    }
+
+    /* Staged uploads must reach the textures before the draw that samples them */
+    texture_batch_flush();
+
+    /* Uniforms live in the program object, so upload them while recording */
+    matrix_stack_flush();
+
+    StateDrawKey key;
+    state_shadow_capture_key(&key);
+    BatchDraw* d = append(b, &key);
+    if (!d) {
+        prismgl_glDrawArrays_wrapper(mode, first, count);
+        b->frame.draws_out++;
+        return;
+    }
+    occlusion_query_draw(mode, &count, 1, 1);
+    d->mode = mode;
+    d->type = 0;
+    d->first = first;
+    d->count = count;
+    d->offset = 0;
+}
+
+void prismgl_batch_draw_elements(GLenum mode, GLsizei count, GLenum type,
+                                 const void* indices, GLint basevertex) {
+    prismgl_glDrawElementsBaseVertex_wrapper(mode, count, type, indices, basevertex);
+}
+
+bool draw_batch_records(const char* name) {
+    /* Instancing needs trampolines on the key state calls to flush its held draws */
+    const PrismGLConfig* config = prismgl_get_config();
+    if (!config->draw_call_batching || config->auto_instancing) return false;
+
+    static const char* const names[] = {
+        "glDrawElements", "glDrawElementsBaseVertex", "glUseProgram", "glBindVertexArray",
+        "glBindTexture", "glActiveTexture", "glBlendFunc", "glBlendFuncSeparate",
+        "glDepthMask", "glEnable", "glDisable",
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) return true;
+    }
+    return false;
+}
+
+/* Every call the application makes between captured draws runs the call hook */
+static inline bool calls_observed(void) {
+    return !gl_thread_enabled() && gl_thread_calls_observed();
+}
+
+bool draw_batch_record_elements(GLenum mode, GLsizei count, GLenum type,
+                                const void* indices, GLint basevertex) {
+    DrawBatch* b = draw_batch_state();
+    if (!b->active) return false;
+    b->frame.draws_in++;
+
+    if (!calls_observed() || needs_direct_draw(mode) || index_size(type) == 0 ||
+        (uintptr_t)indices % index_size(type) != 0) {
+        submit_pending(b);
+        b->frame.draws_out++;
+        return false;
+    }
+
+    matrix_stack_flush();
+
+    /* Indices must come from the element buffer of a known, non-default VAO */
+    StateDrawKey key;
+    state_shadow_capture_key(&key);
+    int slot = (int)(key.vertex_array % BATCH_ELEMENT_SLOTS);
+    bool seen = key.vertex_array > 1 && b->elements[slot].vertex_array == key.vertex_array;
+
+    /*
+     * The shadow forgets the element buffer on every VAO switch, but only
+     * a bind, which it sees, can change it. A VAO already recorded in this
+     * batch therefore still has the buffer it was recorded with.
+     */
+    GLint buffer = 0;
+    if (key.vertex_array > 1 &&
+        !state_shadow_peek_integerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &buffer)) {
+        if (seen) buffer = (GLint)b->elements[slot].buffer;
+        else state_shadow_get_integerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &buffer);
+    }
+    if (buffer == 0) {
+        submit_pending(b);
+        b->frame.draws_out++;
+        return false;
+    }
+
+    /* Pending draws of a VAO whose element buffer changed would read the new one */
+    if (b->elements[slot].vertex_array != 0 &&
+        (b->elements[slot].vertex_array != key.vertex_array ||
+         b->elements[slot].buffer != (GLuint)buffer)) {
+        submit_pending(b);
+    }
+
+    BatchDraw* d = append(b, &key);
+    if (!d) {
+        b->frame.draws_out++;
+        return false;
+    }
+    d->mode = mode;
+    d->type = type;
+    d->first = basevertex;
+    d->count = count;
+    d->offset = (GLintptr)(uintptr_t)indices;
+
+    b->elements[slot].vertex_array = key.vertex_array;
+    b->elements[slot].buffer = (GLuint)buffer;
+    return true;
+}
+
+bool draw_batch_active(void) {
+    return draw_batch_state()->active;
+}
+
+void draw_batch_invalidate(void) {
+    DrawBatch* b = draw_batch_state();
+    if (b->count > 0) submit_pending(b);
+}
+
+void draw_batch_uniforms_changed(GLuint program) {
+    DrawBatch* b = draw_batch_state();
+    GLuint value = program + 1;     /* Keys store names like the shadow */
+    for (int i = 0; i < b->count; i++) {
+        if (b->draws[i].key.program == value) {
+            submit_pending(b);
+            return;
+        }
+    }
+}
+
+/* ===== Statistics ===== */
+
+void draw_batch_frame_end(void) {
+    DrawBatch* b = draw_batch_state();
+
+    b->last = b->frame;
+    b->frame.draws_in = 0;
+    b->frame.draws_out = 0;
+    b->frames++;
+    g_last_frame = b->last;
+
+    if (b->frames % BATCH_STATS_LOG_INTERVAL == 0 && b->last.draws_in > 0) {
+        LOGI("Batched draws last frame: %u in, %u out (%.2fx)",
+             b->last.draws_in, b->last.draws_out,
+             b->last.draws_out ? (float)b->last.draws_in / (float)b->last.draws_out : 0.0f);
+    }
+}
+
+void draw_batch_get_stats(DrawBatchStats* out) {
+    *out = g_last_frame;
+}
@@ -0,0 +1,1029 @@
+/*
+ * PrismGL Draw Instancing
+ * Block-entity and particle renderers draw the same mesh many times in a
+ * row and change only a uniform or two, a model matrix or a colour, in
+ * between. Eligible draws are held back instead of being issued. While
+ * one is held, glUniform* writes to the current program are recorded per
+ * gap and an identical draw extends the run. Every other GL call goes
+ * through a trampoline that runs the call hook (gl_thread.h) first, which
+ * submits the run, so nothing can observe or overtake held draws.
+ *
+ * A run long enough, whose changing uniforms are all float based, becomes
+ * one glDraw*Instanced call of a program variant in which those uniforms
+ * are per-instance vertex inputs, forwarded to the fragment shader where
+ * it reads them (shader_instance_vertex). The variant's other uniforms
+ * are copied from the original before each use. Anything else is replayed
+ * call by call, exactly as it was issued.
+ */
+
+#include "draw_instance.h"
+#include "draw_batch.h"
+#include "client_arrays.h"
+#include "state_shadow.h"
+#include "stream_buffer.h"
+#include "shader_translator.h"
+#include "gl_thread.h"
+#include "context.h"
+#include "prismgl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Instance"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define INSTANCE_MIN_RUN            4       /* Shorter runs are replayed */
+#define INSTANCE_MAX_RUN            256
+#define INSTANCE_MAX_SLOTS          4       /* Uniforms changing within one run */
+#define INSTANCE_BUILD_AFTER        8       /* Runs seen before a variant is compiled */
+#define INSTANCE_MAX_VARIANTS       4       /* Per program */
+#define INSTANCE_MAX_UNIFORMS       128     /* Uniforms a variant copies from the original */
+#define INSTANCE_MAX_BLOCKS         16
+#define INSTANCE_MAX_ATTRIBS        32
+#define INSTANCE_STREAM_SIZE        (256 * 1024)
+#define INSTANCE_STATS_LOG_INTERVAL 600
+
+typedef struct {
+    GLenum mode;
+    GLenum type;                /* Index type, 0 for glDrawArrays draws */
+    GLint first;                /* First vertex, or base vertex of indexed draws */
+    GLsizei count;
+    GLintptr offset;            /* Byte offset of indexed draws in the element buffer */
+} InstanceDraw;
+
+/* A uniform of the original program and its copy in a variant */
+typedef struct {
+    GLint src;
+    GLint dst;
+    GLenum type;
+    bool valid;
+    GLuint value[16];           /* Last value copied */
+} VariantUniform;
+
+typedef struct {
+    GLuint src;
+    GLuint dst;
+    GLint binding;              /* Last binding copied, -1 before the first */
+} VariantBlock;
+
+typedef struct {
+    GLint locations[INSTANCE_MAX_SLOTS];
+    InstanceUniformKind kinds[INSTANCE_MAX_SLOTS];
+    int slot_count;
+    GLuint program;             /* 0 until built */
+    bool failed;
+    int runs;                   /* Runs seen while not built yet */
+    GLuint attribs[INSTANCE_MAX_SLOTS];     /* First attribute location per slot */
+    int stride;                 /* Floats per instance */
+    VariantUniform* uniforms;
+    int uniform_count;
+    VariantBlock blocks[INSTANCE_MAX_BLOCKS];
+    int block_count;
+} InstanceVariant;
+
+/* Sources of a linked program, kept for building variants */
+typedef struct {
+    GLuint program;
+    char* vertex;
+    char* fragment;
+    bool instanceable;
+    InstanceVariant variants[INSTANCE_MAX_VARIANTS];
+    int variant_count;
+} ProgramInfo;
+
+/* Uniform writes made in front of one held draw */
+typedef struct {
+    uint8_t written;            /* One bit per slot */
+    GLuint values[INSTANCE_MAX_SLOTS][16];
+} InstanceRow;
+
+typedef struct {
+    /* Held run; rows[i] holds the writes made before draw i, rows[instances] the trailing ones */
+    bool pending;
+    InstanceDraw draw;
+    ProgramInfo* info;
+    int instances;
+    GLint locations[INSTANCE_MAX_SLOTS];
+    InstanceUniformKind kinds[INSTANCE_MAX_SLOTS];
+    int slot_count;
+    InstanceRow* rows;
+    GLfloat* packed;            /* Per-instance attribute data */
+
+    ProgramInfo** programs;
+    int program_count;
+    int program_capacity;
+    ProgramInfo* last_info;
+
+    StreamBuffer buffer;
+    bool buffer_created;
+    GLint max_attribs;
+
+    DrawInstanceStats frame;
+    DrawInstanceStats last;
+    uint64_t frames;
+} InstanceState;
+
+static const struct {
+    int components;
+    int columns;                /* Attribute locations a per-instance input takes */
+    GLenum type;                /* Matching uniform type, 0 if not instanced */
+} g_kinds[] = {
+    [INSTANCE_UNIFORM_1F]   = { 1,  1, GL_FLOAT },
+    [INSTANCE_UNIFORM_2F]   = { 2,  1, GL_FLOAT_VEC2 },
+    [INSTANCE_UNIFORM_3F]   = { 3,  1, GL_FLOAT_VEC3 },
+    [INSTANCE_UNIFORM_4F]   = { 4,  1, GL_FLOAT_VEC4 },
+    [INSTANCE_UNIFORM_1I]   = { 1,  1, 0 },
+    [INSTANCE_UNIFORM_2I]   = { 2,  1, 0 },
+    [INSTANCE_UNIFORM_3I]   = { 3,  1, 0 },
+    [INSTANCE_UNIFORM_4I]   = { 4,  1, 0 },
+    [INSTANCE_UNIFORM_MAT2] = { 4,  2, GL_FLOAT_MAT2 },
+    [INSTANCE_UNIFORM_MAT3] = { 9,  3, GL_FLOAT_MAT3 },
+    [INSTANCE_UNIFORM_MAT4] = { 16, 4, GL_FLOAT_MAT4 },
+};
+
+/* Counters of the last frame presented by any context, for JNI readers */
+static DrawInstanceStats g_last_frame;
+
+static inline InstanceState* instance_state(void) {
+    return (InstanceState*)prismgl_context_state(PRISMGL_STATE_INSTANCE);
+}
+
+static void release_variants(ProgramInfo* info, bool delete_programs) {
+    for (int i = 0; i < info->variant_count; i++) {
+        InstanceVariant* v = &info->variants[i];
+        if (delete_programs && v->program) glDeleteProgram(v->program);
+        free(v->uniforms);
+    }
+    info->variant_count = 0;
+}
+
+static void release_program(ProgramInfo* info, bool delete_programs) {
+    release_variants(info, delete_programs);
+    free(info->vertex);
+    free(info->fragment);
+    info->vertex = NULL;
+    info->fragment = NULL;
+    info->instanceable = false;
+}
+
+void* draw_instance_create_state(void) {
+    return calloc(1, sizeof(InstanceState));
+}
+
+void draw_instance_destroy_state(void* state) {
+    InstanceState* s = (InstanceState*)state;
+    for (int i = 0; i < s->program_count; i++) {
+        release_program(s->programs[i], false);
+        free(s->programs[i]);
+    }
+    free(s->programs);
+    free(s->rows);
+    free(s->packed);
+    free(s);
+}
+
+bool draw_instance_enabled(void) {
+    return prismgl_get_config()->auto_instancing && !gl_thread_enabled() &&
+           gl_thread_calls_observed();
+}
+
+bool draw_instance_records(const char* name) {
+    if (!draw_instance_enabled()) return false;
+    if (strcmp(name, "glDrawArrays") == 0 || strcmp(name, "glDrawElements") == 0 ||
+        strcmp(name, "glDrawElementsBaseVertex") == 0) {
+        return true;
+    }
+    if (strncmp(name, "glUniform", 9) != 0) return false;
+
+    const char* p = name + 9;
+    if (strncmp(p, "Matrix", 6) == 0) {
+        return p[6] >= '2' && p[6] <= '4' && strcmp(p + 7, "fv") == 0;
+    }
+    return p[0] >= '1' && p[0] <= '4' &&
+           (strcmp(p + 1, "f") == 0 || strcmp(p + 1, "i") == 0 ||
+            strcmp(p + 1, "fv") == 0 || strcmp(p + 1, "iv") == 0);
+}
+
+/* ===== Programs ===== */
+
+static ProgramInfo* find_program(InstanceState* s, GLuint program) {
+    if (s->last_info && s->last_info->program == program) return s->last_info;
+    for (int i = 0; i < s->program_count; i++) {
+        if (s->programs[i]->program == program) {
+            s->last_info = s->programs[i];
+            return s->programs[i];
+        }
+    }
+    return NULL;
+}
+
+static ProgramInfo* add_program(InstanceState* s, GLuint program) {
+    if (s->program_count == s->program_capacity) {
+        int capacity = s->program_capacity ? s->program_capacity * 2 : 64;
+        ProgramInfo** programs = (ProgramInfo**)realloc(s->programs,
+                                                        (size_t)capacity * sizeof(ProgramInfo*));
+        if (!programs) return NULL;
+        s->programs = programs;
+        s->program_capacity = capacity;
+    }
+    ProgramInfo* info = (ProgramInfo*)calloc(1, sizeof(ProgramInfo));
+    if (!info) return NULL;
+    info->program = program;
+    s->programs[s->program_count++] = info;
+    return info;
+}
+
+static char* shader_source(GLuint shader) {
+    GLint length = 0;
+    glGetShaderiv(shader, GL_SHADER_SOURCE_LENGTH, &length);
+    if (length <= 0) return NULL;
+    char* source = (char*)malloc((size_t)length);
+    if (source) glGetShaderSource(shader, length, NULL, source);
+    return source;
+}
+
+void draw_instance_program_linked(GLuint program) {
+    if (program == 0 || !draw_instance_enabled()) return;
+
+    InstanceState* s = instance_state();
+    ProgramInfo* info = find_program(s, program);
+    if (info) release_program(info, true);
+    else info = add_program(s, program);
+    if (!info) return;
+
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) return;
+
+    GLuint shaders[4];
+    GLsizei count = 0;
+    bool other_stages = false;
+    glGetAttachedShaders(program, 4, &count, shaders);
+    for (GLsizei i = 0; i < count; i++) {
+        GLint type = 0;
+        glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+        if (type == GL_VERTEX_SHADER && !info->vertex) info->vertex = shader_source(shaders[i]);
+        else if (type == GL_FRAGMENT_SHADER && !info->fragment) info->fragment = shader_source(shaders[i]);
+        else other_stages = true;
+    }
+
+    /* Shaders that already read gl_InstanceID would see the collapsed draws */
+    info->instanceable = info->vertex && info->fragment && !other_stages &&
+                         !strstr(info->vertex, "gl_InstanceID");
+    if (!info->instanceable) release_program(info, false);
+}
+
+void draw_instance_program_deleted(GLuint program) {
+    if (program == 0 || !draw_instance_enabled()) return;
+
+    InstanceState* s = instance_state();
+    ProgramInfo* info = find_program(s, program);
+    if (!info) return;
+
+    release_program(info, true);
+    for (int i = 0; i < s->program_count; i++) {
+        if (s->programs[i] == info) {
+            s->programs[i] = s->programs[--s->program_count];
+            break;
+        }
+    }
+    if (s->last_info == info) s->last_info = NULL;
+    free(info);
+}
+
+/* ===== Uniform values ===== */
+
+/* Components of a uniform type and how to access it: 'f'loat, 'm'atrix,
+ * 'i'nt (bools and samplers too) or 'u'nsigned; 0 if it is not copied */
+static int uniform_layout(GLenum type, char* cls) {
+    *cls = 'f';
+    switch (type) {
+    case GL_FLOAT:              return 1;
+    case GL_FLOAT_VEC2:         return 2;
+    case GL_FLOAT_VEC3:         return 3;
+    case GL_FLOAT_VEC4:         return 4;
+    default:                    break;
+    }
+    *cls = 'm';
+    switch (type) {
+    case GL_FLOAT_MAT2:         return 4;
+    case GL_FLOAT_MAT3:         return 9;
+    case GL_FLOAT_MAT4:         return 16;
+    case GL_FLOAT_MAT2x3:
+    case GL_FLOAT_MAT3x2:       return 6;
+    case GL_FLOAT_MAT2x4:
+    case GL_FLOAT_MAT4x2:       return 8;
+    case GL_FLOAT_MAT3x4:
+    case GL_FLOAT_MAT4x3:       return 12;
+    default:                    break;
+    }
+    *cls = 'u';
+    switch (type) {
+    case GL_UNSIGNED_INT:       return 1;
+    case GL_UNSIGNED_INT_VEC2:  return 2;
+    case GL_UNSIGNED_INT_VEC3:  return 3;
+    case GL_UNSIGNED_INT_VEC4:  return 4;
+    default:                    break;
+    }
+    *cls = 'i';
+    switch (type) {
+    case GL_INT:
+    case GL_BOOL:               return 1;
+    case GL_INT_VEC2:
+    case GL_BOOL_VEC2:          return 2;
+    case GL_INT_VEC3:
+    case GL_BOOL_VEC3:          return 3;
+    case GL_INT_VEC4:
+    case GL_BOOL_VEC4:          return 4;
+    case GL_SAMPLER_2D:
+    case GL_SAMPLER_3D:
+    case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_2D_SHADOW:
+    case GL_SAMPLER_2D_ARRAY:
+    case GL_SAMPLER_2D_ARRAY_SHADOW:
+    case GL_SAMPLER_CUBE_SHADOW:
+    case GL_SAMPLER_2D_MULTISAMPLE:
+    case GL_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_SAMPLER_BUFFER:
+    case GL_SAMPLER_CUBE_MAP_ARRAY:
+    case GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW:
+    case GL_INT_SAMPLER_2D:
+    case GL_INT_SAMPLER_3D:
+    case GL_INT_SAMPLER_CUBE:
+    case GL_INT_SAMPLER_2D_ARRAY:
+    case GL_INT_SAMPLER_2D_MULTISAMPLE:
+    case GL_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_INT_SAMPLER_BUFFER:
+    case GL_INT_SAMPLER_CUBE_MAP_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_2D:
+    case GL_UNSIGNED_INT_SAMPLER_3D:
+    case GL_UNSIGNED_INT_SAMPLER_CUBE:
+    case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE:
+    case GL_UNSIGNED_INT_SAMPLER_2D_MULTISAMPLE_ARRAY:
+    case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+    case GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY:
+        return 1;
+    default:
+        return 0;               /* Images and the like are bound by layout only */
+    }
+}
+
+static void read_uniform(GLuint program, GLint location, char cls, GLuint* value) {
+    if (cls == 'i') glGetUniformiv(program, location, (GLint*)value);
+    else if (cls == 'u') glGetUniformuiv(program, location, value);
+    else glGetUniformfv(program, location, (GLfloat*)value);
+}
+
+static void write_uniform(GLuint program, GLint location, GLenum type, const GLuint* value) {
+    const GLfloat* f = (const GLfloat*)value;
+    const GLint* i = (const GLint*)value;
+    char cls;
+    int components = uniform_layout(type, &cls);
+
+    switch (type) {
+    case GL_FLOAT_MAT2:   glProgramUniformMatrix2fv(program, location, 1, GL_FALSE, f); return;
+    case GL_FLOAT_MAT3:   glProgramUniformMatrix3fv(program, location, 1, GL_FALSE, f); return;
+    case GL_FLOAT_MAT4:   glProgramUniformMatrix4fv(program, location, 1, GL_FALSE, f); return;
+    case GL_FLOAT_MAT2x3: glProgramUniformMatrix2x3fv(program, location, 1, GL_FALSE, f); return;
+    case GL_FLOAT_MAT3x2: glProgramUniformMatrix3x2fv(program, location, 1, GL_FALSE, f); return;
+    case GL_FLOAT_MAT2x4: glProgramUniformMatrix2x4fv(program, location, 1, GL_FALSE, f); return;
+    case GL_FLOAT_MAT4x2: glProgramUniformMatrix4x2fv(program, location, 1, GL_FALSE, f); return;
+    case GL_FLOAT_MAT3x4: glProgramUniformMatrix3x4fv(program, location, 1, GL_FALSE, f); return;
+    case GL_FLOAT_MAT4x3: glProgramUniformMatrix4x3fv(program, location, 1, GL_FALSE, f); return;
+    default: break;
+    }
+
+    if (cls == 'f') {
+        if (components == 1) glProgramUniform1fv(program, location, 1, f);
+        else if (components == 2) glProgramUniform2fv(program, location, 1, f);
+        else if (components == 3) glProgramUniform3fv(program, location, 1, f);
+        else glProgramUniform4fv(program, location, 1, f);
+    } else if (cls == 'u') {
+        if (components == 1) glProgramUniform1uiv(program, location, 1, value);
+        else if (components == 2) glProgramUniform2uiv(program, location, 1, value);
+        else if (components == 3) glProgramUniform3uiv(program, location, 1, value);
+        else glProgramUniform4uiv(program, location, 1, value);
+    } else {
+        if (components == 1) glProgramUniform1iv(program, location, 1, i);
+        else if (components == 2) glProgramUniform2iv(program, location, 1, i);
+        else if (components == 3) glProgramUniform3iv(program, location, 1, i);
+        else glProgramUniform4iv(program, location, 1, i);
+    }
+}
+
+/* Re-issue a recorded write to the current program */
+static void apply_uniform(InstanceUniformKind kind, GLint location, const GLuint* value) {
+    const GLfloat* f = (const GLfloat*)value;
+    const GLint* i = (const GLint*)value;
+    switch (kind) {
+    case INSTANCE_UNIFORM_1F:   glUniform1fv(location, 1, f); break;
+    case INSTANCE_UNIFORM_2F:   glUniform2fv(location, 1, f); break;
+    case INSTANCE_UNIFORM_3F:   glUniform3fv(location, 1, f); break;
+    case INSTANCE_UNIFORM_4F:   glUniform4fv(location, 1, f); break;
+    case INSTANCE_UNIFORM_1I:   glUniform1iv(location, 1, i); break;
+    case INSTANCE_UNIFORM_2I:   glUniform2iv(location, 1, i); break;
+    case INSTANCE_UNIFORM_3I:   glUniform3iv(location, 1, i); break;
+    case INSTANCE_UNIFORM_4I:   glUniform4iv(location, 1, i); break;
+    case INSTANCE_UNIFORM_MAT2: glUniformMatrix2fv(location, 1, GL_FALSE, f); break;
+    case INSTANCE_UNIFORM_MAT3: glUniformMatrix3fv(location, 1, GL_FALSE, f); break;
+    case INSTANCE_UNIFORM_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, f); break;
+    }
+}
+
+static void apply_row(const InstanceState* s, int row) {
+    const InstanceRow* r = &s->rows[row];
+    for (int j = 0; j < s->slot_count; j++) {
+        if (r->written & (1u << j)) apply_uniform(s->kinds[j], s->locations[j], r->values[j]);
+    }
+}
+
+/* ===== Variants ===== */
+
+static InstanceVariant* find_variant(ProgramInfo* info, const InstanceState* s) {
+    for (int i = 0; i < info->variant_count; i++) {
+        InstanceVariant* v = &info->variants[i];
+        if (v->slot_count != s->slot_count) continue;
+        if (memcmp(v->locations, s->locations, (size_t)s->slot_count * sizeof(GLint)) != 0) continue;
+        if (memcmp(v->kinds, s->kinds, (size_t)s->slot_count * sizeof(InstanceUniformKind)) != 0) continue;
+        return v;
+    }
+    if (info->variant_count == INSTANCE_MAX_VARIANTS) return NULL;
+
+    InstanceVariant* v = &info->variants[info->variant_count++];
+    memset(v, 0, sizeof(*v));
+    v->slot_count = s->slot_count;
+    memcpy(v->locations, s->locations, sizeof(v->locations));
+    memcpy(v->kinds, s->kinds, sizeof(v->kinds));
+    return v;
+}
+
+/* Name of the non-array uniform at `location` */
+static bool uniform_name(GLuint program, GLint location, char* name, GLsizei size, GLenum* type) {
+    GLint count = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    for (GLint i = 0; i < count; i++) {
+        GLint array_size = 0;
+        glGetActiveUniform(program, (GLuint)i, size, NULL, &array_size, type, name);
+        if (array_size != 1 || strpbrk(name, ".[")) continue;
+        if (glGetUniformLocation(program, name) == location) return true;
+    }
+    return false;
+}
+
+static int attrib_columns(GLenum type) {
+    switch (type) {
+    case GL_FLOAT_MAT2:
+    case GL_FLOAT_MAT2x3:
+    case GL_FLOAT_MAT2x4:   return 2;
+    case GL_FLOAT_MAT3:
+    case GL_FLOAT_MAT3x2:
+    case GL_FLOAT_MAT3x4:   return 3;
+    case GL_FLOAT_MAT4:
+    case GL_FLOAT_MAT4x2:
+    case GL_FLOAT_MAT4x3:   return 4;
+    default:                return 1;
+    }
+}
+
+static GLuint compile(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    if (!shader) return 0;
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+
+    GLint compiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        char log[512];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        LOGW("Instanced shader variant failed to compile: %s", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+/* Link the rewritten sources with the original's attribute locations */
+static GLuint link_variant(GLuint original, const InstanceVariant* v,
+                           const char* vertex, const char* fragment) {
+    GLuint vs = compile(GL_VERTEX_SHADER, vertex);
+    GLuint fs = vs ? compile(GL_FRAGMENT_SHADER, fragment) : 0;
+    if (!fs) {
+        if (vs) glDeleteShader(vs);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+
+    char name[128];
+    GLint count = 0;
+    glGetProgramiv(original, GL_ACTIVE_ATTRIBUTES, &count);
+    for (GLint i = 0; i < count; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveAttrib(original, (GLuint)i, sizeof(name), NULL, &size, &type, name);
+        GLint location = glGetAttribLocation(original, name);
+        if (location >= 0) glBindAttribLocation(program, (GLuint)location, name);
+    }
+    for (int j = 0; j < v->slot_count; j++) {
+        snprintf(name, sizeof(name), "prismgl_Instance%d", j);
+        glBindAttribLocation(program, v->attribs[j], name);
+    }
+    glLinkProgram(program);
+
+    glDetachShader(program, vs);
+    glDetachShader(program, fs);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        char log[512];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        LOGW("Instanced program variant failed to link: %s", log);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+/* Uniforms and blocks the variant shares with the original */
+static bool collect_copies(GLuint original, InstanceVariant* v) {
+    char name[128], element[160];
+    GLint count = 0;
+    glGetProgramiv(v->program, GL_ACTIVE_UNIFORMS, &count);
+
+    v->uniforms = (VariantUniform*)calloc(INSTANCE_MAX_UNIFORMS, sizeof(VariantUniform));
+    if (!v->uniforms) return false;
+
+    for (GLint i = 0; i < count; i++) {
+        GLint size = 0;
+        GLenum type = 0;
+        char cls;
+        glGetActiveUniform(v->program, (GLuint)i, sizeof(name), NULL, &size, &type, name);
+        if (uniform_layout(type, &cls) == 0) continue;
+
+        char* bracket = strstr(name, "[0]");
+        if (bracket && bracket[3] == '\0') *bracket = '\0';
+
+        for (GLint e = 0; e < size; e++) {
+            if (size > 1) snprintf(element, sizeof(element), "%s[%d]", name, e);
+            else snprintf(element, sizeof(element), "%s", name);
+
+            GLint src = glGetUniformLocation(original, element);
+            GLint dst = glGetUniformLocation(v->program, element);
+            if (src < 0 || dst < 0) continue;
+            if (v->uniform_count == INSTANCE_MAX_UNIFORMS) return false;
+
+            VariantUniform* u = &v->uniforms[v->uniform_count++];
+            u->src = src;
+            u->dst = dst;
+            u->type = type;
+        }
+    }
+
+    glGetProgramiv(v->program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    for (GLint i = 0; i < count; i++) {
+        glGetActiveUniformBlockName(v->program, (GLuint)i, sizeof(name), NULL, name);
+        GLuint src = glGetUniformBlockIndex(original, name);
+        if (src == GL_INVALID_INDEX) continue;
+        if (v->block_count == INSTANCE_MAX_BLOCKS) return false;
+
+        VariantBlock* b = &v->blocks[v->block_count++];
+        b->src = src;
+        b->dst = (GLuint)i;
+        b->binding = -1;
+    }
+    return true;
+}
+
+/* Attribute locations the original program's inputs occupy */
+static uint32_t used_attribs(GLuint program) {
+    uint32_t used = 0;
+    char name[128];
+    GLint count = 0;
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    for (GLint i = 0; i < count; i++) {
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveAttrib(program, (GLuint)i, sizeof(name), NULL, &size, &type, name);
+        GLint location = glGetAttribLocation(program, name);
+        if (location < 0) continue;
+        int columns = attrib_columns(type) * size;
+        for (int c = 0; c < columns && location + c < INSTANCE_MAX_ATTRIBS; c++) {
+            used |= 1u << (location + c);
+        }
+    }
+    return used;
+}
+
+static bool build_variant(InstanceState* s, ProgramInfo* info, InstanceVariant* v) {
+    char name[128], type[64];
+    char* vertex = strdup(info->vertex);
+    char* fragment = strdup(info->fragment);
+    bool ok = vertex && fragment;
+
+    for (int j = 0; ok && j < v->slot_count; j++) {
+        GLenum uniform_type = 0;
+        ok = g_kinds[v->kinds[j]].type != 0 &&
+             uniform_name(info->program, v->locations[j], name, sizeof(name), &uniform_type) &&
+             uniform_type == g_kinds[v->kinds[j]].type;
+        if (!ok) break;
+
+        bool in_vertex = shader_declares_uniform(vertex, name);
+        bool in_fragment = shader_declares_uniform(fragment, name);
+        ok = shader_uniform_type(in_vertex ? vertex : fragment, name, type, sizeof(type));
+        if (!ok) break;
+
+        if (in_fragment) {
+            char* tmp = shader_instance_fragment(fragment, name, type, j);
+            free(fragment);
+            fragment = tmp;
+            ok = fragment != NULL;
+            if (!ok) break;
+        }
+        char* tmp = shader_instance_vertex(vertex, name, type, j, in_fragment);
+        free(vertex);
+        vertex = tmp;
+        ok = vertex && fragment;
+    }
+
+    /* Per-instance inputs take the highest free attribute locations */
+    if (ok) {
+        if (s->max_attribs == 0) {
+            glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &s->max_attribs);
+            if (s->max_attribs > INSTANCE_MAX_ATTRIBS) s->max_attribs = INSTANCE_MAX_ATTRIBS;
+        }
+        uint32_t used = used_attribs(info->program);
+        int next = s->max_attribs;
+        v->stride = 0;
+        for (int j = 0; ok && j < v->slot_count; j++) {
+            int columns = g_kinds[v->kinds[j]].columns;
+            uint32_t mask = ((1u << columns) - 1u);
+            while (next - columns >= 0 && (used & (mask << (next - columns)))) next--;
+            if (next - columns < 0) {
+                ok = false;
+                break;
+            }
+            next -= columns;
+            v->attribs[j] = (GLuint)next;
+            v->stride += g_kinds[v->kinds[j]].components;
+        }
+    }
+
+    if (ok) v->program = link_variant(info->program, v, vertex, fragment);
+    free(vertex);
+    free(fragment);
+    if (!v->program) return false;
+
+    if (!collect_copies(info->program, v)) {
+        glDeleteProgram(v->program);
+        v->program = 0;
+        return false;
+    }
+    LOGI("Built instanced variant %u of program %u (%d per-instance uniforms)",
+         v->program, info->program, v->slot_count);
+    return true;
+}
+
+/* Bring the variant's shared uniforms and block bindings up to date */
+static void sync_variant(GLuint original, InstanceVariant* v) {
+    for (int i = 0; i < v->uniform_count; i++) {
+        VariantUniform* u = &v->uniforms[i];
+        GLuint value[16];
+        char cls;
+        size_t bytes = (size_t)uniform_layout(u->type, &cls) * sizeof(GLuint);
+
+        read_uniform(original, u->src, cls, value);
+        if (u->valid && memcmp(u->value, value, bytes) == 0) continue;
+        write_uniform(v->program, u->dst, u->type, value);
+        memcpy(u->value, value, bytes);
+        u->valid = true;
+    }
+
+    for (int i = 0; i < v->block_count; i++) {
+        VariantBlock* b = &v->blocks[i];
+        GLint binding = 0;
+        glGetActiveUniformBlockiv(original, b->src, GL_UNIFORM_BLOCK_BINDING, &binding);
+        if (binding == b->binding) continue;
+        glUniformBlockBinding(v->program, b->dst, (GLuint)binding);
+        b->binding = binding;
+    }
+}
+
+/* ===== Submission ===== */
+
+static void issue(const InstanceDraw* d, GLsizei instances) {
+    const void* indices = (const void*)d->offset;
+    if (d->type == 0) {
+        if (instances == 1) glDrawArrays(d->mode, d->first, d->count);
+        else glDrawArraysInstanced(d->mode, d->first, d->count, instances);
+    } else if (d->first != 0) {
+        if (instances == 1) glDrawElementsBaseVertex(d->mode, d->count, d->type, indices, d->first);
+        else glDrawElementsInstancedBaseVertex(d->mode, d->count, d->type, indices, instances, d->first);
+    } else if (instances == 1) {
+        glDrawElements(d->mode, d->count, d->type, indices);
+    } else {
+        glDrawElementsInstanced(d->mode, d->count, d->type, indices, instances);
+    }
+}
+
+static void replay(InstanceState* s) {
+    for (int i = 0; i < s->instances; i++) {
+        if (i > 0) apply_row(s, i);
+        issue(&s->draw, 1);
+    }
+    apply_row(s, s->instances);
+}
+
+/* Per-instance values into s->packed; `current` ends up with the values
+ * the program must be left with */
+static void pack_instances(InstanceState* s, const InstanceVariant* v,
+                           GLuint current[INSTANCE_MAX_SLOTS][16]) {
+    for (int j = 0; j < s->slot_count; j++) {
+        glGetUniformfv(s->info->program, s->locations[j], (GLfloat*)current[j]);
+    }
+
+    GLfloat* dst = s->packed;
+    for (int i = 0; i <= s->instances; i++) {
+        const InstanceRow* r = &s->rows[i];
+        for (int j = 0; j < s->slot_count; j++) {
+            if (i > 0 && (r->written & (1u << j))) {
+                memcpy(current[j], r->values[j], sizeof(current[j]));
+            }
+        }
+        if (i == s->instances) break;
+        for (int j = 0; j < s->slot_count; j++) {
+            int components = g_kinds[v->kinds[j]].components;
+            memcpy(dst, current[j], (size_t)components * sizeof(GLfloat));
+            dst += components;
+        }
+    }
+}
+
+static bool attribs_free(const InstanceVariant* v) {
+    for (int j = 0; j < v->slot_count; j++) {
+        for (int c = 0; c < g_kinds[v->kinds[j]].columns; c++) {
+            GLint enabled = 0;
+            glGetVertexAttribiv(v->attribs[j] + (GLuint)c, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
+            if (enabled) return false;
+        }
+    }
+    return true;
+}
+
+static bool draw_instanced(InstanceState* s) {
+    ProgramInfo* info = s->info;
+
+    /* Nothing changed between the draws: the same draw n times */
+    if (s->slot_count == 0) {
+        issue(&s->draw, s->instances);
+        return true;
+    }
+
+    InstanceVariant* v = find_variant(info, s);
+    if (!v || v->failed) return false;
+    if (!v->program) {
+        if (++v->runs < INSTANCE_BUILD_AFTER) return false;
+        if (!build_variant(s, info, v)) {
+            LOGW("Program %u cannot be instanced, replaying its runs", info->program);
+            v->failed = true;
+            return false;
+        }
+    }
+
+    /* The vertex array must not use the locations the variant reads */
+    if (!attribs_free(v)) return false;
+
+    GLuint current[INSTANCE_MAX_SLOTS][16];
+    pack_instances(s, v, current);
+
+    GLint array_buffer = 0;
+    state_shadow_get_integerv(GL_ARRAY_BUFFER_BINDING, &array_buffer);
+    if (!s->buffer_created) {
+        s->buffer_created = stream_buffer_init(&s->buffer, GL_ARRAY_BUFFER, INSTANCE_STREAM_SIZE);
+    }
+    GLsizeiptr bytes = (GLsizeiptr)s->instances * v->stride * (GLsizeiptr)sizeof(GLfloat);
+    GLsizeiptr offset = s->buffer_created ? stream_buffer_upload(&s->buffer, s->packed, bytes) : -1;
+    if (offset < 0) {
+        state_shadow_bind_buffer(GL_ARRAY_BUFFER, (GLuint)array_buffer);
+        return false;
+    }
+
+    GLsizei stride = v->stride * (GLsizei)sizeof(GLfloat);
+    GLintptr at = offset;
+    for (int j = 0; j < v->slot_count; j++) {
+        int columns = g_kinds[v->kinds[j]].columns;
+        int rows = g_kinds[v->kinds[j]].components / columns;
+        for (int c = 0; c < columns; c++) {
+            GLuint location = v->attribs[j] + (GLuint)c;
+            glEnableVertexAttribArray(location);
+            glVertexAttribPointer(location, rows, GL_FLOAT, GL_FALSE, stride, (const void*)at);
+            glVertexAttribDivisor(location, 1);
+            at += rows * (GLintptr)sizeof(GLfloat);
+        }
+    }
+    state_shadow_bind_buffer(GL_ARRAY_BUFFER, (GLuint)array_buffer);
+
+    sync_variant(info->program, v);
+    glUseProgram(v->program);
+    issue(&s->draw, s->instances);
+    glUseProgram(info->program);
+
+    for (int j = 0; j < v->slot_count; j++) {
+        for (int c = 0; c < g_kinds[v->kinds[j]].columns; c++) {
+            glVertexAttribDivisor(v->attribs[j] + (GLuint)c, 0);
+            glDisableVertexAttribArray(v->attribs[j] + (GLuint)c);
+        }
+    }
+
+    /* Leave the original program with the values of the last write */
+    for (int j = 0; j < s->slot_count; j++) {
+        apply_uniform(s->kinds[j], s->locations[j], current[j]);
+    }
+    return true;
+}
+
+static void submit(InstanceState* s) {
+    if (!s->pending) return;
+    s->pending = false;
+
+    if (s->instances >= INSTANCE_MIN_RUN && draw_instanced(s)) {
+        s->frame.draws_out++;
+    } else {
+        replay(s);
+        s->frame.draws_out += (uint32_t)s->instances;
+    }
+}
+
+void draw_instance_flush(void) {
+    if (gl_thread_tls_call_hook != draw_instance_flush) return;
+    gl_thread_tls_call_hook = NULL;
+    submit(instance_state());
+}
+
+/* ===== Recording ===== */
+
+static inline bool same_draw(const InstanceDraw* a, const InstanceDraw* b) {
+    return a->mode == b->mode && a->type == b->type && a->first == b->first &&
+           a->count == b->count && a->offset == b->offset;
+}
+
+static GLsizei index_size(GLenum type) {
+    switch (type) {
+    case GL_UNSIGNED_BYTE:  return 1;
+    case GL_UNSIGNED_SHORT: return 2;
+    case GL_UNSIGNED_INT:   return 4;
+    default:                return 0;
+    }
+}
+
+/* Program of a draw that can be held, NULL if it must be issued now */
+static ProgramInfo* holdable(InstanceState* s, const InstanceDraw* d) {
+    if (d->mode == GL_QUADS || d->mode == GL_QUAD_STRIP || d->mode == GL_POLYGON) return NULL;
+    if (d->count <= 0 || client_arrays_active() || draw_batch_active()) return NULL;
+
+    /* Vertex data, and indices, must live in buffers: client memory may change after we return */
+    GLint value = 0;
+    state_shadow_get_integerv(GL_VERTEX_ARRAY_BINDING, &value);
+    if (value == 0) return NULL;
+    if (d->type != 0) {
+        GLsizei size = index_size(d->type);
+        if (size == 0 || d->offset % size != 0) return NULL;
+        state_shadow_get_integerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &value);
+        if (value == 0) return NULL;
+    }
+
+    state_shadow_get_integerv(GL_CURRENT_PROGRAM, &value);
+    ProgramInfo* info = value ? find_program(s, (GLuint)value) : NULL;
+    return info && info->instanceable ? info : NULL;
+}
+
+static bool hold(const InstanceDraw* d) {
+    if (!draw_instance_enabled()) {
+        draw_instance_flush();
+        return false;
+    }
+
+    InstanceState* s = instance_state();
+    if (s->pending) {
+        if (s->instances < INSTANCE_MAX_RUN && same_draw(&s->draw, d)) {
+            s->rows[++s->instances].written = 0;
+            s->frame.draws_in++;
+            return true;
+        }
+        draw_instance_flush();
+    }
+
+    ProgramInfo* info = holdable(s, d);
+    if (!info) return false;
+
+    if (!s->rows) {
+        s->rows = (InstanceRow*)malloc((INSTANCE_MAX_RUN + 1) * sizeof(InstanceRow));
+        s->packed = (GLfloat*)malloc(INSTANCE_MAX_RUN * INSTANCE_MAX_SLOTS * 16 * sizeof(GLfloat));
+        if (!s->rows || !s->packed) {
+            free(s->rows);
+            free(s->packed);
+            s->rows = NULL;
+            s->packed = NULL;
+            return false;
+        }
+    }
+
+    s->pending = true;
+    s->draw = *d;
+    s->info = info;
+    s->instances = 1;
+    s->slot_count = 0;
+    s->rows[1].written = 0;
+    gl_thread_tls_call_hook = draw_instance_flush;
+    s->frame.draws_in++;
+    return true;
+}
+
+bool draw_instance_record_arrays(GLenum mode, GLint first, GLsizei count) {
+    InstanceDraw d = { mode, 0, first, count, 0 };
+    return hold(&d);
+}
+
+bool draw_instance_record_elements(GLenum mode, GLsizei count, GLenum type,
+                                   const void* indices, GLint basevertex) {
+    if (type == 0) {
+        draw_instance_flush();
+        return false;
+    }
+    InstanceDraw d = { mode, type, basevertex, count, (GLintptr)(uintptr_t)indices };
+    return hold(&d);
+}
+
+bool draw_instance_record_uniform(GLint location, InstanceUniformKind kind,
+                                  GLsizei count, const void* value) {
+    /* Nothing held on this thread: the write goes straight through */
+    if (gl_thread_tls_call_hook != draw_instance_flush) return false;
+
+    InstanceState* s = instance_state();
+    if (location == -1) return true;    /* Ignored by GL as well */
+    if (count != 1 || !value) {
+        draw_instance_flush();
+        return false;
+    }
+
+    int slot = 0;
+    while (slot < s->slot_count && s->locations[slot] != location) slot++;
+    if (slot == s->slot_count) {
+        if (slot == INSTANCE_MAX_SLOTS) {
+            draw_instance_flush();
+            return false;
+        }
+        s->locations[slot] = location;
+        s->kinds[slot] = kind;
+        s->slot_count++;
+    } else if (s->kinds[slot] != kind) {
+        draw_instance_flush();
+        return false;
+    }
+
+    InstanceRow* r = &s->rows[s->instances];
+    memcpy(r->values[slot], value, (size_t)g_kinds[kind].components * sizeof(GLuint));
+    r->written |= (uint8_t)(1u << slot);
+    return true;
+}
+
+/* ===== Lifetime and statistics ===== */
+
+void draw_instance_shutdown(void) {
+    draw_instance_flush();
+    InstanceState* s = instance_state();
+    for (int i = 0; i < s->program_count; i++) release_variants(s->programs[i], true);
+    if (s->buffer_created) {
+        stream_buffer_destroy(&s->buffer);
+        s->buffer_created = false;
+    }
+}
+
+void draw_instance_frame_end(void) {
+    InstanceState* s = instance_state();
+
+    s->last = s->frame;
+    s->frame.draws_in = 0;
+    s->frame.draws_out = 0;
+    s->frames++;
+    g_last_frame = s->last;
+
+    if (s->frames % INSTANCE_STATS_LOG_INTERVAL == 0 && s->last.draws_in > 0) {
+        LOGI("Held draws last frame: %u in, %u out (%.2fx)",
+             s->last.draws_in, s->last.draws_out,
+             s->last.draws_out ? (float)s->last.draws_in / (float)s->last.draws_out : 0.0f);
+    }
+}
+
+void draw_instance_get_stats(DrawInstanceStats* out) {
+    *out = g_last_frame;
+}
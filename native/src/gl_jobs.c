@@ -0,0 +1,355 @@
+/*
+ * PrismGL GL Jobs
+ * Submitting threads push onto an intrusive multi-producer/single-consumer
+ * queue (one atomic exchange per push, no locks). Whichever context ends
+ * a frame first takes the consumer side and runs jobs until the frame's
+ * time budget is spent; the rest wait for the next frame. Jobs that ask
+ * to be retried move to a list private to the consumer.
+ */
+
+#include "gl_jobs.h"
+#include "state_shadow.h"
+#include "prismgl.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Jobs"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define JOB_FRAME_BUDGET_NS 2000000ull  /* GL time per frame spent on jobs */
+
+typedef enum {
+    JOB_PENDING = 0,
+    JOB_COMPLETED,
+    JOB_DROPPED
+} JobState;
+
+struct GLJob {
+    _Atomic(GLJob*) next;
+    GLJob* retry_next;
+    GLJobFunc run;
+    GLJobCallback done;
+    void* data;
+    atomic_int state;
+    atomic_int refs;            /* Queue, plus the submitter's handle */
+};
+
+static GLJob g_stub;
+
+static struct {
+    _Atomic(GLJob*) head;       /* Producers push here */
+    GLJob* tail;                /* Consumer pops here */
+    GLJob* retry;               /* Jobs to run again next frame, consumer only */
+    atomic_flag consuming;
+    atomic_uint pending;
+    atomic_uint frame_completed;
+    atomic_uint last_completed;
+
+    /* Completion wakeups, only touched while someone waits */
+    atomic_int waiters;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} g = {
+    .head = &g_stub,
+    .tail = &g_stub,
+    .consuming = ATOMIC_FLAG_INIT,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* ===== Queue ===== */
+
+static void push(GLJob* job) {
+    atomic_store_explicit(&job->next, NULL, memory_order_relaxed);
+    GLJob* prev = atomic_exchange_explicit(&g.head, job, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, job, memory_order_release);
+}
+
+/*
+ * Consumer side. Returns NULL when the queue is empty or a producer is
+ * between its exchange and its link; that job is picked up next time.
+ */
+static GLJob* pop(void) {
+    GLJob* tail = g.tail;
+    GLJob* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &g_stub) {
+        if (!next) return NULL;
+        g.tail = next;
+        tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+    if (next) {
+        g.tail = next;
+        return tail;
+    }
+    if (tail != atomic_load_explicit(&g.head, memory_order_acquire)) return NULL;
+
+    push(&g_stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next) {
+        g.tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+/* ===== Jobs ===== */
+
+static void release(GLJob* job) {
+    if (atomic_fetch_sub_explicit(&job->refs, 1, memory_order_acq_rel) == 1) free(job);
+}
+
+static void finish(GLJob* job, JobState state) {
+    if (job->done) job->done(job->data, state == JOB_COMPLETED);
+    atomic_fetch_sub_explicit(&g.pending, 1, memory_order_relaxed);
+    atomic_store(&job->state, state);
+
+    if (atomic_load(&g.waiters) > 0) {
+        pthread_mutex_lock(&g.lock);
+        pthread_cond_broadcast(&g.cond);
+        pthread_mutex_unlock(&g.lock);
+    }
+    release(job);
+}
+
+static GLJob* queue_job(GLJobFunc run, GLJobCallback done, void* data, int refs) {
+    if (!run) return NULL;
+
+    GLJob* job = (GLJob*)calloc(1, sizeof(GLJob));
+    if (!job) {
+        LOGW("Out of memory for GL job");
+        return NULL;
+    }
+    job->run = run;
+    job->done = done;
+    job->data = data;
+    atomic_init(&job->state, JOB_PENDING);
+    atomic_init(&job->refs, refs);
+
+    atomic_fetch_add_explicit(&g.pending, 1, memory_order_relaxed);
+    push(job);
+    return job;
+}
+
+bool gl_job_post(GLJobFunc run, GLJobCallback done, void* data) {
+    return queue_job(run, done, data, 1) != NULL;
+}
+
+GLJob* gl_job_submit(GLJobFunc run, GLJobCallback done, void* data) {
+    return queue_job(run, done, data, 2);
+}
+
+bool gl_job_is_done(const GLJob* job) {
+    return atomic_load((atomic_int*)&job->state) != JOB_PENDING;
+}
+
+bool gl_job_wait(GLJob* job, uint64_t timeout_ns) {
+    if (gl_job_is_done(job)) return atomic_load(&job->state) == JOB_COMPLETED;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout_ns != UINT64_MAX) {
+        uint64_t ns = (uint64_t)deadline.tv_nsec + timeout_ns % 1000000000ull;
+        deadline.tv_sec += (time_t)(timeout_ns / 1000000000ull + ns / 1000000000ull);
+        deadline.tv_nsec = (long)(ns % 1000000000ull);
+    }
+
+    atomic_fetch_add(&g.waiters, 1);
+    pthread_mutex_lock(&g.lock);
+    while (!gl_job_is_done(job)) {
+        if (timeout_ns == UINT64_MAX) {
+            pthread_cond_wait(&g.cond, &g.lock);
+        } else if (pthread_cond_timedwait(&g.cond, &g.lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g.lock);
+    atomic_fetch_sub(&g.waiters, 1);
+
+    return atomic_load(&job->state) == JOB_COMPLETED;
+}
+
+void gl_job_release(GLJob* job) {
+    if (job) release(job);
+}
+
+/* ===== Common jobs ===== */
+
+typedef struct {
+    bool textures;
+    GLsizei n;
+    GLuint names[];
+} DeleteJob;
+
+static GLJobStatus run_delete(void* data) {
+    DeleteJob* d = (DeleteJob*)data;
+    if (d->textures) prismgl_glDeleteTextures_wrapper(d->n, d->names);
+    else prismgl_glDeleteBuffers_wrapper(d->n, d->names);
+    return GL_JOB_DONE;
+}
+
+static void free_data(void* data, bool completed) {
+    (void)completed;
+    free(data);
+}
+
+static bool post_delete(bool textures, GLsizei n, const GLuint* names) {
+    if (n <= 0 || !names) return true;
+
+    DeleteJob* d = (DeleteJob*)malloc(sizeof(DeleteJob) + (size_t)n * sizeof(GLuint));
+    if (!d) return false;
+    d->textures = textures;
+    d->n = n;
+    memcpy(d->names, names, (size_t)n * sizeof(GLuint));
+
+    if (!gl_job_post(run_delete, free_data, d)) {
+        free(d);
+        return false;
+    }
+    return true;
+}
+
+bool gl_jobs_delete_textures(GLsizei n, const GLuint* textures) {
+    return post_delete(true, n, textures);
+}
+
+bool gl_jobs_delete_buffers(GLsizei n, const GLuint* buffers) {
+    return post_delete(false, n, buffers);
+}
+
+typedef struct {
+    GLsync sync;
+    GLJobCallback done;
+    void* data;
+} FenceJob;
+
+static GLJobStatus run_fence(void* data) {
+    FenceJob* f = (FenceJob*)data;
+    if (!f->sync) {
+        f->sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        return f->sync ? GL_JOB_RETRY : GL_JOB_DONE;
+    }
+    GLenum status = glClientWaitSync(f->sync, 0, 0);
+    return status == GL_TIMEOUT_EXPIRED ? GL_JOB_RETRY : GL_JOB_DONE;
+}
+
+static void fence_done(void* data, bool completed) {
+    FenceJob* f = (FenceJob*)data;
+    if (f->sync) glDeleteSync(f->sync);
+    if (f->done) f->done(f->data, completed);
+    free(f);
+}
+
+GLJob* gl_jobs_fence(GLJobCallback done, void* data) {
+    FenceJob* f = (FenceJob*)calloc(1, sizeof(FenceJob));
+    if (!f) return NULL;
+    f->done = done;
+    f->data = data;
+
+    GLJob* job = gl_job_submit(run_fence, fence_done, f);
+    if (!job) free(f);
+    return job;
+}
+
+/* ===== Frame integration ===== */
+
+/* Returns false if the job asked to run again */
+static bool run_job(GLJob* job) {
+    if (job->run(job->data) == GL_JOB_RETRY) return false;
+    finish(job, JOB_COMPLETED);
+    atomic_fetch_add_explicit(&g.frame_completed, 1, memory_order_relaxed);
+    return true;
+}
+
+void gl_jobs_run_pending(void) {
+    if (atomic_load_explicit(&g.pending, memory_order_relaxed) == 0) {
+        atomic_store_explicit(&g.last_completed, atomic_exchange(&g.frame_completed, 0),
+                          memory_order_relaxed);
+        return;
+    }
+    /* Another context is ending its frame; it runs the jobs */
+    if (atomic_flag_test_and_set_explicit(&g.consuming, memory_order_acquire)) return;
+
+    /* Jobs bind through the shadow; give the application its state back afterwards */
+    StateDrawKey live;
+    GLint active = 0, array_buffer = 0, unpack_buffer = 0;
+    state_shadow_capture_key(&live);
+    state_shadow_get_integerv(GL_ACTIVE_TEXTURE, &active);
+    state_shadow_get_integerv(GL_ARRAY_BUFFER_BINDING, &array_buffer);
+    state_shadow_get_integerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack_buffer);
+
+    uint64_t deadline = now_ns() + JOB_FRAME_BUDGET_NS;
+
+    /* Jobs waiting on a previous frame first, each at most once */
+    GLJob* retry = g.retry;
+    GLJob** keep = &g.retry;
+    g.retry = NULL;
+    while (retry) {
+        GLJob* job = retry;
+        retry = job->retry_next;
+        if (now_ns() >= deadline || !run_job(job)) {
+            job->retry_next = NULL;
+            *keep = job;
+            keep = &job->retry_next;
+        }
+    }
+
+    GLJob* job;
+    while (now_ns() < deadline && (job = pop()) != NULL) {
+        if (!run_job(job)) {
+            job->retry_next = NULL;
+            *keep = job;
+            keep = &job->retry_next;
+        }
+    }
+
+    state_shadow_apply_key(&live);
+    state_shadow_bind_buffer(GL_ARRAY_BUFFER, (GLuint)array_buffer);
+    state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, (GLuint)unpack_buffer);
+    state_shadow_active_texture((GLenum)active);
+
+    atomic_store_explicit(&g.last_completed, atomic_exchange(&g.frame_completed, 0),
+                          memory_order_relaxed);
+    atomic_flag_clear_explicit(&g.consuming, memory_order_release);
+}
+
+void gl_jobs_shutdown(void) {
+    while (atomic_flag_test_and_set_explicit(&g.consuming, memory_order_acquire)) {
+        sched_yield();
+    }
+
+    uint32_t dropped = 0;
+    GLJob* job;
+    while ((job = g.retry) != NULL) {
+        g.retry = job->retry_next;
+        finish(job, JOB_DROPPED);
+        dropped++;
+    }
+    while ((job = pop()) != NULL) {
+        finish(job, JOB_DROPPED);
+        dropped++;
+    }
+    if (dropped > 0) LOGI("Dropped %u GL jobs at shutdown", dropped);
+
+    atomic_flag_clear_explicit(&g.consuming, memory_order_release);
+}
+
+void gl_jobs_get_stats(uint32_t* completed, uint32_t* pending) {
+    if (completed) *completed = atomic_load_explicit(&g.last_completed, memory_order_relaxed);
+    if (pending) *pending = atomic_load_explicit(&g.pending, memory_order_relaxed);
+}
@@ -0,0 +1,1030 @@
+/*
+ * PrismGL Call Marshalling
+ * Entry points handed out while threaded dispatch is enabled. Each one
+ * records its arguments for the GL thread when the calling thread's
+ * context lives there, and calls straight through otherwise.
+ *
+ * Pointer arguments are only recorded when it is known what they point
+ * to: buffer offsets are copied as values and client memory with a known
+ * size is copied into the ring. Everything else, and every call that
+ * returns a value, waits for the GL thread.
+ */
+
+#include "gl_thread.h"
+#include "prismgl.h"
+#include "texture_registry.h"
+
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Marshal"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+
+#define VAO_CACHE_SIZE 256
+
+/*
+ * Bindings that decide how pointer arguments are read, as seen by the
+ * render thread. Only maintained while its context is on the GL thread;
+ * reloaded from the context whenever it is handed over.
+ */
+static struct {
+    GLuint array_buffer;
+    GLuint pixel_unpack_buffer;
+    GLuint vertex_array;
+    GLuint element_buffer;
+    bool element_buffer_known;
+    GLint unpack_alignment;
+    GLint unpack_row_length;
+    bool unpack_simple;             /* No skip pixels/rows/images */
+    struct {
+        GLuint vao;
+        GLuint element_buffer;
+    } vao_cache[VAO_CACHE_SIZE];    /* Element buffers of recently bound VAOs */
+} t;
+
+void gl_marshal_sync_bindings(void) {
+    GLint value = 0;
+
+    prismgl_glGetIntegerv_wrapper(GL_ARRAY_BUFFER_BINDING, &value);
+    t.array_buffer = (GLuint)value;
+    prismgl_glGetIntegerv_wrapper(GL_PIXEL_UNPACK_BUFFER_BINDING, &value);
+    t.pixel_unpack_buffer = (GLuint)value;
+    prismgl_glGetIntegerv_wrapper(GL_VERTEX_ARRAY_BINDING, &value);
+    t.vertex_array = (GLuint)value;
+    prismgl_glGetIntegerv_wrapper(GL_ELEMENT_ARRAY_BUFFER_BINDING, &value);
+    t.element_buffer = (GLuint)value;
+    t.element_buffer_known = true;
+
+    prismgl_glGetIntegerv_wrapper(GL_UNPACK_ALIGNMENT, &t.unpack_alignment);
+    prismgl_glGetIntegerv_wrapper(GL_UNPACK_ROW_LENGTH, &t.unpack_row_length);
+    GLint skip_pixels = 0, skip_rows = 0, skip_images = 0, image_height = 0;
+    prismgl_glGetIntegerv_wrapper(GL_UNPACK_SKIP_PIXELS, &skip_pixels);
+    prismgl_glGetIntegerv_wrapper(GL_UNPACK_SKIP_ROWS, &skip_rows);
+    prismgl_glGetIntegerv_wrapper(GL_UNPACK_SKIP_IMAGES, &skip_images);
+    prismgl_glGetIntegerv_wrapper(GL_UNPACK_IMAGE_HEIGHT, &image_height);
+    t.unpack_simple = skip_pixels == 0 && skip_rows == 0 && skip_images == 0 && image_height == 0;
+
+    memset(t.vao_cache, 0, sizeof(t.vao_cache));
+}
+
+/* ===== Generators ===== */
+
+/*
+ * ASYNC records the arguments and returns, SYNC and SYNCV wait for the GL
+ * thread with the arguments left on the caller's stack. The A* helpers
+ * expand a parameter type list into the pieces the generators need.
+ */
+#define A0()                        (void), int unused;, (void)a0;, (), ()
+#define A1(T1)                      (T1 a1), T1 a1;, c->a1 = a1;, (c->a1), (a1)
+#define A2(T1, T2)                  (T1 a1, T2 a2), T1 a1; T2 a2;, \
+                                    c->a1 = a1; c->a2 = a2;, (c->a1, c->a2), (a1, a2)
+#define A3(T1, T2, T3)              (T1 a1, T2 a2, T3 a3), T1 a1; T2 a2; T3 a3;, \
+                                    c->a1 = a1; c->a2 = a2; c->a3 = a3;, \
+                                    (c->a1, c->a2, c->a3), (a1, a2, a3)
+#define A4(T1, T2, T3, T4)          (T1 a1, T2 a2, T3 a3, T4 a4), T1 a1; T2 a2; T3 a3; T4 a4;, \
+                                    c->a1 = a1; c->a2 = a2; c->a3 = a3; c->a4 = a4;, \
+                                    (c->a1, c->a2, c->a3, c->a4), (a1, a2, a3, a4)
+#define A5(T1, T2, T3, T4, T5)      (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5), \
+                                    T1 a1; T2 a2; T3 a3; T4 a4; T5 a5;, \
+                                    c->a1 = a1; c->a2 = a2; c->a3 = a3; c->a4 = a4; c->a5 = a5;, \
+                                    (c->a1, c->a2, c->a3, c->a4, c->a5), (a1, a2, a3, a4, a5)
+#define A6(T1, T2, T3, T4, T5, T6)  (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6), \
+                                    T1 a1; T2 a2; T3 a3; T4 a4; T5 a5; T6 a6;, \
+                                    c->a1 = a1; c->a2 = a2; c->a3 = a3; c->a4 = a4; c->a5 = a5; \
+                                    c->a6 = a6;, \
+                                    (c->a1, c->a2, c->a3, c->a4, c->a5, c->a6), \
+                                    (a1, a2, a3, a4, a5, a6)
+#define A7(T1, T2, T3, T4, T5, T6, T7) \
+                                    (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6, T7 a7), \
+                                    T1 a1; T2 a2; T3 a3; T4 a4; T5 a5; T6 a6; T7 a7;, \
+                                    c->a1 = a1; c->a2 = a2; c->a3 = a3; c->a4 = a4; c->a5 = a5; \
+                                    c->a6 = a6; c->a7 = a7;, \
+                                    (c->a1, c->a2, c->a3, c->a4, c->a5, c->a6, c->a7), \
+                                    (a1, a2, a3, a4, a5, a6, a7)
+#define A9(T1, T2, T3, T4, T5, T6, T7, T8, T9) \
+                                    (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6, T7 a7, T8 a8, T9 a9), \
+                                    T1 a1; T2 a2; T3 a3; T4 a4; T5 a5; T6 a6; T7 a7; T8 a8; T9 a9;, \
+                                    c->a1 = a1; c->a2 = a2; c->a3 = a3; c->a4 = a4; c->a5 = a5; \
+                                    c->a6 = a6; c->a7 = a7; c->a8 = a8; c->a9 = a9;, \
+                                    (c->a1, c->a2, c->a3, c->a4, c->a5, c->a6, c->a7, c->a8, c->a9), \
+                                    (a1, a2, a3, a4, a5, a6, a7, a8, a9)
+#define A10(T1, T2, T3, T4, T5, T6, T7, T8, T9, T10) \
+                                    (T1 a1, T2 a2, T3 a3, T4 a4, T5 a5, T6 a6, T7 a7, T8 a8, T9 a9, \
+                                     T10 a10), \
+                                    T1 a1; T2 a2; T3 a3; T4 a4; T5 a5; T6 a6; T7 a7; T8 a8; T9 a9; \
+                                    T10 a10;, \
+                                    c->a1 = a1; c->a2 = a2; c->a3 = a3; c->a4 = a4; c->a5 = a5; \
+                                    c->a6 = a6; c->a7 = a7; c->a8 = a8; c->a9 = a9; c->a10 = a10;, \
+                                    (c->a1, c->a2, c->a3, c->a4, c->a5, c->a6, c->a7, c->a8, c->a9, \
+                                     c->a10), \
+                                    (a1, a2, a3, a4, a5, a6, a7, a8, a9, a10)
+
+#define ASYNC(name, impl, sig) ASYNC_(name, impl, sig)
+#define ASYNC_(name, impl, PARAMS, FIELDS, STORE, FROM, DIRECT)              \
+    typedef struct { FIELDS } name##_args;                                  \
+    static void name##_exec(const void* p) {                                \
+        const name##_args* c = (const name##_args*)p;                       \
+        (void)c;                                                            \
+        impl FROM;                                                          \
+    }                                                                       \
+    static void marshal_##name PARAMS {                                     \
+        if (!gl_thread_remote()) {                                          \
+            impl DIRECT;                                                    \
+            return;                                                         \
+        }                                                                   \
+        name##_args* c = (name##_args*)gl_thread_enqueue(name##_exec, sizeof(name##_args)); \
+        (void)c;                                                            \
+        STORE                                                               \
+    }
+
+#define SYNC(R, name, impl, sig) SYNC_(R, name, impl, sig)
+#define SYNC_(R, name, impl, PARAMS, FIELDS, STORE, FROM, DIRECT)           \
+    typedef struct { FIELDS R ret; } name##_args;                           \
+    static void name##_exec(const void* p) {                                \
+        name##_args* c = (name##_args*)p;                                   \
+        c->ret = impl FROM;                                                 \
+    }                                                                       \
+    static R marshal_##name PARAMS {                                        \
+        if (!gl_thread_remote()) return impl DIRECT;                        \
+        name##_args s;                                                      \
+        name##_args* c = &s;                                                \
+        STORE                                                               \
+        gl_thread_call(name##_exec, c);                                     \
+        return s.ret;                                                       \
+    }
+
+#define SYNCV(name, impl, sig) SYNCV_(name, impl, sig)
+#define SYNCV_(name, impl, PARAMS, FIELDS, STORE, FROM, DIRECT)             \
+    typedef struct { FIELDS } name##_args;                                  \
+    static void name##_exec(const void* p) {                                \
+        const name##_args* c = (const name##_args*)p;                       \
+        (void)c;                                                            \
+        impl FROM;                                                          \
+    }                                                                       \
+    static void marshal_##name PARAMS {                                     \
+        if (!gl_thread_remote()) {                                          \
+            impl DIRECT;                                                    \
+            return;                                                         \
+        }                                                                   \
+        name##_args s;                                                      \
+        name##_args* c = &s;                                                \
+        STORE                                                               \
+        gl_thread_call(name##_exec, c);                                     \
+    }
+
+/* A0 stores a dummy argument so that every record has a field */
+static const int a0 = 0;
+
+/* ===== Fixed-function emulation ===== */
+
+ASYNC(glBegin,          prismgl_glBegin,            A1(GLenum))
+ASYNC(glEnd,            prismgl_glEnd,              A0())
+ASYNC(glVertex2f,       prismgl_glVertex2f,         A2(GLfloat, GLfloat))
+ASYNC(glVertex3f,       prismgl_glVertex3f,         A3(GLfloat, GLfloat, GLfloat))
+ASYNC(glVertex2d,       prismgl_glVertex2d,         A2(double, double))
+ASYNC(glVertex3d,       prismgl_glVertex3d,         A3(double, double, double))
+ASYNC(glTexCoord2f,     prismgl_glTexCoord2f,       A2(GLfloat, GLfloat))
+ASYNC(glTexCoord2d,     prismgl_glTexCoord2d,       A2(double, double))
+ASYNC(glColor3f,        prismgl_glColor3f,          A3(GLfloat, GLfloat, GLfloat))
+ASYNC(glColor4f,        prismgl_glColor4f,          A4(GLfloat, GLfloat, GLfloat, GLfloat))
+ASYNC(glColor3ub,       prismgl_glColor3ub,         A3(GLubyte, GLubyte, GLubyte))
+ASYNC(glColor4ub,       prismgl_glColor4ub,         A4(GLubyte, GLubyte, GLubyte, GLubyte))
+ASYNC(glNormal3f,       prismgl_glNormal3f,         A3(GLfloat, GLfloat, GLfloat))
+ASYNC(glMatrixMode,     prismgl_glMatrixMode,       A1(GLenum))
+ASYNC(glPushMatrix,     prismgl_glPushMatrix,       A0())
+ASYNC(glPopMatrix,      prismgl_glPopMatrix,        A0())
+ASYNC(glLoadIdentity,   prismgl_glLoadIdentity,     A0())
+ASYNC(glTranslatef,     prismgl_glTranslatef,       A3(GLfloat, GLfloat, GLfloat))
+ASYNC(glRotatef,        prismgl_glRotatef,          A4(GLfloat, GLfloat, GLfloat, GLfloat))
+ASYNC(glScalef,         prismgl_glScalef,           A3(GLfloat, GLfloat, GLfloat))
+ASYNC(glOrtho,          prismgl_glOrtho,            A6(double, double, double, double, double, double))
+ASYNC(glFrustum,        prismgl_glFrustum,          A6(double, double, double, double, double, double))
+
+typedef struct {
+    GLfloat m[16];
+    bool load;
+} MatrixArgs;
+
+static void exec_matrix(const void* p) {
+    const MatrixArgs* c = (const MatrixArgs*)p;
+    if (c->load) prismgl_glLoadMatrixf(c->m);
+    else prismgl_glMultMatrixf(c->m);
+}
+
+static void record_matrix(const GLfloat* m, bool load) {
+    MatrixArgs* c = (MatrixArgs*)gl_thread_enqueue(exec_matrix, sizeof(MatrixArgs));
+    memcpy(c->m, m, sizeof(c->m));
+    c->load = load;
+}
+
+static void marshal_glLoadMatrixf(const GLfloat* m) {
+    if (!gl_thread_remote() || !m) prismgl_glLoadMatrixf(m);
+    else record_matrix(m, true);
+}
+
+static void marshal_glMultMatrixf(const GLfloat* m) {
+    if (!gl_thread_remote() || !m) prismgl_glMultMatrixf(m);
+    else record_matrix(m, false);
+}
+
+/* ===== State ===== */
+
+ASYNC(glEnable,             prismgl_glEnable_wrapper,           A1(GLenum))
+ASYNC(glDisable,            prismgl_glDisable_wrapper,          A1(GLenum))
+ASYNC(glBlendFunc,          prismgl_glBlendFunc_wrapper,        A2(GLenum, GLenum))
+ASYNC(glBlendFuncSeparate,  prismgl_glBlendFuncSeparate_wrapper, A4(GLenum, GLenum, GLenum, GLenum))
+ASYNC(glBlendEquation,      glBlendEquation,                    A1(GLenum))
+ASYNC(glBlendEquationSeparate, glBlendEquationSeparate,         A2(GLenum, GLenum))
+ASYNC(glBlendColor,         glBlendColor,                       A4(GLfloat, GLfloat, GLfloat, GLfloat))
+ASYNC(glDepthMask,          prismgl_glDepthMask_wrapper,        A1(GLboolean))
+ASYNC(glDepthFunc,          glDepthFunc,                        A1(GLenum))
+ASYNC(glDepthRangef,        glDepthRangef,                      A2(GLfloat, GLfloat))
+ASYNC(glColorMask,          glColorMask,                        A4(GLboolean, GLboolean, GLboolean, GLboolean))
+ASYNC(glCullFace,           glCullFace,                         A1(GLenum))
+ASYNC(glFrontFace,          glFrontFace,                        A1(GLenum))
+ASYNC(glPolygonOffset,      glPolygonOffset,                    A2(GLfloat, GLfloat))
+ASYNC(glStencilFunc,        glStencilFunc,                      A3(GLenum, GLint, GLuint))
+ASYNC(glStencilOp,          glStencilOp,                        A3(GLenum, GLenum, GLenum))
+ASYNC(glStencilMask,        glStencilMask,                      A1(GLuint))
+ASYNC(glViewport,           prismgl_glViewport_wrapper,         A4(GLint, GLint, GLsizei, GLsizei))
+ASYNC(glScissor,            prismgl_glScissor_wrapper,          A4(GLint, GLint, GLsizei, GLsizei))
+ASYNC(glClear,              prismgl_glClear_wrapper,            A1(GLbitfield))
+ASYNC(glClearColor,         glClearColor,                       A4(GLfloat, GLfloat, GLfloat, GLfloat))
+ASYNC(glClearDepthf,        glClearDepthf,                      A1(GLfloat))
+ASYNC(glClearStencil,       glClearStencil,                     A1(GLint))
+ASYNC(glHint,               glHint,                             A2(GLenum, GLenum))
+ASYNC(glFlush,              prismgl_glFlush_wrapper,            A0())
+SYNCV(glFinish,             prismgl_glFinish_wrapper,           A0())
+
+SYNC(GLenum,          glGetError,       glGetError,                     A0())
+SYNC(GLboolean,       glIsEnabled,      prismgl_glIsEnabled_wrapper,    A1(GLenum))
+SYNC(const GLubyte*,  glGetString,      prismgl_glGetString_wrapper,    A1(GLenum))
+SYNC(const GLubyte*,  glGetStringi,     prismgl_glGetStringi_wrapper,   A2(GLenum, GLuint))
+SYNCV(glGetIntegerv,  prismgl_glGetIntegerv_wrapper,    A2(GLenum, GLint*))
+SYNCV(glGetFloatv,    prismgl_glGetFloatv_wrapper,      A2(GLenum, GLfloat*))
+SYNCV(glGetInteger64v, prismgl_glGetInteger64v_wrapper, A2(GLenum, GLint64*))
+SYNCV(glGetBooleanv,  prismgl_glGetBooleanv_wrapper,    A2(GLenum, GLboolean*))
+
+/* Unpack state decides how many bytes a texture upload reads */
+ASYNC(glPixelStorei_record, prismgl_glPixelStorei_wrapper, A2(GLenum, GLint))
+
+static void marshal_glPixelStorei(GLenum pname, GLint param) {
+    if (gl_thread_remote()) {
+        switch (pname) {
+            case GL_UNPACK_ALIGNMENT:   t.unpack_alignment = param; break;
+            case GL_UNPACK_ROW_LENGTH:  t.unpack_row_length = param; break;
+            case GL_UNPACK_SKIP_PIXELS:
+            case GL_UNPACK_SKIP_ROWS:
+            case GL_UNPACK_SKIP_IMAGES:
+            case GL_UNPACK_IMAGE_HEIGHT:
+                /* Reset to 0 by careful callers; stay conservative until the next handoff */
+                if (param != 0) t.unpack_simple = false;
+                break;
+            default: break;
+        }
+    }
+    marshal_glPixelStorei_record(pname, param);
+}
+
+/* ===== Buffers and vertex arrays ===== */
+
+ASYNC(glBindBuffer_record,      prismgl_glBindBuffer_wrapper,       A2(GLenum, GLuint))
+ASYNC(glBindBufferBase_record,  prismgl_glBindBufferBase_wrapper,   A3(GLenum, GLuint, GLuint))
+ASYNC(glBindBufferRange_record, prismgl_glBindBufferRange_wrapper,
+      A5(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr))
+ASYNC(glBindVertexArray_record, prismgl_glBindVertexArray_wrapper,  A1(GLuint))
+
+static void track_buffer_binding(GLenum target, GLuint buffer) {
+    switch (target) {
+        case GL_ARRAY_BUFFER:
+            t.array_buffer = buffer;
+            break;
+        case GL_PIXEL_UNPACK_BUFFER:
+            t.pixel_unpack_buffer = buffer;
+            break;
+        case GL_ELEMENT_ARRAY_BUFFER: {
+            t.element_buffer = buffer;
+            t.element_buffer_known = true;
+            unsigned slot = t.vertex_array % VAO_CACHE_SIZE;
+            t.vao_cache[slot].vao = t.vertex_array;
+            t.vao_cache[slot].element_buffer = buffer;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void marshal_glBindBuffer(GLenum target, GLuint buffer) {
+    if (gl_thread_remote()) track_buffer_binding(target, buffer);
+    marshal_glBindBuffer_record(target, buffer);
+}
+
+static void marshal_glBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    if (gl_thread_remote()) track_buffer_binding(target, buffer);
+    marshal_glBindBufferBase_record(target, index, buffer);
+}
+
+static void marshal_glBindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                                      GLintptr offset, GLsizeiptr size) {
+    if (gl_thread_remote()) track_buffer_binding(target, buffer);
+    marshal_glBindBufferRange_record(target, index, buffer, offset, size);
+}
+
+static void marshal_glBindVertexArray(GLuint array) {
+    if (gl_thread_remote()) {
+        unsigned slot = array % VAO_CACHE_SIZE;
+        t.vertex_array = array;
+        t.element_buffer_known = t.vao_cache[slot].vao == array && array != 0;
+        t.element_buffer = t.element_buffer_known ? t.vao_cache[slot].element_buffer : 0;
+    }
+    marshal_glBindVertexArray_record(array);
+}
+
+/* glDelete* and friends: the name list is copied */
+typedef void (*NamesFunc)(GLsizei n, const GLuint* names);
+
+typedef struct {
+    NamesFunc func;
+    GLsizei n;
+    GLuint names[];
+} NamesArgs;
+
+static void exec_names(const void* p) {
+    const NamesArgs* c = (const NamesArgs*)p;
+    c->func(c->n, c->names);
+}
+
+static void record_names(NamesFunc func, GLsizei n, const GLuint* names) {
+    size_t bytes = (size_t)n * sizeof(GLuint);
+    if (!gl_thread_remote() || n <= 0 || !names || bytes > gl_thread_max_payload()) {
+        if (gl_thread_remote()) gl_thread_finish();
+        func(n, names);
+        return;
+    }
+    NamesArgs* c = (NamesArgs*)gl_thread_enqueue(exec_names, sizeof(NamesArgs) + bytes);
+    c->func = func;
+    c->n = n;
+    memcpy(c->names, names, bytes);
+}
+
+static void forget_buffers(GLsizei n, const GLuint* buffers) {
+    for (GLsizei i = 0; i < n; i++) {
+        if (buffers[i] == 0) continue;
+        if (t.array_buffer == buffers[i]) t.array_buffer = 0;
+        if (t.pixel_unpack_buffer == buffers[i]) t.pixel_unpack_buffer = 0;
+        if (t.element_buffer == buffers[i]) t.element_buffer = 0;
+        for (int s = 0; s < VAO_CACHE_SIZE; s++) {
+            if (t.vao_cache[s].element_buffer == buffers[i]) t.vao_cache[s].vao = 0;
+        }
+    }
+}
+
+static void marshal_glDeleteBuffers(GLsizei n, const GLuint* buffers) {
+    if (gl_thread_remote() && buffers) forget_buffers(n, buffers);
+    record_names(prismgl_glDeleteBuffers_wrapper, n, buffers);
+}
+
+static void marshal_glDeleteVertexArrays(GLsizei n, const GLuint* arrays) {
+    if (gl_thread_remote() && arrays) {
+        for (GLsizei i = 0; i < n; i++) {
+            if (arrays[i] == 0) continue;
+            t.vao_cache[arrays[i] % VAO_CACHE_SIZE].vao = 0;
+            if (t.vertex_array == arrays[i]) {
+                t.vertex_array = 0;
+                t.element_buffer_known = false;
+            }
+        }
+    }
+    record_names(prismgl_glDeleteVertexArrays_wrapper, n, arrays);
+}
+
+static void marshal_glDeleteTextures(GLsizei n, const GLuint* textures) {
+    record_names(prismgl_glDeleteTextures_wrapper, n, textures);
+}
+
+static void marshal_glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+    record_names(prismgl_glDeleteFramebuffers_wrapper, n, framebuffers);
+}
+
+static void marshal_glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers) {
+    record_names(glDeleteRenderbuffers, n, renderbuffers);
+}
+
+static void marshal_glDeleteQueries(GLsizei n, const GLuint* ids) {
+    record_names(prismgl_glDeleteQueries, n, ids);
+}
+
+SYNCV(glGenBuffers,         glGenBuffers,           A2(GLsizei, GLuint*))
+SYNCV(glGenVertexArrays,    glGenVertexArrays,      A2(GLsizei, GLuint*))
+SYNCV(glGenTextures,        glGenTextures,          A2(GLsizei, GLuint*))
+SYNCV(glGenFramebuffers,    glGenFramebuffers,      A2(GLsizei, GLuint*))
+SYNCV(glGenRenderbuffers,   glGenRenderbuffers,     A2(GLsizei, GLuint*))
+SYNCV(glGenQueries,         prismgl_glGenQueries,   A2(GLsizei, GLuint*))
+
+typedef struct {
+    GLenum target;
+    GLintptr offset;
+    GLsizeiptr size;
+    GLenum usage;
+    bool sub;
+    bool has_data;
+    _Alignas(16) uint8_t data[];
+} BufferDataArgs;
+
+static void exec_buffer_data(const void* p) {
+    const BufferDataArgs* c = (const BufferDataArgs*)p;
+    const void* data = c->has_data ? c->data : NULL;
+    if (c->sub) prismgl_glBufferSubData_wrapper(c->target, c->offset, c->size, data);
+    else prismgl_glBufferData_wrapper(c->target, c->size, data, c->usage);
+}
+
+static bool record_buffer_data(GLenum target, GLintptr offset, GLsizeiptr size,
+                               const void* data, GLenum usage, bool sub) {
+    size_t bytes = data && size > 0 ? (size_t)size : 0;
+    if (bytes > gl_thread_max_payload()) return false;
+
+    BufferDataArgs* c = (BufferDataArgs*)gl_thread_enqueue(exec_buffer_data,
+                                                           sizeof(BufferDataArgs) + bytes);
+    c->target = target;
+    c->offset = offset;
+    c->size = size;
+    c->usage = usage;
+    c->sub = sub;
+    c->has_data = bytes > 0;
+    if (bytes) memcpy(c->data, data, bytes);
+    return true;
+}
+
+SYNCV(glBufferData_sync,    prismgl_glBufferData_wrapper,    A4(GLenum, GLsizeiptr, const void*, GLenum))
+SYNCV(glBufferSubData_sync, prismgl_glBufferSubData_wrapper, A4(GLenum, GLintptr, GLsizeiptr, const void*))
+
+static void marshal_glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) {
+    if (!gl_thread_remote() || !record_buffer_data(target, 0, size, data, usage, false)) {
+        marshal_glBufferData_sync(target, size, data, usage);
+    }
+}
+
+static void marshal_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size,
+                                    const void* data) {
+    if (!gl_thread_remote() || !record_buffer_data(target, offset, size, data, 0, true)) {
+        marshal_glBufferSubData_sync(target, offset, size, data);
+    }
+}
+
+ASYNC(glCopyBufferSubData,  prismgl_glCopyBufferSubData_wrapper,
+      A5(GLenum, GLenum, GLintptr, GLintptr, GLsizeiptr))
+SYNC(void*,     glMapBufferRange,   prismgl_glMapBufferRange_wrapper,
+     A4(GLenum, GLintptr, GLsizeiptr, GLbitfield))
+SYNC(GLboolean, glUnmapBuffer,      glUnmapBuffer,          A1(GLenum))
+ASYNC(glFlushMappedBufferRange,     glFlushMappedBufferRange, A3(GLenum, GLintptr, GLsizeiptr))
+
+/* Attribute pointers are buffer offsets, or client pointers read at draw time */
+ASYNC(glVertexAttribPointer,    glVertexAttribPointer,
+      A6(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*))
+ASYNC(glVertexAttribIPointer,   glVertexAttribIPointer,
+      A5(GLuint, GLint, GLenum, GLsizei, const void*))
+ASYNC(glEnableVertexAttribArray,    glEnableVertexAttribArray,  A1(GLuint))
+ASYNC(glDisableVertexAttribArray,   glDisableVertexAttribArray, A1(GLuint))
+ASYNC(glVertexAttribDivisor,        glVertexAttribDivisor,      A2(GLuint, GLuint))
+ASYNC(glVertexAttrib4f,             glVertexAttrib4f,
+      A5(GLuint, GLfloat, GLfloat, GLfloat, GLfloat))
+
+/* ===== Draws ===== */
+
+/* The default VAO may source client memory, which must be read before returning */
+static inline bool draw_can_record(void) {
+    return t.vertex_array != 0;
+}
+
+ASYNC(glDrawArrays_record,              prismgl_glDrawArrays_wrapper,   A3(GLenum, GLint, GLsizei))
+ASYNC(glDrawArraysInstanced_record,     prismgl_glDrawArraysInstanced_wrapper,
+      A4(GLenum, GLint, GLsizei, GLsizei))
+SYNCV(glDrawArrays_sync,                prismgl_glDrawArrays_wrapper,   A3(GLenum, GLint, GLsizei))
+SYNCV(glDrawArraysInstanced_sync,       prismgl_glDrawArraysInstanced_wrapper,
+      A4(GLenum, GLint, GLsizei, GLsizei))
+
+static void marshal_glDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    if (!gl_thread_remote() || draw_can_record()) marshal_glDrawArrays_record(mode, first, count);
+    else marshal_glDrawArrays_sync(mode, first, count);
+}
+
+static void marshal_glDrawArraysInstanced(GLenum mode, GLint first, GLsizei count,
+                                          GLsizei instancecount) {
+    if (!gl_thread_remote() || draw_can_record()) {
+        marshal_glDrawArraysInstanced_record(mode, first, count, instancecount);
+    } else {
+        marshal_glDrawArraysInstanced_sync(mode, first, count, instancecount);
+    }
+}
+
+static size_t index_size(GLenum type) {
+    switch (type) {
+        case GL_UNSIGNED_BYTE:  return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT:   return 4;
+        default:                return 0;
+    }
+}
+
+typedef enum {
+    ELEMENTS_PLAIN = 0,
+    ELEMENTS_INSTANCED,
+    ELEMENTS_BASE_VERTEX,
+    ELEMENTS_RANGE
+} ElementsKind;
+
+typedef struct {
+    ElementsKind kind;
+    GLenum mode;
+    GLsizei count;
+    GLenum type;
+    const void* indices;        /* Buffer offset, or NULL when copied */
+    GLsizei instancecount;
+    GLint basevertex;
+    GLuint start;
+    GLuint end;
+    _Alignas(16) uint8_t data[];
+} ElementsArgs;
+
+static void run_elements(const ElementsArgs* c, const void* indices) {
+    switch (c->kind) {
+        case ELEMENTS_PLAIN:
+            prismgl_glDrawElements_wrapper(c->mode, c->count, c->type, indices);
+            break;
+        case ELEMENTS_INSTANCED:
+            prismgl_glDrawElementsInstanced_wrapper(c->mode, c->count, c->type, indices,
+                                                    c->instancecount);
+            break;
+        case ELEMENTS_BASE_VERTEX:
+            prismgl_glDrawElementsBaseVertex_wrapper(c->mode, c->count, c->type, indices,
+                                                     c->basevertex);
+            break;
+        case ELEMENTS_RANGE:
+            glDrawRangeElements(c->mode, c->start, c->end, c->count, c->type, indices);
+            break;
+    }
+}
+
+static void exec_elements(const void* p) {
+    const ElementsArgs* c = (const ElementsArgs*)p;
+    run_elements(c, c->indices ? c->indices : (const void*)c->data);
+}
+
+static void exec_elements_sync(const void* p) {
+    const ElementsArgs* c = (const ElementsArgs*)p;
+    run_elements(c, c->indices);
+}
+
+/* Indices come from the element buffer, or are copied out of client memory */
+static void draw_elements(ElementsArgs* a) {
+    if (!gl_thread_remote()) {
+        run_elements(a, a->indices);
+        return;
+    }
+
+    size_t bytes = a->count > 0 ? (size_t)a->count * index_size(a->type) : 0;
+    bool client = t.element_buffer_known && t.element_buffer == 0;
+    if (!draw_can_record() || !t.element_buffer_known ||
+        (client && (bytes == 0 || bytes > gl_thread_max_payload()))) {
+        gl_thread_call(exec_elements_sync, a);
+        return;
+    }
+
+    ElementsArgs* c = (ElementsArgs*)gl_thread_enqueue(exec_elements,
+                                                       sizeof(ElementsArgs) + (client ? bytes : 0));
+    *c = *a;
+    if (client) {
+        c->indices = NULL;
+        memcpy(c->data, a->indices, bytes);
+    }
+}
+
+static void marshal_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) {
+    ElementsArgs a = { .kind = ELEMENTS_PLAIN, .mode = mode, .count = count, .type = type,
+                       .indices = indices };
+    draw_elements(&a);
+}
+
+static void marshal_glDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type,
+                                            const void* indices, GLsizei instancecount) {
+    ElementsArgs a = { .kind = ELEMENTS_INSTANCED, .mode = mode, .count = count, .type = type,
+                       .indices = indices, .instancecount = instancecount };
+    draw_elements(&a);
+}
+
+static void marshal_glDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type,
+                                             const void* indices, GLint basevertex) {
+    ElementsArgs a = { .kind = ELEMENTS_BASE_VERTEX, .mode = mode, .count = count, .type = type,
+                       .indices = indices, .basevertex = basevertex };
+    draw_elements(&a);
+}
+
+static void marshal_glDrawRangeElements(GLenum mode, GLuint start, GLuint end, GLsizei count,
+                                        GLenum type, const void* indices) {
+    ElementsArgs a = { .kind = ELEMENTS_RANGE, .mode = mode, .count = count, .type = type,
+                       .indices = indices, .start = start, .end = end };
+    draw_elements(&a);
+}
+
+typedef struct {
+    GLenum mode;
+    GLsizei drawcount;
+    _Alignas(16) uint8_t data[];    /* firsts, then counts */
+} MultiDrawArgs;
+
+static void exec_multi_draw_arrays(const void* p) {
+    const MultiDrawArgs* c = (const MultiDrawArgs*)p;
+    const GLint* first = (const GLint*)c->data;
+    const GLsizei* count = (const GLsizei*)(first + c->drawcount);
+    prismgl_glMultiDrawArrays(c->mode, first, count, c->drawcount);
+}
+
+SYNCV(glMultiDrawArrays_sync, prismgl_glMultiDrawArrays,
+      A4(GLenum, const GLint*, const GLsizei*, GLsizei))
+
+static void marshal_glMultiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count,
+                                      GLsizei drawcount) {
+    size_t bytes = drawcount > 0 ? (size_t)drawcount * (sizeof(GLint) + sizeof(GLsizei)) : 0;
+    if (!gl_thread_remote() || !draw_can_record() || !first || !count ||
+        bytes == 0 || bytes > gl_thread_max_payload()) {
+        marshal_glMultiDrawArrays_sync(mode, first, count, drawcount);
+        return;
+    }
+    MultiDrawArgs* c = (MultiDrawArgs*)gl_thread_enqueue(exec_multi_draw_arrays,
+                                                         sizeof(MultiDrawArgs) + bytes);
+    c->mode = mode;
+    c->drawcount = drawcount;
+    memcpy(c->data, first, (size_t)drawcount * sizeof(GLint));
+    memcpy(c->data + (size_t)drawcount * sizeof(GLint), count, (size_t)drawcount * sizeof(GLsizei));
+}
+
+SYNCV(glMultiDrawElements,  prismgl_glMultiDrawElements,
+      A5(GLenum, const GLsizei*, GLenum, const void* const*, GLsizei))
+SYNCV(glMultiDrawElementsBaseVertex, prismgl_glMultiDrawElementsBaseVertex,
+      A6(GLenum, const GLsizei*, GLenum, const void* const*, GLsizei, const GLint*))
+
+/* ===== Textures ===== */
+
+ASYNC(glActiveTexture,      prismgl_glActiveTexture_wrapper,    A1(GLenum))
+ASYNC(glBindTexture,        prismgl_glBindTexture_wrapper,      A2(GLenum, GLuint))
+ASYNC(glTexParameteri,      prismgl_glTexParameteri_wrapper,    A3(GLenum, GLenum, GLint))
+ASYNC(glTexParameterf,      glTexParameterf,                    A3(GLenum, GLenum, GLfloat))
+ASYNC(glGenerateMipmap,     prismgl_glGenerateMipmap_wrapper,   A1(GLenum))
+ASYNC(glTexStorage2D,       prismgl_glTexStorage2D_wrapper,
+      A5(GLenum, GLsizei, GLenum, GLsizei, GLsizei))
+ASYNC(glBindSampler,        glBindSampler,                      A2(GLuint, GLuint))
+ASYNC(glSamplerParameteri,  glSamplerParameteri,                A3(GLuint, GLenum, GLint))
+
+/* Bytes a 2D upload reads from client memory, 0 if it cannot be told */
+static size_t upload_size(GLsizei width, GLsizei height, GLenum format, GLenum type) {
+    size_t pixel = texture_pixel_size(format, type);
+    if (!t.unpack_simple || pixel == 0 || width <= 0 || height <= 0) return 0;
+
+    size_t row_pixels = t.unpack_row_length > 0 ? (size_t)t.unpack_row_length : (size_t)width;
+    size_t align = t.unpack_alignment > 0 ? (size_t)t.unpack_alignment : 4;
+    size_t stride = (row_pixels * pixel + align - 1) / align * align;
+    return stride * (size_t)(height - 1) + (size_t)width * pixel;
+}
+
+typedef struct {
+    bool sub;
+    GLenum target;
+    GLint level;
+    GLint internalformat;
+    GLint xoffset;
+    GLint yoffset;
+    GLsizei width;
+    GLsizei height;
+    GLint border;
+    GLenum format;
+    GLenum type;
+    const void* pixels;         /* Unpack buffer offset, or NULL when copied */
+    bool copied;
+    _Alignas(16) uint8_t data[];
+} TexImageArgs;
+
+static void run_tex_image(const TexImageArgs* c, const void* pixels) {
+    if (c->sub) {
+        prismgl_glTexSubImage2D_wrapper(c->target, c->level, c->xoffset, c->yoffset,
+                                        c->width, c->height, c->format, c->type, pixels);
+    } else {
+        prismgl_glTexImage2D_wrapper(c->target, c->level, c->internalformat, c->width,
+                                     c->height, c->border, c->format, c->type, pixels);
+    }
+}
+
+static void exec_tex_image(const void* p) {
+    const TexImageArgs* c = (const TexImageArgs*)p;
+    run_tex_image(c, c->copied ? (const void*)c->data : c->pixels);
+}
+
+static void exec_tex_image_sync(const void* p) {
+    const TexImageArgs* c = (const TexImageArgs*)p;
+    run_tex_image(c, c->pixels);
+}
+
+/*
+ * Uploads from an unpack buffer pass the offset through. Client pixels are
+ * copied when their size is known, otherwise the call waits until the GL
+ * thread has read them.
+ */
+static void tex_image(TexImageArgs* a) {
+    if (!gl_thread_remote()) {
+        run_tex_image(a, a->pixels);
+        return;
+    }
+
+    size_t bytes = 0;
+    if (t.pixel_unpack_buffer == 0 && a->pixels) {
+        bytes = upload_size(a->width, a->height, a->format, a->type);
+        if (bytes == 0 || bytes > gl_thread_max_payload()) {
+            gl_thread_call(exec_tex_image_sync, a);
+            return;
+        }
+    }
+
+    TexImageArgs* c = (TexImageArgs*)gl_thread_enqueue(exec_tex_image, sizeof(TexImageArgs) + bytes);
+    *c = *a;
+    c->copied = bytes > 0;
+    if (bytes) memcpy(c->data, a->pixels, bytes);
+}
+
+static void marshal_glTexImage2D(GLenum target, GLint level, GLint internalformat,
+                                 GLsizei width, GLsizei height, GLint border,
+                                 GLenum format, GLenum type, const void* pixels) {
+    TexImageArgs a = { .sub = false, .target = target, .level = level,
+                       .internalformat = internalformat, .width = width, .height = height,
+                       .border = border, .format = format, .type = type, .pixels = pixels };
+    tex_image(&a);
+}
+
+static void marshal_glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset,
+                                    GLsizei width, GLsizei height, GLenum format, GLenum type,
+                                    const void* pixels) {
+    TexImageArgs a = { .sub = true, .target = target, .level = level, .xoffset = xoffset,
+                       .yoffset = yoffset, .width = width, .height = height,
+                       .format = format, .type = type, .pixels = pixels };
+    tex_image(&a);
+}
+
+SYNCV(glReadPixels,     prismgl_glReadPixels_wrapper,
+      A7(GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void*))
+
+/* ===== Framebuffers ===== */
+
+ASYNC(glBindFramebuffer,        prismgl_glBindFramebuffer_wrapper,  A2(GLenum, GLuint))
+ASYNC(glBindRenderbuffer,       glBindRenderbuffer,                 A2(GLenum, GLuint))
+ASYNC(glFramebufferTexture2D,   prismgl_glFramebufferTexture2D_wrapper,
+      A5(GLenum, GLenum, GLenum, GLuint, GLint))
+ASYNC(glFramebufferTextureLayer, prismgl_glFramebufferTextureLayer_wrapper,
+      A5(GLenum, GLenum, GLuint, GLint, GLint))
+ASYNC(glFramebufferRenderbuffer, glFramebufferRenderbuffer,
+      A4(GLenum, GLenum, GLenum, GLuint))
+ASYNC(glRenderbufferStorage,    glRenderbufferStorage,
+      A4(GLenum, GLenum, GLsizei, GLsizei))
+ASYNC(glBlitFramebuffer,        prismgl_glBlitFramebuffer_wrapper,
+      A10(GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLbitfield, GLenum))
+ASYNC(glReadBuffer,             prismgl_glReadBuffer_wrapper,       A1(GLenum))
+ASYNC(glDrawBuffer,             prismgl_glDrawBuffer,               A1(GLenum))
+SYNC(GLenum, glCheckFramebufferStatus, glCheckFramebufferStatus,    A1(GLenum))
+SYNCV(glDrawBuffers,            glDrawBuffers,                      A2(GLsizei, const GLenum*))
+
+/* ===== Shaders and uniforms ===== */
+
+ASYNC(glUseProgram,         prismgl_glUseProgram_wrapper,       A1(GLuint))
+ASYNC(glLinkProgram,        prismgl_glLinkProgram_wrapper,      A1(GLuint))
+ASYNC(glCompileShader,      glCompileShader,                    A1(GLuint))
+ASYNC(glAttachShader,       glAttachShader,                     A2(GLuint, GLuint))
+ASYNC(glDetachShader,       glDetachShader,                     A2(GLuint, GLuint))
+ASYNC(glDeleteShader,       glDeleteShader,                     A1(GLuint))
+ASYNC(glDeleteProgram,      prismgl_glDeleteProgram_wrapper,    A1(GLuint))
+ASYNC(glUniformBlockBinding, glUniformBlockBinding,             A3(GLuint, GLuint, GLuint))
+SYNC(GLuint, glCreateShader,    glCreateShader,                 A1(GLenum))
+SYNC(GLuint, glCreateProgram,   glCreateProgram,                A0())
+SYNCV(glShaderSource,       glShaderSource,
+      A4(GLuint, GLsizei, const GLchar* const*, const GLint*))
+SYNCV(glBindAttribLocation, glBindAttribLocation,               A3(GLuint, GLuint, const GLchar*))
+SYNCV(glGetShaderiv,        glGetShaderiv,                      A3(GLuint, GLenum, GLint*))
+SYNCV(glGetProgramiv,       glGetProgramiv,                     A3(GLuint, GLenum, GLint*))
+SYNCV(glGetShaderInfoLog,   glGetShaderInfoLog,                 A4(GLuint, GLsizei, GLsizei*, GLchar*))
+SYNCV(glGetProgramInfoLog,  glGetProgramInfoLog,                A4(GLuint, GLsizei, GLsizei*, GLchar*))
+SYNC(GLint, glGetUniformLocation, glGetUniformLocation,         A2(GLuint, const GLchar*))
+SYNC(GLint, glGetAttribLocation,  glGetAttribLocation,          A2(GLuint, const GLchar*))
+SYNC(GLuint, glGetUniformBlockIndex, glGetUniformBlockIndex,    A2(GLuint, const GLchar*))
+
+ASYNC(glUniform1i,  glUniform1i,    A2(GLint, GLint))
+ASYNC(glUniform2i,  glUniform2i,    A3(GLint, GLint, GLint))
+ASYNC(glUniform3i,  glUniform3i,    A4(GLint, GLint, GLint, GLint))
+ASYNC(glUniform4i,  glUniform4i,    A5(GLint, GLint, GLint, GLint, GLint))
+ASYNC(glUniform1f,  glUniform1f,    A2(GLint, GLfloat))
+ASYNC(glUniform2f,  glUniform2f,    A3(GLint, GLfloat, GLfloat))
+ASYNC(glUniform3f,  glUniform3f,    A4(GLint, GLfloat, GLfloat, GLfloat))
+ASYNC(glUniform4f,  glUniform4f,    A5(GLint, GLfloat, GLfloat, GLfloat, GLfloat))
+
+
+/* Array uniforms: `count` elements of `size` bytes are copied */
+typedef enum {
+    UNIFORM_FLOAT = 0,
+    UNIFORM_INT,
+    UNIFORM_MATRIX
+} UniformKind;
+
+typedef void (*UniformfvFunc)(GLint location, GLsizei count, const GLfloat* value);
+typedef void (*UniformivFunc)(GLint location, GLsizei count, const GLint* value);
+typedef void (*UniformMatrixFunc)(GLint location, GLsizei count, GLboolean transpose,
+                                  const GLfloat* value);
+
+typedef struct {
+    UniformKind kind;
+    union {
+        UniformfvFunc fv;
+        UniformivFunc iv;
+        UniformMatrixFunc matrix;
+    } func;
+    GLint location;
+    GLsizei count;
+    GLboolean transpose;
+    _Alignas(16) uint8_t data[];
+} UniformArgs;
+
+static void run_uniform(const UniformArgs* c, const void* value) {
+    switch (c->kind) {
+        case UNIFORM_FLOAT:
+            c->func.fv(c->location, c->count, (const GLfloat*)value);
+            break;
+        case UNIFORM_INT:
+            c->func.iv(c->location, c->count, (const GLint*)value);
+            break;
+        case UNIFORM_MATRIX:
+            c->func.matrix(c->location, c->count, c->transpose, (const GLfloat*)value);
+            break;
+    }
+}
+
+static void exec_uniform(const void* p) {
+    const UniformArgs* c = (const UniformArgs*)p;
+    run_uniform(c, c->data);
+}
+
+/* The values are left in the caller's memory when they are too large to copy */
+typedef struct {
+    UniformArgs call;
+    const void* value;
+} UniformSyncArgs;
+
+static void exec_uniform_sync(const void* p) {
+    const UniformSyncArgs* c = (const UniformSyncArgs*)p;
+    run_uniform(&c->call, c->value);
+}
+
+static void uniform(const UniformArgs* a, const void* value, size_t element_size) {
+    if (!gl_thread_remote()) {
+        run_uniform(a, value);
+        return;
+    }
+
+    size_t bytes = a->count > 0 ? (size_t)a->count * element_size : 0;
+    if (!value || bytes == 0 || bytes > gl_thread_max_payload()) {
+        UniformSyncArgs s = { *a, value };
+        gl_thread_call(exec_uniform_sync, &s);
+        return;
+    }
+
+    UniformArgs* c = (UniformArgs*)gl_thread_enqueue(exec_uniform, sizeof(UniformArgs) + bytes);
+    *c = *a;
+    memcpy(c->data, value, bytes);
+}
+
+#define UNIFORMV(name, T, kind_, member, components)                            \
+    static void marshal_##name(GLint location, GLsizei count, const T* value) { \
+        UniformArgs a = { .kind = kind_, .func.member = name,                   \
+                          .location = location, .count = count };               \
+        uniform(&a, value, (components) * sizeof(T));                          \
+    }
+
+#define UNIFORM_MATRIX(name, components)                                        \
+    static void marshal_##name(GLint location, GLsizei count, GLboolean transpose, \
+                               const GLfloat* value) {                          \
+        UniformArgs a = { .kind = UNIFORM_MATRIX, .func.matrix = name,          \
+                          .location = location, .count = count,                 \
+                          .transpose = transpose };                             \
+        uniform(&a, value, (components) * sizeof(GLfloat));                     \
+    }
+
+UNIFORMV(glUniform1fv, GLfloat, UNIFORM_FLOAT, fv, 1)
+UNIFORMV(glUniform2fv, GLfloat, UNIFORM_FLOAT, fv, 2)
+UNIFORMV(glUniform3fv, GLfloat, UNIFORM_FLOAT, fv, 3)
+UNIFORMV(glUniform4fv, GLfloat, UNIFORM_FLOAT, fv, 4)
+UNIFORMV(glUniform1iv, GLint,   UNIFORM_INT,   iv, 1)
+UNIFORMV(glUniform2iv, GLint,   UNIFORM_INT,   iv, 2)
+UNIFORMV(glUniform3iv, GLint,   UNIFORM_INT,   iv, 3)
+UNIFORMV(glUniform4iv, GLint,   UNIFORM_INT,   iv, 4)
+UNIFORM_MATRIX(glUniformMatrix2fv, 4)
+UNIFORM_MATRIX(glUniformMatrix3fv, 9)
+UNIFORM_MATRIX(glUniformMatrix4fv, 16)
+
+/* ===== Queries ===== */
+
+ASYNC(glBeginQuery,     prismgl_glBeginQuery_wrapper,   A2(GLenum, GLuint))
+ASYNC(glEndQuery,       prismgl_glEndQuery_wrapper,     A1(GLenum))
+ASYNC(glQueryCounter,   prismgl_glQueryCounter,         A2(GLuint, GLenum))
+SYNCV(glGetQueryObjectuiv,   prismgl_glGetQueryObjectuiv_wrapper, A3(GLuint, GLenum, GLuint*))
+SYNCV(glGetQueryObjecti64v,  prismgl_glGetQueryObjecti64v,        A3(GLuint, GLenum, GLint64*))
+SYNCV(glGetQueryObjectui64v, prismgl_glGetQueryObjectui64v,       A3(GLuint, GLenum, GLuint64*))
+
+/* ===== Sync objects ===== */
+
+SYNC(GLsync, glFenceSync,       prismgl_glFenceSync_wrapper, A2(GLenum, GLbitfield))
+SYNC(GLenum, glClientWaitSync,  glClientWaitSync,   A3(GLsync, GLbitfield, GLuint64))
+ASYNC(glWaitSync,               glWaitSync,         A3(GLsync, GLbitfield, GLuint64))
+ASYNC(glDeleteSync,             glDeleteSync,       A1(GLsync))
+
+/* ===== Lookup ===== */
+
+typedef struct {
+    const char* name;
+    void* func;
+} MarshalEntry;
+
+#define M(name) { #name, (void*)marshal_##name }
+
+static const MarshalEntry g_marshalled[] = {
+    /* Fixed-function emulation */
+    M(glBegin), M(glEnd), M(glVertex2f), M(glVertex3f), M(glVertex2d), M(glVertex3d),
+    M(glTexCoord2f), M(glTexCoord2d), M(glColor3f), M(glColor4f), M(glColor3ub),
+    M(glColor4ub), M(glNormal3f), M(glMatrixMode), M(glPushMatrix), M(glPopMatrix),
+    M(glLoadIdentity), M(glTranslatef), M(glRotatef), M(glScalef), M(glOrtho),
+    M(glFrustum), M(glLoadMatrixf), M(glMultMatrixf),
+
+    /* State */
+    M(glEnable), M(glDisable), M(glBlendFunc), M(glBlendFuncSeparate), M(glBlendEquation),
+    M(glBlendEquationSeparate), M(glBlendColor), M(glDepthMask), M(glDepthFunc),
+    M(glDepthRangef), M(glColorMask), M(glCullFace), M(glFrontFace), M(glPolygonOffset),
+    M(glStencilFunc), M(glStencilOp), M(glStencilMask), M(glViewport), M(glScissor),
+    M(glClear), M(glClearColor), M(glClearDepthf), M(glClearStencil), M(glHint),
+    M(glFlush), M(glFinish), M(glGetError), M(glIsEnabled), M(glGetString),
+    M(glGetStringi), M(glGetIntegerv), M(glGetFloatv), M(glGetBooleanv), M(glPixelStorei),
+    M(glGetInteger64v),
+
+    /* Buffers and vertex arrays */
+    M(glBindBuffer), M(glBindBufferBase), M(glBindBufferRange), M(glBindVertexArray),
+    M(glDeleteBuffers), M(glDeleteVertexArrays), M(glGenBuffers), M(glGenVertexArrays),
+    M(glBufferData), M(glBufferSubData), M(glCopyBufferSubData), M(glMapBufferRange),
+    M(glUnmapBuffer), M(glFlushMappedBufferRange), M(glVertexAttribPointer),
+    M(glVertexAttribIPointer), M(glEnableVertexAttribArray), M(glDisableVertexAttribArray),
+    M(glVertexAttribDivisor), M(glVertexAttrib4f),
+
+    /* Draws */
+    M(glDrawArrays), M(glDrawArraysInstanced), M(glDrawElements), M(glDrawElementsInstanced),
+    M(glDrawElementsBaseVertex), M(glDrawRangeElements), M(glMultiDrawArrays),
+    M(glMultiDrawElements), M(glMultiDrawElementsBaseVertex),
+
+    /* Textures */
+    M(glActiveTexture), M(glBindTexture), M(glTexParameteri), M(glTexParameterf),
+    M(glGenerateMipmap), M(glTexStorage2D), M(glBindSampler), M(glSamplerParameteri),
+    M(glGenTextures), M(glDeleteTextures), M(glTexImage2D), M(glTexSubImage2D),
+    M(glReadPixels),
+
+    /* Framebuffers */
+    M(glBindFramebuffer), M(glBindRenderbuffer), M(glFramebufferTexture2D),
+    M(glFramebufferTextureLayer), M(glFramebufferRenderbuffer), M(glRenderbufferStorage),
+    M(glBlitFramebuffer),
+    M(glReadBuffer), M(glDrawBuffer), M(glDrawBuffers), M(glCheckFramebufferStatus),
+    M(glGenFramebuffers), M(glGenRenderbuffers), M(glDeleteFramebuffers),
+    M(glDeleteRenderbuffers),
+
+    /* Shaders and uniforms */
+    M(glUseProgram), M(glLinkProgram), M(glCompileShader), M(glAttachShader),
+    M(glDetachShader), M(glDeleteShader), M(glDeleteProgram), M(glUniformBlockBinding),
+    M(glCreateShader), M(glCreateProgram), M(glShaderSource), M(glBindAttribLocation),
+    M(glGetShaderiv), M(glGetProgramiv), M(glGetShaderInfoLog), M(glGetProgramInfoLog),
+    M(glGetUniformLocation), M(glGetAttribLocation), M(glGetUniformBlockIndex),
+    M(glUniform1i), M(glUniform2i), M(glUniform3i), M(glUniform4i), M(glUniform1f),
+    M(glUniform2f), M(glUniform3f), M(glUniform4f), M(glUniform1fv), M(glUniform2fv),
+    M(glUniform3fv), M(glUniform4fv), M(glUniform1iv), M(glUniform2iv), M(glUniform3iv),
+    M(glUniform4iv), M(glUniformMatrix2fv), M(glUniformMatrix3fv), M(glUniformMatrix4fv),
+
+    /* Queries and sync objects */
+    M(glGenQueries), M(glDeleteQueries), M(glBeginQuery), M(glEndQuery), M(glQueryCounter),
+    M(glGetQueryObjectuiv), M(glGetQueryObjecti64v), M(glGetQueryObjectui64v),
+    M(glFenceSync), M(glClientWaitSync), M(glWaitSync), M(glDeleteSync),
+
+    /* EGL calls that depend on where the context lives */
+    { "eglSwapBuffers",         (void*)gl_thread_swap_buffers },
+    { "eglMakeCurrent",         (void*)gl_thread_make_current },
+    { "eglGetCurrentContext",   (void*)gl_thread_get_current_context },
+    { "eglGetCurrentDisplay",   (void*)gl_thread_get_current_display },
+    { "eglGetCurrentSurface",   (void*)gl_thread_get_current_surface },
+
+    { NULL, NULL }
+};
+
+#undef M
+
+void* gl_marshal_get_proc(const char* name) {
+    for (int i = 0; g_marshalled[i].name; i++) {
+        if (strcmp(g_marshalled[i].name, name) == 0) return g_marshalled[i].func;
+    }
+    return NULL;
+}
@@ -0,0 +1,634 @@
+/*
+ * PrismGL Threaded Dispatch
+ * Minecraft's render thread spends a large part of each frame inside the
+ * driver. With threaded dispatch on, marshalled entry points only copy
+ * their arguments into a single-producer ring buffer and return; a
+ * dedicated GL thread that owns the EGL context decodes and executes the
+ * calls, so game logic overlaps with driver CPU time.
+ *
+ * The context moves to the GL thread at the first eglSwapBuffers that
+ * goes through PrismGL. Entry points that are not marshalled are handed
+ * out as trampolines: calling one drains the ring and moves the context
+ * back to the render thread, where it stays until the next swap. Calls
+ * that return values wait for the GL thread instead.
+ *
+ * The same trampolines let other modules observe every call: with
+ * automatic instancing on they are handed out even without a GL thread,
+ * and each one runs the calling thread's call hook first.
+ */
+
+#include "gl_thread.h"
+#include "context.h"
+#include "prismgl.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-GLThread"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+#define RING_SIZE              (4u * 1024u * 1024u)    /* Power of two */
+#define RING_ALIGN             16u
+#define PUBLISH_BYTES          4096u                   /* Work handed over per wakeup */
+#define SPIN_ITERATIONS        2000
+#define STATS_LOG_INTERVAL     600
+
+#define TRAMPOLINE_COUNT       4096
+
+#if defined(__aarch64__)
+#define TRAMPOLINE_STRIDE      8
+#define HAVE_TRAMPOLINES       1
+#elif defined(__x86_64__)
+#define TRAMPOLINE_STRIDE      16
+#define HAVE_TRAMPOLINES       1
+#else
+#define HAVE_TRAMPOLINES       0
+#endif
+
+/* Every record starts with this header; sizes are multiples of RING_ALIGN */
+typedef struct {
+    _Alignas(16) GLThreadExec exec;     /* NULL pads the end of the ring */
+    uint32_t size;
+    uint32_t tracked;           /* Bumps `completed` once executed */
+} CommandHeader;
+
+_Static_assert(sizeof(CommandHeader) % RING_ALIGN == 0, "header breaks alignment");
+
+typedef struct {
+    const char* name;
+    void* target;
+    bool borrow_logged;
+} TrampolineSlot;
+
+static struct {
+    uint8_t* ring;
+    pthread_t thread;
+    bool running;
+    /* Set once from any thread, read by every thread resolving or swapping */
+    _Atomic bool failed;            /* Handoff failed or lookups bypassed PrismGL */
+    _Atomic bool unwrapped_lookup;  /* Entry point resolved while disabled */
+
+    /* Producer side, only touched by the render thread */
+    uint64_t write;
+    uint64_t issued;            /* Tracked commands recorded */
+    uint64_t last_swap;
+    EGLDisplay display;
+    EGLSurface draw;
+    EGLSurface read;
+    EGLContext context;
+
+    /* Shared */
+    _Atomic uint64_t published;
+    _Atomic uint64_t consumed;
+    _Atomic uint64_t completed;
+    _Atomic bool consumer_sleeping;
+    _Atomic bool producer_waiting;
+    _Atomic bool quit;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    /* Frame statistics, render thread */
+    uint32_t frame_calls;
+    uint32_t frame_syncs;
+    uint32_t frame_borrows;
+    uint64_t frames;
+} g = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work_cond = PTHREAD_COND_INITIALIZER,
+    .done_cond = PTHREAD_COND_INITIALIZER,
+};
+
+_Thread_local bool gl_thread_tls_remote = false;
+_Thread_local void (*gl_thread_tls_call_hook)(void) = NULL;
+static _Thread_local bool g_tls_producer = false;
+
+static pthread_mutex_t g_slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static TrampolineSlot g_slots[TRAMPOLINE_COUNT];
+static int g_slot_count = 0;
+
+static inline void cpu_relax(void) {
+#if defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+    __asm__ __volatile__("pause");
+#endif
+}
+
+/* ===== GL thread ===== */
+
+static void wait_for_work(uint64_t read) {
+    for (int i = 0; i < SPIN_ITERATIONS; i++) {
+        if (atomic_load_explicit(&g.published, memory_order_acquire) != read) return;
+        cpu_relax();
+    }
+
+    pthread_mutex_lock(&g.lock);
+    atomic_store(&g.consumer_sleeping, true);
+    while (atomic_load(&g.published) == read && !atomic_load(&g.quit)) {
+        pthread_cond_wait(&g.work_cond, &g.lock);
+    }
+    atomic_store(&g.consumer_sleeping, false);
+    pthread_mutex_unlock(&g.lock);
+}
+
+static void signal_completed(void) {
+    atomic_fetch_add(&g.completed, 1);
+    if (atomic_load(&g.producer_waiting)) {
+        pthread_mutex_lock(&g.lock);
+        pthread_cond_broadcast(&g.done_cond);
+        pthread_mutex_unlock(&g.lock);
+    }
+}
+
+static void* gl_thread_main(void* arg) {
+    (void)arg;
+    pthread_setname_np(pthread_self(), "PrismGL-GL");
+
+    uint64_t read = atomic_load(&g.consumed);
+    for (;;) {
+        uint64_t end = atomic_load_explicit(&g.published, memory_order_acquire);
+        if (read == end) {
+            if (atomic_load(&g.quit)) break;
+            wait_for_work(read);
+            continue;
+        }
+
+        while (read != end) {
+            CommandHeader* h = (CommandHeader*)(g.ring + (read & (RING_SIZE - 1)));
+            if (h->exec) h->exec(h + 1);
+            read += h->size;
+            if (h->tracked) {
+                atomic_store_explicit(&g.consumed, read, memory_order_release);
+                signal_completed();
+            }
+        }
+        atomic_store_explicit(&g.consumed, read, memory_order_release);
+    }
+
+    /* The context cannot outlive the thread that has it current */
+    if (eglGetCurrentContext() != EGL_NO_CONTEXT) {
+        eglMakeCurrent(g.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        prismgl_context_make_current(g.display, EGL_NO_CONTEXT);
+    }
+    return NULL;
+}
+
+/* ===== Ring (render thread) ===== */
+
+static void publish(void) {
+    atomic_store(&g.published, g.write);
+    if (atomic_load(&g.consumer_sleeping)) {
+        pthread_mutex_lock(&g.lock);
+        pthread_cond_signal(&g.work_cond);
+        pthread_mutex_unlock(&g.lock);
+    }
+}
+
+static void wait_completed(uint64_t ticket) {
+    for (int i = 0; i < SPIN_ITERATIONS; i++) {
+        if (atomic_load_explicit(&g.completed, memory_order_acquire) >= ticket) return;
+        cpu_relax();
+    }
+
+    pthread_mutex_lock(&g.lock);
+    atomic_store(&g.producer_waiting, true);
+    while (atomic_load(&g.completed) < ticket) {
+        pthread_cond_wait(&g.done_cond, &g.lock);
+    }
+    atomic_store(&g.producer_waiting, false);
+    pthread_mutex_unlock(&g.lock);
+}
+
+static void wait_for_space(uint64_t needed) {
+    if (g.write + needed - atomic_load_explicit(&g.consumed, memory_order_acquire) <= RING_SIZE) {
+        return;
+    }
+    publish();
+    while (g.write + needed - atomic_load_explicit(&g.consumed, memory_order_acquire) > RING_SIZE) {
+        sched_yield();
+    }
+}
+
+static void* record(GLThreadExec exec, size_t size, bool tracked) {
+    uint32_t total = (uint32_t)((sizeof(CommandHeader) + size + RING_ALIGN - 1) & ~(size_t)(RING_ALIGN - 1));
+    uint32_t offset = (uint32_t)(g.write & (RING_SIZE - 1));
+    uint32_t pad = offset + total > RING_SIZE ? RING_SIZE - offset : 0;
+
+    wait_for_space((uint64_t)pad + total);
+    if (pad) {
+        CommandHeader* skip = (CommandHeader*)(g.ring + offset);
+        skip->exec = NULL;
+        skip->size = pad;
+        skip->tracked = 0;
+        g.write += pad;
+        offset = 0;
+    }
+
+    /* Hand over finished work in chunks to keep cache-line traffic low */
+    if (g.write - atomic_load_explicit(&g.published, memory_order_relaxed) >= PUBLISH_BYTES) {
+        publish();
+    }
+
+    CommandHeader* h = (CommandHeader*)(g.ring + offset);
+    h->exec = exec;
+    h->size = total;
+    h->tracked = tracked ? 1u : 0u;
+    g.write += total;
+    if (tracked) g.issued++;
+    g.frame_calls++;
+    return h + 1;
+}
+
+void* gl_thread_enqueue(GLThreadExec exec, size_t size) {
+    return record(exec, size, false);
+}
+
+size_t gl_thread_max_payload(void) {
+    return RING_SIZE / 4;
+}
+
+typedef struct {
+    GLThreadExec exec;
+    void* args;
+} SyncCall;
+
+static void exec_sync_call(const void* p) {
+    const SyncCall* c = (const SyncCall*)p;
+    c->exec(c->args);
+}
+
+void gl_thread_call(GLThreadExec exec, void* args) {
+    SyncCall* c = (SyncCall*)record(exec_sync_call, sizeof(SyncCall), true);
+    c->exec = exec;
+    c->args = args;
+    uint64_t ticket = g.issued;
+    publish();
+    g.frame_syncs++;
+    wait_completed(ticket);
+}
+
+static void exec_nothing(const void* p) {
+    (void)p;
+}
+
+void gl_thread_finish(void) {
+    if (!gl_thread_tls_remote) return;
+    gl_thread_call(exec_nothing, NULL);
+}
+
+/* ===== Context ownership ===== */
+
+static void exec_acquire(const void* p) {
+    EGLBoolean* result = (EGLBoolean*)p;
+    *result = eglMakeCurrent(g.display, g.draw, g.read, g.context);
+    if (*result == EGL_TRUE) prismgl_context_make_current(g.display, g.context);
+}
+
+static void exec_release(const void* p) {
+    (void)p;
+    eglMakeCurrent(g.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    prismgl_context_make_current(g.display, EGL_NO_CONTEXT);
+}
+
+static bool start_thread(void) {
+    if (g.running) return true;
+
+    g.ring = (uint8_t*)malloc(RING_SIZE);
+    if (!g.ring) {
+        LOGE("Failed to allocate the command ring");
+        return false;
+    }
+    atomic_store(&g.quit, false);
+    if (pthread_create(&g.thread, NULL, gl_thread_main, NULL) != 0) {
+        LOGE("Failed to start the GL thread");
+        free(g.ring);
+        g.ring = NULL;
+        return false;
+    }
+    g.running = true;
+    return true;
+}
+
+/* Move the context current on the render thread to the GL thread */
+static void hand_off(void) {
+    EGLContext context = eglGetCurrentContext();
+    if (context == EGL_NO_CONTEXT) return;
+    if (!start_thread()) {
+        atomic_store_explicit(&g.failed, true, memory_order_release);
+        return;
+    }
+
+    g.display = eglGetCurrentDisplay();
+    g.draw = eglGetCurrentSurface(EGL_DRAW);
+    g.read = eglGetCurrentSurface(EGL_READ);
+    g.context = context;
+    g_tls_producer = true;
+
+    gl_marshal_sync_bindings();
+    eglMakeCurrent(g.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    prismgl_context_make_current(g.display, EGL_NO_CONTEXT);
+
+    EGLBoolean acquired = EGL_FALSE;
+    gl_thread_tls_remote = true;
+    gl_thread_call(exec_acquire, &acquired);
+    if (acquired != EGL_TRUE) {
+        LOGE("GL thread could not make the context current (0x%x), disabling threaded dispatch",
+             eglGetError());
+        gl_thread_tls_remote = false;
+        atomic_store_explicit(&g.failed, true, memory_order_release);
+        eglMakeCurrent(g.display, g.draw, g.read, g.context);
+        prismgl_context_make_current(g.display, g.context);
+    }
+}
+
+/* Pull the context back to the render thread for a call that is not marshalled */
+static void borrow(TrampolineSlot* slot) {
+    gl_thread_call(exec_release, NULL);
+    gl_thread_tls_remote = false;
+    eglMakeCurrent(g.display, g.draw, g.read, g.context);
+    prismgl_context_make_current(g.display, g.context);
+    g.frame_borrows++;
+
+    if (slot && !slot->borrow_logged) {
+        slot->borrow_logged = true;
+        LOGI("%s is not marshalled; the context stays on the render thread until the next swap",
+             slot->name);
+    }
+}
+
+/* ===== EGL on the render thread ===== */
+
+static void log_frame_stats(void) {
+    g.frames++;
+    if (g.frames % STATS_LOG_INTERVAL == 0) {
+        LOGI("Threaded dispatch last frame: %u calls, %u syncs, %u context borrows",
+             g.frame_calls, g.frame_syncs, g.frame_borrows);
+    }
+    g.frame_calls = 0;
+    g.frame_syncs = 0;
+    g.frame_borrows = 0;
+}
+
+typedef struct {
+    EGLDisplay display;
+    EGLSurface surface;
+} SwapArgs;
+
+static void exec_swap(const void* p) {
+    const SwapArgs* a = (const SwapArgs*)p;
+    prismgl_eglSwapBuffers(a->display, a->surface);
+}
+
+EGLBoolean gl_thread_swap_buffers(EGLDisplay display, EGLSurface surface) {
+    if (gl_thread_tls_remote) {
+        /* At most one frame queued ahead of the one being presented */
+        wait_completed(g.last_swap);
+        SwapArgs* a = (SwapArgs*)record(exec_swap, sizeof(SwapArgs), true);
+        a->display = display;
+        a->surface = surface;
+        g.last_swap = g.issued;
+        publish();
+        log_frame_stats();
+        return EGL_TRUE;
+    }
+
+    EGLBoolean result = prismgl_eglSwapBuffers(display, surface);
+    if (result == EGL_TRUE && gl_thread_enabled() &&
+        !atomic_load_explicit(&g.unwrapped_lookup, memory_order_acquire) &&
+        (!g.running || g_tls_producer)) {
+        if (g_tls_producer) log_frame_stats();
+        hand_off();
+    }
+    return result;
+}
+
+typedef struct {
+    EGLDisplay display;
+    EGLSurface draw;
+    EGLSurface read;
+    EGLContext context;
+    EGLBoolean result;
+} MakeCurrentArgs;
+
+static void exec_make_current(const void* p) {
+    MakeCurrentArgs* a = (MakeCurrentArgs*)p;
+    a->result = prismgl_eglMakeCurrent(a->display, a->draw, a->read, a->context);
+}
+
+EGLBoolean gl_thread_make_current(EGLDisplay display, EGLSurface draw,
+                                  EGLSurface read, EGLContext context) {
+    if (!g_tls_producer) return prismgl_eglMakeCurrent(display, draw, read, context);
+
+    EGLBoolean result;
+    if (gl_thread_tls_remote) {
+        MakeCurrentArgs a = { display, draw, read, context, EGL_FALSE };
+        gl_thread_call(exec_make_current, &a);
+        result = a.result;
+    } else {
+        result = prismgl_eglMakeCurrent(display, draw, read, context);
+    }
+    if (result == EGL_TRUE) {
+        g.display = display;
+        g.draw = draw;
+        g.read = read;
+        g.context = context;
+    }
+    return result;
+}
+
+EGLContext gl_thread_get_current_context(void) {
+    return gl_thread_tls_remote ? g.context : eglGetCurrentContext();
+}
+
+EGLDisplay gl_thread_get_current_display(void) {
+    return gl_thread_tls_remote ? g.display : eglGetCurrentDisplay();
+}
+
+EGLSurface gl_thread_get_current_surface(EGLint readdraw) {
+    if (!gl_thread_tls_remote) return eglGetCurrentSurface(readdraw);
+    return readdraw == EGL_READ ? g.read : g.draw;
+}
+
+/* ===== Trampolines ===== */
+
+/*
+ * Each trampoline passes its own address to a common stub that saves the
+ * argument registers, asks prismgl_gl_thread_trampoline_target() for the
+ * real entry point and tail-calls it with the arguments untouched, stack
+ * arguments included.
+ */
+#if defined(__aarch64__)
+__asm__(
+    ".text\n"
+    ".balign 16\n"
+    ".globl prismgl_gl_thread_trampolines\n"
+    ".hidden prismgl_gl_thread_trampolines\n"
+    "prismgl_gl_thread_trampolines:\n"
+    ".rept 4096\n"
+    "    adr x16, .\n"
+    "    b 2f\n"
+    ".endr\n"
+    "2:\n"
+    "    stp x29, x30, [sp, #-160]!\n"
+    "    mov x29, sp\n"
+    "    stp x0, x1, [sp, #16]\n"
+    "    stp x2, x3, [sp, #32]\n"
+    "    stp x4, x5, [sp, #48]\n"
+    "    stp x6, x7, [sp, #64]\n"
+    "    stp d0, d1, [sp, #80]\n"
+    "    stp d2, d3, [sp, #96]\n"
+    "    stp d4, d5, [sp, #112]\n"
+    "    stp d6, d7, [sp, #128]\n"
+    "    str x8, [sp, #144]\n"
+    "    mov x0, x16\n"
+    "    bl prismgl_gl_thread_trampoline_target\n"
+    "    mov x16, x0\n"
+    "    ldr x8, [sp, #144]\n"
+    "    ldp d6, d7, [sp, #128]\n"
+    "    ldp d4, d5, [sp, #112]\n"
+    "    ldp d2, d3, [sp, #96]\n"
+    "    ldp d0, d1, [sp, #80]\n"
+    "    ldp x6, x7, [sp, #64]\n"
+    "    ldp x4, x5, [sp, #48]\n"
+    "    ldp x2, x3, [sp, #32]\n"
+    "    ldp x0, x1, [sp, #16]\n"
+    "    ldp x29, x30, [sp], #160\n"
+    "    br x16\n"
+);
+#elif defined(__x86_64__)
+__asm__(
+    ".text\n"
+    ".balign 16\n"
+    ".globl prismgl_gl_thread_trampolines\n"
+    ".hidden prismgl_gl_thread_trampolines\n"
+    "prismgl_gl_thread_trampolines:\n"
+    ".rept 4096\n"
+    "1:  leaq 1b(%rip), %r11\n"
+    "    jmp 2f\n"
+    "    .balign 16\n"
+    ".endr\n"
+    "2:\n"
+    "    pushq %rbp\n"
+    "    movq %rsp, %rbp\n"
+    "    subq $192, %rsp\n"
+    "    movq %rdi, 0(%rsp)\n"
+    "    movq %rsi, 8(%rsp)\n"
+    "    movq %rdx, 16(%rsp)\n"
+    "    movq %rcx, 24(%rsp)\n"
+    "    movq %r8, 32(%rsp)\n"
+    "    movq %r9, 40(%rsp)\n"
+    "    movq %rax, 48(%rsp)\n"
+    "    movdqa %xmm0, 64(%rsp)\n"
+    "    movdqa %xmm1, 80(%rsp)\n"
+    "    movdqa %xmm2, 96(%rsp)\n"
+    "    movdqa %xmm3, 112(%rsp)\n"
+    "    movdqa %xmm4, 128(%rsp)\n"
+    "    movdqa %xmm5, 144(%rsp)\n"
+    "    movdqa %xmm6, 160(%rsp)\n"
+    "    movdqa %xmm7, 176(%rsp)\n"
+    "    movq %r11, %rdi\n"
+    "    call prismgl_gl_thread_trampoline_target@PLT\n"
+    "    movq %rax, %r11\n"
+    "    movdqa 176(%rsp), %xmm7\n"
+    "    movdqa 160(%rsp), %xmm6\n"
+    "    movdqa 144(%rsp), %xmm5\n"
+    "    movdqa 128(%rsp), %xmm4\n"
+    "    movdqa 112(%rsp), %xmm3\n"
+    "    movdqa 96(%rsp), %xmm2\n"
+    "    movdqa 80(%rsp), %xmm1\n"
+    "    movdqa 64(%rsp), %xmm0\n"
+    "    movq 48(%rsp), %rax\n"
+    "    movq 40(%rsp), %r9\n"
+    "    movq 32(%rsp), %r8\n"
+    "    movq 24(%rsp), %rcx\n"
+    "    movq 16(%rsp), %rdx\n"
+    "    movq 8(%rsp), %rsi\n"
+    "    movq 0(%rsp), %rdi\n"
+    "    leave\n"
+    "    jmp *%r11\n"
+);
+#endif
+
+#if HAVE_TRAMPOLINES
+extern const uint8_t prismgl_gl_thread_trampolines[];
+
+__attribute__((visibility("hidden")))
+void* prismgl_gl_thread_trampoline_target(uintptr_t trampoline);
+
+void* prismgl_gl_thread_trampoline_target(uintptr_t trampoline) {
+    size_t index = (trampoline - (uintptr_t)prismgl_gl_thread_trampolines) / TRAMPOLINE_STRIDE;
+    TrampolineSlot* slot = &g_slots[index];
+    if (gl_thread_tls_remote) borrow(slot);
+    else if (gl_thread_tls_call_hook) gl_thread_tls_call_hook();
+    return slot->target;
+}
+#endif
+
+bool gl_thread_enabled(void) {
+    return HAVE_TRAMPOLINES && !atomic_load_explicit(&g.failed, memory_order_acquire) &&
+           prismgl_get_config()->threaded_dispatch;
+}
+
+bool gl_thread_calls_observed(void) {
+    return HAVE_TRAMPOLINES && !atomic_load_explicit(&g.unwrapped_lookup, memory_order_acquire);
+}
+
+void* gl_thread_wrap_proc(const char* name, void* func) {
+    if (!func) return NULL;
+    const PrismGLConfig* config = prismgl_get_config();
+    if (!gl_thread_enabled() && !config->auto_instancing && !config->draw_call_batching) {
+        /* Raw pointers would bypass the GL thread once it owns the context */
+        atomic_store_explicit(&g.unwrapped_lookup, true, memory_order_release);
+        return func;
+    }
+
+#if HAVE_TRAMPOLINES
+    pthread_mutex_lock(&g_slot_lock);
+    int index = -1;
+    for (int i = 0; i < g_slot_count; i++) {
+        if (g_slots[i].target == func) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0 && g_slot_count < TRAMPOLINE_COUNT) {
+        index = g_slot_count++;
+        g_slots[index].name = strdup(name);
+        g_slots[index].target = func;
+    }
+    pthread_mutex_unlock(&g_slot_lock);
+
+    if (index >= 0) {
+        return (void*)(prismgl_gl_thread_trampolines + (size_t)index * TRAMPOLINE_STRIDE);
+    }
+    LOGE("Out of trampolines at %s, threaded dispatch and instancing disabled", name);
+    atomic_store_explicit(&g.unwrapped_lookup, true, memory_order_release);
+#endif
+    return func;
+}
+
+void gl_thread_shutdown(void) {
+    if (!g.running) return;
+
+    if (gl_thread_tls_remote) gl_thread_finish();
+    atomic_store(&g.quit, true);
+    pthread_mutex_lock(&g.lock);
+    pthread_cond_signal(&g.work_cond);
+    pthread_mutex_unlock(&g.lock);
+    pthread_join(g.thread, NULL);
+
+    free(g.ring);
+    g.ring = NULL;
+    g.running = false;
+    gl_thread_tls_remote = false;
+    g_tls_producer = false;
+    LOGI("GL thread stopped");
+}
@@ -4,8 +4,31 @@
  */
 
 #include "prismgl.h"
+#include "prismgl_internal.h"
+#include "context.h"
+#include "display_list.h"
+#include "matrix_stack.h"
+#include "client_arrays.h"
+#include "quad_convert.h"
+#include "multi_draw.h"
+#include "stream_buffer.h"
+#include "state_shadow.h"
+#include "gl_jobs.h"
+#include "draw_batch.h"
+#include "draw_instance.h"
+#include "texture_upload.h"
+#include "texture_registry.h"
+#include "texture_readback.h"
+#include "texture_convert.h"
+#include "texture_storage.h"
+#include "texture_budget.h"
+#include "texture_batch.h"
 #include "shader_translator.h"
+#include "gpu_detect.h"
+#include "gpu_timer.h"
+#include "occlusion_query.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -19,168 +42,316 @@
 /* ===== Immediate Mode Emulation ===== */
 
 #define MAX_IMMEDIATE_VERTICES 65536
+#define IMMEDIATE_STREAM_SIZE  (1024 * 1024)
+
+/* Attributes changed between glBegin and glEnd, stored per vertex. The
+ * rest are constant for the primitive and come from the current value. */
+#define IMMEDIATE_VARY_COLOR    0x1
+#define IMMEDIATE_VARY_TEXCOORD 0x2
+#define IMMEDIATE_VARY_NORMAL   0x4
+#define IMMEDIATE_LAYOUTS       8
+
+/* VAO configured once for one packed vertex layout, fed from binding 0 */
+typedef struct {
+    GLuint vao;
+    GLsizei stride;
+    bool quad_indices;      /* Shared quad index buffer attached */
+} ImmediateLayout;
 
 typedef struct {
-    GLfloat x, y, z;
-    GLfloat r, g, b, a;
-    GLfloat s, t;
-    GLfloat nx, ny, nz;
-} ImmediateVertex;
-
-static struct {
-    ImmediateVertex vertices[MAX_IMMEDIATE_VERTICES];
+    ImmediateVertex* vertices;  /* MAX_IMMEDIATE_VERTICES, allocated on first glBegin */
     int count;
     GLenum mode;
     GLfloat cur_r, cur_g, cur_b, cur_a;
     GLfloat cur_s, cur_t;
     GLfloat cur_nx, cur_ny, cur_nz;
+    unsigned varying;
     bool active;
-    GLuint vao;
-    GLuint vbo;
-    GLuint ibo;
+    ImmediateLayout layouts[IMMEDIATE_LAYOUTS];
+    StreamBuffer stream;
     bool buffers_created;
-} g_immediate = {
-    .cur_r = 1.0f, .cur_g = 1.0f, .cur_b = 1.0f, .cur_a = 1.0f,
-    .cur_nz = 1.0f,
-    .active = false, .buffers_created = false
-};
+} ImmediateState;
+
+/* ===== Per-context wrapper state ===== */
 
-/* ===== Polygon Mode State ===== */
-static GLenum g_polygon_mode = GL_FILL;
+typedef struct {
+    ImmediateState immediate;
+    GLenum polygon_mode;
+    GLenum provoking_vertex;
+    GLenum clip_origin;
+    GLenum clip_depth;
+    bool depth_clamp_enabled;
+} WrapperState;
+
+static inline WrapperState* wrapper_state(void) {
+    return (WrapperState*)prismgl_context_state(PRISMGL_STATE_WRAPPER);
+}
 
-/* ===== Provoking Vertex ===== */
-static GLenum g_provoking_vertex = GL_LAST_VERTEX_CONVENTION;
+void* prismgl_wrapper_create_state(void) {
+    WrapperState* ws = (WrapperState*)calloc(1, sizeof(WrapperState));
+    if (!ws) return NULL;
+    ws->immediate.cur_r = 1.0f;
+    ws->immediate.cur_g = 1.0f;
+    ws->immediate.cur_b = 1.0f;
+    ws->immediate.cur_a = 1.0f;
+    ws->immediate.cur_nz = 1.0f;
+    ws->polygon_mode = GL_FILL;
+    ws->provoking_vertex = GL_LAST_VERTEX_CONVENTION;
+    ws->clip_origin = GL_LOWER_LEFT;
+    ws->clip_depth = GL_NEGATIVE_ONE_TO_ONE;
+    return ws;
+}
 
-/* ===== Clip Control State ===== */
-static GLenum g_clip_origin = GL_LOWER_LEFT;
-static GLenum g_clip_depth = GL_NEGATIVE_ONE_TO_ONE;
+void prismgl_wrapper_destroy_state(void* state) {
+    /* Layout VAOs and the stream buffer went away with the EGL context */
+    WrapperState* ws = (WrapperState*)state;
+    free(ws->immediate.vertices);
+    free(ws);
+}
 
 /* ===== Adaptive Resolution ===== */
+/* Process-wide: it describes the presented surface and is driven from JNI */
 static float g_resolution_scale = 1.0f;
 static float g_fps_history[60];
 static int g_fps_history_index = 0;
 
-/* ===== Depth Clamp State ===== */
-static bool g_depth_clamp_enabled = false;
-
 /* ===== Implementation ===== */
 
 void prismgl_glPolygonMode(GLenum face, GLenum mode) {
     (void)face;
-    g_polygon_mode = mode;
+    wrapper_state()->polygon_mode = mode;
     if (mode == GL_LINE) {
         LOGW("GL_LINE polygon mode requested - wireframe not natively supported in ES");
     }
 }
 
 void prismgl_glClipControl(GLenum origin, GLenum depth) {
-    g_clip_origin = origin;
-    g_clip_depth = depth;
+    WrapperState* ws = wrapper_state();
+    ws->clip_origin = origin;
+    ws->clip_depth = depth;
     LOGI("ClipControl(%d, %d) - state stored for shader modification", origin, depth);
 }
 
 void prismgl_glProvokingVertex(GLenum mode) {
-    g_provoking_vertex = mode;
+    wrapper_state()->provoking_vertex = mode;
     if (mode == GL_FIRST_VERTEX_CONVENTION) {
         LOGW("FIRST_VERTEX_CONVENTION not supported in ES, using LAST");
     }
 }
 
-static void ensure_immediate_buffers(void) {
-    if (!g_immediate.buffers_created) {
-        glGenVertexArrays(1, &g_immediate.vao);
-        glGenBuffers(1, &g_immediate.vbo);
-        glGenBuffers(1, &g_immediate.ibo);
-        g_immediate.buffers_created = true;
+static void setup_immediate_layout(ImmediateLayout* layout, unsigned varying) {
+    GLuint offset = 0;
+
+    state_shadow_bind_vertex_array(layout->vao);
+
+    glEnableVertexAttribArray(PRISMGL_ATTRIB_POSITION);
+    glVertexAttribFormat(PRISMGL_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, offset);
+    glVertexAttribBinding(PRISMGL_ATTRIB_POSITION, 0);
+    offset += 3 * sizeof(GLfloat);
+
+    if (varying & IMMEDIATE_VARY_COLOR) {
+        glEnableVertexAttribArray(PRISMGL_ATTRIB_COLOR);
+        glVertexAttribFormat(PRISMGL_ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, offset);
+        glVertexAttribBinding(PRISMGL_ATTRIB_COLOR, 0);
+        offset += 4 * sizeof(GLfloat);
+    }
+    if (varying & IMMEDIATE_VARY_TEXCOORD) {
+        glEnableVertexAttribArray(PRISMGL_ATTRIB_TEXCOORD);
+        glVertexAttribFormat(PRISMGL_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, offset);
+        glVertexAttribBinding(PRISMGL_ATTRIB_TEXCOORD, 0);
+        offset += 2 * sizeof(GLfloat);
+    }
+    if (varying & IMMEDIATE_VARY_NORMAL) {
+        glEnableVertexAttribArray(PRISMGL_ATTRIB_NORMAL);
+        glVertexAttribFormat(PRISMGL_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, offset);
+        glVertexAttribBinding(PRISMGL_ATTRIB_NORMAL, 0);
+        offset += 3 * sizeof(GLfloat);
     }
-}
 
-void prismgl_glBegin(GLenum mode) {
-    ensure_immediate_buffers();
-    g_immediate.mode = mode;
-    g_immediate.count = 0;
-    g_immediate.active = true;
+    layout->stride = (GLsizei)offset;
+    layout->quad_indices = false;
 }
 
-void prismgl_glEnd(void) {
-    if (!g_immediate.active || g_immediate.count == 0) {
-        g_immediate.active = false;
-        return;
+static void ensure_immediate_buffers(ImmediateState* im) {
+    if (!im->buffers_created) {
+        /* Streamed through COPY_WRITE so the app's GL_ARRAY_BUFFER survives */
+        if (!stream_buffer_init(&im->stream, GL_COPY_WRITE_BUFFER,
+                                IMMEDIATE_STREAM_SIZE)) {
+            LOGE("Failed to create immediate mode stream buffer");
+            return;
+        }
+        state_shadow_bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+
+        GLuint vaos[IMMEDIATE_LAYOUTS];
+        glGenVertexArrays(IMMEDIATE_LAYOUTS, vaos);
+        for (unsigned i = 0; i < IMMEDIATE_LAYOUTS; i++) {
+            im->layouts[i].vao = vaos[i];
+            setup_immediate_layout(&im->layouts[i], i);
+        }
+        state_shadow_bind_vertex_array(0);
+        im->buffers_created = true;
     }
+}
 
-    glBindVertexArray(g_immediate.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, g_immediate.vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-                 g_immediate.count * (GLsizeiptr)sizeof(ImmediateVertex),
-                 g_immediate.vertices, GL_DYNAMIC_DRAW);
+/* Copy position plus the `varying` attributes into the stream, packed */
+static void pack_immediate_vertices(const ImmediateState* im, uint8_t* dst,
+                                    unsigned varying, int count) {
+    for (int i = 0; i < count; i++) {
+        const ImmediateVertex* v = &im->vertices[i];
+        memcpy(dst, &v->x, 3 * sizeof(GLfloat));
+        dst += 3 * sizeof(GLfloat);
+        if (varying & IMMEDIATE_VARY_COLOR) {
+            memcpy(dst, &v->r, 4 * sizeof(GLfloat));
+            dst += 4 * sizeof(GLfloat);
+        }
+        if (varying & IMMEDIATE_VARY_TEXCOORD) {
+            memcpy(dst, &v->s, 2 * sizeof(GLfloat));
+            dst += 2 * sizeof(GLfloat);
+        }
+        if (varying & IMMEDIATE_VARY_NORMAL) {
+            memcpy(dst, &v->nx, 3 * sizeof(GLfloat));
+            dst += 3 * sizeof(GLfloat);
+        }
+    }
+}
 
+void prismgl_immediate_setup_attribs(void) {
     /* Position (location=0) */
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
+    glEnableVertexAttribArray(PRISMGL_ATTRIB_POSITION);
+    glVertexAttribPointer(PRISMGL_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE,
                           sizeof(ImmediateVertex),
                           (void*)offsetof(ImmediateVertex, x));
 
     /* Color (location=1) */
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE,
+    glEnableVertexAttribArray(PRISMGL_ATTRIB_COLOR);
+    glVertexAttribPointer(PRISMGL_ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE,
                           sizeof(ImmediateVertex),
                           (void*)offsetof(ImmediateVertex, r));
 
     /* TexCoord (location=2) */
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
+    glEnableVertexAttribArray(PRISMGL_ATTRIB_TEXCOORD);
+    glVertexAttribPointer(PRISMGL_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
                           sizeof(ImmediateVertex),
                           (void*)offsetof(ImmediateVertex, s));
 
     /* Normal (location=3) */
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE,
+    glEnableVertexAttribArray(PRISMGL_ATTRIB_NORMAL);
+    glVertexAttribPointer(PRISMGL_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE,
                           sizeof(ImmediateVertex),
                           (void*)offsetof(ImmediateVertex, nx));
+}
+
+void prismgl_immediate_get_attribs(ImmediateAttribs* out) {
+    ImmediateState* im = &wrapper_state()->immediate;
+    out->r = im->cur_r;
+    out->g = im->cur_g;
+    out->b = im->cur_b;
+    out->a = im->cur_a;
+    out->s = im->cur_s;
+    out->t = im->cur_t;
+    out->nx = im->cur_nx;
+    out->ny = im->cur_ny;
+    out->nz = im->cur_nz;
+}
 
-    GLenum draw_mode = g_immediate.mode;
+void prismgl_immediate_set_attribs(const ImmediateAttribs* attribs) {
+    ImmediateState* im = &wrapper_state()->immediate;
+    im->cur_r = attribs->r;
+    im->cur_g = attribs->g;
+    im->cur_b = attribs->b;
+    im->cur_a = attribs->a;
+    im->cur_s = attribs->s;
+    im->cur_t = attribs->t;
+    im->cur_nx = attribs->nx;
+    im->cur_ny = attribs->ny;
+    im->cur_nz = attribs->nz;
+}
 
-    /* Convert quads to triangles using index buffer */
-    if (g_immediate.mode == GL_QUADS) {
-        int quad_count = g_immediate.count / 4;
-        int idx_count = quad_count * 6;
-        GLushort* indices = (GLushort*)malloc(idx_count * sizeof(GLushort));
-        if (!indices) {
-            g_immediate.active = false;
+void prismgl_glBegin(GLenum mode) {
+    ImmediateState* im = &wrapper_state()->immediate;
+    if (!im->vertices) {
+        /* Most contexts never use immediate mode, so the 3 MB is deferred */
+        im->vertices = (ImmediateVertex*)malloc(MAX_IMMEDIATE_VERTICES *
+                                                sizeof(ImmediateVertex));
+        if (!im->vertices) {
+            LOGE("Failed to allocate immediate mode vertices");
             return;
         }
+    }
+    ensure_immediate_buffers(im);
+    im->mode = mode;
+    im->count = 0;
+    im->varying = 0;
+    im->active = true;
+}
 
-        for (int i = 0; i < quad_count; i++) {
-            int base = i * 4;
-            indices[i * 6 + 0] = (GLushort)(base + 0);
-            indices[i * 6 + 1] = (GLushort)(base + 1);
-            indices[i * 6 + 2] = (GLushort)(base + 2);
-            indices[i * 6 + 3] = (GLushort)(base + 0);
-            indices[i * 6 + 4] = (GLushort)(base + 2);
-            indices[i * 6 + 5] = (GLushort)(base + 3);
-        }
+void prismgl_glEnd(void) {
+    ImmediateState* im = &wrapper_state()->immediate;
+    if (!im->active || im->count == 0) {
+        im->active = false;
+        return;
+    }
 
-        /* Use IBO for proper indexed drawing */
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_immediate.ibo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     idx_count * (GLsizeiptr)sizeof(GLushort),
-                     indices, GL_DYNAMIC_DRAW);
-        glDrawElements(GL_TRIANGLES, idx_count, GL_UNSIGNED_SHORT, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-        free(indices);
-    } else {
-        if (draw_mode == GL_QUAD_STRIP) {
-            draw_mode = GL_TRIANGLE_STRIP;
+    /* Inside glNewList the geometry is baked into the list instead */
+    if (display_list_record_primitive(im->mode, im->vertices, im->count)) {
+        im->active = false;
+        return;
+    }
+
+    if (!im->buffers_created) {
+        im->active = false;
+        return;
+    }
+
+    texture_batch_flush();
+    occlusion_query_draw(im->mode, &im->count, 1, 1);
+    matrix_stack_flush();
+
+    int count = im->count;
+    unsigned varying = im->varying;
+    ImmediateLayout* layout = &im->layouts[varying];
+
+    GLsizeiptr offset = 0;
+    uint8_t* dst = (uint8_t*)stream_buffer_map(&im->stream,
+                                               (GLsizeiptr)count * layout->stride, &offset);
+    if (!dst) {
+        im->active = false;
+        return;
+    }
+    pack_immediate_vertices(im, dst, varying, count);
+    stream_buffer_unmap(&im->stream);
+
+    /* Bind + offset update; the attribute layout lives in the VAO */
+    state_shadow_bind_vertex_array(layout->vao);
+    glBindVertexBuffer(0, im->stream.buffer, (GLintptr)offset, layout->stride);
+
+    if (!(varying & IMMEDIATE_VARY_COLOR)) {
+        glVertexAttrib4f(PRISMGL_ATTRIB_COLOR, im->cur_r, im->cur_g, im->cur_b, im->cur_a);
+    }
+    if (!(varying & IMMEDIATE_VARY_TEXCOORD)) {
+        glVertexAttrib4f(PRISMGL_ATTRIB_TEXCOORD, im->cur_s, im->cur_t, 0.0f, 1.0f);
+    }
+    if (!(varying & IMMEDIATE_VARY_NORMAL)) {
+        glVertexAttrib4f(PRISMGL_ATTRIB_NORMAL, im->cur_nx, im->cur_ny, im->cur_nz, 1.0f);
+    }
+
+    if (im->mode == GL_QUADS) {
+        /* The shared quad index buffer stays attached to the layout VAO */
+        GLsizei quads = count / 4;
+        GLuint indices = quad_convert_shared_indices(quads);
+        if (indices && quads > 0) {
+            if (!layout->quad_indices) {
+                state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+                layout->quad_indices = true;
+            }
+            glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_SHORT, 0);
         }
-        glDrawArrays(draw_mode, 0, g_immediate.count);
+    } else if (!quad_convert_draw_arrays(im->mode, 0, count, 1)) {
+        glDrawArrays(im->mode, 0, count);
     }
 
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(2);
-    glDisableVertexAttribArray(3);
-    glBindVertexArray(0);
-    g_immediate.active = false;
+    state_shadow_bind_vertex_array(0);
+    im->active = false;
 }
 
 void prismgl_glVertex2f(GLfloat x, GLfloat y) {
@@ -188,19 +359,20 @@ void prismgl_glVertex2f(GLfloat x, GLfloat y) {
 }
 
 void prismgl_glVertex3f(GLfloat x, GLfloat y, GLfloat z) {
-    if (!g_immediate.active || g_immediate.count >= MAX_IMMEDIATE_VERTICES) return;
+    ImmediateState* im = &wrapper_state()->immediate;
+    if (!im->active || im->count >= MAX_IMMEDIATE_VERTICES) return;
 
-    ImmediateVertex* v = &g_immediate.vertices[g_immediate.count++];
+    ImmediateVertex* v = &im->vertices[im->count++];
     v->x = x; v->y = y; v->z = z;
-    v->r = g_immediate.cur_r;
-    v->g = g_immediate.cur_g;
-    v->b = g_immediate.cur_b;
-    v->a = g_immediate.cur_a;
-    v->s = g_immediate.cur_s;
-    v->t = g_immediate.cur_t;
-    v->nx = g_immediate.cur_nx;
-    v->ny = g_immediate.cur_ny;
-    v->nz = g_immediate.cur_nz;
+    v->r = im->cur_r;
+    v->g = im->cur_g;
+    v->b = im->cur_b;
+    v->a = im->cur_a;
+    v->s = im->cur_s;
+    v->t = im->cur_t;
+    v->nx = im->cur_nx;
+    v->ny = im->cur_ny;
+    v->nz = im->cur_nz;
 }
 
 void prismgl_glVertex3d(double x, double y, double z) {
@@ -212,13 +384,19 @@ void prismgl_glVertex2d(double x, double y) {
 }
 
 void prismgl_glTexCoord2f(GLfloat s, GLfloat t) {
-    g_immediate.cur_s = s;
-    g_immediate.cur_t = t;
+    ImmediateState* im = &wrapper_state()->immediate;
+    im->cur_s = s;
+    im->cur_t = t;
+    if (im->active) {
+        im->varying |= IMMEDIATE_VARY_TEXCOORD;
+    } else {
+        const GLfloat v[2] = { s, t };
+        display_list_record_floats(DL_CMD_TEXCOORD, v, 2);
+    }
 }
 
 void prismgl_glTexCoord2d(double s, double t) {
-    g_immediate.cur_s = (GLfloat)s;
-    g_immediate.cur_t = (GLfloat)t;
+    prismgl_glTexCoord2f((GLfloat)s, (GLfloat)t);
 }
 
 void prismgl_glColor3f(GLfloat r, GLfloat g, GLfloat b) {
@@ -230,10 +408,18 @@ void prismgl_glColor3d(double r, double g, double b) {
 }
 
 void prismgl_glColor4f(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
-    g_immediate.cur_r = r;
-    g_immediate.cur_g = g;
-    g_immediate.cur_b = b;
-    g_immediate.cur_a = a;
+    ImmediateState* im = &wrapper_state()->immediate;
+    im->cur_r = r;
+    im->cur_g = g;
+    im->cur_b = b;
+    im->cur_a = a;
+    /* Inside glBegin/glEnd the color is baked into the vertices */
+    if (im->active) {
+        im->varying |= IMMEDIATE_VARY_COLOR;
+    } else {
+        const GLfloat v[4] = { r, g, b, a };
+        display_list_record_floats(DL_CMD_COLOR, v, 4);
+    }
 }
 
 void prismgl_glColor4d(double r, double g, double b, double a) {
@@ -249,9 +435,16 @@ void prismgl_glColor4ub(GLubyte r, GLubyte g, GLubyte b, GLubyte a) {
 }
 
 void prismgl_glNormal3f(GLfloat nx, GLfloat ny, GLfloat nz) {
-    g_immediate.cur_nx = nx;
-    g_immediate.cur_ny = ny;
-    g_immediate.cur_nz = nz;
+    ImmediateState* im = &wrapper_state()->immediate;
+    im->cur_nx = nx;
+    im->cur_ny = ny;
+    im->cur_nz = nz;
+    if (im->active) {
+        im->varying |= IMMEDIATE_VARY_NORMAL;
+    } else {
+        const GLfloat v[3] = { nx, ny, nz };
+        display_list_record_floats(DL_CMD_NORMAL, v, 3);
+    }
 }
 
 void prismgl_glShadeModel(GLenum mode) {
@@ -267,72 +460,15 @@ void prismgl_glTexImage1D(GLenum target, GLint level, GLint internalformat,
                            GLsizei width, GLint border, GLenum format,
                            GLenum type, const void* pixels) {
     (void)target;
-    glTexImage2D(GL_TEXTURE_2D, level, internalformat,
-                 width, 1, border, format, type, pixels);
+    prismgl_glTexImage2D_wrapper(GL_TEXTURE_2D, level, internalformat,
+                                 width, 1, border, format, type, pixels);
 }
 
 void prismgl_glGetTexImage(GLenum target, GLint level, GLenum format,
                             GLenum type, void* pixels) {
-    /* glGetTexImage not available in ES - implement via FBO readback */
-    if (!pixels) return;
-
-    GLint prev_fbo = 0;
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fbo);
-
-    /* Get the current bound texture */
-    GLint tex_id = 0;
-    GLenum binding;
-    switch (target) {
-        case GL_TEXTURE_2D:
-            binding = GL_TEXTURE_BINDING_2D;
-            break;
-        case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
-        case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
-        case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
-        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
-        case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
-        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
-            binding = GL_TEXTURE_BINDING_CUBE_MAP;
-            break;
-        default:
-            LOGW("glGetTexImage: unsupported target 0x%x", target);
-            return;
-    }
-    glGetIntegerv(binding, &tex_id);
-    if (tex_id == 0) {
-        LOGW("glGetTexImage: no texture bound");
-        return;
-    }
-
-    /* Get texture dimensions */
-    GLint width = 0, height = 0;
-    /* We need to get texture dimensions - use level 0 */
-    GLuint fbo;
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
-    if (target == GL_TEXTURE_2D) {
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                               GL_TEXTURE_2D, tex_id, level);
-    } else {
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                               target, tex_id, level);
-    }
-
-    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (status == GL_FRAMEBUFFER_COMPLETE) {
-        /* Get the actual dimensions from the viewport - we need to query them */
-        GLint vp[4];
-        glGetIntegerv(GL_VIEWPORT, vp);
-        /* For texture readback, dimensions are implicit from the FBO attachment */
-        /* We'll read what we can */
-        glReadPixels(0, 0, vp[2], vp[3], format, type, pixels);
-    } else {
-        LOGW("glGetTexImage: FBO incomplete (0x%x)", status);
-    }
-
-    glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
-    glDeleteFramebuffers(1, &fbo);
+    /* glGetTexImage not available in ES - read back through a framebuffer */
+    texture_batch_flush();
+    texture_readback_get_image(target, level, format, type, pixels);
 }
 
 void prismgl_glDrawBuffer(GLenum buf) {
@@ -354,51 +490,695 @@ void prismgl_glTexImage3D_wrapper(GLenum target, GLint level, GLint internalform
                                    GLsizei width, GLsizei height, GLsizei depth,
                                    GLint border, GLenum format, GLenum type,
                                    const void* pixels) {
+    texture_batch_flush();
+    GLuint texture = texture_registry_bound(target);
+    if (texture_storage_image_3d(texture, target, level, internalformat, width, height, depth,
+                                 border, format, type, pixels)) {
+        return;
+    }
     glTexImage3D(target, level, internalformat, width, height, depth,
                  border, format, type, pixels);
+    texture_registry_define(texture, target, level, (GLenum)internalformat, width, height, depth);
 }
 
-/* ===== Fixed-function matrix stack stubs ===== */
+/* ===== Texture definitions ===== */
+/*
+ * Level sizes are recorded so readback never has to ask the driver.
+ * Desktop-only pixel formats are rewritten by texture_convert, and
+ * per-level allocations promoted to immutable storage by texture_storage.
+ */
+
+static void define_level_2d(GLuint texture, GLenum target, GLint level, GLint internalformat,
+                            GLsizei width, GLsizei height, GLint border, GLenum format,
+                            GLenum type, const void* pixels) {
+    if (texture_storage_image_2d(texture, target, level, internalformat, width, height,
+                                 border, format, type, pixels)) {
+        return;
+    }
+    glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+    texture_registry_define(texture, target, level, (GLenum)internalformat, width, height, 1);
+}
+
+void prismgl_glTexImage2D_wrapper(GLenum target, GLint level, GLint internalformat,
+                                   GLsizei width, GLsizei height, GLint border,
+                                   GLenum format, GLenum type, const void* pixels) {
+    texture_batch_flush();
+    GLuint texture = texture_registry_bound(target);
+    TextureSwizzle stored = texture_registry_swizzle(texture);
+    TextureUploadPlan plan;
+    if (!texture_convert_plan(internalformat, format, type, stored, level == 0, &plan)) {
+        define_level_2d(texture, target, level, internalformat, width, height, border,
+                        format, type, pixels);
+        return;
+    }
+
+    void* converted = NULL;
+    TextureUnpackState unpack;
+    if (plan.kernel != TEXTURE_CONVERT_NONE &&
+        !texture_convert_begin(&plan, format, type, width, height, pixels, &converted, &unpack)) {
+        return;
+    }
+    define_level_2d(texture, target, level, plan.internal_format, width, height, border,
+                    plan.format, plan.type, converted ? converted : pixels);
+    texture_convert_end(converted, &unpack);
+
+    if (plan.swizzle != stored) texture_convert_set_swizzle(texture, target, plan.swizzle);
+}
+
+/*
+ * glTexSubImage2D, remapped for textures the memory budget allocated
+ * smaller, or staged with other small uploads until the next draw
+ */
+static void sub_image_2d(GLuint texture, GLenum target, GLint level, GLint xoffset,
+                         GLint yoffset, GLsizei width, GLsizei height, GLenum format,
+                         GLenum type, const void* pixels) {
+    if (texture_storage_sub_image_2d(texture, target, level, xoffset, yoffset, width, height,
+                                     format, type, pixels)) {
+        return;
+    }
+    if (texture_batch_sub_image_2d(texture, target, level, xoffset, yoffset, width, height,
+                                   format, type, pixels)) {
+        return;
+    }
+    glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+void prismgl_glTexSubImage2D_wrapper(GLenum target, GLint level, GLint xoffset,
+                                      GLint yoffset, GLsizei width, GLsizei height,
+                                      GLenum format, GLenum type, const void* pixels) {
+    GLuint texture = texture_registry_bound(target);
+    TextureSwizzle stored = texture_registry_swizzle(texture);
+    TextureUploadPlan plan;
+    if (!texture_convert_plan(0, format, type, stored, false, &plan)) {
+        sub_image_2d(texture, target, level, xoffset, yoffset, width, height, format, type,
+                     pixels);
+        return;
+    }
+
+    void* converted = NULL;
+    TextureUnpackState unpack;
+    if (plan.kernel != TEXTURE_CONVERT_NONE &&
+        !texture_convert_begin(&plan, format, type, width, height, pixels, &converted, &unpack)) {
+        return;
+    }
+    sub_image_2d(texture, target, level, xoffset, yoffset, width, height, plan.format,
+                 plan.type, converted ? converted : pixels);
+    texture_convert_end(converted, &unpack);
+}
+
+void prismgl_glCompressedTexImage2D_wrapper(GLenum target, GLint level, GLenum internalformat,
+                                             GLsizei width, GLsizei height, GLint border,
+                                             GLsizei image_size, const void* data) {
+    texture_batch_flush();
+    glCompressedTexImage2D(target, level, internalformat, width, height, border,
+                           image_size, data);
+    texture_registry_define(texture_registry_bound(target), target, level,
+                            internalformat, width, height, 1);
+}
+
+void prismgl_glCopyTexImage2D_wrapper(GLenum target, GLint level, GLenum internalformat,
+                                       GLint x, GLint y, GLsizei width, GLsizei height,
+                                       GLint border) {
+    texture_batch_flush();
+    glCopyTexImage2D(target, level, internalformat, x, y, width, height, border);
+    texture_registry_define(texture_registry_bound(target), target, level,
+                            internalformat, width, height, 1);
+}
+
+void prismgl_glCompressedTexSubImage2D_wrapper(GLenum target, GLint level, GLint xoffset,
+                                                GLint yoffset, GLsizei width, GLsizei height,
+                                                GLenum format, GLsizei image_size,
+                                                const void* data) {
+    texture_batch_flush();
+    glCompressedTexSubImage2D(target, level, xoffset, yoffset, width, height, format,
+                              image_size, data);
+}
+
+void prismgl_glCopyTexSubImage2D_wrapper(GLenum target, GLint level, GLint xoffset,
+                                          GLint yoffset, GLint x, GLint y,
+                                          GLsizei width, GLsizei height) {
+    /* Staged uploads may target the texture or the read framebuffer */
+    texture_batch_flush();
+    glCopyTexSubImage2D(target, level, xoffset, yoffset, x, y, width, height);
+}
+
+void prismgl_glTexStorage2D_wrapper(GLenum target, GLsizei levels, GLenum internalformat,
+                                     GLsizei width, GLsizei height) {
+    texture_batch_flush();
+    TextureSwizzle swizzle;
+    GLenum internal = texture_convert_storage_format(internalformat, &swizzle);
+    glTexStorage2D(target, levels, internal, width, height);
+
+    GLuint texture = texture_registry_bound(target);
+    texture_registry_define_storage(texture, target, levels, internal, width, height, 1);
+    if (swizzle != texture_registry_swizzle(texture)) {
+        texture_convert_set_swizzle(texture, target, swizzle);
+    }
+}
+
+void prismgl_glTexStorage3D_wrapper(GLenum target, GLsizei levels, GLenum internalformat,
+                                     GLsizei width, GLsizei height, GLsizei depth) {
+    texture_batch_flush();
+    TextureSwizzle swizzle;
+    GLenum internal = texture_convert_storage_format(internalformat, &swizzle);
+    glTexStorage3D(target, levels, internal, width, height, depth);
+
+    GLuint texture = texture_registry_bound(target);
+    texture_registry_define_storage(texture, target, levels, internal, width, height, depth);
+    if (swizzle != texture_registry_swizzle(texture)) {
+        texture_convert_set_swizzle(texture, target, swizzle);
+    }
+}
+
+void prismgl_glTexParameteri_wrapper(GLenum target, GLenum pname, GLint param) {
+    glTexParameteri(target, pname, param);
+    if (pname == GL_TEXTURE_MAX_LEVEL) {
+        texture_registry_set_max_level(texture_registry_bound(target), target, param);
+    }
+}
+
+void prismgl_glGenerateMipmap_wrapper(GLenum target) {
+    texture_batch_flush();
+    glGenerateMipmap(target);
+    texture_registry_generate_mipmaps(texture_registry_bound(target));
+}
+
+void prismgl_glPixelStorei_wrapper(GLenum pname, GLint param) {
+    state_shadow_pixel_store(pname, param);
+}
+
+/* ===== Fixed-function matrix stack ===== */
 /* Minecraft itself doesn't use these but some mods/legacy code may */
 
-void prismgl_glPushMatrix(void) { /* no-op in modern GL */ }
-void prismgl_glPopMatrix(void) { /* no-op */ }
-void prismgl_glLoadIdentity(void) { /* no-op */ }
-void prismgl_glMatrixMode(GLenum mode) { (void)mode; }
+void prismgl_glPushMatrix(void) {
+    if (display_list_record_op(DL_CMD_PUSH_MATRIX)) return;
+    matrix_stack_push();
+}
+
+void prismgl_glPopMatrix(void) {
+    if (display_list_record_op(DL_CMD_POP_MATRIX)) return;
+    matrix_stack_pop();
+}
+
+void prismgl_glLoadIdentity(void) {
+    if (display_list_record_op(DL_CMD_LOAD_IDENTITY)) return;
+    matrix_stack_load_identity();
+}
+
+void prismgl_glMatrixMode(GLenum mode) {
+    if (display_list_record_enum(DL_CMD_MATRIX_MODE, mode)) return;
+    matrix_stack_set_mode(mode);
+}
+
 void prismgl_glOrtho(double l, double r, double b, double t, double n, double f) {
-    (void)l; (void)r; (void)b; (void)t; (void)n; (void)f;
+    const GLfloat v[6] = { (GLfloat)l, (GLfloat)r, (GLfloat)b, (GLfloat)t, (GLfloat)n, (GLfloat)f };
+    if (display_list_record_floats(DL_CMD_ORTHO, v, 6)) return;
+    matrix_stack_ortho(v[0], v[1], v[2], v[3], v[4], v[5]);
 }
+
 void prismgl_glFrustum(double l, double r, double b, double t, double n, double f) {
-    (void)l; (void)r; (void)b; (void)t; (void)n; (void)f;
+    const GLfloat v[6] = { (GLfloat)l, (GLfloat)r, (GLfloat)b, (GLfloat)t, (GLfloat)n, (GLfloat)f };
+    if (display_list_record_floats(DL_CMD_FRUSTUM, v, 6)) return;
+    matrix_stack_frustum(v[0], v[1], v[2], v[3], v[4], v[5]);
+}
+
+void prismgl_glTranslatef(GLfloat x, GLfloat y, GLfloat z) {
+    const GLfloat v[3] = { x, y, z };
+    if (display_list_record_floats(DL_CMD_TRANSLATE, v, 3)) return;
+    matrix_stack_translate(x, y, z);
+}
+
+void prismgl_glRotatef(GLfloat angle, GLfloat x, GLfloat y, GLfloat z) {
+    const GLfloat v[4] = { angle, x, y, z };
+    if (display_list_record_floats(DL_CMD_ROTATE, v, 4)) return;
+    matrix_stack_rotate(angle, x, y, z);
+}
+
+void prismgl_glScalef(GLfloat x, GLfloat y, GLfloat z) {
+    const GLfloat v[3] = { x, y, z };
+    if (display_list_record_floats(DL_CMD_SCALE, v, 3)) return;
+    matrix_stack_scale(x, y, z);
+}
+
+void prismgl_glMultMatrixf(const GLfloat* m) {
+    if (!m) return;
+    if (display_list_record_floats(DL_CMD_MULT_MATRIX, m, 16)) return;
+    matrix_stack_mult(m);
+}
+
+void prismgl_glLoadMatrixf(const GLfloat* m) {
+    if (!m) return;
+    if (display_list_record_floats(DL_CMD_LOAD_MATRIX, m, 16)) return;
+    matrix_stack_load(m);
+}
+
+void prismgl_glUseProgram_wrapper(GLuint program) {
+    matrix_stack_use_program(program);
+    state_shadow_use_program(program);
+}
+
+void prismgl_glLinkProgram_wrapper(GLuint program) {
+    glLinkProgram(program);
+    matrix_stack_program_linked(program);
+    draw_instance_program_linked(program);
+    occlusion_query_program_changed(program);
+}
+
+void prismgl_glDeleteProgram_wrapper(GLuint program) {
+    draw_instance_program_deleted(program);
+    occlusion_query_program_changed(program);
+    glDeleteProgram(program);
+}
+
+/* ===== Uniforms ===== */
+/* Held back while draws of the current program wait for instancing */
+
+void prismgl_glUniform1f_wrapper(GLint location, GLfloat v0) {
+    const GLfloat v[1] = { v0 };
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_1F, 1, v)) return;
+    glUniform1f(location, v0);
+}
+
+void prismgl_glUniform2f_wrapper(GLint location, GLfloat v0, GLfloat v1) {
+    const GLfloat v[2] = { v0, v1 };
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_2F, 1, v)) return;
+    glUniform2f(location, v0, v1);
+}
+
+void prismgl_glUniform3f_wrapper(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+    const GLfloat v[3] = { v0, v1, v2 };
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_3F, 1, v)) return;
+    glUniform3f(location, v0, v1, v2);
+}
+
+void prismgl_glUniform4f_wrapper(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) {
+    const GLfloat v[4] = { v0, v1, v2, v3 };
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_4F, 1, v)) return;
+    glUniform4f(location, v0, v1, v2, v3);
+}
+
+void prismgl_glUniform1i_wrapper(GLint location, GLint v0) {
+    const GLint v[1] = { v0 };
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_1I, 1, v)) return;
+    glUniform1i(location, v0);
+}
+
+void prismgl_glUniform2i_wrapper(GLint location, GLint v0, GLint v1) {
+    const GLint v[2] = { v0, v1 };
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_2I, 1, v)) return;
+    glUniform2i(location, v0, v1);
+}
+
+void prismgl_glUniform3i_wrapper(GLint location, GLint v0, GLint v1, GLint v2) {
+    const GLint v[3] = { v0, v1, v2 };
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_3I, 1, v)) return;
+    glUniform3i(location, v0, v1, v2);
+}
+
+void prismgl_glUniform4i_wrapper(GLint location, GLint v0, GLint v1, GLint v2, GLint v3) {
+    const GLint v[4] = { v0, v1, v2, v3 };
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_4I, 1, v)) return;
+    glUniform4i(location, v0, v1, v2, v3);
+}
+
+void prismgl_glUniform1fv_wrapper(GLint location, GLsizei count, const GLfloat* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_1F, count, value)) return;
+    glUniform1fv(location, count, value);
+}
+
+void prismgl_glUniform2fv_wrapper(GLint location, GLsizei count, const GLfloat* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_2F, count, value)) return;
+    glUniform2fv(location, count, value);
+}
+
+void prismgl_glUniform3fv_wrapper(GLint location, GLsizei count, const GLfloat* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_3F, count, value)) return;
+    glUniform3fv(location, count, value);
+}
+
+void prismgl_glUniform4fv_wrapper(GLint location, GLsizei count, const GLfloat* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_4F, count, value)) return;
+    glUniform4fv(location, count, value);
+}
+
+void prismgl_glUniform1iv_wrapper(GLint location, GLsizei count, const GLint* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_1I, count, value)) return;
+    glUniform1iv(location, count, value);
+}
+
+void prismgl_glUniform2iv_wrapper(GLint location, GLsizei count, const GLint* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_2I, count, value)) return;
+    glUniform2iv(location, count, value);
+}
+
+void prismgl_glUniform3iv_wrapper(GLint location, GLsizei count, const GLint* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_3I, count, value)) return;
+    glUniform3iv(location, count, value);
+}
+
+void prismgl_glUniform4iv_wrapper(GLint location, GLsizei count, const GLint* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_4I, count, value)) return;
+    glUniform4iv(location, count, value);
+}
+
+/* Transposed matrices are not recorded; a zero count makes the instancer flush */
+void prismgl_glUniformMatrix2fv_wrapper(GLint location, GLsizei count, GLboolean transpose,
+                                        const GLfloat* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_MAT2,
+                                     transpose ? 0 : count, value)) return;
+    glUniformMatrix2fv(location, count, transpose, value);
+}
+
+void prismgl_glUniformMatrix3fv_wrapper(GLint location, GLsizei count, GLboolean transpose,
+                                        const GLfloat* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_MAT3,
+                                     transpose ? 0 : count, value)) return;
+    glUniformMatrix3fv(location, count, transpose, value);
+}
+
+void prismgl_glUniformMatrix4fv_wrapper(GLint location, GLsizei count, GLboolean transpose,
+                                        const GLfloat* value) {
+    if (draw_instance_record_uniform(location, INSTANCE_UNIFORM_MAT4,
+                                     transpose ? 0 : count, value)) return;
+    glUniformMatrix4fv(location, count, transpose, value);
+}
+
+/* ===== Client state (legacy vertex arrays) ===== */
+
+void prismgl_glEnableClientState(GLenum array) {
+    client_arrays_enable(array, true);
+}
+
+void prismgl_glDisableClientState(GLenum array) {
+    client_arrays_enable(array, false);
 }
-void prismgl_glTranslatef(GLfloat x, GLfloat y, GLfloat z) { (void)x; (void)y; (void)z; }
-void prismgl_glRotatef(GLfloat angle, GLfloat x, GLfloat y, GLfloat z) { (void)angle; (void)x; (void)y; (void)z; }
-void prismgl_glScalef(GLfloat x, GLfloat y, GLfloat z) { (void)x; (void)y; (void)z; }
-void prismgl_glMultMatrixf(const GLfloat* m) { (void)m; }
-void prismgl_glLoadMatrixf(const GLfloat* m) { (void)m; }
 
-/* ===== Client state stubs ===== */
-void prismgl_glEnableClientState(GLenum array) { (void)array; }
-void prismgl_glDisableClientState(GLenum array) { (void)array; }
 void prismgl_glVertexPointer(GLint size, GLenum type, GLsizei stride, const void* pointer) {
-    (void)size; (void)type; (void)stride; (void)pointer;
+    client_arrays_pointer(GL_VERTEX_ARRAY, size, type, stride, pointer);
 }
+
 void prismgl_glColorPointer(GLint size, GLenum type, GLsizei stride, const void* pointer) {
-    (void)size; (void)type; (void)stride; (void)pointer;
+    client_arrays_pointer(GL_COLOR_ARRAY, size, type, stride, pointer);
 }
+
 void prismgl_glTexCoordPointer(GLint size, GLenum type, GLsizei stride, const void* pointer) {
-    (void)size; (void)type; (void)stride; (void)pointer;
+    client_arrays_pointer(GL_TEXTURE_COORD_ARRAY, size, type, stride, pointer);
 }
+
 void prismgl_glNormalPointer(GLenum type, GLsizei stride, const void* pointer) {
-    (void)type; (void)stride; (void)pointer;
+    client_arrays_pointer(GL_NORMAL_ARRAY, 3, type, stride, pointer);
+}
+
+/* ===== Draw calls ===== */
+
+void prismgl_glDrawArrays_wrapper(GLenum mode, GLint first, GLsizei count) {
+    texture_batch_flush();
+    occlusion_query_draw(mode, &count, 1, 1);
+    matrix_stack_flush();
+    if (draw_instance_record_arrays(mode, first, count)) return;
+    if (client_arrays_active() && client_arrays_draw_arrays(mode, first, count)) {
+        return;
+    }
+    if (quad_convert_draw_arrays(mode, first, count, 1)) return;
+    glDrawArrays(mode, first, count);
+}
+
+void prismgl_glDrawElements_wrapper(GLenum mode, GLsizei count, GLenum type,
+                                    const void* indices) {
+    texture_batch_flush();
+    occlusion_query_draw(mode, &count, 1, 1);
+    if (draw_batch_record_elements(mode, count, type, indices, 0)) return;
+    matrix_stack_flush();
+    if (draw_instance_record_elements(mode, count, type, indices, 0)) return;
+    if (client_arrays_active() && client_arrays_draw_elements(mode, count, type, indices)) {
+        return;
+    }
+    if (quad_convert_draw_elements(mode, count, type, indices, 1, 0)) return;
+    glDrawElements(mode, count, type, indices);
+}
+
+void prismgl_glDrawElementsBaseVertex_wrapper(GLenum mode, GLsizei count, GLenum type,
+                                              const void* indices, GLint basevertex) {
+    texture_batch_flush();
+    occlusion_query_draw(mode, &count, 1, 1);
+    if (draw_batch_record_elements(mode, count, type, indices, basevertex)) return;
+    matrix_stack_flush();
+    if (draw_instance_record_elements(mode, count, type, indices, basevertex)) return;
+    if (quad_convert_draw_elements(mode, count, type, indices, 1, basevertex)) return;
+    glDrawElementsBaseVertex(mode, count, type, indices, basevertex);
+}
+
+void prismgl_glDrawArraysInstanced_wrapper(GLenum mode, GLint first, GLsizei count,
+                                           GLsizei instancecount) {
+    texture_batch_flush();
+    occlusion_query_draw(mode, &count, 1, instancecount);
+    matrix_stack_flush();
+    if (quad_convert_draw_arrays(mode, first, count, instancecount)) return;
+    glDrawArraysInstanced(mode, first, count, instancecount);
+}
+
+void prismgl_glDrawElementsInstanced_wrapper(GLenum mode, GLsizei count, GLenum type,
+                                             const void* indices, GLsizei instancecount) {
+    texture_batch_flush();
+    occlusion_query_draw(mode, &count, 1, instancecount);
+    matrix_stack_flush();
+    if (quad_convert_draw_elements(mode, count, type, indices, instancecount, 0)) return;
+    glDrawElementsInstanced(mode, count, type, indices, instancecount);
+}
+
+/* Legacy modes and client arrays need per-draw rewriting */
+static inline bool needs_per_draw_path(GLenum mode) {
+    return mode == GL_QUADS || mode == GL_QUAD_STRIP || mode == GL_POLYGON ||
+           client_arrays_active();
+}
+
+void prismgl_glMultiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count,
+                               GLsizei drawcount) {
+    if (!first || !count || drawcount <= 0) return;
+    if (needs_per_draw_path(mode)) {
+        for (GLsizei i = 0; i < drawcount; i++) {
+            prismgl_glDrawArrays_wrapper(mode, first[i], count[i]);
+        }
+        return;
+    }
+    texture_batch_flush();
+    occlusion_query_draw(mode, count, drawcount, 1);
+    matrix_stack_flush();
+    multi_draw_arrays(mode, first, count, drawcount);
+}
+
+void prismgl_glMultiDrawElements(GLenum mode, const GLsizei* count, GLenum type,
+                                 const void* const* indices, GLsizei drawcount) {
+    if (!count || !indices || drawcount <= 0) return;
+    if (needs_per_draw_path(mode)) {
+        for (GLsizei i = 0; i < drawcount; i++) {
+            prismgl_glDrawElements_wrapper(mode, count[i], type, indices[i]);
+        }
+        return;
+    }
+    texture_batch_flush();
+    occlusion_query_draw(mode, count, drawcount, 1);
+    matrix_stack_flush();
+    multi_draw_elements(mode, count, type, indices, drawcount, NULL);
+}
+
+void prismgl_glMultiDrawElementsBaseVertex(GLenum mode, const GLsizei* count, GLenum type,
+                                           const void* const* indices, GLsizei drawcount,
+                                           const GLint* basevertex) {
+    if (!count || !indices || drawcount <= 0) return;
+    texture_batch_flush();
+    occlusion_query_draw(mode, count, drawcount, 1);
+    matrix_stack_flush();
+    if (mode == GL_QUADS || mode == GL_QUAD_STRIP || mode == GL_POLYGON) {
+        for (GLsizei i = 0; i < drawcount; i++) {
+            GLint base = basevertex ? basevertex[i] : 0;
+            /* Like the single-draw path, pass on what conversion declined */
+            if (!quad_convert_draw_elements(mode, count[i], type, indices[i], 1, base)) {
+                glDrawElementsBaseVertex(mode, count[i], type, indices[i], base);
+            }
+        }
+        return;
+    }
+    multi_draw_elements(mode, count, type, indices, drawcount, basevertex);
+}
+
+/* ===== Buffer objects ===== */
+/* Writes submit batched draws first and drop index data cached from the buffer */
+
+void prismgl_glBufferData_wrapper(GLenum target, GLsizeiptr size, const void* data,
+                                  GLenum usage) {
+    draw_batch_invalidate();
+    quad_convert_invalidate_target(target);
+    multi_draw_invalidate_target(target);
+    glBufferData(target, size, data, usage);
+}
+
+void prismgl_glBufferSubData_wrapper(GLenum target, GLintptr offset, GLsizeiptr size,
+                                     const void* data) {
+    draw_batch_invalidate();
+    quad_convert_invalidate_target(target);
+    multi_draw_invalidate_target(target);
+    glBufferSubData(target, offset, size, data);
+}
+
+void* prismgl_glMapBufferRange_wrapper(GLenum target, GLintptr offset, GLsizeiptr length,
+                                       GLbitfield access) {
+    if (access & GL_MAP_WRITE_BIT) {
+        draw_batch_invalidate();
+        quad_convert_invalidate_target(target);
+        multi_draw_invalidate_target(target);
+    }
+    return glMapBufferRange(target, offset, length, access);
+}
+
+void prismgl_glCopyBufferSubData_wrapper(GLenum read_target, GLenum write_target,
+                                         GLintptr read_offset, GLintptr write_offset,
+                                         GLsizeiptr size) {
+    draw_batch_invalidate();
+    quad_convert_invalidate_target(write_target);
+    multi_draw_invalidate_target(write_target);
+    glCopyBufferSubData(read_target, write_target, read_offset, write_offset, size);
+}
+
+void prismgl_glDeleteBuffers_wrapper(GLsizei n, const GLuint* buffers) {
+    /* Finalizer and loader threads have no context; delete at frame end */
+    if (eglGetCurrentContext() == EGL_NO_CONTEXT && gl_jobs_delete_buffers(n, buffers)) return;
+    draw_batch_invalidate();
+    quad_convert_invalidate_buffers(n, buffers);
+    multi_draw_invalidate_buffers(n, buffers);
+    state_shadow_delete_buffers(n, buffers);
+}
+
+void prismgl_glBindTexture_wrapper(GLenum target, GLuint texture) {
+    if (display_list_record_texture(target, texture)) return;
+    if (texture != 0) texture_budget_touch(texture);
+    /* Batched draws restore 2D textures of the first units only */
+    if (!state_shadow_key_has_texture(target)) draw_batch_invalidate();
+    state_shadow_bind_texture(target, texture);
+}
+
+/* ===== Shadowed state ===== */
+/* Redundant changes are dropped by the state shadow */
+
+void prismgl_glActiveTexture_wrapper(GLenum texture) {
+    state_shadow_active_texture(texture);
+}
+
+void prismgl_glDeleteTextures_wrapper(GLsizei n, const GLuint* textures) {
+    /* The job runs this wrapper again on a thread with the context */
+    if (eglGetCurrentContext() == EGL_NO_CONTEXT && gl_jobs_delete_textures(n, textures)) return;
+    texture_batch_flush();
+    texture_registry_delete(n, textures);
+    state_shadow_delete_textures(n, textures);
+}
+
+void prismgl_glBindBuffer_wrapper(GLenum target, GLuint buffer) {
+    state_shadow_bind_buffer(target, buffer);
+}
+
+void prismgl_glBindBufferBase_wrapper(GLenum target, GLuint index, GLuint buffer) {
+    state_shadow_buffer_bound_indexed(target, buffer);
+    glBindBufferBase(target, index, buffer);
+}
+
+void prismgl_glBindBufferRange_wrapper(GLenum target, GLuint index, GLuint buffer,
+                                       GLintptr offset, GLsizeiptr size) {
+    state_shadow_buffer_bound_indexed(target, buffer);
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void prismgl_glBindVertexArray_wrapper(GLuint array) {
+    state_shadow_bind_vertex_array(array);
+}
+
+void prismgl_glDeleteVertexArrays_wrapper(GLsizei n, const GLuint* arrays) {
+    draw_batch_invalidate();
+    state_shadow_delete_vertex_arrays(n, arrays);
+}
+
+void prismgl_glBlendFunc_wrapper(GLenum sfactor, GLenum dfactor) {
+    state_shadow_blend_func(sfactor, dfactor, sfactor, dfactor);
+}
+
+void prismgl_glBlendFuncSeparate_wrapper(GLenum src_rgb, GLenum dst_rgb,
+                                         GLenum src_alpha, GLenum dst_alpha) {
+    state_shadow_blend_func(src_rgb, dst_rgb, src_alpha, dst_alpha);
+}
+
+void prismgl_glDepthMask_wrapper(GLboolean flag) {
+    state_shadow_depth_mask(flag);
+}
+
+void prismgl_glBindFramebuffer_wrapper(GLenum target, GLuint framebuffer) {
+    state_shadow_bind_framebuffer(target, framebuffer);
+}
+
+/* Staged uploads into an attached texture must land before these */
+void prismgl_glClear_wrapper(GLbitfield mask) {
+    texture_batch_flush();
+    glClear(mask);
+}
+
+void prismgl_glBlitFramebuffer_wrapper(GLint src_x0, GLint src_y0, GLint src_x1, GLint src_y1,
+                                       GLint dst_x0, GLint dst_y0, GLint dst_x1, GLint dst_y1,
+                                       GLbitfield mask, GLenum filter) {
+    texture_batch_flush();
+    glBlitFramebuffer(src_x0, src_y0, src_x1, src_y1, dst_x0, dst_y0, dst_x1, dst_y1,
+                      mask, filter);
+}
+
+void prismgl_glReadPixels_wrapper(GLint x, GLint y, GLsizei width, GLsizei height,
+                                  GLenum format, GLenum type, void* pixels) {
+    texture_batch_flush();
+    glReadPixels(x, y, width, height, format, type, pixels);
+}
+
+/* A loader context signals others through these, so staged uploads go first */
+void prismgl_glFlush_wrapper(void) {
+    texture_batch_flush();
+    glFlush();
+}
+
+void prismgl_glFinish_wrapper(void) {
+    texture_batch_flush();
+    glFinish();
+}
+
+GLsync prismgl_glFenceSync_wrapper(GLenum condition, GLbitfield flags) {
+    texture_batch_flush();
+    return glFenceSync(condition, flags);
+}
+
+/* Recorded so a texture recreated under its name is attached again */
+void prismgl_glFramebufferTexture2D_wrapper(GLenum target, GLenum attachment, GLenum textarget,
+                                            GLuint texture, GLint level) {
+    state_shadow_framebuffer_texture_2d(target, attachment, textarget, texture, level);
+}
+
+void prismgl_glFramebufferTextureLayer_wrapper(GLenum target, GLenum attachment,
+                                               GLuint texture, GLint level, GLint layer) {
+    state_shadow_framebuffer_texture_layer(target, attachment, texture, level, layer);
+}
+
+void prismgl_glDeleteFramebuffers_wrapper(GLsizei n, const GLuint* framebuffers) {
+    state_shadow_delete_framebuffers(n, framebuffers);
+}
+
+void prismgl_glViewport_wrapper(GLint x, GLint y, GLsizei width, GLsizei height) {
+    state_shadow_viewport(x, y, width, height);
+}
+
+void prismgl_glScissor_wrapper(GLint x, GLint y, GLsizei width, GLsizei height) {
+    state_shadow_scissor(x, y, width, height);
 }
 
 /* ===== glEnable/glDisable wrappers ===== */
 
 void prismgl_glEnable_wrapper(GLenum cap) {
+    if (display_list_record_enum(DL_CMD_ENABLE, cap)) return;
     switch (cap) {
         case GL_DEPTH_CLAMP:
-            g_depth_clamp_enabled = true;
+            wrapper_state()->depth_clamp_enabled = true;
             LOGI("Depth clamp enabled (emulated)");
             return;
         case GL_TEXTURE_CUBE_MAP_SEAMLESS:
@@ -420,15 +1200,17 @@ void prismgl_glEnable_wrapper(GLenum cap) {
             /* No 1D textures in ES */
             return;
         default:
-            glEnable(cap);
+            if (!state_shadow_key_has_cap(cap)) draw_batch_invalidate();
+            state_shadow_enable(cap, true);
             return;
     }
 }
 
 void prismgl_glDisable_wrapper(GLenum cap) {
+    if (display_list_record_enum(DL_CMD_DISABLE, cap)) return;
     switch (cap) {
         case GL_DEPTH_CLAMP:
-            g_depth_clamp_enabled = false;
+            wrapper_state()->depth_clamp_enabled = false;
             return;
         case GL_TEXTURE_CUBE_MAP_SEAMLESS:
         case GL_PROGRAM_POINT_SIZE:
@@ -440,7 +1222,8 @@ void prismgl_glDisable_wrapper(GLenum cap) {
         case GL_TEXTURE_1D:
             return;
         default:
-            glDisable(cap);
+            if (!state_shadow_key_has_cap(cap)) draw_batch_invalidate();
+            state_shadow_enable(cap, false);
             return;
     }
 }
@@ -454,21 +1237,102 @@ void prismgl_glGetIntegerv_wrapper(GLenum pname, GLint* params) {
             *params = 8;
             return;
         case GL_POLYGON_MODE:
-            *params = (GLint)g_polygon_mode;
+            *params = (GLint)wrapper_state()->polygon_mode;
             return;
         case GL_PROVOKING_VERTEX:
-            *params = (GLint)g_provoking_vertex;
+            *params = (GLint)wrapper_state()->provoking_vertex;
+            return;
+        case GL_MATRIX_MODE:
+            *params = (GLint)matrix_stack_get_mode();
+            return;
+        case GL_GPU_DISJOINT_EXT:
+            *params = gpu_timer_disjoint();
             return;
         default:
-            glGetIntegerv(pname, params);
+            /* Limits were captured at init, bindings come from the shadow */
+            if (gpu_get_limit(pname, params)) return;
+            state_shadow_get_integerv(pname, params);
             return;
     }
 }
 
+void prismgl_glGetBooleanv_wrapper(GLenum pname, GLboolean* params) {
+    if (!params) return;
+    switch (pname) {
+        case GL_DEPTH_CLAMP:
+            *params = wrapper_state()->depth_clamp_enabled ? GL_TRUE : GL_FALSE;
+            return;
+        case GL_DEPTH_WRITEMASK:
+        case GL_BLEND:
+        case GL_CULL_FACE:
+        case GL_DEPTH_TEST:
+        case GL_SCISSOR_TEST:
+        case GL_STENCIL_TEST:
+        case GL_POLYGON_OFFSET_FILL: {
+            GLint value = 0;
+            state_shadow_get_integerv(pname, &value);
+            *params = value ? GL_TRUE : GL_FALSE;
+            return;
+        }
+        default:
+            glGetBooleanv(pname, params);
+            return;
+    }
+}
+
+void prismgl_glGetInteger64v_wrapper(GLenum pname, GLint64* params) {
+    if (!params) return;
+    if (pname == GL_GPU_DISJOINT_EXT) {
+        /* Reading the flag clears it; PrismGL keeps the ones it consumed */
+        *params = gpu_timer_disjoint();
+        return;
+    }
+    glGetInteger64v(pname, params);
+}
+
+GLboolean prismgl_glIsEnabled_wrapper(GLenum cap) {
+    switch (cap) {
+        case GL_DEPTH_CLAMP:
+            return wrapper_state()->depth_clamp_enabled ? GL_TRUE : GL_FALSE;
+        case GL_TEXTURE_CUBE_MAP_SEAMLESS:
+        case GL_PROGRAM_POINT_SIZE:
+        case GL_POINT_SPRITE:
+            /* Always on in ES */
+            return GL_TRUE;
+        case GL_CLIP_DISTANCE0:
+        case GL_CLIP_DISTANCE1:
+        case GL_CLIP_DISTANCE2:
+        case GL_CLIP_DISTANCE3:
+        case GL_TEXTURE_1D:
+            return GL_FALSE;
+        default:
+            return state_shadow_is_enabled(cap);
+    }
+}
+
 void prismgl_glGetFloatv_wrapper(GLenum pname, GLfloat* params) {
     if (!params) return;
-    /* Pass through to GLES for most */
-    glGetFloatv(pname, params);
+    switch (pname) {
+        case GL_MODELVIEW_MATRIX:
+            memcpy(params, matrix_stack_top(GL_MODELVIEW), 16 * sizeof(GLfloat));
+            return;
+        case GL_PROJECTION_MATRIX:
+            memcpy(params, matrix_stack_top(GL_PROJECTION), 16 * sizeof(GLfloat));
+            return;
+        case GL_TEXTURE_MATRIX:
+            memcpy(params, matrix_stack_top(GL_TEXTURE), 16 * sizeof(GLfloat));
+            return;
+        case GL_VIEWPORT: {
+            GLint vp[4];
+            state_shadow_get_integerv(GL_VIEWPORT, vp);
+            for (int i = 0; i < 4; i++) params[i] = (GLfloat)vp[i];
+            return;
+        }
+        default:
+            /* Pass through to GLES for most */
+            glGetFloatv(pname, params);
+            return;
+    }
 }
 
 const GLubyte* prismgl_glGetString_wrapper(GLenum name) {
@@ -550,34 +1414,37 @@ void prismgl_glGenQueries(GLsizei n, GLuint* ids) {
 }
 
 void prismgl_glDeleteQueries(GLsizei n, const GLuint* ids) {
+    occlusion_query_delete(n, ids);
     glDeleteQueries(n, ids);
 }
 
 void prismgl_glBeginQuery_wrapper(GLenum target, GLuint id) {
-    /* Map desktop query targets to ES equivalents */
-    if (target == GL_SAMPLES_PASSED) {
-        target = GL_ANY_SAMPLES_PASSED;
-    } else if (target == GL_PRIMITIVES_GENERATED) {
-        /* Not supported in ES, use any_samples as fallback */
-        LOGW("GL_PRIMITIVES_GENERATED not supported, using ANY_SAMPLES_PASSED");
-        target = GL_ANY_SAMPLES_PASSED;
-    } else if (target == GL_TIME_ELAPSED) {
+    /* Batched draws must land on their side of the query */
+    draw_batch_invalidate();
+    if (target == GL_TIME_ELAPSED) {
         /* Timer queries need EXT_disjoint_timer_query */
-        LOGW("GL_TIME_ELAPSED query - may not be supported");
+        gpu_timer_begin_elapsed(id);
     }
+    /* Occlusion and primitive queries are emulated, see occlusion_query.h */
+    if (occlusion_query_begin(target, id)) return;
+    if (target == GL_SAMPLES_PASSED) target = GL_ANY_SAMPLES_PASSED;
     glBeginQuery(target, id);
 }
 
 void prismgl_glEndQuery_wrapper(GLenum target) {
-    if (target == GL_SAMPLES_PASSED) {
-        target = GL_ANY_SAMPLES_PASSED;
-    } else if (target == GL_PRIMITIVES_GENERATED) {
-        target = GL_ANY_SAMPLES_PASSED;
-    }
+    draw_batch_invalidate();
+    if (target == GL_TIME_ELAPSED) gpu_timer_end_elapsed();
+    if (occlusion_query_end(target)) return;
+    if (target == GL_SAMPLES_PASSED) target = GL_ANY_SAMPLES_PASSED;
     glEndQuery(target);
 }
 
 void prismgl_glGetQueryObjectuiv_wrapper(GLuint id, GLenum pname, GLuint* params) {
+    GLuint64 value = 0;
+    if (occlusion_query_result(id, pname, &value)) {
+        *params = (GLuint)value;
+        return;
+    }
     if (pname == GL_QUERY_RESULT_NO_WAIT) {
         /* ES doesn't have NO_WAIT, try GL_QUERY_RESULT_AVAILABLE first */
         GLuint avail = 0;
@@ -592,28 +1459,23 @@ void prismgl_glGetQueryObjectuiv_wrapper(GLuint id, GLenum pname, GLuint* params
     glGetQueryObjectuiv(id, pname, params);
 }
 
+/* 64-bit results come from EXT_disjoint_timer_query, see gpu_timer.h */
 void prismgl_glGetQueryObjecti64v(GLuint id, GLenum pname, GLint64* params) {
-    /* Timer query results - stub with zero if unsupported */
     if (params) {
-        GLuint val = 0;
-        glGetQueryObjectuiv(id, pname == GL_QUERY_RESULT_NO_WAIT ? GL_QUERY_RESULT : pname, &val);
+        GLuint64 val = 0;
+        prismgl_glGetQueryObjectui64v(id, pname, &val);
         *params = (GLint64)val;
     }
 }
 
 void prismgl_glGetQueryObjectui64v(GLuint id, GLenum pname, GLuint64* params) {
-    if (params) {
-        GLuint val = 0;
-        glGetQueryObjectuiv(id, pname == GL_QUERY_RESULT_NO_WAIT ? GL_QUERY_RESULT : pname, &val);
-        *params = (GLuint64)val;
-    }
+    if (!params) return;
+    if (occlusion_query_result(id, pname, params)) return;
+    gpu_timer_get_result(id, pname, params);
 }
 
 void prismgl_glQueryCounter(GLuint id, GLenum target) {
-    /* GL_TIMESTAMP query counter - not available in base ES */
-    (void)id;
-    (void)target;
-    LOGW("glQueryCounter (GL_TIMESTAMP) not supported in ES");
+    gpu_timer_query_counter(id, target);
 }
 
 /* ===== Adaptive Resolution ===== */
@@ -628,6 +1490,10 @@ float prismgl_get_resolution_scale(void) {
     return g_resolution_scale;
 }
 
+float prismgl_get_gpu_frame_time(void) {
+    return gpu_timer_frame_ms();
+}
+
 void prismgl_update_adaptive_resolution(float current_fps, float target_fps) {
     g_fps_history[g_fps_history_index] = current_fps;
     g_fps_history_index = (g_fps_history_index + 1) % 60;
@@ -638,7 +1504,12 @@ void prismgl_update_adaptive_resolution(float current_fps, float target_fps) {
     }
     avg_fps /= 60.0f;
 
-    if (avg_fps < target_fps * 0.85f) {
+    /* Lowering the resolution only helps when the GPU is what falls behind */
+    float gpu_ms = gpu_timer_frame_ms();
+    bool gpu_bound = gpu_ms <= 0.0f || target_fps <= 0.0f ||
+                     gpu_ms > (1000.0f / target_fps) * 0.8f;
+
+    if (avg_fps < target_fps * 0.85f && gpu_bound) {
         g_resolution_scale -= 0.02f;
         if (g_resolution_scale < 0.25f) g_resolution_scale = 0.25f;
     } else if (avg_fps > target_fps * 1.1f && g_resolution_scale < 1.0f) {
@@ -647,65 +1518,11 @@ void prismgl_update_adaptive_resolution(float current_fps, float target_fps) {
     }
 }
 
-/* ===== Draw Call Batching ===== */
-
-#define MAX_BATCH_DRAWS 256
-
-typedef struct {
-    GLenum mode;
-    GLint first;
-    GLsizei count;
-} BatchDraw;
-
-static struct {
-    BatchDraw draws[MAX_BATCH_DRAWS];
-    int count;
-    bool active;
-} g_batch = { .active = false };
-
-void prismgl_batch_begin(void) {
-    g_batch.count = 0;
-    g_batch.active = true;
-}
-
-void prismgl_batch_flush(void) {
-    if (!g_batch.active || g_batch.count == 0) {
-        g_batch.active = false;
-        return;
-    }
-
-    for (int i = 0; i < g_batch.count; ) {
-        GLenum mode = g_batch.draws[i].mode;
-        GLint first = g_batch.draws[i].first;
-        GLsizei total_count = g_batch.draws[i].count;
-
-        int j = i + 1;
-        while (j < g_batch.count &&
-               g_batch.draws[j].mode == mode &&
-               g_batch.draws[j].first == first + total_count) {
-            total_count += g_batch.draws[j].count;
-            j++;
-        }
-
-        glDrawArrays(mode, first, total_count);
-        i = j;
-    }
-
-    g_batch.count = 0;
-    g_batch.active = false;
-}
-
-void prismgl_batch_draw(GLenum mode, GLint first, GLsizei count) {
-    if (!g_batch.active || g_batch.count >= MAX_BATCH_DRAWS) {
-        if (g_batch.active) prismgl_batch_flush();
-        glDrawArrays(mode, first, count);
-        return;
-    }
+/* ===== Frame boundary ===== */
 
-    g_batch.draws[g_batch.count].mode = mode;
-    g_batch.draws[g_batch.count].first = first;
-    g_batch.draws[g_batch.count].count = count;
-    g_batch.count++;
+EGLBoolean prismgl_eglSwapBuffers(EGLDisplay display, EGLSurface surface) {
+    prismgl_frame_end();
+    return eglSwapBuffers(display, surface);
 }
 
 /* ===== Shader Translation Wrapper ===== */
@@ -725,9 +1542,14 @@ const char* prismgl_translate_shader(const char* source, GLenum type) {
 void prismgl_async_texture_load(const void* data, int width, int height,
                                  GLenum format, prismgl_texture_callback cb,
                                  void* userdata) {
+    if (prismgl_get_config()->async_texture_loading &&
+        texture_upload_submit(data, width, height, format, cb, userdata)) {
+        return;
+    }
+
     GLuint tex;
     glGenTextures(1, &tex);
-    glBindTexture(GL_TEXTURE_2D, tex);
+    state_shadow_bind_texture(GL_TEXTURE_2D, tex);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
@@ -741,8 +1563,18 @@ void prismgl_async_texture_load(const void* data, int width, int height,
     glTexImage2D(GL_TEXTURE_2D, 0, (GLint)gl_format, width, height, 0,
                  gl_format, gl_type, data);
     glGenerateMipmap(GL_TEXTURE_2D);
+    texture_registry_define(tex, GL_TEXTURE_2D, 0, gl_format, width, height, 1);
+    texture_registry_generate_mipmaps(tex);
 
     if (cb) {
         cb(tex, userdata);
     }
 }
+
+/* ===== Texture Readback ===== */
+
+bool prismgl_get_tex_image_async(GLenum target, GLint level, GLenum format, GLenum type,
+                                 prismgl_readback_callback cb, void* userdata) {
+    texture_batch_flush();
+    return texture_readback_async(target, level, format, type, cb, userdata);
+}
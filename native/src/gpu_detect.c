@@ -6,6 +6,8 @@
 #include "gpu_detect.h"
 
 #include <GLES3/gl32.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include <android/log.h>
 
@@ -16,6 +18,39 @@
 static GPUInfo g_gpu_info;
 static bool g_detected = false;
 
+/* Limits captured once in gpu_detect() and served by gpu_get_limit() */
+typedef struct {
+    GLenum pname;
+    size_t offset;
+    int count;
+} GPULimit;
+
+static const GPULimit g_limits[] = {
+    { GL_MAX_TEXTURE_SIZE,                  offsetof(GPUInfo, max_texture_size), 1 },
+    { GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS,  offsetof(GPUInfo, max_texture_units), 1 },
+    { GL_MAX_VERTEX_ATTRIBS,                offsetof(GPUInfo, max_vertex_attribs), 1 },
+    { GL_MAX_VERTEX_UNIFORM_COMPONENTS,     offsetof(GPUInfo, max_uniform_components), 1 },
+    { GL_MAX_TEXTURE_IMAGE_UNITS,           offsetof(GPUInfo, max_fragment_texture_units), 1 },
+    { GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS,    offsetof(GPUInfo, max_vertex_texture_units), 1 },
+    { GL_MAX_FRAGMENT_UNIFORM_COMPONENTS,   offsetof(GPUInfo, max_fragment_uniform_components), 1 },
+    { GL_MAX_VARYING_VECTORS,               offsetof(GPUInfo, max_varying_vectors), 1 },
+    { GL_MAX_3D_TEXTURE_SIZE,               offsetof(GPUInfo, max_3d_texture_size), 1 },
+    { GL_MAX_CUBE_MAP_TEXTURE_SIZE,         offsetof(GPUInfo, max_cube_map_texture_size), 1 },
+    { GL_MAX_ARRAY_TEXTURE_LAYERS,          offsetof(GPUInfo, max_array_texture_layers), 1 },
+    { GL_MAX_RENDERBUFFER_SIZE,             offsetof(GPUInfo, max_renderbuffer_size), 1 },
+    { GL_MAX_VIEWPORT_DIMS,                 offsetof(GPUInfo, max_viewport_dims), 2 },
+    { GL_MAX_DRAW_BUFFERS,                  offsetof(GPUInfo, max_draw_buffers), 1 },
+    { GL_MAX_COLOR_ATTACHMENTS,             offsetof(GPUInfo, max_color_attachments), 1 },
+    { GL_MAX_SAMPLES,                       offsetof(GPUInfo, max_samples), 1 },
+    { GL_MAX_UNIFORM_BUFFER_BINDINGS,       offsetof(GPUInfo, max_uniform_buffer_bindings), 1 },
+    { GL_MAX_UNIFORM_BLOCK_SIZE,            offsetof(GPUInfo, max_uniform_block_size), 1 },
+    { GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT,   offsetof(GPUInfo, uniform_buffer_offset_alignment), 1 },
+    { GL_MAX_ELEMENTS_VERTICES,             offsetof(GPUInfo, max_elements_vertices), 1 },
+    { GL_MAX_ELEMENTS_INDICES,              offsetof(GPUInfo, max_elements_indices), 1 },
+};
+
+#define GPU_LIMIT_COUNT (sizeof(g_limits) / sizeof(g_limits[0]))
+
 static bool check_extension(const char* extensions, const char* ext) {
     if (!extensions || !ext) return false;
     size_t ext_len = strlen(ext);
@@ -130,11 +165,10 @@ GPUInfo gpu_detect(void) {
         else if (strstr(vendor, "ARM")) g_gpu_info.vendor = GPU_VENDOR_ARM_MALI;
     }
 
-    /* Query capabilities */
-    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &g_gpu_info.max_texture_size);
-    glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &g_gpu_info.max_texture_units);
-    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &g_gpu_info.max_vertex_attribs);
-    glGetIntegerv(GL_MAX_VERTEX_UNIFORM_COMPONENTS, &g_gpu_info.max_uniform_components);
+    /* Query capabilities once; later glGet calls for them are served from here */
+    for (size_t i = 0; i < GPU_LIMIT_COUNT; i++) {
+        glGetIntegerv(g_limits[i].pname, (GLint*)((char*)&g_gpu_info + g_limits[i].offset));
+    }
 
     /* Parse GL version */
     if (version) {
@@ -150,6 +184,8 @@ GPUInfo gpu_detect(void) {
     g_gpu_info.supports_astc = gpu_has_extension("GL_KHR_texture_compression_astc_ldr");
     g_gpu_info.supports_etc2 = true; /* Mandatory in ES 3.0+ */
     g_gpu_info.supports_pvrtc = gpu_has_extension("GL_IMG_texture_compression_pvrtc");
+    g_gpu_info.supports_multi_draw = gpu_has_extension("GL_EXT_multi_draw_arrays");
+    g_gpu_info.supports_multi_draw_indirect = gpu_has_extension("GL_EXT_multi_draw_indirect");
 
     /* Set recommended resolution scale */
     g_gpu_info.recommended_resolution_scale = gpu_get_recommended_scale(&g_gpu_info);
@@ -168,6 +204,19 @@ GPUInfo gpu_detect(void) {
     return g_gpu_info;
 }
 
+bool gpu_get_limit(unsigned int pname, int* params) {
+    if (!g_detected) return false;
+
+    for (size_t i = 0; i < GPU_LIMIT_COUNT; i++) {
+        if (g_limits[i].pname == pname) {
+            const int* values = (const int*)((const char*)&g_gpu_info + g_limits[i].offset);
+            for (int v = 0; v < g_limits[i].count; v++) params[v] = values[v];
+            return true;
+        }
+    }
+    return false;
+}
+
 float gpu_get_recommended_scale(const GPUInfo* info) {
     switch (info->tier) {
         case GPU_TIER_ULTRA: return 1.0f;
@@ -0,0 +1,239 @@
+/*
+ * PrismGL GPU Timer
+ * ES has no timer queries of its own; EXT_disjoint_timer_query adds
+ * GL_TIME_ELAPSED, GL_TIMESTAMP counters and 64-bit results, which is all
+ * the desktop ARB_timer_query profilers of Sodium and Iris need. Without
+ * 64-bit reads a GL_TIME_ELAPSED result wraps after about 4 seconds.
+ *
+ * The extension adds GL_GPU_DISJOINT: the GPU changed frequency, lost its
+ * context or otherwise broke the timeline, and results of queries in
+ * flight are meaningless. Desktop applications never ask, so PrismGL polls
+ * the flag whenever a timer query is issued or read. Each poll that finds
+ * it set starts a new epoch, and elapsed times from queries issued in an
+ * older epoch read as 0. The application can still query the flag itself;
+ * it then sees every disjoint since its last check, including the ones
+ * PrismGL consumed.
+ *
+ * Each frame is also bracketed with a GL_TIME_ELAPSED query of PrismGL's
+ * own, read a few frames later without waiting, to give adaptive
+ * resolution the GPU's share of the frame time. Only one elapsed query can
+ * be active, so an application query ends the frame's query early and that
+ * frame is not counted.
+ */
+
+#include "gpu_timer.h"
+#include "gpu_detect.h"
+#include "context.h"
+#include "prismgl.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+#include <string.h>
+#include <stdlib.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Timer"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define TIMER_QUERY_SLOTS   256         /* Power of two, indexed by query id */
+#define TIMER_FRAME_QUERIES 4           /* Frames in flight before one is dropped */
+#define TIMER_SMOOTHING     0.1f
+
+typedef struct {
+    GLuint id;
+    uint32_t epoch;
+    bool elapsed;                       /* GL_TIME_ELAPSED, not a timestamp */
+} TimerQuery;
+
+typedef struct {
+    GLuint id;
+    uint32_t epoch;
+    bool valid;                         /* Spanned the whole frame */
+} FrameQuery;
+
+typedef struct {
+    uint32_t epoch;                     /* Disjoint operations seen so far */
+    bool disjoint_unreported;           /* Seen by PrismGL, not yet by the application */
+    bool app_elapsed;                   /* Application GL_TIME_ELAPSED query active */
+    TimerQuery queries[TIMER_QUERY_SLOTS];
+    FrameQuery frames[TIMER_FRAME_QUERIES];
+    int frame_head;                     /* Oldest frame query in flight */
+    int frame_pending;
+    bool frame_active;
+    float frame_ms;
+} TimerState;
+
+static struct {
+    PFNGLQUERYCOUNTEREXTPROC query_counter;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC get_ui64;
+    bool supported;
+    bool warned;
+} g;
+
+/* Smoothed frame time of the last context to present, for JNI readers */
+static float g_frame_ms;
+
+static inline TimerState* timer_state(void) {
+    return (TimerState*)prismgl_context_state(PRISMGL_STATE_TIMER);
+}
+
+void gpu_timer_init(void) {
+    memset(&g, 0, sizeof(g));
+    if (gpu_has_extension("GL_EXT_disjoint_timer_query")) {
+        g.query_counter = (PFNGLQUERYCOUNTEREXTPROC)eglGetProcAddress("glQueryCounterEXT");
+        g.get_ui64 = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+    }
+    g.supported = g.query_counter && g.get_ui64;
+    LOGI("Timer queries: %s", g.supported ? "EXT_disjoint_timer_query" : "unsupported");
+}
+
+void* gpu_timer_create_state(void) {
+    return calloc(1, sizeof(TimerState));
+}
+
+void gpu_timer_destroy_state(void* state) {
+    /* The query objects go with the context */
+    free(state);
+}
+
+static void warn_unsupported(const char* what) {
+    if (g.warned) return;
+    g.warned = true;
+    LOGW("%s needs EXT_disjoint_timer_query, which this driver lacks", what);
+}
+
+/* ===== Disjoint tracking ===== */
+
+static void poll_disjoint(TimerState* s) {
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (disjoint) {
+        s->epoch++;
+        s->disjoint_unreported = true;
+    }
+}
+
+static void track(TimerState* s, GLuint id, bool elapsed) {
+    poll_disjoint(s);
+    TimerQuery* q = &s->queries[id & (TIMER_QUERY_SLOTS - 1)];
+    q->id = id;
+    q->epoch = s->epoch;
+    q->elapsed = elapsed;
+}
+
+bool gpu_timer_disjoint(void) {
+    if (!g.supported) return false;
+    TimerState* s = timer_state();
+    poll_disjoint(s);
+    bool disjoint = s->disjoint_unreported;
+    s->disjoint_unreported = false;
+    return disjoint;
+}
+
+/* ===== Application queries ===== */
+
+static void end_frame_query(TimerState* s, bool valid);
+
+void gpu_timer_begin_elapsed(GLuint id) {
+    if (!g.supported) {
+        warn_unsupported("GL_TIME_ELAPSED");
+        return;
+    }
+    TimerState* s = timer_state();
+    if (s->frame_active) end_frame_query(s, false);
+    s->app_elapsed = true;
+    track(s, id, true);
+}
+
+void gpu_timer_end_elapsed(void) {
+    if (g.supported) timer_state()->app_elapsed = false;
+}
+
+void gpu_timer_query_counter(GLuint id, GLenum target) {
+    if (!g.supported || target != GL_TIMESTAMP) {
+        warn_unsupported("glQueryCounter");
+        return;
+    }
+    track(timer_state(), id, false);
+    g.query_counter(id, GL_TIMESTAMP_EXT);
+}
+
+void gpu_timer_get_result(GLuint id, GLenum pname, GLuint64* params) {
+    /* ES has no NO_WAIT; an unavailable result reads as 0 like the 32-bit path */
+    if (pname == GL_QUERY_RESULT_NO_WAIT || pname == GL_QUERY_RESULT_AVAILABLE) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (pname == GL_QUERY_RESULT_AVAILABLE || !available) {
+            *params = available;
+            return;
+        }
+    }
+
+    if (!g.supported) {
+        GLuint value = 0;
+        glGetQueryObjectuiv(id, GL_QUERY_RESULT, &value);
+        *params = value;
+        return;
+    }
+
+    g.get_ui64(id, GL_QUERY_RESULT, params);
+    TimerState* s = timer_state();
+    poll_disjoint(s);
+    const TimerQuery* q = &s->queries[id & (TIMER_QUERY_SLOTS - 1)];
+    if (q->id == id && q->elapsed && q->epoch != s->epoch) *params = 0;
+}
+
+/* ===== Frame time ===== */
+
+static void end_frame_query(TimerState* s, bool valid) {
+    glEndQuery(GL_TIME_ELAPSED_EXT);
+    s->frame_active = false;
+    FrameQuery* f = &s->frames[(s->frame_head + s->frame_pending) % TIMER_FRAME_QUERIES];
+    f->valid = valid;
+    s->frame_pending++;
+}
+
+/* Take results that are ready, oldest first, without waiting */
+static void collect_frames(TimerState* s) {
+    while (s->frame_pending > 0) {
+        FrameQuery* f = &s->frames[s->frame_head];
+        GLuint available = 0;
+        glGetQueryObjectuiv(f->id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+
+        GLuint64 ns = 0;
+        g.get_ui64(f->id, GL_QUERY_RESULT, &ns);
+        if (f->valid && f->epoch == s->epoch) {
+            float ms = (float)((double)ns / 1.0e6);
+            s->frame_ms = s->frame_ms > 0.0f
+                ? s->frame_ms + (ms - s->frame_ms) * TIMER_SMOOTHING
+                : ms;
+        }
+        s->frame_head = (s->frame_head + 1) % TIMER_FRAME_QUERIES;
+        s->frame_pending--;
+    }
+}
+
+void gpu_timer_frame_end(void) {
+    if (!g.supported) return;
+    TimerState* s = timer_state();
+
+    poll_disjoint(s);
+    if (s->frame_active) end_frame_query(s, true);
+    collect_frames(s);
+
+    if (prismgl_get_config()->adaptive_resolution && !s->app_elapsed &&
+        s->frame_pending < TIMER_FRAME_QUERIES) {
+        FrameQuery* f = &s->frames[(s->frame_head + s->frame_pending) % TIMER_FRAME_QUERIES];
+        if (f->id == 0) glGenQueries(1, &f->id);
+        f->epoch = s->epoch;
+        glBeginQuery(GL_TIME_ELAPSED_EXT, f->id);
+        s->frame_active = true;
+    }
+    g_frame_ms = s->frame_ms;
+}
+
+float gpu_timer_frame_ms(void) {
+    return g_frame_ms;
+}
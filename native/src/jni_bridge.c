@@ -72,6 +72,62 @@ Java_com_prismgl_renderer_PrismGLNative_nativeSetConfig(JNIEnv* env, jclass claz
     config->resolution_scale = resScale;
 }
 
+JNIEXPORT void JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeSetThreadedDispatch(JNIEnv* env, jclass clazz,
+    jboolean enabled) {
+    (void)env;
+    (void)clazz;
+    prismgl_get_config()->threaded_dispatch = enabled;
+}
+
+JNIEXPORT void JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeSetAutoInstancing(JNIEnv* env, jclass clazz,
+    jboolean enabled) {
+    (void)env;
+    (void)clazz;
+    prismgl_get_config()->auto_instancing = enabled;
+}
+
+JNIEXPORT void JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeSetTextureCompression(JNIEnv* env, jclass clazz,
+    jboolean enabled) {
+    (void)env;
+    (void)clazz;
+    prismgl_get_config()->texture_compression = enabled;
+}
+
+JNIEXPORT void JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeSetImmutableTextures(JNIEnv* env, jclass clazz,
+    jboolean enabled) {
+    (void)env;
+    (void)clazz;
+    prismgl_get_config()->immutable_textures = enabled;
+}
+
+JNIEXPORT void JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeSetTextureUploadBatching(JNIEnv* env, jclass clazz,
+    jboolean enabled) {
+    (void)env;
+    (void)clazz;
+    prismgl_get_config()->texture_upload_batching = enabled;
+}
+
+JNIEXPORT void JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeSetTextureBudget(JNIEnv* env, jclass clazz,
+    jint megabytes) {
+    (void)env;
+    (void)clazz;
+    prismgl_get_config()->texture_budget_mb = megabytes;
+}
+
+JNIEXPORT void JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeSetOcclusionQueryLatency(JNIEnv* env, jclass clazz,
+    jint frames) {
+    (void)env;
+    (void)clazz;
+    prismgl_get_config()->occlusion_query_latency = frames;
+}
+
 JNIEXPORT jlong JNICALL
 Java_com_prismgl_renderer_PrismGLNative_nativeGetProcAddress(JNIEnv* env, jclass clazz, jstring name) {
     const char* func_name = (*env)->GetStringUTFChars(env, name, NULL);
@@ -79,3 +135,101 @@ Java_com_prismgl_renderer_PrismGLNative_nativeGetProcAddress(JNIEnv* env, jclass
     (*env)->ReleaseStringUTFChars(env, name, func_name);
     return (jlong)(intptr_t)addr;
 }
+
+JNIEXPORT void JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeFrameEnd(JNIEnv* env, jclass clazz) {
+    (void)env;
+    (void)clazz;
+    prismgl_frame_end();
+}
+
+JNIEXPORT jintArray JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeGetStateStats(JNIEnv* env, jclass clazz) {
+    (void)clazz;
+    uint32_t filtered = 0, forwarded = 0;
+    prismgl_get_state_stats(&filtered, &forwarded);
+
+    jint values[2] = { (jint)filtered, (jint)forwarded };
+    jintArray result = (*env)->NewIntArray(env, 2);
+    if (result) {
+        (*env)->SetIntArrayRegion(env, result, 0, 2, values);
+    }
+    return result;
+}
+
+JNIEXPORT jintArray JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeGetBatchStats(JNIEnv* env, jclass clazz) {
+    (void)clazz;
+    uint32_t draws_in = 0, draws_out = 0;
+    prismgl_get_batch_stats(&draws_in, &draws_out);
+
+    jint values[2] = { (jint)draws_in, (jint)draws_out };
+    jintArray result = (*env)->NewIntArray(env, 2);
+    if (result) {
+        (*env)->SetIntArrayRegion(env, result, 0, 2, values);
+    }
+    return result;
+}
+
+JNIEXPORT jintArray JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeGetJobStats(JNIEnv* env, jclass clazz) {
+    (void)clazz;
+    uint32_t completed = 0, pending = 0;
+    prismgl_get_job_stats(&completed, &pending);
+
+    jint values[2] = { (jint)completed, (jint)pending };
+    jintArray result = (*env)->NewIntArray(env, 2);
+    if (result) {
+        (*env)->SetIntArrayRegion(env, result, 0, 2, values);
+    }
+    return result;
+}
+
+JNIEXPORT jintArray JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeGetInstanceStats(JNIEnv* env, jclass clazz) {
+    (void)clazz;
+    uint32_t draws_in = 0, draws_out = 0;
+    prismgl_get_instance_stats(&draws_in, &draws_out);
+
+    jint values[2] = { (jint)draws_in, (jint)draws_out };
+    jintArray result = (*env)->NewIntArray(env, 2);
+    if (result) {
+        (*env)->SetIntArrayRegion(env, result, 0, 2, values);
+    }
+    return result;
+}
+
+JNIEXPORT jfloat JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeGetGpuFrameTime(JNIEnv* env, jclass clazz) {
+    (void)env;
+    (void)clazz;
+    return prismgl_get_gpu_frame_time();
+}
+
+JNIEXPORT jintArray JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeGetTextureUploadStats(JNIEnv* env, jclass clazz) {
+    (void)clazz;
+    uint32_t uploads_in = 0, uploads_out = 0, bytes = 0;
+    prismgl_get_texture_upload_stats(&uploads_in, &uploads_out, &bytes);
+
+    jint values[3] = { (jint)uploads_in, (jint)uploads_out, (jint)bytes };
+    jintArray result = (*env)->NewIntArray(env, 3);
+    if (result) {
+        (*env)->SetIntArrayRegion(env, result, 0, 3, values);
+    }
+    return result;
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_com_prismgl_renderer_PrismGLNative_nativeGetTextureMemoryStats(JNIEnv* env, jclass clazz) {
+    (void)clazz;
+    size_t usage = 0, peak = 0, budget = 0;
+    prismgl_get_texture_memory(&usage, &peak, &budget);
+
+    jlong values[3] = { (jlong)usage, (jlong)peak, (jlong)budget };
+    jlongArray result = (*env)->NewLongArray(env, 3);
+    if (result) {
+        (*env)->SetLongArrayRegion(env, result, 0, 3, values);
+    }
+    return result;
+}
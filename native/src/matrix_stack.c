@@ -0,0 +1,446 @@
+/*
+ * PrismGL Matrix Stack
+ * Per-mode modelview/projection/texture stacks.
+ * Matrices are uploaded lazily: a change only bumps a serial, and the
+ * uniforms of the current program are refreshed at the next draw.
+ */
+
+#include "matrix_stack.h"
+#include "context.h"
+#include "draw_batch.h"
+#include "draw_instance.h"
+#include "prismgl_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Matrix"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define MAX_MODELVIEW_DEPTH  32
+#define MAX_PROJECTION_DEPTH 4
+#define MAX_TEXTURE_DEPTH    4
+#define PROGRAM_CACHE_INITIAL 64   /* Power of two */
+
+enum { STACK_MODELVIEW = 0, STACK_PROJECTION, STACK_TEXTURE, STACK_COUNT };
+enum { LOC_MODELVIEW = 0, LOC_PROJECTION, LOC_MVP, LOC_TEXTURE, LOC_NORMAL, LOC_COUNT };
+
+typedef struct {
+    GLfloat m[16];
+} Mat4;
+
+typedef struct {
+    Mat4 entries[MAX_MODELVIEW_DEPTH];
+    int depth;
+    int max_depth;
+    uint32_t serial;    /* Changes whenever the top matrix changes */
+} MatrixStack;
+
+typedef struct {
+    GLuint program;     /* 0 for an empty slot */
+    bool valid;
+    bool uses_matrices;
+    GLint loc[LOC_COUNT];
+    uint32_t uploaded[STACK_COUNT];
+} ProgramMatrices;
+
+/* Matrix state of one GL context */
+typedef struct {
+    MatrixStack stacks[STACK_COUNT];
+    int active;
+    uint32_t serial;
+
+    Mat4 mvp;
+    uint32_t mvp_serial[2];
+
+    GLuint current_program;
+    /* Open-addressed by program name, at most 3/4 full */
+    ProgramMatrices* programs;
+    uint32_t program_capacity;
+    uint32_t program_count;
+} MatrixState;
+
+static const GLfloat g_identity[16] = {
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f
+};
+
+/* ===== 4x4 kernels (column-major, out = a * b) ===== */
+/* Plain C: compilers vectorize these loops, and hand-written NEON/SSE2
+ * versions measured no faster. */
+
+static void mat4_multiply(GLfloat* out, const GLfloat* a, const GLfloat* b) {
+    GLfloat tmp[16];
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            tmp[j * 4 + i] = a[0 * 4 + i] * b[j * 4 + 0] +
+                             a[1 * 4 + i] * b[j * 4 + 1] +
+                             a[2 * 4 + i] * b[j * 4 + 2] +
+                             a[3 * 4 + i] * b[j * 4 + 3];
+        }
+    }
+    memcpy(out, tmp, sizeof(tmp));
+}
+
+/*
+ * m = m * R for a 3x3 rotation/linear part R (row-major r[row][col]).
+ * Only the first three columns change, so this is 9 multiply-adds per
+ * lane instead of a full 4x4 product.
+ */
+static void mat4_post_multiply3(GLfloat* m, const GLfloat r[3][3]) {
+    GLfloat c[12];
+    memcpy(c, m, sizeof(c));
+    for (int j = 0; j < 3; j++) {
+        for (int i = 0; i < 4; i++) {
+            m[j * 4 + i] = c[0 * 4 + i] * r[0][j] +
+                           c[1 * 4 + i] * r[1][j] +
+                           c[2 * 4 + i] * r[2][j];
+        }
+    }
+}
+
+/* m = m * T(x, y, z): only the last column changes */
+static void mat4_translate(GLfloat* m, GLfloat x, GLfloat y, GLfloat z) {
+    for (int i = 0; i < 4; i++) {
+        m[12 + i] += m[i] * x + m[4 + i] * y + m[8 + i] * z;
+    }
+}
+
+/* m = m * S(x, y, z) */
+static void mat4_scale(GLfloat* m, GLfloat x, GLfloat y, GLfloat z) {
+    for (int i = 0; i < 4; i++) {
+        m[0 + i] *= x;
+        m[4 + i] *= y;
+        m[8 + i] *= z;
+    }
+}
+
+/* ===== Stack helpers ===== */
+
+static inline MatrixState* matrix_state(void) {
+    return (MatrixState*)prismgl_context_state(PRISMGL_STATE_MATRICES);
+}
+
+void* matrix_stack_create_state(void) {
+    MatrixState* ms = (MatrixState*)calloc(1, sizeof(MatrixState));
+    if (!ms) return NULL;
+
+    ms->active = STACK_MODELVIEW;
+    ms->stacks[STACK_MODELVIEW].max_depth = MAX_MODELVIEW_DEPTH;
+    ms->stacks[STACK_PROJECTION].max_depth = MAX_PROJECTION_DEPTH;
+    ms->stacks[STACK_TEXTURE].max_depth = MAX_TEXTURE_DEPTH;
+    for (int i = 0; i < STACK_COUNT; i++) {
+        memcpy(ms->stacks[i].entries[0].m, g_identity, sizeof(g_identity));
+        ms->stacks[i].serial = ++ms->serial;
+    }
+    return ms;
+}
+
+void matrix_stack_destroy_state(void* state) {
+    MatrixState* ms = (MatrixState*)state;
+    if (!ms) return;
+    free(ms->programs);
+    free(ms);
+}
+
+static GLfloat* active_top(MatrixState* ms) {
+    MatrixStack* s = &ms->stacks[ms->active];
+    return s->entries[s->depth].m;
+}
+
+static void mark_changed(MatrixState* ms) {
+    ms->stacks[ms->active].serial = ++ms->serial;
+}
+
+static int stack_index(GLenum mode) {
+    switch (mode) {
+        case GL_MODELVIEW:  return STACK_MODELVIEW;
+        case GL_PROJECTION: return STACK_PROJECTION;
+        case GL_TEXTURE:    return STACK_TEXTURE;
+        default:            return -1;
+    }
+}
+
+/* ===== Stack operations ===== */
+
+void matrix_stack_set_mode(GLenum mode) {
+    MatrixState* ms = matrix_state();
+    int index = stack_index(mode);
+    if (index < 0) {
+        LOGW("glMatrixMode: unsupported mode 0x%x", mode);
+        return;
+    }
+    ms->active = index;
+}
+
+GLenum matrix_stack_get_mode(void) {
+    MatrixState* ms = matrix_state();
+    static const GLenum modes[STACK_COUNT] = { GL_MODELVIEW, GL_PROJECTION, GL_TEXTURE };
+    return modes[ms->active];
+}
+
+void matrix_stack_push(void) {
+    MatrixState* ms = matrix_state();
+    MatrixStack* s = &ms->stacks[ms->active];
+    if (s->depth + 1 >= s->max_depth) {
+        LOGW("glPushMatrix: stack overflow (mode 0x%x)", matrix_stack_get_mode());
+        return;
+    }
+    s->entries[s->depth + 1] = s->entries[s->depth];
+    s->depth++;
+    /* Top value is unchanged, so no upload is needed */
+}
+
+void matrix_stack_pop(void) {
+    MatrixState* ms = matrix_state();
+    MatrixStack* s = &ms->stacks[ms->active];
+    if (s->depth == 0) {
+        LOGW("glPopMatrix: stack underflow (mode 0x%x)", matrix_stack_get_mode());
+        return;
+    }
+    s->depth--;
+    mark_changed(ms);
+}
+
+void matrix_stack_load_identity(void) {
+    MatrixState* ms = matrix_state();
+    memcpy(active_top(ms), g_identity, sizeof(g_identity));
+    mark_changed(ms);
+}
+
+void matrix_stack_load(const GLfloat* m) {
+    MatrixState* ms = matrix_state();
+    if (!m) return;
+    memcpy(active_top(ms), m, 16 * sizeof(GLfloat));
+    mark_changed(ms);
+}
+
+void matrix_stack_mult(const GLfloat* m) {
+    MatrixState* ms = matrix_state();
+    if (!m) return;
+    GLfloat* top = active_top(ms);
+    mat4_multiply(top, top, m);
+    mark_changed(ms);
+}
+
+void matrix_stack_translate(GLfloat x, GLfloat y, GLfloat z) {
+    MatrixState* ms = matrix_state();
+    mat4_translate(active_top(ms), x, y, z);
+    mark_changed(ms);
+}
+
+void matrix_stack_rotate(GLfloat angle, GLfloat x, GLfloat y, GLfloat z) {
+    MatrixState* ms = matrix_state();
+    GLfloat len = sqrtf(x * x + y * y + z * z);
+    if (len == 0.0f) return;
+    x /= len; y /= len; z /= len;
+
+    GLfloat rad = angle * (float)(M_PI / 180.0);
+    GLfloat c = cosf(rad);
+    GLfloat s = sinf(rad);
+    GLfloat ic = 1.0f - c;
+
+    const GLfloat r[3][3] = {
+        { x * x * ic + c,     x * y * ic - z * s, x * z * ic + y * s },
+        { y * x * ic + z * s, y * y * ic + c,     y * z * ic - x * s },
+        { x * z * ic - y * s, y * z * ic + x * s, z * z * ic + c     }
+    };
+    mat4_post_multiply3(active_top(ms), r);
+    mark_changed(ms);
+}
+
+void matrix_stack_scale(GLfloat x, GLfloat y, GLfloat z) {
+    MatrixState* ms = matrix_state();
+    mat4_scale(active_top(ms), x, y, z);
+    mark_changed(ms);
+}
+
+void matrix_stack_ortho(GLfloat l, GLfloat r, GLfloat b, GLfloat t, GLfloat n, GLfloat f) {
+    MatrixState* ms = matrix_state();
+    if (l == r || b == t || n == f) return;
+    const GLfloat o[16] = {
+        2.0f / (r - l), 0.0f, 0.0f, 0.0f,
+        0.0f, 2.0f / (t - b), 0.0f, 0.0f,
+        0.0f, 0.0f, -2.0f / (f - n), 0.0f,
+        -(r + l) / (r - l), -(t + b) / (t - b), -(f + n) / (f - n), 1.0f
+    };
+    GLfloat* top = active_top(ms);
+    mat4_multiply(top, top, o);
+    mark_changed(ms);
+}
+
+void matrix_stack_frustum(GLfloat l, GLfloat r, GLfloat b, GLfloat t, GLfloat n, GLfloat f) {
+    MatrixState* ms = matrix_state();
+    if (l == r || b == t || n == f || n <= 0.0f || f <= 0.0f) return;
+    const GLfloat p[16] = {
+        2.0f * n / (r - l), 0.0f, 0.0f, 0.0f,
+        0.0f, 2.0f * n / (t - b), 0.0f, 0.0f,
+        (r + l) / (r - l), (t + b) / (t - b), -(f + n) / (f - n), -1.0f,
+        0.0f, 0.0f, -2.0f * f * n / (f - n), 0.0f
+    };
+    GLfloat* top = active_top(ms);
+    mat4_multiply(top, top, p);
+    mark_changed(ms);
+}
+
+static const GLfloat* stack_top(const MatrixState* ms, int index) {
+    return ms->stacks[index].entries[ms->stacks[index].depth].m;
+}
+
+const GLfloat* matrix_stack_top(GLenum mode) {
+    int index = stack_index(mode);
+    if (index < 0) return NULL;
+    return stack_top(matrix_state(), index);
+}
+
+/* ===== Lazy uniform upload ===== */
+
+/* Slot holding `program`, or the empty slot it would go in */
+static ProgramMatrices* program_slot(const MatrixState* ms, GLuint program) {
+    uint32_t mask = ms->program_capacity - 1;
+    for (uint32_t i = (program * 0x9E3779B1u) & mask;; i = (i + 1) & mask) {
+        ProgramMatrices* pm = &ms->programs[i];
+        if (pm->program == program || pm->program == 0) return pm;
+    }
+}
+
+static bool grow_programs(MatrixState* ms) {
+    uint32_t old_capacity = ms->program_capacity;
+    uint32_t capacity = old_capacity ? old_capacity * 2 : PROGRAM_CACHE_INITIAL;
+    ProgramMatrices* programs = (ProgramMatrices*)calloc(capacity, sizeof(ProgramMatrices));
+    if (!programs) {
+        LOGW("Out of memory growing the program matrix cache to %u", capacity);
+        return false;
+    }
+
+    ProgramMatrices* old = ms->programs;
+    ms->programs = programs;
+    ms->program_capacity = capacity;
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old[i].program != 0) *program_slot(ms, old[i].program) = old[i];
+    }
+    free(old);
+    return true;
+}
+
+static ProgramMatrices* lookup_program(MatrixState* ms, GLuint program) {
+    ProgramMatrices* pm = ms->programs ? program_slot(ms, program) : NULL;
+    if (pm && pm->valid) return pm;
+
+    if (!pm || pm->program == 0) {
+        if ((ms->program_count + 1) * 4 > ms->program_capacity * 3) {
+            if (!grow_programs(ms)) return NULL;
+            pm = program_slot(ms, program);
+        }
+        ms->program_count++;
+    }
+
+    /* First use, or relinked: query locations once for this program */
+    static const char* names[LOC_COUNT] = {
+        PRISMGL_UNIFORM_MODELVIEW, PRISMGL_UNIFORM_PROJECTION, PRISMGL_UNIFORM_MVP,
+        PRISMGL_UNIFORM_TEXTURE, PRISMGL_UNIFORM_NORMAL
+    };
+    pm->program = program;
+    pm->valid = true;
+    pm->uses_matrices = false;
+    for (int i = 0; i < LOC_COUNT; i++) {
+        pm->loc[i] = glGetUniformLocation(program, names[i]);
+        if (pm->loc[i] >= 0) pm->uses_matrices = true;
+    }
+    memset(pm->uploaded, 0, sizeof(pm->uploaded));
+    return pm;
+}
+
+void matrix_stack_use_program(GLuint program) {
+    MatrixState* ms = matrix_state();
+    ms->current_program = program;
+}
+
+void matrix_stack_program_linked(GLuint program) {
+    MatrixState* ms = matrix_state();
+    /* Relinking may move uniforms; forget the cached locations */
+    if (!ms->programs || program == 0) return;
+    ProgramMatrices* pm = program_slot(ms, program);
+    if (pm->program == program) pm->valid = false;
+}
+
+static const GLfloat* current_mvp(MatrixState* ms) {
+    uint32_t mv = ms->stacks[STACK_MODELVIEW].serial;
+    uint32_t p = ms->stacks[STACK_PROJECTION].serial;
+    if (ms->mvp_serial[0] != mv || ms->mvp_serial[1] != p) {
+        mat4_multiply(ms->mvp.m, stack_top(ms, STACK_PROJECTION), stack_top(ms, STACK_MODELVIEW));
+        ms->mvp_serial[0] = mv;
+        ms->mvp_serial[1] = p;
+    }
+    return ms->mvp.m;
+}
+
+/* Inverse transpose of the upper-left 3x3 of the modelview matrix */
+static void normal_matrix(GLfloat out[9], const GLfloat* m) {
+    GLfloat a = m[0], b = m[4], c = m[8];
+    GLfloat d = m[1], e = m[5], f = m[9];
+    GLfloat g = m[2], h = m[6], i = m[10];
+
+    GLfloat A = e * i - f * h;
+    GLfloat B = f * g - d * i;
+    GLfloat C = d * h - e * g;
+    GLfloat det = a * A + b * B + c * C;
+    GLfloat inv = det != 0.0f ? 1.0f / det : 0.0f;
+
+    /* Column-major inverse transpose == cofactor matrix / det */
+    out[0] = A * inv;
+    out[1] = B * inv;
+    out[2] = C * inv;
+    out[3] = (c * h - b * i) * inv;
+    out[4] = (a * i - c * g) * inv;
+    out[5] = (b * g - a * h) * inv;
+    out[6] = (b * f - c * e) * inv;
+    out[7] = (c * d - a * f) * inv;
+    out[8] = (a * e - b * d) * inv;
+}
+
+void matrix_stack_flush(void) {
+    MatrixState* ms = matrix_state();
+    if (ms->current_program == 0) return;
+
+    ProgramMatrices* pm = lookup_program(ms, ms->current_program);
+    if (!pm || !pm->uses_matrices) return;
+
+    uint32_t mv = ms->stacks[STACK_MODELVIEW].serial;
+    uint32_t p = ms->stacks[STACK_PROJECTION].serial;
+    uint32_t tex = ms->stacks[STACK_TEXTURE].serial;
+    bool mv_dirty = pm->uploaded[STACK_MODELVIEW] != mv;
+    bool p_dirty = pm->uploaded[STACK_PROJECTION] != p;
+    bool tex_dirty = pm->uploaded[STACK_TEXTURE] != tex;
+    if (!mv_dirty && !p_dirty && !tex_dirty) return;
+
+    /* Held and batched draws of this program must still see the old matrices */
+    draw_instance_flush();
+    draw_batch_uniforms_changed(ms->current_program);
+
+    if (mv_dirty && pm->loc[LOC_MODELVIEW] >= 0) {
+        glUniformMatrix4fv(pm->loc[LOC_MODELVIEW], 1, GL_FALSE, stack_top(ms, STACK_MODELVIEW));
+    }
+    if (mv_dirty && pm->loc[LOC_NORMAL] >= 0) {
+        GLfloat nm[9];
+        normal_matrix(nm, stack_top(ms, STACK_MODELVIEW));
+        glUniformMatrix3fv(pm->loc[LOC_NORMAL], 1, GL_FALSE, nm);
+    }
+    if (p_dirty && pm->loc[LOC_PROJECTION] >= 0) {
+        glUniformMatrix4fv(pm->loc[LOC_PROJECTION], 1, GL_FALSE, stack_top(ms, STACK_PROJECTION));
+    }
+    if ((mv_dirty || p_dirty) && pm->loc[LOC_MVP] >= 0) {
+        glUniformMatrix4fv(pm->loc[LOC_MVP], 1, GL_FALSE, current_mvp(ms));
+    }
+    if (tex_dirty && pm->loc[LOC_TEXTURE] >= 0) {
+        glUniformMatrix4fv(pm->loc[LOC_TEXTURE], 1, GL_FALSE, stack_top(ms, STACK_TEXTURE));
+    }
+
+    pm->uploaded[STACK_MODELVIEW] = mv;
+    pm->uploaded[STACK_PROJECTION] = p;
+    pm->uploaded[STACK_TEXTURE] = tex;
+}
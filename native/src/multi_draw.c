@@ -0,0 +1,441 @@
+/*
+ * PrismGL Multi-Draw
+ * Sodium-style renderers submit hundreds of non-contiguous chunk ranges
+ * with identical state. EXT_multi_draw_arrays hands them to the driver in
+ * one call; EXT_multi_draw_indirect does the same from a command buffer
+ * streamed per submission. Devices with neither fall back to a loop.
+ *
+ * Indexed draws with per-draw base vertices need the base-vertex variant
+ * of either extension. Without it, list-mode draws are merged by adding
+ * each draw's base vertex to a CPU copy of its indices and drawing the
+ * result from a stream buffer in one call. The copies are read back once
+ * per source range and dropped when the source buffer is written.
+ */
+
+#include "multi_draw.h"
+#include "stream_buffer.h"
+#include "state_shadow.h"
+#include "context.h"
+#include "prismgl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-MultiDraw"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+
+#define COMMAND_STREAM_SIZE (64 * 1024)
+#define REBASE_STREAM_SIZE  (1024 * 1024)
+#define REBASE_CACHE_SIZE   128
+#define REBASE_MAX_INDICES  65536       /* Per source range */
+
+/* Command layouts fixed by the ES 3.1 indirect draw specification */
+typedef struct {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint reserved;
+} DrawArraysCommand;
+
+typedef struct {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint reserved;
+} DrawElementsCommand;
+
+/* Entry points do not depend on the context, so they are resolved once */
+static struct {
+    PFNGLMULTIDRAWARRAYSEXTPROC arrays;
+    PFNGLMULTIDRAWELEMENTSEXTPROC elements;
+    PFNGLMULTIDRAWELEMENTSBASEVERTEXEXTPROC elements_base_vertex;
+    PFNGLMULTIDRAWARRAYSINDIRECTEXTPROC arrays_indirect;
+    PFNGLMULTIDRAWELEMENTSINDIRECTEXTPROC elements_indirect;
+} g_procs;
+
+/* Application index range widened to 32 bits */
+typedef struct {
+    GLuint source;          /* 0 = slot unused */
+    GLintptr offset;
+    GLsizei count;
+    GLenum type;
+    GLuint* indices;        /* Owned, kept across invalidations for reuse */
+    GLsizei capacity;
+} SourceIndices;
+
+/* Indirect command ring and rebased index stream of one GL context */
+typedef struct {
+    StreamBuffer commands;
+    bool commands_created;
+    StreamBuffer rebased;
+    bool rebased_created;
+    SourceIndices cache[REBASE_CACHE_SIZE];
+    int cached;             /* Slots with a live source */
+} MultiDrawState;
+
+static inline MultiDrawState* multi_draw_state(void) {
+    return (MultiDrawState*)prismgl_context_state(PRISMGL_STATE_MULTI_DRAW);
+}
+
+void* multi_draw_create_state(void) {
+    return calloc(1, sizeof(MultiDrawState));
+}
+
+void multi_draw_destroy_state(void* state) {
+    MultiDrawState* md = (MultiDrawState*)state;
+    for (int i = 0; i < REBASE_CACHE_SIZE; i++) free(md->cache[i].indices);
+    free(md);
+}
+
+void multi_draw_init(const GPUInfo* info) {
+    memset(&g_procs, 0, sizeof(g_procs));
+
+    if (info->supports_multi_draw) {
+        g_procs.arrays = (PFNGLMULTIDRAWARRAYSEXTPROC)
+            eglGetProcAddress("glMultiDrawArraysEXT");
+        g_procs.elements = (PFNGLMULTIDRAWELEMENTSEXTPROC)
+            eglGetProcAddress("glMultiDrawElementsEXT");
+        /* Added by EXT/OES_draw_elements_base_vertex on top of multi-draw */
+        if (gpu_has_extension("GL_EXT_draw_elements_base_vertex") ||
+            gpu_has_extension("GL_OES_draw_elements_base_vertex")) {
+            g_procs.elements_base_vertex = (PFNGLMULTIDRAWELEMENTSBASEVERTEXEXTPROC)
+                eglGetProcAddress("glMultiDrawElementsBaseVertexEXT");
+        }
+    }
+    if (info->supports_multi_draw_indirect) {
+        g_procs.arrays_indirect = (PFNGLMULTIDRAWARRAYSINDIRECTEXTPROC)
+            eglGetProcAddress("glMultiDrawArraysIndirectEXT");
+        g_procs.elements_indirect = (PFNGLMULTIDRAWELEMENTSINDIRECTEXTPROC)
+            eglGetProcAddress("glMultiDrawElementsIndirectEXT");
+    }
+
+    LOGI("Multi-draw: direct %s, base vertex %s, indirect %s",
+         g_procs.arrays ? "yes" : "no",
+         g_procs.elements_base_vertex ? "yes" : "no",
+         g_procs.arrays_indirect ? "yes" : "no");
+}
+
+/* ===== Indirect path ===== */
+
+/* ES only sources indirect draws from a bound VAO */
+static bool indirect_allowed(void) {
+    GLint vao = 0;
+    state_shadow_get_integerv(GL_VERTEX_ARRAY_BINDING, &vao);
+    return vao != 0;
+}
+
+static void* map_commands(MultiDrawState* md, GLsizeiptr bytes, GLsizeiptr* offset) {
+    if (!md->commands_created) {
+        md->commands_created = stream_buffer_init(&md->commands, GL_DRAW_INDIRECT_BUFFER,
+                                                  COMMAND_STREAM_SIZE);
+        if (!md->commands_created) return NULL;
+    }
+    return stream_buffer_map(&md->commands, bytes, offset);
+}
+
+static bool draw_arrays_indirect(GLenum mode, const GLint* first, const GLsizei* count,
+                                 GLsizei drawcount) {
+    if (!indirect_allowed()) return false;
+
+    GLint prev_indirect = 0;
+    state_shadow_get_integerv(GL_DRAW_INDIRECT_BUFFER_BINDING, &prev_indirect);
+
+    MultiDrawState* md = multi_draw_state();
+    GLsizeiptr offset = 0;
+    DrawArraysCommand* cmd = (DrawArraysCommand*)map_commands(
+        md, (GLsizeiptr)drawcount * (GLsizeiptr)sizeof(DrawArraysCommand), &offset);
+    if (!cmd) {
+        state_shadow_bind_buffer(GL_DRAW_INDIRECT_BUFFER, (GLuint)prev_indirect);
+        return false;
+    }
+    for (GLsizei i = 0; i < drawcount; i++) {
+        cmd[i].count = (GLuint)count[i];
+        cmd[i].instance_count = 1;
+        cmd[i].first = (GLuint)first[i];
+        cmd[i].reserved = 0;
+    }
+    stream_buffer_unmap(&md->commands);
+
+    g_procs.arrays_indirect(mode, (const void*)(uintptr_t)offset, drawcount, 0);
+    state_shadow_bind_buffer(GL_DRAW_INDIRECT_BUFFER, (GLuint)prev_indirect);
+    return true;
+}
+
+static bool draw_elements_indirect(GLenum mode, const GLsizei* count, GLenum type,
+                                   const void* const* indices, GLsizei drawcount,
+                                   const GLint* basevertex) {
+    if (!indirect_allowed()) return false;
+
+    /* Indices must come from the bound element buffer at element-aligned offsets */
+    GLint element_buffer = 0;
+    state_shadow_get_integerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &element_buffer);
+    if (element_buffer == 0) return false;
+
+    uintptr_t elem = type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+    for (GLsizei i = 0; i < drawcount; i++) {
+        if ((uintptr_t)indices[i] % elem != 0) return false;
+    }
+
+    GLint prev_indirect = 0;
+    state_shadow_get_integerv(GL_DRAW_INDIRECT_BUFFER_BINDING, &prev_indirect);
+
+    MultiDrawState* md = multi_draw_state();
+    GLsizeiptr offset = 0;
+    DrawElementsCommand* cmd = (DrawElementsCommand*)map_commands(
+        md, (GLsizeiptr)drawcount * (GLsizeiptr)sizeof(DrawElementsCommand), &offset);
+    if (!cmd) {
+        state_shadow_bind_buffer(GL_DRAW_INDIRECT_BUFFER, (GLuint)prev_indirect);
+        return false;
+    }
+    for (GLsizei i = 0; i < drawcount; i++) {
+        cmd[i].count = (GLuint)count[i];
+        cmd[i].instance_count = 1;
+        cmd[i].first_index = (GLuint)((uintptr_t)indices[i] / elem);
+        cmd[i].base_vertex = basevertex ? basevertex[i] : 0;
+        cmd[i].reserved = 0;
+    }
+    stream_buffer_unmap(&md->commands);
+
+    g_procs.elements_indirect(mode, type, (const void*)(uintptr_t)offset, drawcount, 0);
+    state_shadow_bind_buffer(GL_DRAW_INDIRECT_BUFFER, (GLuint)prev_indirect);
+    return true;
+}
+
+/* ===== Rebased index path ===== */
+
+static inline size_t index_size(GLenum type) {
+    return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+static SourceIndices* cache_slot(MultiDrawState* md, GLuint source, GLintptr offset,
+                                 GLsizei count, GLenum type) {
+    uint32_t h = source * 2654435761u;
+    h ^= (uint32_t)offset * 40503u;
+    h ^= (uint32_t)count * 2246822519u;
+    h ^= type;
+    return &md->cache[(h >> 7) % REBASE_CACHE_SIZE];
+}
+
+static inline bool cache_hit(const SourceIndices* e, GLuint source, GLintptr offset,
+                             GLsizei count, GLenum type) {
+    return e->source == source && e->offset == offset && e->count == count && e->type == type;
+}
+
+/* Read a range of the bound element buffer into `entry`, widening it */
+static bool fill_source(MultiDrawState* md, SourceIndices* entry, GLuint source,
+                        GLintptr offset, GLsizei count, GLenum type) {
+    if (count > entry->capacity) {
+        GLuint* grown = (GLuint*)realloc(entry->indices, (size_t)count * sizeof(GLuint));
+        if (!grown) return false;
+        entry->indices = grown;
+        entry->capacity = count;
+    }
+
+    const void* src = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, offset,
+                                       (GLsizeiptr)((size_t)count * index_size(type)),
+                                       GL_MAP_READ_BIT);
+    if (!src) return false;
+    switch (type) {
+        case GL_UNSIGNED_BYTE:
+            for (GLsizei i = 0; i < count; i++) entry->indices[i] = ((const GLubyte*)src)[i];
+            break;
+        case GL_UNSIGNED_SHORT:
+            for (GLsizei i = 0; i < count; i++) entry->indices[i] = ((const GLushort*)src)[i];
+            break;
+        default:
+            memcpy(entry->indices, src, (size_t)count * sizeof(GLuint));
+            break;
+    }
+    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+
+    if (!entry->source) md->cached++;
+    entry->source = source;
+    entry->offset = offset;
+    entry->count = count;
+    entry->type = type;
+    return true;
+}
+
+/*
+ * Merge list-mode draws with base vertices into one GL_UNSIGNED_INT draw.
+ * Returns false, having drawn nothing, when the draws cannot be merged.
+ */
+static bool draw_elements_rebased(GLenum mode, const GLsizei* count, GLenum type,
+                                  const void* const* indices, GLsizei drawcount,
+                                  const GLint* basevertex) {
+    /* Strips and fans cannot be concatenated, nor can restart markers be rebased */
+    if (mode != GL_TRIANGLES && mode != GL_LINES && mode != GL_POINTS) return false;
+    if (state_shadow_is_enabled(GL_PRIMITIVE_RESTART_FIXED_INDEX)) return false;
+
+    GLint bound = 0;
+    state_shadow_get_integerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &bound);
+    if (bound == 0) return false;
+    GLuint source = (GLuint)bound;
+
+    size_t total = 0;
+    for (GLsizei i = 0; i < drawcount; i++) {
+        if (count[i] <= 0) continue;
+        if (count[i] > REBASE_MAX_INDICES || (uintptr_t)indices[i] % index_size(type) != 0) {
+            return false;
+        }
+        total += (size_t)count[i];
+    }
+    if (total == 0) return true;
+    if (total * sizeof(GLuint) > REBASE_STREAM_SIZE) return false;
+
+    /* Read missing ranges while the source is still bound */
+    MultiDrawState* md = multi_draw_state();
+    for (GLsizei i = 0; i < drawcount; i++) {
+        if (count[i] <= 0) continue;
+        GLintptr offset = (GLintptr)(uintptr_t)indices[i];
+        SourceIndices* entry = cache_slot(md, source, offset, count[i], type);
+        if (!cache_hit(entry, source, offset, count[i], type) &&
+            !fill_source(md, entry, source, offset, count[i], type)) {
+            return false;
+        }
+    }
+
+    if (!md->rebased_created) {
+        md->rebased_created = stream_buffer_init(&md->rebased, GL_ELEMENT_ARRAY_BUFFER,
+                                                 REBASE_STREAM_SIZE);
+        if (!md->rebased_created) {
+            state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, source);
+            return false;
+        }
+    }
+
+    GLsizeiptr at = 0;
+    GLuint* dst = (GLuint*)stream_buffer_map(&md->rebased,
+                                             (GLsizeiptr)(total * sizeof(GLuint)), &at);
+    if (!dst) {
+        state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, source);
+        return false;
+    }
+
+    size_t written = 0;
+    for (GLsizei i = 0; i < drawcount; i++) {
+        if (count[i] <= 0) continue;
+        GLintptr offset = (GLintptr)(uintptr_t)indices[i];
+        const SourceIndices* entry = cache_slot(md, source, offset, count[i], type);
+        /* Ranges sharing a slot evicted each other; draw the rest one by one */
+        if (!cache_hit(entry, source, offset, count[i], type)) break;
+
+        GLuint base = (GLuint)basevertex[i];
+        for (GLsizei k = 0; k < count[i]; k++) dst[written + (size_t)k] = entry->indices[k] + base;
+        written += (size_t)count[i];
+    }
+    stream_buffer_unmap(&md->rebased);
+
+    if (written != total) {
+        state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, source);
+        return false;
+    }
+    glDrawElements(mode, (GLsizei)total, GL_UNSIGNED_INT, (const void*)(uintptr_t)at);
+    state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, source);
+    return true;
+}
+
+/* ===== Entry points ===== */
+
+GLsizei multi_draw_arrays(GLenum mode, const GLint* first, const GLsizei* count,
+                          GLsizei drawcount) {
+    if (drawcount <= 0) return 0;
+    if (drawcount == 1) {
+        glDrawArrays(mode, first[0], count[0]);
+        return 1;
+    }
+
+    if (g_procs.arrays) {
+        g_procs.arrays(mode, first, count, drawcount);
+        return 1;
+    }
+    if (g_procs.arrays_indirect && draw_arrays_indirect(mode, first, count, drawcount)) {
+        return 1;
+    }
+    for (GLsizei i = 0; i < drawcount; i++) {
+        glDrawArrays(mode, first[i], count[i]);
+    }
+    return drawcount;
+}
+
+GLsizei multi_draw_elements(GLenum mode, const GLsizei* count, GLenum type,
+                            const void* const* indices, GLsizei drawcount,
+                            const GLint* basevertex) {
+    if (drawcount <= 0) return 0;
+
+    if (drawcount > 1) {
+        if (!basevertex && g_procs.elements) {
+            g_procs.elements(mode, count, type, indices, drawcount);
+            return 1;
+        }
+        if (basevertex && g_procs.elements_base_vertex) {
+            g_procs.elements_base_vertex(mode, count, type, indices, drawcount, basevertex);
+            return 1;
+        }
+        if (g_procs.elements_indirect &&
+            draw_elements_indirect(mode, count, type, indices, drawcount, basevertex)) {
+            return 1;
+        }
+        if (basevertex && draw_elements_rebased(mode, count, type, indices, drawcount,
+                                                basevertex)) {
+            return 1;
+        }
+    }
+
+    for (GLsizei i = 0; i < drawcount; i++) {
+        if (basevertex && basevertex[i] != 0) {
+            glDrawElementsBaseVertex(mode, count[i], type, indices[i], basevertex[i]);
+        } else {
+            glDrawElements(mode, count[i], type, indices[i]);
+        }
+    }
+    return drawcount;
+}
+
+/* ===== Invalidation ===== */
+
+static void invalidate_source(MultiDrawState* md, GLuint source) {
+    for (int i = 0; i < REBASE_CACHE_SIZE && md->cached > 0; i++) {
+        if (md->cache[i].source == source) {
+            md->cache[i].source = 0;
+            md->cached--;
+        }
+    }
+}
+
+void multi_draw_invalidate_target(GLenum target) {
+    MultiDrawState* md = multi_draw_state();
+    /* Only pay for the binding query while copies are cached */
+    if (md->cached == 0) return;
+
+    GLenum binding = state_shadow_buffer_binding(target);
+    if (!binding) return;
+
+    GLint bound = 0;
+    state_shadow_get_integerv(binding, &bound);
+    if (bound != 0) invalidate_source(md, (GLuint)bound);
+}
+
+void multi_draw_invalidate_buffers(GLsizei n, const GLuint* buffers) {
+    if (!buffers) return;
+    MultiDrawState* md = multi_draw_state();
+    for (GLsizei i = 0; i < n && md->cached > 0; i++) {
+        if (buffers[i] != 0) invalidate_source(md, buffers[i]);
+    }
+}
+
+void multi_draw_shutdown(void) {
+    MultiDrawState* md = multi_draw_state();
+    if (md->commands_created) {
+        stream_buffer_destroy(&md->commands);
+        md->commands_created = false;
+    }
+    if (md->rebased_created) {
+        stream_buffer_destroy(&md->rebased);
+        md->rebased_created = false;
+    }
+    for (int i = 0; i < REBASE_CACHE_SIZE; i++) md->cache[i].source = 0;
+    md->cached = 0;
+}
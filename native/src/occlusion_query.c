@@ -0,0 +1,500 @@
+/*
+ * PrismGL Occlusion Queries
+ * Desktop renderers test chunk and entity bounding boxes with occlusion
+ * queries and read the results with GL_QUERY_RESULT, often in the same
+ * frame. On a tiled GPU that waits for the whole frame to be rendered, and
+ * reusing the query object next frame waits again for the previous result.
+ *
+ * Instead, every glBeginQuery on an application id starts a query object
+ * from a per-context pool, and the id remembers the issues still in flight,
+ * oldest first. A read answers with the newest issue that is ready; if none
+ * is, an issue at least PrismGLConfig.occlusion_query_latency frames old
+ * is waited for, as the GPU has all but finished it. Failing both, the id's
+ * last answer is repeated, and an id that has never been answered reads as
+ * visible.
+ *
+ * The cost is latency in visibility: for up to `latency` frames an object
+ * keeps the visibility it had, so something that just came into view can
+ * be culled for that long, and something hidden is still drawn. Answering
+ * visible while unsure keeps the error on the side of overdraw rather than
+ * holes in the world. 0 restores blocking, exact reads.
+ *
+ * ES only answers whether any sample passed. For GL_SAMPLES_PASSED the
+ * translator gives fragment shaders an atomic counter behind the uniform
+ * prismgl_CountSamples (shader_patch_sample_counter), which draws inside
+ * the query turn on. Each issue gets its own counter buffer, read once
+ * its occlusion query is ready, so it never stalls either. Draws of
+ * programs that do not count make the result a lower bound, raised to 1
+ * if any sample passed. Counts are of fragments, not multisamples.
+ *
+ * GL_PRIMITIVES_GENERATED is unsupported without geometry shaders and
+ * PrismGL has none to run, so it is counted on the CPU from the mode and
+ * vertex counts of draws in the query and is ready at glEndQuery. Indirect
+ * draws are not seen.
+ */
+
+#include "occlusion_query.h"
+#include "shader_translator.h"
+#include "state_shadow.h"
+#include "context.h"
+#include "prismgl.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Occlusion"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define OCCLUSION_MAX_ISSUED   (OCCLUSION_MAX_LATENCY + 2)
+#define OCCLUSION_POOL_GROW    32
+#define OCCLUSION_MIN_CAPACITY 64       /* Power of two */
+#define COUNTING_PROGRAM_CACHE 64
+#define COUNTING_MAX_ENABLED   32       /* Programs counting in one query */
+
+typedef struct {
+    GLuint query;                       /* Pooled query object */
+    GLuint counter;                     /* Sample counter buffer, 0 if not counted */
+    uint64_t frame;                     /* Frame it was begun in */
+} IssuedQuery;
+
+typedef struct {
+    GLuint id;                          /* Application id, 0 if the slot is free */
+    GLuint64 result;                    /* Last answer read */
+    bool answered;
+    int issued_count;
+    IssuedQuery issued[OCCLUSION_MAX_ISSUED];   /* Oldest first */
+} OcclusionEntry;
+
+typedef struct {
+    GLuint* names;
+    size_t count;
+    size_t capacity;
+} NamePool;
+
+/* Location of prismgl_CountSamples, -1 in programs that do not count */
+typedef struct {
+    GLuint program;                     /* 0 if the slot is free */
+    GLint location;
+} CountingProgram;
+
+typedef struct {
+    OcclusionEntry* entries;            /* Open addressing, linear probing */
+    size_t capacity;
+    size_t count;
+    NamePool queries;
+    NamePool counters;
+    uint64_t frame;
+
+    /* Active GL_SAMPLES_PASSED query */
+    bool counting;
+    GLuint counting_id;
+    GLuint counter;
+    CountingProgram enabled[COUNTING_MAX_ENABLED];
+    int enabled_count;
+    CountingProgram programs[COUNTING_PROGRAM_CACHE];
+
+    /* Active GL_PRIMITIVES_GENERATED query */
+    bool primitives_active;
+    GLuint primitives_id;
+    GLuint64 primitives;
+} OcclusionState;
+
+static struct {
+    int counter_binding;                /* -1 without sample counting */
+} g = { -1 };
+
+static inline OcclusionState* occlusion_state(void) {
+    return (OcclusionState*)prismgl_context_state(PRISMGL_STATE_OCCLUSION);
+}
+
+void occlusion_query_init(const GPUInfo* info) {
+    g.counter_binding = -1;
+    if (info->gl_major > 3 || (info->gl_major == 3 && info->gl_minor >= 1)) {
+        GLint counters = 0, buffers = 0, bindings = 0;
+        glGetIntegerv(GL_MAX_FRAGMENT_ATOMIC_COUNTERS, &counters);
+        glGetIntegerv(GL_MAX_FRAGMENT_ATOMIC_COUNTER_BUFFERS, &buffers);
+        glGetIntegerv(GL_MAX_ATOMIC_COUNTER_BUFFER_BINDINGS, &bindings);
+        /* The last binding, least likely to be one the application uses */
+        if (counters > 0 && buffers > 0 && bindings > 0) g.counter_binding = bindings - 1;
+    }
+    shader_translator_set_sample_counter(g.counter_binding);
+    if (g.counter_binding >= 0) {
+        LOGI("GL_SAMPLES_PASSED counted on atomic counter binding %d", g.counter_binding);
+    } else {
+        LOGI("No fragment atomic counters, GL_SAMPLES_PASSED reads 0 or 1");
+    }
+}
+
+void* occlusion_query_create_state(void) {
+    return calloc(1, sizeof(OcclusionState));
+}
+
+void occlusion_query_destroy_state(void* state) {
+    OcclusionState* s = (OcclusionState*)state;
+    if (!s) return;
+    /* The query objects and buffers go with the context */
+    free(s->entries);
+    free(s->queries.names);
+    free(s->counters.names);
+    free(s);
+}
+
+static int latency(void) {
+    int frames = prismgl_get_config()->occlusion_query_latency;
+    if (frames < 0) return 0;
+    return frames > OCCLUSION_MAX_LATENCY ? OCCLUSION_MAX_LATENCY : frames;
+}
+
+/* ===== Query object and counter pools ===== */
+
+static GLuint take(NamePool* pool, bool buffers) {
+    if (pool->count == 0) {
+        if (pool->capacity < OCCLUSION_POOL_GROW) {
+            GLuint* names = (GLuint*)realloc(pool->names, OCCLUSION_POOL_GROW * sizeof(GLuint));
+            if (!names) return 0;
+            pool->names = names;
+            pool->capacity = OCCLUSION_POOL_GROW;
+        }
+        if (buffers) glGenBuffers(OCCLUSION_POOL_GROW, pool->names);
+        else glGenQueries(OCCLUSION_POOL_GROW, pool->names);
+        pool->count = OCCLUSION_POOL_GROW;
+    }
+    return pool->names[--pool->count];
+}
+
+static void put(NamePool* pool, GLuint name, bool buffers) {
+    if (pool->count == pool->capacity) {
+        size_t capacity = pool->capacity ? pool->capacity * 2 : OCCLUSION_POOL_GROW;
+        GLuint* names = (GLuint*)realloc(pool->names, capacity * sizeof(GLuint));
+        if (!names) {
+            if (buffers) state_shadow_delete_buffers(1, &name);
+            else glDeleteQueries(1, &name);
+            return;
+        }
+        pool->names = names;
+        pool->capacity = capacity;
+    }
+    pool->names[pool->count++] = name;
+}
+
+/* Return the `n` oldest issues of `e` to the pools */
+static void retire(OcclusionState* s, OcclusionEntry* e, int n) {
+    for (int i = 0; i < n; i++) {
+        put(&s->queries, e->issued[i].query, false);
+        if (e->issued[i].counter) put(&s->counters, e->issued[i].counter, true);
+    }
+    e->issued_count -= n;
+    memmove(e->issued, e->issued + n, e->issued_count * sizeof(IssuedQuery));
+}
+
+/* ===== Id table ===== */
+
+static inline size_t slot_of(GLuint id, size_t capacity) {
+    return (id * 2654435761u) & (capacity - 1);
+}
+
+static OcclusionEntry* find(OcclusionState* s, GLuint id) {
+    if (s->count == 0) return NULL;
+    for (size_t i = slot_of(id, s->capacity);; i = (i + 1) & (s->capacity - 1)) {
+        if (s->entries[i].id == id) return &s->entries[i];
+        if (s->entries[i].id == 0) return NULL;
+    }
+}
+
+static bool grow(OcclusionState* s) {
+    size_t capacity = s->capacity ? s->capacity * 2 : OCCLUSION_MIN_CAPACITY;
+    OcclusionEntry* entries = (OcclusionEntry*)calloc(capacity, sizeof(OcclusionEntry));
+    if (!entries) return false;
+    for (size_t i = 0; i < s->capacity; i++) {
+        if (s->entries[i].id == 0) continue;
+        size_t j = slot_of(s->entries[i].id, capacity);
+        while (entries[j].id != 0) j = (j + 1) & (capacity - 1);
+        entries[j] = s->entries[i];
+    }
+    free(s->entries);
+    s->entries = entries;
+    s->capacity = capacity;
+    return true;
+}
+
+static OcclusionEntry* insert(OcclusionState* s, GLuint id) {
+    OcclusionEntry* e = find(s, id);
+    if (e) return e;
+    /* Keep the load under 3/4 */
+    if ((s->count + 1) * 4 > s->capacity * 3 && !grow(s)) return NULL;
+    size_t i = slot_of(id, s->capacity);
+    while (s->entries[i].id != 0) i = (i + 1) & (s->capacity - 1);
+    e = &s->entries[i];
+    memset(e, 0, sizeof(*e));
+    e->id = id;
+    s->count++;
+    return e;
+}
+
+/* Backward-shift deletion, so probing needs no tombstones */
+static void erase(OcclusionState* s, OcclusionEntry* e) {
+    retire(s, e, e->issued_count);
+    size_t mask = s->capacity - 1;
+    size_t hole = (size_t)(e - s->entries);
+    for (size_t i = (hole + 1) & mask; s->entries[i].id != 0; i = (i + 1) & mask) {
+        size_t home = slot_of(s->entries[i].id, s->capacity);
+        /* Entry can move into the hole unless its home lies in (hole, i] */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            s->entries[hole] = s->entries[i];
+            hole = i;
+        }
+    }
+    s->entries[hole].id = 0;
+    s->count--;
+}
+
+/* ===== Sample counting ===== */
+
+static GLint counting_location(OcclusionState* s, GLuint program) {
+    CountingProgram* p = &s->programs[program % COUNTING_PROGRAM_CACHE];
+    if (p->program != program) {
+        p->program = program;
+        p->location = glGetUniformLocation(program, "prismgl_CountSamples");
+    }
+    return p->location;
+}
+
+static void begin_counting(OcclusionState* s, GLuint id) {
+    GLuint counter = take(&s->counters, true);
+    if (counter == 0) return;
+
+    /* Reset the counter and leave it bound; the shaders only touch it while counting */
+    static const GLuint zero = 0;
+    GLint previous = 0;
+    state_shadow_get_integerv(GL_ATOMIC_COUNTER_BUFFER_BINDING, &previous);
+    state_shadow_buffer_bound_indexed(GL_ATOMIC_COUNTER_BUFFER, counter);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, (GLuint)g.counter_binding, counter);
+    glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(zero), &zero, GL_DYNAMIC_READ);
+    state_shadow_bind_buffer(GL_ATOMIC_COUNTER_BUFFER, (GLuint)previous);
+
+    s->counting = true;
+    s->counting_id = id;
+    s->counter = counter;
+    s->enabled_count = 0;
+}
+
+static void count_draw(OcclusionState* s) {
+    GLint program = 0;
+    state_shadow_get_integerv(GL_CURRENT_PROGRAM, &program);
+    /* Programs that do not count leave the result a lower bound */
+    GLint location = program ? counting_location(s, (GLuint)program) : -1;
+    if (location < 0 || s->enabled_count == COUNTING_MAX_ENABLED) return;
+    for (int i = 0; i < s->enabled_count; i++) {
+        if (s->enabled[i].program == (GLuint)program) return;
+    }
+    s->enabled[s->enabled_count].program = (GLuint)program;
+    s->enabled[s->enabled_count].location = location;
+    s->enabled_count++;
+    glProgramUniform1ui((GLuint)program, location, 1u);
+}
+
+static void end_counting(OcclusionState* s, IssuedQuery* q) {
+    for (int i = 0; i < s->enabled_count; i++) {
+        glProgramUniform1ui(s->enabled[i].program, s->enabled[i].location, 0u);
+    }
+    /* Make the increments visible to glMapBufferRange */
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    if (q) {
+        q->counter = s->counter;
+    } else {
+        put(&s->counters, s->counter, true);
+    }
+    s->counting = false;
+    s->counter = 0;
+    s->enabled_count = 0;
+}
+
+static GLuint read_counter(GLuint counter) {
+    GLuint value = 0;
+    GLint previous = 0;
+    state_shadow_get_integerv(GL_COPY_READ_BUFFER_BINDING, &previous);
+    state_shadow_bind_buffer(GL_COPY_READ_BUFFER, counter);
+    const GLuint* mapped = (const GLuint*)glMapBufferRange(GL_COPY_READ_BUFFER, 0,
+                                                           sizeof(GLuint), GL_MAP_READ_BIT);
+    if (mapped) {
+        value = *mapped;
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+    }
+    state_shadow_bind_buffer(GL_COPY_READ_BUFFER, (GLuint)previous);
+    return value;
+}
+
+void occlusion_query_program_changed(GLuint program) {
+    OcclusionState* s = occlusion_state();
+    CountingProgram* p = &s->programs[program % COUNTING_PROGRAM_CACHE];
+    if (p->program == program) p->program = 0;
+    for (int i = 0; i < s->enabled_count; i++) {
+        if (s->enabled[i].program != program) continue;
+        s->enabled[i] = s->enabled[--s->enabled_count];
+        break;
+    }
+}
+
+/* ===== Primitive counting ===== */
+
+static GLuint64 primitives_of(GLenum mode, GLsizei count) {
+    GLuint64 n = count > 0 ? (GLuint64)count : 0;
+    switch (mode) {
+    case GL_POINTS:                     return n;
+    case GL_LINES:                      return n / 2;
+    case GL_LINE_LOOP:                  return n >= 2 ? n : 0;
+    case GL_LINE_STRIP:                 return n >= 2 ? n - 1 : 0;
+    case GL_TRIANGLES:                  return n / 3;
+    case GL_TRIANGLE_STRIP:
+    case GL_TRIANGLE_FAN:               return n >= 3 ? n - 2 : 0;
+    case GL_QUADS:                      return n / 4;
+    case GL_QUAD_STRIP:                 return n >= 4 ? (n - 2) / 2 : 0;
+    case GL_POLYGON:                    return n >= 3 ? 1 : 0;
+    case GL_LINES_ADJACENCY:            return n / 4;
+    case GL_LINE_STRIP_ADJACENCY:       return n >= 4 ? n - 3 : 0;
+    case GL_TRIANGLES_ADJACENCY:        return n / 6;
+    case GL_TRIANGLE_STRIP_ADJACENCY:   return n >= 6 ? (n - 4) / 2 : 0;
+    default:                            return 0;
+    }
+}
+
+void occlusion_query_draw(GLenum mode, const GLsizei* counts, GLsizei drawcount,
+                          GLsizei instances) {
+    OcclusionState* s = occlusion_state();
+    if (s->primitives_active && instances > 0) {
+        GLuint64 primitives = 0;
+        for (GLsizei i = 0; i < drawcount; i++) primitives += primitives_of(mode, counts[i]);
+        s->primitives += primitives * (GLuint64)instances;
+    }
+    if (s->counting) count_draw(s);
+}
+
+/* ===== Queries ===== */
+
+static inline bool is_occlusion(GLenum target) {
+    return target == GL_ANY_SAMPLES_PASSED || target == GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+}
+
+bool occlusion_query_begin(GLenum target, GLuint id) {
+    OcclusionState* s = occlusion_state();
+
+    if (target == GL_PRIMITIVES_GENERATED) {
+        s->primitives_active = true;
+        s->primitives_id = id;
+        s->primitives = 0;
+        return true;
+    }
+
+    bool count = target == GL_SAMPLES_PASSED && g.counter_binding >= 0;
+    if (target == GL_SAMPLES_PASSED) target = GL_ANY_SAMPLES_PASSED;
+    if (!is_occlusion(target) || (latency() == 0 && !count)) {
+        /* Back to plain queries on this id, e.g. after the setting changed */
+        OcclusionEntry* e = find(s, id);
+        if (e) erase(s, e);
+        return false;
+    }
+
+    OcclusionEntry* e = insert(s, id);
+    if (!e) return false;
+    if (e->issued_count == OCCLUSION_MAX_ISSUED) {
+        /* Begun every frame and never read: drop the oldest to make room */
+        retire(s, e, 1);
+    }
+
+    GLuint query = take(&s->queries, false);
+    if (query == 0) {
+        LOGW("Out of memory for query objects, id %u queried directly", id);
+        erase(s, e);
+        return false;
+    }
+    IssuedQuery* q = &e->issued[e->issued_count++];
+    memset(q, 0, sizeof(*q));
+    q->query = query;
+    q->frame = s->frame;
+    if (count) begin_counting(s, id);
+    glBeginQuery(target, query);
+    return true;
+}
+
+bool occlusion_query_end(GLenum target) {
+    OcclusionState* s = occlusion_state();
+
+    if (target == GL_PRIMITIVES_GENERATED) {
+        if (!s->primitives_active) return true;
+        s->primitives_active = false;
+        OcclusionEntry* e = insert(s, s->primitives_id);
+        if (e) {
+            retire(s, e, e->issued_count);
+            e->result = s->primitives;
+            e->answered = true;
+        }
+        return true;
+    }
+
+    if (target != GL_SAMPLES_PASSED || !s->counting) return false;
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+    /* The counting query is the newest issue of its id, unless it was deleted */
+    OcclusionEntry* e = find(s, s->counting_id);
+    end_counting(s, e && e->issued_count > 0 ? &e->issued[e->issued_count - 1] : NULL);
+    return true;
+}
+
+/* Settle on the newest ready or old enough issue, retiring it and older ones */
+static void collect(OcclusionState* s, OcclusionEntry* e) {
+    uint64_t frames = (uint64_t)latency();
+    for (int i = e->issued_count - 1; i >= 0; i--) {
+        IssuedQuery* q = &e->issued[i];
+        GLuint available = GL_TRUE;
+        if (s->frame - q->frame < frames) {
+            glGetQueryObjectuiv(q->query, GL_QUERY_RESULT_AVAILABLE, &available);
+        }
+        if (!available) continue;
+
+        GLuint any = 0;
+        glGetQueryObjectuiv(q->query, GL_QUERY_RESULT, &any);
+        e->result = any;
+        if (q->counter) {
+            /* The draws are done, so is the counter; at least 1 if uncounted draws passed */
+            GLuint samples = read_counter(q->counter);
+            e->result = samples > any ? samples : any;
+        }
+        e->answered = true;
+        retire(s, e, i + 1);
+        return;
+    }
+}
+
+bool occlusion_query_result(GLuint id, GLenum pname, GLuint64* params) {
+    OcclusionState* s = occlusion_state();
+    OcclusionEntry* e = find(s, id);
+    if (!e) return false;
+
+    if (pname == GL_QUERY_RESULT_AVAILABLE) {
+        /* Some answer always is, and polling for a fresher one would stall */
+        GLuint available = GL_TRUE;
+        if (latency() == 0 && e->issued_count > 0) {
+            glGetQueryObjectuiv(e->issued[e->issued_count - 1].query,
+                                GL_QUERY_RESULT_AVAILABLE, &available);
+        }
+        *params = available;
+        return true;
+    }
+    collect(s, e);
+    *params = e->answered ? e->result : GL_TRUE;
+    return true;
+}
+
+void occlusion_query_delete(GLsizei n, const GLuint* ids) {
+    OcclusionState* s = occlusion_state();
+    for (GLsizei i = 0; i < n && s->count > 0; i++) {
+        OcclusionEntry* e = find(s, ids[i]);
+        if (e) erase(s, e);
+    }
+}
+
+void occlusion_query_frame_end(void) {
+    occlusion_state()->frame++;
+}
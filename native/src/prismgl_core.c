@@ -5,6 +5,23 @@
 #include "prismgl.h"
 #include "gpu_detect.h"
 #include "shader_translator.h"
+#include "display_list.h"
+#include "client_arrays.h"
+#include "quad_convert.h"
+#include "state_shadow.h"
+#include "multi_draw.h"
+#include "draw_batch.h"
+#include "draw_instance.h"
+#include "gl_thread.h"
+#include "gl_jobs.h"
+#include "texture_compress.h"
+#include "texture_registry.h"
+#include "texture_readback.h"
+#include "texture_budget.h"
+#include "texture_batch.h"
+#include "gpu_timer.h"
+#include "occlusion_query.h"
+#include "worker_pool.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -30,12 +47,19 @@ bool prismgl_init(const char* cache_dir) {
     /* Set default config */
     memset(&g_config, 0, sizeof(PrismGLConfig));
     g_config.shader_cache_enabled = true;
-    g_config.draw_call_batching = true;
+    g_config.draw_call_batching = false;
     g_config.adaptive_resolution = true;
     g_config.async_texture_loading = true;
     g_config.vulkan_backend = false;
+    g_config.threaded_dispatch = false;
+    g_config.auto_instancing = false;
+    g_config.texture_compression = false;
+    g_config.immutable_textures = true;
+    g_config.texture_upload_batching = true;
     g_config.resolution_scale = 1.0f;
     g_config.max_cached_shaders = 1024;
+    g_config.texture_budget_mb = 0;
+    g_config.occlusion_query_latency = 2;
 
     if (cache_dir) {
         strncpy(g_config.cache_dir, cache_dir, sizeof(g_config.cache_dir) - 1);
@@ -52,6 +76,11 @@ bool prismgl_init(const char* cache_dir) {
 
     /* Apply GPU-specific optimizations */
     gpu_apply_optimizations(&g_gpu_info);
+    multi_draw_init(&g_gpu_info);
+    texture_compress_init(&g_gpu_info, cache_dir);
+    texture_budget_init(&g_gpu_info);
+    gpu_timer_init();
+    occlusion_query_init(&g_gpu_info);
 
     /* Initialize shader cache */
     if (g_config.shader_cache_enabled && cache_dir) {
@@ -61,6 +90,9 @@ bool prismgl_init(const char* cache_dir) {
         }
     }
 
+    /* Shadowed GL state starts out unknown for the current context */
+    state_shadow_reset();
+
     /* Initialize shader translator */
     if (!shader_translator_init()) {
         LOGE("Shader translator initialization failed");
@@ -77,16 +109,82 @@ void prismgl_shutdown(void) {
 
     LOGI("PrismGL shutting down...");
 
+    gl_thread_shutdown();
+    draw_instance_shutdown();
+    worker_pool_shutdown();     /* Workers may still fill buffers of queued jobs */
+    gl_jobs_shutdown();
+
     if (g_config.shader_cache_enabled) {
         prismgl_shader_cache_shutdown();
     }
 
     shader_translator_shutdown();
+    display_list_shutdown();
+    client_arrays_shutdown();
+    quad_convert_shutdown();
+    multi_draw_shutdown();
+    texture_registry_shutdown();
 
     g_initialized = false;
     LOGI("PrismGL shutdown complete");
 }
 
+void prismgl_frame_end(void) {
+    draw_instance_flush();
+    texture_batch_frame_end();
+    gl_jobs_run_pending();
+    state_shadow_frame_end();
+    draw_batch_frame_end();
+    draw_instance_frame_end();
+    texture_readback_frame_end();
+    texture_budget_frame_end();
+    gpu_timer_frame_end();
+    occlusion_query_frame_end();
+}
+
+void prismgl_get_state_stats(uint32_t* filtered, uint32_t* forwarded) {
+    StateShadowStats stats;
+    state_shadow_get_stats(&stats);
+    if (filtered) *filtered = stats.filtered;
+    if (forwarded) *forwarded = stats.forwarded;
+}
+
+void prismgl_get_batch_stats(uint32_t* draws_in, uint32_t* draws_out) {
+    DrawBatchStats stats;
+    draw_batch_get_stats(&stats);
+    if (draws_in) *draws_in = stats.draws_in;
+    if (draws_out) *draws_out = stats.draws_out;
+}
+
+void prismgl_get_job_stats(uint32_t* completed, uint32_t* pending) {
+    gl_jobs_get_stats(completed, pending);
+}
+
+void prismgl_get_instance_stats(uint32_t* draws_in, uint32_t* draws_out) {
+    DrawInstanceStats stats;
+    draw_instance_get_stats(&stats);
+    if (draws_in) *draws_in = stats.draws_in;
+    if (draws_out) *draws_out = stats.draws_out;
+}
+
+void prismgl_get_texture_upload_stats(uint32_t* uploads_in, uint32_t* uploads_out,
+                                      uint32_t* bytes) {
+    TextureBatchStats stats;
+    texture_batch_get_stats(&stats);
+    if (uploads_in) *uploads_in = stats.uploads_in;
+    if (uploads_out) *uploads_out = stats.uploads_out;
+    if (bytes) *bytes = stats.bytes;
+}
+
+void prismgl_get_texture_memory(size_t* usage, size_t* peak, size_t* budget) {
+    texture_registry_get_usage(usage, peak);
+    if (budget) *budget = texture_budget_bytes();
+}
+
+void prismgl_set_state_validation(bool enable) {
+    state_shadow_set_validation(enable);
+}
+
 void prismgl_set_config(const PrismGLConfig* config) {
     if (config) {
         memcpy(&g_config, config, sizeof(PrismGLConfig));
@@ -4,7 +4,11 @@
  */
 
 #include "prismgl.h"
+#include "gl_thread.h"
+#include "draw_batch.h"
+#include "draw_instance.h"
 
+#include <stdio.h>
 #include <string.h>
 #include <dlfcn.h>
 #include <android/log.h>
@@ -50,18 +54,96 @@ static const GLFuncEntry g_overrides[] = {
     { "glAlphaFunc",          (void*)prismgl_glAlphaFunc },
     { "glEnable",             (void*)prismgl_glEnable_wrapper },
     { "glDisable",            (void*)prismgl_glDisable_wrapper },
+    { "glBlendFunc",          (void*)prismgl_glBlendFunc_wrapper },
+    { "glBlendFuncSeparate",  (void*)prismgl_glBlendFuncSeparate_wrapper },
+    { "glDepthMask",          (void*)prismgl_glDepthMask_wrapper },
+    { "glViewport",           (void*)prismgl_glViewport_wrapper },
+    { "glScissor",            (void*)prismgl_glScissor_wrapper },
     { "glGetIntegerv",        (void*)prismgl_glGetIntegerv_wrapper },
     { "glGetFloatv",          (void*)prismgl_glGetFloatv_wrapper },
+    { "glGetInteger64v",      (void*)prismgl_glGetInteger64v_wrapper },
+    { "glGetBooleanv",        (void*)prismgl_glGetBooleanv_wrapper },
+    { "glIsEnabled",          (void*)prismgl_glIsEnabled_wrapper },
     { "glGetString",          (void*)prismgl_glGetString_wrapper },
     { "glGetStringi",         (void*)prismgl_glGetStringi_wrapper },
 
+    /* ===== Programs ===== */
+    { "glUseProgram",         (void*)prismgl_glUseProgram_wrapper },
+    { "glLinkProgram",        (void*)prismgl_glLinkProgram_wrapper },
+    { "glDeleteProgram",      (void*)prismgl_glDeleteProgram_wrapper },
+
+    /* ===== Uniforms ===== */
+    { "glUniform1f",          (void*)prismgl_glUniform1f_wrapper },
+    { "glUniform2f",          (void*)prismgl_glUniform2f_wrapper },
+    { "glUniform3f",          (void*)prismgl_glUniform3f_wrapper },
+    { "glUniform4f",          (void*)prismgl_glUniform4f_wrapper },
+    { "glUniform1i",          (void*)prismgl_glUniform1i_wrapper },
+    { "glUniform2i",          (void*)prismgl_glUniform2i_wrapper },
+    { "glUniform3i",          (void*)prismgl_glUniform3i_wrapper },
+    { "glUniform4i",          (void*)prismgl_glUniform4i_wrapper },
+    { "glUniform1fv",         (void*)prismgl_glUniform1fv_wrapper },
+    { "glUniform2fv",         (void*)prismgl_glUniform2fv_wrapper },
+    { "glUniform3fv",         (void*)prismgl_glUniform3fv_wrapper },
+    { "glUniform4fv",         (void*)prismgl_glUniform4fv_wrapper },
+    { "glUniform1iv",         (void*)prismgl_glUniform1iv_wrapper },
+    { "glUniform2iv",         (void*)prismgl_glUniform2iv_wrapper },
+    { "glUniform3iv",         (void*)prismgl_glUniform3iv_wrapper },
+    { "glUniform4iv",         (void*)prismgl_glUniform4iv_wrapper },
+    { "glUniformMatrix2fv",   (void*)prismgl_glUniformMatrix2fv_wrapper },
+    { "glUniformMatrix3fv",   (void*)prismgl_glUniformMatrix3fv_wrapper },
+    { "glUniformMatrix4fv",   (void*)prismgl_glUniformMatrix4fv_wrapper },
+
+    /* ===== Draw calls ===== */
+    { "glDrawArrays",         (void*)prismgl_glDrawArrays_wrapper },
+    { "glDrawElements",       (void*)prismgl_glDrawElements_wrapper },
+    { "glDrawArraysInstanced",   (void*)prismgl_glDrawArraysInstanced_wrapper },
+    { "glDrawElementsInstanced", (void*)prismgl_glDrawElementsInstanced_wrapper },
+    { "glDrawElementsBaseVertex", (void*)prismgl_glDrawElementsBaseVertex_wrapper },
+    { "glMultiDrawArrays",       (void*)prismgl_glMultiDrawArrays },
+    { "glMultiDrawElements",     (void*)prismgl_glMultiDrawElements },
+    { "glMultiDrawElementsBaseVertex", (void*)prismgl_glMultiDrawElementsBaseVertex },
+
+    /* ===== Buffer objects ===== */
+    { "glBufferData",         (void*)prismgl_glBufferData_wrapper },
+    { "glBufferSubData",      (void*)prismgl_glBufferSubData_wrapper },
+    { "glMapBufferRange",     (void*)prismgl_glMapBufferRange_wrapper },
+    { "glCopyBufferSubData",  (void*)prismgl_glCopyBufferSubData_wrapper },
+    { "glDeleteBuffers",      (void*)prismgl_glDeleteBuffers_wrapper },
+    { "glBindBuffer",         (void*)prismgl_glBindBuffer_wrapper },
+    { "glBindBufferBase",     (void*)prismgl_glBindBufferBase_wrapper },
+    { "glBindBufferRange",    (void*)prismgl_glBindBufferRange_wrapper },
+    { "glBindVertexArray",    (void*)prismgl_glBindVertexArray_wrapper },
+    { "glDeleteVertexArrays", (void*)prismgl_glDeleteVertexArrays_wrapper },
+
     /* ===== Texture ===== */
     { "glTexImage1D",         (void*)prismgl_glTexImage1D },
     { "glGetTexImage",        (void*)prismgl_glGetTexImage },
+    { "glTexImage2D",         (void*)prismgl_glTexImage2D_wrapper },
+    { "glTexSubImage2D",      (void*)prismgl_glTexSubImage2D_wrapper },
+    { "glTexImage3D",         (void*)prismgl_glTexImage3D_wrapper },
+    { "glCompressedTexImage2D", (void*)prismgl_glCompressedTexImage2D_wrapper },
+    { "glCopyTexImage2D",     (void*)prismgl_glCopyTexImage2D_wrapper },
+    { "glCompressedTexSubImage2D", (void*)prismgl_glCompressedTexSubImage2D_wrapper },
+    { "glCopyTexSubImage2D",  (void*)prismgl_glCopyTexSubImage2D_wrapper },
+    { "glTexStorage2D",       (void*)prismgl_glTexStorage2D_wrapper },
+    { "glTexStorage3D",       (void*)prismgl_glTexStorage3D_wrapper },
+    { "glTexParameteri",      (void*)prismgl_glTexParameteri_wrapper },
+    { "glGenerateMipmap",     (void*)prismgl_glGenerateMipmap_wrapper },
+    { "glPixelStorei",        (void*)prismgl_glPixelStorei_wrapper },
+    { "glBindTexture",        (void*)prismgl_glBindTexture_wrapper },
+    { "glActiveTexture",      (void*)prismgl_glActiveTexture_wrapper },
+    { "glDeleteTextures",     (void*)prismgl_glDeleteTextures_wrapper },
 
     /* ===== Framebuffer ===== */
     { "glDrawBuffer",         (void*)prismgl_glDrawBuffer },
     { "glReadBuffer",         (void*)prismgl_glReadBuffer_wrapper },
+    { "glBindFramebuffer",    (void*)prismgl_glBindFramebuffer_wrapper },
+    { "glClear",              (void*)prismgl_glClear_wrapper },
+    { "glBlitFramebuffer",    (void*)prismgl_glBlitFramebuffer_wrapper },
+    { "glReadPixels",         (void*)prismgl_glReadPixels_wrapper },
+    { "glFramebufferTexture2D",    (void*)prismgl_glFramebufferTexture2D_wrapper },
+    { "glFramebufferTextureLayer", (void*)prismgl_glFramebufferTextureLayer_wrapper },
+    { "glDeleteFramebuffers", (void*)prismgl_glDeleteFramebuffers_wrapper },
 
     /* ===== Fixed function matrix (legacy) ===== */
     { "glPushMatrix",         (void*)prismgl_glPushMatrix },
@@ -76,6 +158,16 @@ static const GLFuncEntry g_overrides[] = {
     { "glMultMatrixf",        (void*)prismgl_glMultMatrixf },
     { "glLoadMatrixf",        (void*)prismgl_glLoadMatrixf },
 
+    /* ===== Display lists (legacy) ===== */
+    { "glGenLists",           (void*)prismgl_glGenLists },
+    { "glDeleteLists",        (void*)prismgl_glDeleteLists },
+    { "glIsList",             (void*)prismgl_glIsList },
+    { "glNewList",            (void*)prismgl_glNewList },
+    { "glEndList",            (void*)prismgl_glEndList },
+    { "glCallList",           (void*)prismgl_glCallList },
+    { "glCallLists",          (void*)prismgl_glCallLists },
+    { "glListBase",           (void*)prismgl_glListBase },
+
     /* ===== Client state (legacy) ===== */
     { "glEnableClientState",  (void*)prismgl_glEnableClientState },
     { "glDisableClientState", (void*)prismgl_glDisableClientState },
@@ -84,6 +176,17 @@ static const GLFuncEntry g_overrides[] = {
     { "glTexCoordPointer",    (void*)prismgl_glTexCoordPointer },
     { "glNormalPointer",      (void*)prismgl_glNormalPointer },
 
+    /* ===== EGL ===== */
+    { "eglSwapBuffers",       (void*)prismgl_eglSwapBuffers },
+    { "eglCreateContext",     (void*)prismgl_eglCreateContext },
+    { "eglMakeCurrent",       (void*)prismgl_eglMakeCurrent },
+    { "eglDestroyContext",    (void*)prismgl_eglDestroyContext },
+
+    /* ===== Synchronization ===== */
+    { "glFlush",              (void*)prismgl_glFlush_wrapper },
+    { "glFinish",             (void*)prismgl_glFinish_wrapper },
+    { "glFenceSync",          (void*)prismgl_glFenceSync_wrapper },
+
     /* ===== Query objects ===== */
     { "glGenQueries",         (void*)prismgl_glGenQueries },
     { "glDeleteQueries",      (void*)prismgl_glDeleteQueries },
@@ -124,8 +227,7 @@ static void ensure_libs_loaded(void) {
     }
 }
 
-void* prismgl_get_proc_address(const char* name) {
-    if (!name) return NULL;
+static void* resolve_proc(const char* name) {
 
     /* First check our overrides */
     for (int i = 0; g_overrides[i].name != NULL; i++) {
@@ -201,3 +303,20 @@ void* prismgl_get_proc_address(const char* name) {
 
     return func;
 }
+
+void* prismgl_get_proc_address(const char* name) {
+    if (!name) return NULL;
+
+    /* With threaded dispatch the context may live on the GL thread */
+    if (gl_thread_enabled()) {
+        void* marshalled = gl_marshal_get_proc(name);
+        if (marshalled) return marshalled;
+    }
+
+    void* func = resolve_proc(name);
+    if (!func) return NULL;
+
+    /* Calls the instancer or batcher records must reach it without flushing it */
+    if (draw_instance_records(name) || draw_batch_records(name)) return func;
+    return gl_thread_wrap_proc(name, func);
+}
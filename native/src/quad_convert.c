@@ -0,0 +1,369 @@
+/*
+ * PrismGL Quad Conversion
+ * ES has no GL_QUADS. Non-indexed quad draws reuse one shared index
+ * buffer holding the 0,1,2 0,2,3 pattern; indexed quad draws convert the
+ * application's index range once and keep the result until the source
+ * buffer is written or deleted.
+ */
+
+#include "quad_convert.h"
+#include "stream_buffer.h"
+#include "state_shadow.h"
+#include "context.h"
+#include "prismgl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Quads"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+#define QUAD_INDEX_MIN_QUADS   1024
+#define QUAD_U16_MAX_VERTICES  65536
+#define QUAD_CACHE_SIZE        64
+#define STREAM_INDEX_SIZE      (512 * 1024)
+
+/* Shared 0,1,2 0,2,3 index pattern for `quads` quads */
+typedef struct {
+    GLuint buffer;
+    GLsizei quads;
+} QuadIndexBuffer;
+
+/* Converted copy of a range of an application index buffer */
+typedef struct {
+    GLuint source;          /* 0 = slot unused */
+    GLintptr offset;
+    GLsizei count;
+    GLenum type;
+    GLuint buffer;          /* Owned, kept across invalidations for reuse */
+} ConvertedIndices;
+
+/* Conversion state of one GL context */
+typedef struct {
+    QuadIndexBuffer shared_u16;
+    QuadIndexBuffer shared_u32;
+    ConvertedIndices cache[QUAD_CACHE_SIZE];
+    int cached;             /* Slots with a live source */
+    StreamBuffer stream;
+    bool stream_created;
+    void* scratch;
+    size_t scratch_size;
+} QuadState;
+
+static inline QuadState* quad_state(void) {
+    return (QuadState*)prismgl_context_state(PRISMGL_STATE_QUADS);
+}
+
+void* quad_convert_create_state(void) {
+    return calloc(1, sizeof(QuadState));
+}
+
+void quad_convert_destroy_state(void* state) {
+    QuadState* qc = (QuadState*)state;
+    free(qc->scratch);
+    free(qc);
+}
+
+static int index_size(GLenum type) {
+    switch (type) {
+        case GL_UNSIGNED_BYTE:  return 1;
+        case GL_UNSIGNED_SHORT: return 2;
+        default:                return 4;
+    }
+}
+
+static GLuint bound_element_buffer(void) {
+    GLint bound = 0;
+    state_shadow_get_integerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &bound);
+    return (GLuint)bound;
+}
+
+/* Expand quads a,b,c,d into triangles a,b,c a,c,d */
+#define CONVERT_QUADS(T, src, dst, quads)                  \
+    do {                                                   \
+        const T* s_ = (const T*)(src);                     \
+        T* d_ = (T*)(dst);                                 \
+        for (GLsizei q_ = 0; q_ < (quads); q_++) {         \
+            d_[0] = s_[0]; d_[1] = s_[1]; d_[2] = s_[2];   \
+            d_[3] = s_[0]; d_[4] = s_[2]; d_[5] = s_[3];   \
+            s_ += 4;                                       \
+            d_ += 6;                                       \
+        }                                                  \
+    } while (0)
+
+static void convert_quads(GLenum type, const void* src, void* dst, GLsizei quads) {
+    switch (type) {
+        case GL_UNSIGNED_BYTE:  CONVERT_QUADS(GLubyte, src, dst, quads); break;
+        case GL_UNSIGNED_SHORT: CONVERT_QUADS(GLushort, src, dst, quads); break;
+        default:                CONVERT_QUADS(GLuint, src, dst, quads); break;
+    }
+}
+
+static void* scratch_reserve(QuadState* qc, size_t size) {
+    if (size > qc->scratch_size) {
+        void* grown = realloc(qc->scratch, size);
+        if (!grown) return NULL;
+        qc->scratch = grown;
+        qc->scratch_size = size;
+    }
+    return qc->scratch;
+}
+
+static void draw_triangles(GLsizei count, GLenum type, const void* offset,
+                           GLsizei instancecount, GLint basevertex) {
+    if (instancecount != 1) {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, type, offset,
+                                          instancecount, basevertex);
+    } else if (basevertex != 0) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, count, type, offset, basevertex);
+    } else {
+        glDrawElements(GL_TRIANGLES, count, type, offset);
+    }
+}
+
+/* Remap the legacy modes that need no index rewrite; 0 if not legacy */
+static GLenum remap_mode(GLenum mode) {
+    switch (mode) {
+        case GL_QUAD_STRIP: return GL_TRIANGLE_STRIP;
+        case GL_POLYGON:    return GL_TRIANGLE_FAN;
+        default:            return 0;
+    }
+}
+
+/* ===== Shared quad index buffer ===== */
+
+/*
+ * Make sure `qib` covers `quads` quads. The upload goes through
+ * GL_COPY_WRITE_BUFFER so the element binding of the current VAO is left
+ * alone; the buffer name never changes, so VAOs holding it stay valid.
+ */
+static bool ensure_shared_indices(QuadState* qc, QuadIndexBuffer* qib, GLenum type,
+                                  GLsizei quads) {
+    if (!qib->buffer) {
+        glGenBuffers(1, &qib->buffer);
+        if (!qib->buffer) return false;
+    }
+    if (quads <= qib->quads) return true;
+
+    GLsizei capacity = qib->quads ? qib->quads : QUAD_INDEX_MIN_QUADS;
+    while (capacity < quads) capacity *= 2;
+    if (type == GL_UNSIGNED_SHORT && capacity > QUAD_U16_MAX_VERTICES / 4) {
+        capacity = QUAD_U16_MAX_VERTICES / 4;
+    }
+
+    size_t elem = (size_t)index_size(type);
+    uint8_t* data = (uint8_t*)scratch_reserve(qc, (size_t)capacity * 6 * elem);
+    if (!data) return false;
+
+    for (GLsizei q = 0; q < capacity; q++) {
+        GLuint base = (GLuint)q * 4;
+        GLuint tri[6] = { base, base + 1, base + 2, base, base + 2, base + 3 };
+        for (int i = 0; i < 6; i++) {
+            if (type == GL_UNSIGNED_SHORT) {
+                ((GLushort*)data)[q * 6 + i] = (GLushort)tri[i];
+            } else {
+                ((GLuint*)data)[q * 6 + i] = tri[i];
+            }
+        }
+    }
+
+    state_shadow_bind_buffer(GL_COPY_WRITE_BUFFER, qib->buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)((size_t)capacity * 6 * elem),
+                 data, GL_STATIC_DRAW);
+    state_shadow_bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+    qib->quads = capacity;
+    return true;
+}
+
+GLuint quad_convert_shared_indices(GLsizei quads) {
+    if (quads > QUAD_U16_MAX_VERTICES / 4) return 0;
+    QuadState* qc = quad_state();
+    if (!ensure_shared_indices(qc, &qc->shared_u16, GL_UNSIGNED_SHORT, quads)) return 0;
+    return qc->shared_u16.buffer;
+}
+
+bool quad_convert_draw_arrays(GLenum mode, GLint first, GLsizei count,
+                              GLsizei instancecount) {
+    GLenum remapped = remap_mode(mode);
+    if (remapped) {
+        if (instancecount != 1) glDrawArraysInstanced(remapped, first, count, instancecount);
+        else glDrawArrays(remapped, first, count);
+        return true;
+    }
+    if (mode != GL_QUADS) return false;
+
+    GLsizei quads = count / 4;
+    if (quads <= 0 || first < 0) return true;
+    QuadState* qc = quad_state();
+
+    /* Indices are relative to `first`, which becomes the base vertex */
+    GLenum type = (GLsizeiptr)quads * 4 <= QUAD_U16_MAX_VERTICES
+                  ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    QuadIndexBuffer* qib = type == GL_UNSIGNED_SHORT ? &qc->shared_u16 : &qc->shared_u32;
+
+    GLuint prev_elements = bound_element_buffer();
+    if (ensure_shared_indices(qc, qib, type, quads)) {
+        state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, qib->buffer);
+        draw_triangles(quads * 6, type, NULL, instancecount, first);
+    } else {
+        LOGE("Failed to build quad index buffer for %d quads", quads);
+    }
+    state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, prev_elements);
+    return true;
+}
+
+/* ===== Converted index cache ===== */
+
+static ConvertedIndices* cache_slot(QuadState* qc, GLuint source, GLintptr offset,
+                                    GLsizei count, GLenum type) {
+    uint32_t h = source * 2654435761u;
+    h ^= (uint32_t)offset * 40503u;
+    h ^= (uint32_t)count * 2246822519u;
+    h ^= type;
+    return &qc->cache[(h >> 7) % QUAD_CACHE_SIZE];
+}
+
+/* Convert `quads` quads read from `source` at `offset` into `entry` */
+static bool fill_cache_entry(QuadState* qc, ConvertedIndices* entry, GLuint source,
+                             GLintptr offset, GLsizei quads, GLenum type) {
+    size_t elem = (size_t)index_size(type);
+    GLsizeiptr src_bytes = (GLsizeiptr)((size_t)quads * 4 * elem);
+    size_t dst_bytes = (size_t)quads * 6 * elem;
+
+    void* dst = scratch_reserve(qc, dst_bytes);
+    if (!dst) return false;
+
+    const void* src = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, offset, src_bytes, GL_MAP_READ_BIT);
+    if (!src) {
+        LOGE("Cannot read index buffer %u for quad conversion", source);
+        return false;
+    }
+    convert_quads(type, src, dst, quads);
+    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+
+    if (!entry->buffer) glGenBuffers(1, &entry->buffer);
+    state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, entry->buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)dst_bytes, dst, GL_STATIC_DRAW);
+
+    if (!entry->source) qc->cached++;
+    entry->source = source;
+    entry->offset = offset;
+    entry->count = quads * 4;
+    entry->type = type;
+    return true;
+}
+
+bool quad_convert_draw_elements(GLenum mode, GLsizei count, GLenum type,
+                                const void* indices, GLsizei instancecount,
+                                GLint basevertex) {
+    GLenum remapped = remap_mode(mode);
+    if (remapped) {
+        if (instancecount != 1) {
+            glDrawElementsInstancedBaseVertex(remapped, count, type, indices,
+                                              instancecount, basevertex);
+        } else {
+            glDrawElementsBaseVertex(remapped, count, type, indices, basevertex);
+        }
+        return true;
+    }
+    if (mode != GL_QUADS) return false;
+
+    GLsizei quads = count / 4;
+    if (quads <= 0) return true;
+    QuadState* qc = quad_state();
+
+    GLuint source = bound_element_buffer();
+
+    if (source != 0) {
+        GLintptr offset = (GLintptr)(uintptr_t)indices;
+        ConvertedIndices* entry = cache_slot(qc, source, offset, quads * 4, type);
+        bool hit = entry->source == source && entry->offset == offset &&
+                   entry->count == quads * 4 && entry->type == type;
+
+        if (hit) {
+            state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, entry->buffer);
+        } else if (!fill_cache_entry(qc, entry, source, offset, quads, type)) {
+            state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, source);
+            return true;
+        }
+        draw_triangles(quads * 6, type, NULL, instancecount, basevertex);
+        state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, source);
+        return true;
+    }
+
+    /* Client memory can change between draws: convert straight into the stream */
+    if (!indices) return true;
+    if (!qc->stream_created) {
+        qc->stream_created = stream_buffer_init(&qc->stream, GL_ELEMENT_ARRAY_BUFFER,
+                                                STREAM_INDEX_SIZE);
+        if (!qc->stream_created) return true;
+    }
+
+    GLsizeiptr at = 0;
+    void* dst = stream_buffer_map(&qc->stream,
+                                  (GLsizeiptr)quads * 6 * index_size(type), &at);
+    if (dst) {
+        convert_quads(type, indices, dst, quads);
+        stream_buffer_unmap(&qc->stream);
+        draw_triangles(quads * 6, type, (const void*)(uintptr_t)at, instancecount, basevertex);
+    }
+    state_shadow_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    return true;
+}
+
+/* ===== Invalidation ===== */
+
+static void invalidate_source(QuadState* qc, GLuint source) {
+    for (int i = 0; i < QUAD_CACHE_SIZE && qc->cached > 0; i++) {
+        if (qc->cache[i].source == source) {
+            qc->cache[i].source = 0;
+            qc->cached--;
+        }
+    }
+}
+
+void quad_convert_invalidate_target(GLenum target) {
+    QuadState* qc = quad_state();
+    /* Only pay for the binding query while conversions are cached */
+    if (qc->cached == 0) return;
+
+    GLenum binding = state_shadow_buffer_binding(target);
+    if (!binding) return;
+
+    GLint bound = 0;
+    state_shadow_get_integerv(binding, &bound);
+    if (bound != 0) invalidate_source(qc, (GLuint)bound);
+}
+
+void quad_convert_invalidate_buffers(GLsizei n, const GLuint* buffers) {
+    if (!buffers) return;
+    QuadState* qc = quad_state();
+    for (GLsizei i = 0; i < n && qc->cached > 0; i++) {
+        if (buffers[i] != 0) invalidate_source(qc, buffers[i]);
+    }
+}
+
+void quad_convert_shutdown(void) {
+    QuadState* qc = quad_state();
+    if (qc->shared_u16.buffer) state_shadow_delete_buffers(1, &qc->shared_u16.buffer);
+    if (qc->shared_u32.buffer) state_shadow_delete_buffers(1, &qc->shared_u32.buffer);
+    memset(&qc->shared_u16, 0, sizeof(qc->shared_u16));
+    memset(&qc->shared_u32, 0, sizeof(qc->shared_u32));
+
+    for (int i = 0; i < QUAD_CACHE_SIZE; i++) {
+        if (qc->cache[i].buffer) state_shadow_delete_buffers(1, &qc->cache[i].buffer);
+        memset(&qc->cache[i], 0, sizeof(qc->cache[i]));
+    }
+    qc->cached = 0;
+
+    if (qc->stream_created) {
+        stream_buffer_destroy(&qc->stream);
+        qc->stream_created = false;
+    }
+
+    free(qc->scratch);
+    qc->scratch = NULL;
+    qc->scratch_size = 0;
+}
@@ -4,6 +4,8 @@
  */
 
 #include "shader_translator.h"
+#include "matrix_stack.h"
+#include "prismgl_internal.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,6 +21,7 @@
 #define MAX_SHADER_SIZE (256 * 1024)
 
 static bool g_translator_initialized = false;
+static int g_sample_counter_binding = -1;
 
 bool shader_translator_init(void) {
     if (g_translator_initialized) return true;
@@ -74,6 +77,77 @@ static char* str_replace_all(const char* source, const char* find, const char* r
     return result;
 }
 
+static bool is_ident_char(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+/* Like str_replace_all, but only matches whole identifiers. Stores the
+ * number of replacements in *count. */
+static char* replace_identifier(const char* source, const char* find, const char* replace,
+                                int* count) {
+    size_t find_len = strlen(find);
+    size_t replace_len = strlen(replace);
+    bool check_tail = is_ident_char(find[find_len - 1]);
+
+    size_t cap = strlen(source) + 1;
+    const char* p = source;
+    while ((p = strstr(p, find)) != NULL) {
+        cap += replace_len;
+        p += find_len;
+    }
+
+    char* result = (char*)malloc(cap);
+    if (!result) return NULL;
+
+    char* dst = result;
+    *count = 0;
+    p = source;
+    while (*p) {
+        if (strncmp(p, find, find_len) == 0 &&
+            (p == source || !is_ident_char(p[-1])) &&
+            (!check_tail || !is_ident_char(p[find_len]))) {
+            memcpy(dst, replace, replace_len);
+            dst += replace_len;
+            p += find_len;
+            (*count)++;
+        } else {
+            *dst++ = *p++;
+        }
+    }
+    *dst = '\0';
+    return result;
+}
+
+/* Insert a declaration block right after the precision statements */
+static char* insert_after_precision(const char* source, const char* decl) {
+    const char* insert_after = strstr(source, "precision highp");
+    if (!insert_after) return NULL;
+
+    size_t decl_len = strlen(decl);
+    size_t work_len = strlen(source);
+    char* new_src = (char*)malloc(work_len + decl_len + 1);
+    if (!new_src) return NULL;
+
+    /* Find end of last precision line */
+    const char* p = insert_after;
+    while (*p) {
+        if (*p == '\n') {
+            const char* next = p + 1;
+            if (strncmp(next, "precision", 9) != 0) {
+                break;
+            }
+        }
+        p++;
+    }
+    if (*p == '\n') p++;
+    size_t prefix = (size_t)(p - source);
+    memcpy(new_src, source, prefix);
+    memcpy(new_src + prefix, decl, decl_len);
+    memcpy(new_src + prefix + decl_len, p, work_len - prefix);
+    new_src[work_len + decl_len] = '\0';
+    return new_src;
+}
+
 char* shader_patch_extensions(const char* source) {
     char* result = strdup(source);
     if (!result) return NULL;
@@ -243,6 +317,70 @@ char* shader_patch_builtins(const char* source) {
     return result;
 }
 
+char* shader_patch_fixed_function(const char* source, GLenum shader_type) {
+    char* result = strdup(source);
+    if (!result) return NULL;
+
+    /* Legacy built-in -> emulation name, declaration */
+    static const char* matrix_builtins[][3] = {
+        { "gl_ModelViewProjectionMatrix", PRISMGL_UNIFORM_MVP,
+          "uniform mat4 " PRISMGL_UNIFORM_MVP ";\n" },
+        { "gl_ModelViewMatrix",           PRISMGL_UNIFORM_MODELVIEW,
+          "uniform mat4 " PRISMGL_UNIFORM_MODELVIEW ";\n" },
+        { "gl_ProjectionMatrix",          PRISMGL_UNIFORM_PROJECTION,
+          "uniform mat4 " PRISMGL_UNIFORM_PROJECTION ";\n" },
+        { "gl_TextureMatrix[0]",          PRISMGL_UNIFORM_TEXTURE,
+          "uniform mat4 " PRISMGL_UNIFORM_TEXTURE ";\n" },
+        { "gl_NormalMatrix",              PRISMGL_UNIFORM_NORMAL,
+          "uniform mat3 " PRISMGL_UNIFORM_NORMAL ";\n" },
+        { NULL, NULL, NULL }
+    };
+
+    /* Vertex attributes map onto the fixed-function emulation locations */
+    static const char* attrib_builtins[][3] = {
+        { "gl_MultiTexCoord0", "prismgl_MultiTexCoord0",
+          "layout(location = 2) in vec4 prismgl_MultiTexCoord0;\n" },
+        { "gl_Vertex",         "prismgl_Vertex",
+          "layout(location = 0) in vec4 prismgl_Vertex;\n" },
+        { "gl_Color",          "prismgl_Color",
+          "layout(location = 1) in vec4 prismgl_Color;\n" },
+        { "gl_Normal",         "prismgl_Normal",
+          "layout(location = 3) in vec3 prismgl_Normal;\n" },
+        { NULL, NULL, NULL }
+    };
+
+    char decls[1024];
+    size_t decl_len = 0;
+    decls[0] = '\0';
+
+    for (int i = 0; matrix_builtins[i][0] != NULL; i++) {
+        int count = 0;
+        char* tmp = replace_identifier(result, matrix_builtins[i][0], matrix_builtins[i][1], &count);
+        if (tmp) { free(result); result = tmp; }
+        if (count == 0) continue;
+        decl_len += (size_t)snprintf(decls + decl_len, sizeof(decls) - decl_len,
+                                     "%s", matrix_builtins[i][2]);
+    }
+
+    if (shader_type == GL_VERTEX_SHADER) {
+        for (int i = 0; attrib_builtins[i][0] != NULL; i++) {
+            int count = 0;
+            char* tmp = replace_identifier(result, attrib_builtins[i][0], attrib_builtins[i][1], &count);
+            if (tmp) { free(result); result = tmp; }
+            if (count == 0) continue;
+            decl_len += (size_t)snprintf(decls + decl_len, sizeof(decls) - decl_len,
+                                         "%s", attrib_builtins[i][2]);
+        }
+    }
+
+    if (decl_len > 0) {
+        char* tmp = insert_after_precision(result, decls);
+        if (tmp) { free(result); result = tmp; }
+    }
+
+    return result;
+}
+
 ShaderTranslation shader_translate(const char* source, GLenum shader_type) {
     ShaderTranslation result;
     memset(&result, 0, sizeof(result));
@@ -317,6 +455,10 @@ ShaderTranslation shader_translate(const char* source, GLenum shader_type) {
     tmp = shader_patch_builtins(working);
     if (tmp) { free(working); working = tmp; }
 
+    /* Step 5b: Map fixed-function built-ins onto the emulation uniforms */
+    tmp = shader_patch_fixed_function(working, shader_type);
+    if (tmp) { free(working); working = tmp; }
+
     /* Step 6: Replace unsupported double-precision types */
     static const char* type_replacements[][2] = {
         { "dvec2", "vec2" },
@@ -351,37 +493,8 @@ ShaderTranslation shader_translate(const char* source, GLenum shader_type) {
             if (tmp) { free(working); working = tmp; }
 
             /* Insert output declaration after precision */
-            const char* out_decl = "out vec4 prismgl_FragColor;\n";
-            size_t decl_len = strlen(out_decl);
-            size_t work_len = strlen(working);
-            char* new_src = (char*)malloc(work_len + decl_len + 1);
-            if (new_src) {
-                /* Find insertion point after precision block */
-                const char* insert_after = strstr(working, "precision highp");
-                if (insert_after) {
-                    /* Find end of last precision line */
-                    const char* p = insert_after;
-                    while (*p) {
-                        if (*p == '\n') {
-                            const char* next = p + 1;
-                            if (strncmp(next, "precision", 9) != 0) {
-                                break;
-                            }
-                        }
-                        p++;
-                    }
-                    if (*p == '\n') p++;
-                    size_t prefix = (size_t)(p - working);
-                    memcpy(new_src, working, prefix);
-                    memcpy(new_src + prefix, out_decl, decl_len);
-                    memcpy(new_src + prefix + decl_len, p, work_len - prefix);
-                    new_src[prefix + decl_len + work_len - prefix] = '\0';
-                    free(working);
-                    working = new_src;
-                } else {
-                    free(new_src);
-                }
-            }
+            tmp = insert_after_precision(working, "out vec4 prismgl_FragColor;\n");
+            if (tmp) { free(working); working = tmp; }
         }
 
         /* varying -> in for fragment shaders */
@@ -397,6 +510,12 @@ ShaderTranslation shader_translate(const char* source, GLenum shader_type) {
         if (tmp) { free(working); working = tmp; }
     }
 
+    /* Step 8: Count samples for GL_SAMPLES_PASSED queries */
+    if (shader_type == GL_FRAGMENT_SHADER && g_sample_counter_binding >= 0) {
+        tmp = shader_patch_sample_counter(working, g_sample_counter_binding);
+        if (tmp) { free(working); working = tmp; }
+    }
+
     result.translated_source = working;
     result.success = true;
 
@@ -410,3 +529,304 @@ void shader_translation_free(ShaderTranslation* result) {
         result->translated_source = NULL;
     }
 }
+
+/* ===== Instanced uniforms ===== */
+
+typedef struct {
+    const char* start;      /* First character of the declaration statement */
+    const char* end;        /* One past its ';' */
+    const char* type;       /* Precision qualifier and type */
+    size_t type_len;
+    bool simple;            /* `uniform [precision] <type> <name>;` and nothing else */
+} UniformDecl;
+
+static const char* skip_space(const char* p) {
+    for (;;) {
+        while (isspace((unsigned char)*p)) p++;
+        if (p[0] == '/' && p[1] == '/') {
+            while (*p && *p != '\n') p++;
+        } else if (p[0] == '/' && p[1] == '*') {
+            const char* e = strstr(p + 2, "*/");
+            p = e ? e + 2 : p + strlen(p);
+        } else {
+            return p;
+        }
+    }
+}
+
+static const char* read_identifier(const char* p, size_t* len) {
+    const char* s = p;
+    if (!isalpha((unsigned char)*p) && *p != '_') {
+        *len = 0;
+        return p;
+    }
+    while (is_ident_char(*p)) p++;
+    *len = (size_t)(p - s);
+    return p;
+}
+
+static bool identifier_is(const char* p, size_t len, const char* word) {
+    return len == strlen(word) && strncmp(p, word, len) == 0;
+}
+
+/* Whether `name` appears as a whole identifier in [p, end) */
+static bool mentions_identifier(const char* p, const char* end, const char* name) {
+    size_t name_len = strlen(name);
+    while (p < end) {
+        size_t len;
+        const char* next = read_identifier(p, &len);
+        if (len == 0) {
+            p++;
+            continue;
+        }
+        if (len == name_len && strncmp(p, name, len) == 0) return true;
+        p = next;
+    }
+    return false;
+}
+
+/* Parse the statement [start, semi) as a declaration of the uniform `name` */
+static bool match_uniform_decl(const char* start, const char* semi, const char* name,
+                               UniformDecl* out) {
+    size_t len;
+    const char* p = skip_space(start);
+    const char* q = read_identifier(p, &len);
+
+    if (identifier_is(p, len, "layout")) {
+        p = skip_space(q);
+        if (*p != '(') return false;
+        while (p < semi && *p != ')') p++;
+        p = skip_space(p + 1);
+        q = read_identifier(p, &len);
+    }
+    if (!identifier_is(p, len, "uniform")) return false;
+    if (!mentions_identifier(q, semi, name)) return false;
+
+    out->start = start;
+    out->end = semi + 1;
+    out->simple = false;
+
+    /* Optional precision qualifier, then type and name */
+    p = skip_space(q);
+    out->type = p;
+    q = read_identifier(p, &len);
+    if (identifier_is(p, len, "lowp") || identifier_is(p, len, "mediump") ||
+        identifier_is(p, len, "highp")) {
+        p = skip_space(q);
+        q = read_identifier(p, &len);
+    }
+    if (len == 0) return true;
+    out->type_len = (size_t)(q - out->type);
+
+    p = skip_space(q);
+    q = read_identifier(p, &len);
+    out->simple = identifier_is(p, len, name) && skip_space(q) == semi;
+    return true;
+}
+
+/*
+ * Find the next global declaration of the uniform `name` at or after
+ * *cursor, skipping comments, preprocessor lines and function bodies.
+ */
+static bool next_uniform_decl(const char** cursor, const char* name, UniformDecl* out) {
+    const char* p = *cursor;
+    const char* stmt = NULL;
+    int depth = 0;
+
+    while (*p) {
+        if (p[0] == '/' && (p[1] == '/' || p[1] == '*')) {
+            p = skip_space(p);
+            continue;
+        }
+        if (*p == '#') {
+            while (*p && *p != '\n') p++;
+            continue;
+        }
+        if (depth == 0 && !stmt && !isspace((unsigned char)*p)) stmt = p;
+
+        if (*p == '{') {
+            depth++;
+        } else if (*p == '}') {
+            if (--depth <= 0) {
+                depth = 0;
+                stmt = NULL;
+            }
+        } else if (*p == ';' && depth == 0) {
+            if (stmt && match_uniform_decl(stmt, p, name, out)) {
+                *cursor = p + 1;
+                return true;
+            }
+            stmt = NULL;
+        }
+        p++;
+    }
+    *cursor = p;
+    return false;
+}
+
+/* Start of the first declaration, after #version, #extension and the like */
+static const char* first_declaration(const char* source) {
+    const char* p = source;
+    for (;;) {
+        p = skip_space(p);
+        if (*p != '#') return p;
+        while (*p && *p != '\n') p++;
+    }
+}
+
+/* Insert `text` at `at`, which points into `source` */
+static char* insert_at(const char* source, const char* at, const char* text) {
+    size_t prefix = (size_t)(at - source);
+    size_t text_len = strlen(text);
+    size_t rest = strlen(at);
+    char* result = (char*)malloc(prefix + text_len + rest + 1);
+    if (!result) return NULL;
+    memcpy(result, source, prefix);
+    memcpy(result + prefix, text, text_len);
+    memcpy(result + prefix + text_len, at, rest + 1);
+    return result;
+}
+
+/* Replace every simple declaration of `name`; NULL if any is not simple */
+static char* replace_uniform_decl(const char* source, const char* name, const char* decl) {
+    const char* cursor = source;
+    UniformDecl d;
+    size_t count = 0;
+    while (next_uniform_decl(&cursor, name, &d)) {
+        if (!d.simple) return NULL;
+        count++;
+    }
+    if (count == 0) return NULL;
+
+    size_t decl_len = strlen(decl);
+    char* result = (char*)malloc(strlen(source) + count * decl_len + 1);
+    if (!result) return NULL;
+
+    char* dst = result;
+    const char* copied = source;
+    cursor = source;
+    while (next_uniform_decl(&cursor, name, &d)) {
+        memcpy(dst, copied, (size_t)(d.start - copied));
+        dst += d.start - copied;
+        memcpy(dst, decl, decl_len);
+        dst += decl_len;
+        copied = d.end;
+    }
+    strcpy(dst, copied);
+    return result;
+}
+
+/* Position right after the opening brace of main() */
+static const char* main_body(const char* source) {
+    const char* p = source;
+    while ((p = strstr(p, "main")) != NULL) {
+        if ((p == source || !is_ident_char(p[-1])) && !is_ident_char(p[4])) {
+            const char* q = skip_space(p + 4);
+            if (*q == '(') {
+                while (*q && *q != ')') q++;
+                q = skip_space(*q ? q + 1 : q);
+                if (*q == '{') return q + 1;
+            }
+        }
+        p += 4;
+    }
+    return NULL;
+}
+
+bool shader_declares_uniform(const char* source, const char* name) {
+    UniformDecl d;
+    return next_uniform_decl(&source, name, &d);
+}
+
+bool shader_uniform_type(const char* source, const char* name, char* type, size_t size) {
+    UniformDecl d;
+    if (!next_uniform_decl(&source, name, &d) || !d.simple || d.type_len >= size) return false;
+    memcpy(type, d.type, d.type_len);
+    type[d.type_len] = '\0';
+    return true;
+}
+
+char* shader_instance_vertex(const char* source, const char* name, const char* type,
+                             int index, bool forward) {
+    char decl[256];
+    char* result;
+
+    if (shader_declares_uniform(source, name)) {
+        snprintf(decl, sizeof(decl), "in %s prismgl_Instance%d;\n#define %s prismgl_Instance%d\n",
+                 type, index, name, index);
+        result = replace_uniform_decl(source, name, decl);
+    } else if (forward) {
+        snprintf(decl, sizeof(decl), "in %s prismgl_Instance%d;\n", type, index);
+        result = insert_at(source, first_declaration(source), decl);
+    } else {
+        return NULL;
+    }
+    if (!result || !forward) return result;
+
+    /* Hand the value to the fragment shader unchanged */
+    snprintf(decl, sizeof(decl), "flat out %s prismgl_InstanceVarying%d;\n", type, index);
+    char* tmp = insert_at(result, first_declaration(result), decl);
+    free(result);
+    if (!tmp) return NULL;
+    result = tmp;
+
+    const char* body = main_body(result);
+    if (!body) {
+        free(result);
+        return NULL;
+    }
+    snprintf(decl, sizeof(decl), "\n    prismgl_InstanceVarying%d = prismgl_Instance%d;", index, index);
+    tmp = insert_at(result, body, decl);
+    free(result);
+    return tmp;
+}
+
+char* shader_instance_fragment(const char* source, const char* name, const char* type,
+                               int index) {
+    char decl[256];
+    snprintf(decl, sizeof(decl),
+             "flat in %s prismgl_InstanceVarying%d;\n#define %s prismgl_InstanceVarying%d\n",
+             type, index, name, index);
+    return replace_uniform_decl(source, name, decl);
+}
+
+/* ===== Sample counting ===== */
+
+void shader_translator_set_sample_counter(int binding) {
+    g_sample_counter_binding = binding;
+}
+
+char* shader_patch_sample_counter(const char* source, int binding) {
+    const char* end = source + strlen(source);
+    /*
+     * Early tests would write depth before a discard, and ignore
+     * gl_FragDepth; such shaders are left alone and not counted.
+     */
+    if (mentions_identifier(source, end, "discard") ||
+        mentions_identifier(source, end, "gl_FragDepth") ||
+        mentions_identifier(source, end, "prismgl_CountSamples")) {
+        return NULL;
+    }
+
+    char decl[256];
+    snprintf(decl, sizeof(decl),
+             "%slayout(binding = %d, offset = 0) uniform atomic_uint prismgl_SampleCount;\n"
+             "uniform highp uint prismgl_CountSamples;\n",
+             mentions_identifier(source, end, "early_fragment_tests")
+                 ? "" : "layout(early_fragment_tests) in;\n",
+             binding);
+    char* result = insert_at(source, first_declaration(source), decl);
+    if (!result) return NULL;
+
+    /* Every invocation that starts has passed the depth and stencil tests */
+    const char* body = main_body(result);
+    if (!body) {
+        free(result);
+        return NULL;
+    }
+    char* tmp = insert_at(result, body,
+                          "\n    if (prismgl_CountSamples != 0u) "
+                          "atomicCounterIncrement(prismgl_SampleCount);");
+    free(result);
+    return tmp;
+}
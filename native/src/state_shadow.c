@@ -0,0 +1,919 @@
+/*
+ * PrismGL State Shadow
+ * Minecraft, Sodium and Iris re-set the same enables, bindings, program
+ * and blend state many times per frame. Every entry point here compares
+ * against a client-side copy of the context state and drops calls that
+ * would not change anything. State that has not been seen yet is unknown
+ * and always forwarded, so the shadow never has to guess initial values.
+ * The same copy answers glGet queries, which stall the command stream on
+ * several Android drivers.
+ */
+
+#include "state_shadow.h"
+#include "context.h"
+#include "prismgl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-State"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define SHADOW_TEXTURE_UNITS      32
+#define SHADOW_ATTACHMENTS        64
+#define SHADOW_STATS_LOG_INTERVAL 600
+
+/*
+ * Bindings are stored as name + 1 so that zeroed storage means "unknown".
+ * The same encoding is used for the active texture unit.
+ */
+#define SHADOW_UNKNOWN   0u
+#define SHADOW_VALUE(n)  ((GLuint)(n) + 1u)
+
+enum {
+    CAP_BLEND = 0,
+    CAP_CULL_FACE,
+    CAP_DEPTH_TEST,
+    CAP_DITHER,
+    CAP_POLYGON_OFFSET_FILL,
+    CAP_PRIMITIVE_RESTART,
+    CAP_RASTERIZER_DISCARD,
+    CAP_SAMPLE_ALPHA_TO_COVERAGE,
+    CAP_SAMPLE_COVERAGE,
+    CAP_SCISSOR_TEST,
+    CAP_STENCIL_TEST,
+    CAP_COUNT
+};
+
+enum {
+    TEX_2D = 0,
+    TEX_3D,
+    TEX_2D_ARRAY,
+    TEX_CUBE_MAP,
+    TEX_CUBE_MAP_ARRAY,
+    TEX_2D_MULTISAMPLE,
+    TEX_BUFFER,
+    TEX_TARGET_COUNT
+};
+
+enum {
+    BUF_ARRAY = 0,
+    BUF_ELEMENT_ARRAY,          /* Per VAO: unknown after every VAO change */
+    BUF_COPY_READ,
+    BUF_COPY_WRITE,
+    BUF_PIXEL_PACK,
+    BUF_PIXEL_UNPACK,
+    BUF_UNIFORM,
+    BUF_SHADER_STORAGE,
+    BUF_ATOMIC_COUNTER,
+    BUF_DRAW_INDIRECT,
+    BUF_DISPATCH_INDIRECT,
+    BUF_TEXTURE,
+    BUF_TARGET_COUNT
+};
+
+enum {
+    PIXEL_UNPACK_ALIGNMENT = 0,
+    PIXEL_UNPACK_ROW_LENGTH,
+    PIXEL_UNPACK_IMAGE_HEIGHT,
+    PIXEL_UNPACK_SKIP_ROWS,
+    PIXEL_UNPACK_SKIP_PIXELS,
+    PIXEL_UNPACK_SKIP_IMAGES,
+    PIXEL_PACK_ALIGNMENT,
+    PIXEL_PACK_ROW_LENGTH,
+    PIXEL_PACK_SKIP_ROWS,
+    PIXEL_PACK_SKIP_PIXELS,
+    PIXEL_STORE_COUNT
+};
+
+/* Shadowed state of one GL context */
+/* A texture level attached to a framebuffer through PrismGL */
+typedef struct {
+    GLuint framebuffer;
+    GLenum attachment;
+    GLenum textarget;           /* 0 for glFramebufferTextureLayer */
+    GLuint texture;
+    GLint level;
+    GLint layer;
+} ShadowAttachment;
+
+typedef struct {
+    uint32_t caps_known;
+    uint32_t caps_enabled;
+    GLuint active_unit;
+    GLuint textures[SHADOW_TEXTURE_UNITS][TEX_TARGET_COUNT];
+    GLuint buffers[BUF_TARGET_COUNT];
+    GLuint pixel_store[PIXEL_STORE_COUNT];  /* Same encoding as bindings */
+    GLuint vertex_array;
+    GLuint program;
+    GLenum blend[4];            /* src_rgb, dst_rgb, src_alpha, dst_alpha */
+    bool blend_known;
+    GLuint depth_mask;
+    GLuint draw_framebuffer;
+    GLuint read_framebuffer;
+    GLint viewport[4];
+    bool viewport_known;
+    GLint scissor[4];
+    bool scissor_known;
+    StateShadowStats frame;
+    StateShadowStats last;
+    uint64_t frames;
+    /* Object state, not bindings: kept by state_shadow_reset */
+    ShadowAttachment attachments[SHADOW_ATTACHMENTS];
+    int attachment_count;
+} StateShadow;
+
+/* Counters of the last frame presented by any context, for JNI readers */
+static StateShadowStats g_last_frame;
+
+#ifdef DEBUG
+static bool g_validate = true;
+#else
+static bool g_validate = false;
+#endif
+
+static inline StateShadow* current_shadow(void) {
+    return (StateShadow*)prismgl_context_state(PRISMGL_STATE_SHADOW);
+}
+
+void* state_shadow_create_state(void) {
+    /* Zeroed storage is the all-unknown state */
+    return calloc(1, sizeof(StateShadow));
+}
+
+void state_shadow_destroy_state(void* state) {
+    free(state);
+}
+
+static const GLenum g_cap_enums[CAP_COUNT] = {
+    [CAP_BLEND]                    = GL_BLEND,
+    [CAP_CULL_FACE]                = GL_CULL_FACE,
+    [CAP_DEPTH_TEST]               = GL_DEPTH_TEST,
+    [CAP_DITHER]                   = GL_DITHER,
+    [CAP_POLYGON_OFFSET_FILL]      = GL_POLYGON_OFFSET_FILL,
+    [CAP_PRIMITIVE_RESTART]        = GL_PRIMITIVE_RESTART_FIXED_INDEX,
+    [CAP_RASTERIZER_DISCARD]       = GL_RASTERIZER_DISCARD,
+    [CAP_SAMPLE_ALPHA_TO_COVERAGE] = GL_SAMPLE_ALPHA_TO_COVERAGE,
+    [CAP_SAMPLE_COVERAGE]          = GL_SAMPLE_COVERAGE,
+    [CAP_SCISSOR_TEST]             = GL_SCISSOR_TEST,
+    [CAP_STENCIL_TEST]             = GL_STENCIL_TEST,
+};
+
+static int cap_index(GLenum cap) {
+    switch (cap) {
+        case GL_BLEND:                    return CAP_BLEND;
+        case GL_CULL_FACE:                return CAP_CULL_FACE;
+        case GL_DEPTH_TEST:               return CAP_DEPTH_TEST;
+        case GL_DITHER:                   return CAP_DITHER;
+        case GL_POLYGON_OFFSET_FILL:      return CAP_POLYGON_OFFSET_FILL;
+        case GL_PRIMITIVE_RESTART_FIXED_INDEX: return CAP_PRIMITIVE_RESTART;
+        case GL_RASTERIZER_DISCARD:       return CAP_RASTERIZER_DISCARD;
+        case GL_SAMPLE_ALPHA_TO_COVERAGE: return CAP_SAMPLE_ALPHA_TO_COVERAGE;
+        case GL_SAMPLE_COVERAGE:          return CAP_SAMPLE_COVERAGE;
+        case GL_SCISSOR_TEST:             return CAP_SCISSOR_TEST;
+        case GL_STENCIL_TEST:             return CAP_STENCIL_TEST;
+        default:                          return -1;
+    }
+}
+
+static int texture_target_index(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_2D:             return TEX_2D;
+        case GL_TEXTURE_3D:             return TEX_3D;
+        case GL_TEXTURE_2D_ARRAY:       return TEX_2D_ARRAY;
+        case GL_TEXTURE_CUBE_MAP:       return TEX_CUBE_MAP;
+        case GL_TEXTURE_CUBE_MAP_ARRAY: return TEX_CUBE_MAP_ARRAY;
+        case GL_TEXTURE_2D_MULTISAMPLE: return TEX_2D_MULTISAMPLE;
+        case GL_TEXTURE_BUFFER:         return TEX_BUFFER;
+        default:                        return -1;
+    }
+}
+
+static int buffer_target_index(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER:             return BUF_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER:     return BUF_ELEMENT_ARRAY;
+        case GL_COPY_READ_BUFFER:         return BUF_COPY_READ;
+        case GL_COPY_WRITE_BUFFER:        return BUF_COPY_WRITE;
+        case GL_PIXEL_PACK_BUFFER:        return BUF_PIXEL_PACK;
+        case GL_PIXEL_UNPACK_BUFFER:      return BUF_PIXEL_UNPACK;
+        case GL_UNIFORM_BUFFER:           return BUF_UNIFORM;
+        case GL_SHADER_STORAGE_BUFFER:    return BUF_SHADER_STORAGE;
+        case GL_ATOMIC_COUNTER_BUFFER:    return BUF_ATOMIC_COUNTER;
+        case GL_DRAW_INDIRECT_BUFFER:     return BUF_DRAW_INDIRECT;
+        case GL_DISPATCH_INDIRECT_BUFFER: return BUF_DISPATCH_INDIRECT;
+        case GL_TEXTURE_BUFFER:           return BUF_TEXTURE;
+        /* Transform feedback buffer binding belongs to the TF object */
+        default:                          return -1;
+    }
+}
+
+/* Generic buffer binding queries, e.g. GL_ARRAY_BUFFER_BINDING */
+static int buffer_binding_index(GLenum pname) {
+    switch (pname) {
+        case GL_ARRAY_BUFFER_BINDING:             return BUF_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER_BINDING:     return BUF_ELEMENT_ARRAY;
+        case GL_COPY_READ_BUFFER_BINDING:         return BUF_COPY_READ;
+        case GL_COPY_WRITE_BUFFER_BINDING:        return BUF_COPY_WRITE;
+        case GL_PIXEL_PACK_BUFFER_BINDING:        return BUF_PIXEL_PACK;
+        case GL_PIXEL_UNPACK_BUFFER_BINDING:      return BUF_PIXEL_UNPACK;
+        case GL_UNIFORM_BUFFER_BINDING:           return BUF_UNIFORM;
+        case GL_SHADER_STORAGE_BUFFER_BINDING:    return BUF_SHADER_STORAGE;
+        case GL_ATOMIC_COUNTER_BUFFER_BINDING:    return BUF_ATOMIC_COUNTER;
+        case GL_DRAW_INDIRECT_BUFFER_BINDING:     return BUF_DRAW_INDIRECT;
+        case GL_DISPATCH_INDIRECT_BUFFER_BINDING: return BUF_DISPATCH_INDIRECT;
+        case GL_TEXTURE_BUFFER_BINDING:           return BUF_TEXTURE;
+        default:                                  return -1;
+    }
+}
+
+GLenum state_shadow_buffer_binding(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER:              return GL_ARRAY_BUFFER_BINDING;
+        case GL_ELEMENT_ARRAY_BUFFER:      return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+        case GL_COPY_READ_BUFFER:          return GL_COPY_READ_BUFFER_BINDING;
+        case GL_COPY_WRITE_BUFFER:         return GL_COPY_WRITE_BUFFER_BINDING;
+        case GL_PIXEL_PACK_BUFFER:         return GL_PIXEL_PACK_BUFFER_BINDING;
+        case GL_PIXEL_UNPACK_BUFFER:       return GL_PIXEL_UNPACK_BUFFER_BINDING;
+        case GL_UNIFORM_BUFFER:            return GL_UNIFORM_BUFFER_BINDING;
+        case GL_TRANSFORM_FEEDBACK_BUFFER: return GL_TRANSFORM_FEEDBACK_BUFFER_BINDING;
+        case GL_SHADER_STORAGE_BUFFER:     return GL_SHADER_STORAGE_BUFFER_BINDING;
+        case GL_ATOMIC_COUNTER_BUFFER:     return GL_ATOMIC_COUNTER_BUFFER_BINDING;
+        case GL_DRAW_INDIRECT_BUFFER:      return GL_DRAW_INDIRECT_BUFFER_BINDING;
+        case GL_DISPATCH_INDIRECT_BUFFER:  return GL_DISPATCH_INDIRECT_BUFFER_BINDING;
+        case GL_TEXTURE_BUFFER:            return GL_TEXTURE_BUFFER_BINDING;
+        default:                           return 0;
+    }
+}
+
+/* Texture binding queries for the active unit, e.g. GL_TEXTURE_BINDING_2D */
+static int texture_binding_index(GLenum pname) {
+    switch (pname) {
+        case GL_TEXTURE_BINDING_2D:             return TEX_2D;
+        case GL_TEXTURE_BINDING_3D:             return TEX_3D;
+        case GL_TEXTURE_BINDING_2D_ARRAY:       return TEX_2D_ARRAY;
+        case GL_TEXTURE_BINDING_CUBE_MAP:       return TEX_CUBE_MAP;
+        case GL_TEXTURE_BINDING_CUBE_MAP_ARRAY: return TEX_CUBE_MAP_ARRAY;
+        case GL_TEXTURE_BINDING_2D_MULTISAMPLE: return TEX_2D_MULTISAMPLE;
+        case GL_TEXTURE_BINDING_BUFFER:         return TEX_BUFFER;
+        default:                                return -1;
+    }
+}
+
+/* glPixelStorei parameters, which are also their query names */
+static int pixel_store_index(GLenum pname) {
+    switch (pname) {
+        case GL_UNPACK_ALIGNMENT:    return PIXEL_UNPACK_ALIGNMENT;
+        case GL_UNPACK_ROW_LENGTH:   return PIXEL_UNPACK_ROW_LENGTH;
+        case GL_UNPACK_IMAGE_HEIGHT: return PIXEL_UNPACK_IMAGE_HEIGHT;
+        case GL_UNPACK_SKIP_ROWS:    return PIXEL_UNPACK_SKIP_ROWS;
+        case GL_UNPACK_SKIP_PIXELS:  return PIXEL_UNPACK_SKIP_PIXELS;
+        case GL_UNPACK_SKIP_IMAGES:  return PIXEL_UNPACK_SKIP_IMAGES;
+        case GL_PACK_ALIGNMENT:      return PIXEL_PACK_ALIGNMENT;
+        case GL_PACK_ROW_LENGTH:     return PIXEL_PACK_ROW_LENGTH;
+        case GL_PACK_SKIP_ROWS:      return PIXEL_PACK_SKIP_ROWS;
+        case GL_PACK_SKIP_PIXELS:    return PIXEL_PACK_SKIP_PIXELS;
+        default:                     return -1;
+    }
+}
+
+void state_shadow_reset(void) {
+    StateShadow* s = current_shadow();
+    StateShadowStats frame = s->frame;
+    StateShadowStats last = s->last;
+    uint64_t frames = s->frames;
+    ShadowAttachment attachments[SHADOW_ATTACHMENTS];
+    int attachment_count = s->attachment_count;
+    memcpy(attachments, s->attachments, sizeof(attachments));
+
+    memset(s, 0, sizeof(*s));
+    s->frame = frame;
+    s->last = last;
+    s->frames = frames;
+    memcpy(s->attachments, attachments, sizeof(attachments));
+    s->attachment_count = attachment_count;
+}
+
+/* Drop attachment records of `framebuffer` or of `texture`, whichever is non-zero */
+static void forget_attachments(StateShadow* s, GLuint framebuffer, GLuint texture) {
+    for (int i = 0; i < s->attachment_count;) {
+        const ShadowAttachment* a = &s->attachments[i];
+        if ((framebuffer && a->framebuffer == framebuffer) || (texture && a->texture == texture)) {
+            s->attachments[i] = s->attachments[--s->attachment_count];
+        } else {
+            i++;
+        }
+    }
+}
+
+/* ===== Capabilities ===== */
+
+void state_shadow_enable(GLenum cap, bool enable) {
+    StateShadow* s = current_shadow();
+    int index = cap_index(cap);
+
+    if (index >= 0) {
+        uint32_t bit = 1u << index;
+        if ((s->caps_known & bit) && ((s->caps_enabled & bit) != 0) == enable) {
+            s->frame.filtered++;
+            return;
+        }
+        s->caps_known |= bit;
+        if (enable) s->caps_enabled |= bit;
+        else s->caps_enabled &= ~bit;
+    }
+
+    s->frame.forwarded++;
+    if (enable) glEnable(cap);
+    else glDisable(cap);
+}
+
+/* ===== Textures ===== */
+
+void state_shadow_active_texture(GLenum unit) {
+    StateShadow* s = current_shadow();
+    GLuint index = unit - GL_TEXTURE0;
+
+    if (s->active_unit == SHADOW_VALUE(index)) {
+        s->frame.filtered++;
+        return;
+    }
+    s->active_unit = index < SHADOW_TEXTURE_UNITS ? SHADOW_VALUE(index) : SHADOW_UNKNOWN;
+    s->frame.forwarded++;
+    glActiveTexture(unit);
+}
+
+void state_shadow_bind_texture(GLenum target, GLuint texture) {
+    StateShadow* s = current_shadow();
+    int index = texture_target_index(target);
+
+    if (index >= 0 && s->active_unit != SHADOW_UNKNOWN) {
+        GLuint* entry = &s->textures[s->active_unit - 1][index];
+        if (*entry == SHADOW_VALUE(texture)) {
+            s->frame.filtered++;
+            return;
+        }
+        *entry = SHADOW_VALUE(texture);
+    }
+
+    s->frame.forwarded++;
+    glBindTexture(target, texture);
+}
+
+bool state_shadow_texture_bound(GLuint texture) {
+    StateShadow* s = current_shadow();
+    GLuint value = SHADOW_VALUE(texture);
+    for (int u = 0; u < SHADOW_TEXTURE_UNITS; u++) {
+        for (int t = 0; t < TEX_TARGET_COUNT; t++) {
+            if (s->textures[u][t] == value) return true;
+        }
+    }
+    return false;
+}
+
+void state_shadow_delete_textures(GLsizei n, const GLuint* textures) {
+    StateShadow* s = current_shadow();
+    if (!textures) return;
+
+    /* Deleting a bound texture reverts the binding to 0 */
+    for (GLsizei i = 0; i < n; i++) {
+        if (textures[i] == 0) continue;
+        GLuint value = SHADOW_VALUE(textures[i]);
+        for (int u = 0; u < SHADOW_TEXTURE_UNITS; u++) {
+            for (int t = 0; t < TEX_TARGET_COUNT; t++) {
+                if (s->textures[u][t] == value) s->textures[u][t] = SHADOW_VALUE(0);
+            }
+        }
+        forget_attachments(s, 0, textures[i]);
+    }
+    glDeleteTextures(n, textures);
+}
+
+void state_shadow_recreate_texture(GLenum target, GLuint texture) {
+    StateShadow* s = current_shadow();
+    int index = texture_target_index(target);
+    GLuint value = SHADOW_VALUE(texture);
+
+    /* Where the old texture was bound and attached, before deleting forgets it */
+    uint32_t units = 0;
+    for (int u = 0; u < SHADOW_TEXTURE_UNITS && index >= 0; u++) {
+        if (s->textures[u][index] == value) units |= 1u << u;
+    }
+    ShadowAttachment attached[SHADOW_ATTACHMENTS];
+    int attached_count = 0;
+    for (int i = 0; i < s->attachment_count; i++) {
+        if (s->attachments[i].texture == texture) attached[attached_count++] = s->attachments[i];
+    }
+
+    state_shadow_delete_textures(1, &texture);
+    state_shadow_bind_texture(target, texture);
+
+    GLuint active = s->active_unit;
+    if (active != SHADOW_UNKNOWN) {
+        units &= ~(1u << (active - 1));
+        for (int u = 0; units; u++) {
+            if (!(units & (1u << u))) continue;
+            units &= ~(1u << u);
+            state_shadow_active_texture(GL_TEXTURE0 + (GLenum)u);
+            state_shadow_bind_texture(target, texture);
+        }
+        state_shadow_active_texture(GL_TEXTURE0 + (active - 1));
+    }
+
+    if (attached_count > 0) {
+        GLint previous = 0;
+        state_shadow_get_integerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+        for (int i = 0; i < attached_count; i++) {
+            const ShadowAttachment* a = &attached[i];
+            state_shadow_bind_framebuffer(GL_DRAW_FRAMEBUFFER, a->framebuffer);
+            if (a->textarget) {
+                state_shadow_framebuffer_texture_2d(GL_DRAW_FRAMEBUFFER, a->attachment,
+                                                    a->textarget, texture, a->level);
+            } else {
+                state_shadow_framebuffer_texture_layer(GL_DRAW_FRAMEBUFFER, a->attachment,
+                                                       texture, a->level, a->layer);
+            }
+        }
+        state_shadow_bind_framebuffer(GL_DRAW_FRAMEBUFFER, (GLuint)previous);
+    }
+}
+
+/* ===== Buffers and vertex arrays ===== */
+
+void state_shadow_bind_buffer(GLenum target, GLuint buffer) {
+    StateShadow* s = current_shadow();
+    int index = buffer_target_index(target);
+
+    if (index >= 0) {
+        if (s->buffers[index] == SHADOW_VALUE(buffer)) {
+            s->frame.filtered++;
+            return;
+        }
+        s->buffers[index] = SHADOW_VALUE(buffer);
+    }
+
+    s->frame.forwarded++;
+    glBindBuffer(target, buffer);
+}
+
+void state_shadow_buffer_bound_indexed(GLenum target, GLuint buffer) {
+    int index = buffer_target_index(target);
+    if (index >= 0) current_shadow()->buffers[index] = SHADOW_VALUE(buffer);
+}
+
+void state_shadow_delete_buffers(GLsizei n, const GLuint* buffers) {
+    StateShadow* s = current_shadow();
+    if (!buffers) return;
+
+    for (GLsizei i = 0; i < n; i++) {
+        if (buffers[i] == 0) continue;
+        GLuint value = SHADOW_VALUE(buffers[i]);
+        for (int t = 0; t < BUF_TARGET_COUNT; t++) {
+            if (s->buffers[t] == value) s->buffers[t] = SHADOW_VALUE(0);
+        }
+    }
+    glDeleteBuffers(n, buffers);
+}
+
+void state_shadow_bind_vertex_array(GLuint vao) {
+    StateShadow* s = current_shadow();
+
+    if (s->vertex_array == SHADOW_VALUE(vao)) {
+        s->frame.filtered++;
+        return;
+    }
+    s->vertex_array = SHADOW_VALUE(vao);
+    s->buffers[BUF_ELEMENT_ARRAY] = SHADOW_UNKNOWN;
+
+    s->frame.forwarded++;
+    glBindVertexArray(vao);
+}
+
+void state_shadow_delete_vertex_arrays(GLsizei n, const GLuint* arrays) {
+    StateShadow* s = current_shadow();
+    if (!arrays) return;
+
+    for (GLsizei i = 0; i < n; i++) {
+        if (arrays[i] != 0 && s->vertex_array == SHADOW_VALUE(arrays[i])) {
+            s->vertex_array = SHADOW_VALUE(0);
+            s->buffers[BUF_ELEMENT_ARRAY] = SHADOW_UNKNOWN;
+        }
+    }
+    glDeleteVertexArrays(n, arrays);
+}
+
+/* ===== Pixel storage ===== */
+
+void state_shadow_pixel_store(GLenum pname, GLint param) {
+    StateShadow* s = current_shadow();
+    int index = pixel_store_index(pname);
+    GLuint value = SHADOW_VALUE(param);
+
+    if (index >= 0 && s->pixel_store[index] == value) {
+        s->frame.filtered++;
+        return;
+    }
+    /* Values GL rejects leave the state as it was */
+    bool alignment = pname == GL_UNPACK_ALIGNMENT || pname == GL_PACK_ALIGNMENT;
+    bool valid = alignment ? param == 1 || param == 2 || param == 4 || param == 8 : param >= 0;
+    if (index >= 0 && valid) s->pixel_store[index] = value;
+
+    s->frame.forwarded++;
+    glPixelStorei(pname, param);
+}
+
+/* ===== Program and fragment state ===== */
+
+void state_shadow_use_program(GLuint program) {
+    StateShadow* s = current_shadow();
+
+    if (s->program == SHADOW_VALUE(program)) {
+        s->frame.filtered++;
+        return;
+    }
+    s->program = SHADOW_VALUE(program);
+
+    s->frame.forwarded++;
+    glUseProgram(program);
+}
+
+void state_shadow_blend_func(GLenum src_rgb, GLenum dst_rgb,
+                             GLenum src_alpha, GLenum dst_alpha) {
+    StateShadow* s = current_shadow();
+
+    if (s->blend_known &&
+        s->blend[0] == src_rgb && s->blend[1] == dst_rgb &&
+        s->blend[2] == src_alpha && s->blend[3] == dst_alpha) {
+        s->frame.filtered++;
+        return;
+    }
+    s->blend[0] = src_rgb;
+    s->blend[1] = dst_rgb;
+    s->blend[2] = src_alpha;
+    s->blend[3] = dst_alpha;
+    s->blend_known = true;
+
+    s->frame.forwarded++;
+    glBlendFuncSeparate(src_rgb, dst_rgb, src_alpha, dst_alpha);
+}
+
+void state_shadow_depth_mask(GLboolean flag) {
+    StateShadow* s = current_shadow();
+    GLuint value = SHADOW_VALUE(flag ? GL_TRUE : GL_FALSE);
+
+    if (s->depth_mask == value) {
+        s->frame.filtered++;
+        return;
+    }
+    s->depth_mask = value;
+
+    s->frame.forwarded++;
+    glDepthMask(flag);
+}
+
+/* ===== Framebuffer and viewport ===== */
+
+void state_shadow_bind_framebuffer(GLenum target, GLuint framebuffer) {
+    StateShadow* s = current_shadow();
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    GLuint value = SHADOW_VALUE(framebuffer);
+
+    if ((draw || read) &&
+        (!draw || s->draw_framebuffer == value) &&
+        (!read || s->read_framebuffer == value)) {
+        s->frame.filtered++;
+        return;
+    }
+    if (draw) s->draw_framebuffer = value;
+    if (read) s->read_framebuffer = value;
+
+    s->frame.forwarded++;
+    glBindFramebuffer(target, framebuffer);
+}
+
+void state_shadow_delete_framebuffers(GLsizei n, const GLuint* framebuffers) {
+    StateShadow* s = current_shadow();
+    if (!framebuffers) return;
+
+    for (GLsizei i = 0; i < n; i++) {
+        if (framebuffers[i] == 0) continue;
+        GLuint value = SHADOW_VALUE(framebuffers[i]);
+        if (s->draw_framebuffer == value) s->draw_framebuffer = SHADOW_VALUE(0);
+        if (s->read_framebuffer == value) s->read_framebuffer = SHADOW_VALUE(0);
+        forget_attachments(s, framebuffers[i], 0);
+    }
+    glDeleteFramebuffers(n, framebuffers);
+}
+
+/* Record what `attachment` of the framebuffer bound to `target` now holds */
+static void record_attachment(StateShadow* s, GLenum target, GLenum attachment,
+                              GLenum textarget, GLuint texture, GLint level, GLint layer) {
+    GLint framebuffer = 0;
+    state_shadow_get_integerv(target == GL_READ_FRAMEBUFFER ? GL_READ_FRAMEBUFFER_BINDING
+                                                            : GL_DRAW_FRAMEBUFFER_BINDING,
+                              &framebuffer);
+    if (framebuffer == 0) return;
+
+    ShadowAttachment* slot = NULL;
+    for (int i = 0; i < s->attachment_count; i++) {
+        ShadowAttachment* a = &s->attachments[i];
+        if (a->framebuffer == (GLuint)framebuffer && a->attachment == attachment) {
+            slot = a;
+            break;
+        }
+    }
+    if (texture == 0) {
+        /* Detached: move the last record into the hole */
+        if (slot) *slot = s->attachments[--s->attachment_count];
+        return;
+    }
+    if (!slot) {
+        if (s->attachment_count == SHADOW_ATTACHMENTS) return;
+        slot = &s->attachments[s->attachment_count++];
+    }
+    slot->framebuffer = (GLuint)framebuffer;
+    slot->attachment = attachment;
+    slot->textarget = textarget;
+    slot->texture = texture;
+    slot->level = level;
+    slot->layer = layer;
+}
+
+void state_shadow_framebuffer_texture_2d(GLenum target, GLenum attachment, GLenum textarget,
+                                         GLuint texture, GLint level) {
+    record_attachment(current_shadow(), target, attachment, textarget, texture, level, 0);
+    glFramebufferTexture2D(target, attachment, textarget, texture, level);
+}
+
+void state_shadow_framebuffer_texture_layer(GLenum target, GLenum attachment, GLuint texture,
+                                            GLint level, GLint layer) {
+    record_attachment(current_shadow(), target, attachment, 0, texture, level, layer);
+    glFramebufferTextureLayer(target, attachment, texture, level, layer);
+}
+
+void state_shadow_viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    StateShadow* s = current_shadow();
+
+    if (s->viewport_known &&
+        s->viewport[0] == x && s->viewport[1] == y &&
+        s->viewport[2] == width && s->viewport[3] == height) {
+        s->frame.filtered++;
+        return;
+    }
+    s->viewport[0] = x;
+    s->viewport[1] = y;
+    s->viewport[2] = width;
+    s->viewport[3] = height;
+    s->viewport_known = true;
+
+    s->frame.forwarded++;
+    glViewport(x, y, width, height);
+}
+
+void state_shadow_scissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+    StateShadow* s = current_shadow();
+
+    if (s->scissor_known &&
+        s->scissor[0] == x && s->scissor[1] == y &&
+        s->scissor[2] == width && s->scissor[3] == height) {
+        s->frame.filtered++;
+        return;
+    }
+    s->scissor[0] = x;
+    s->scissor[1] = y;
+    s->scissor[2] = width;
+    s->scissor[3] = height;
+    s->scissor_known = true;
+
+    s->frame.forwarded++;
+    glScissor(x, y, width, height);
+}
+
+/* ===== Queries ===== */
+
+/* Single-value bindings stored with the name + 1 encoding */
+static GLuint* scalar_slot(StateShadow* s, GLenum pname) {
+    switch (pname) {
+        case GL_VERTEX_ARRAY_BINDING:     return &s->vertex_array;
+        case GL_CURRENT_PROGRAM:          return &s->program;
+        case GL_DEPTH_WRITEMASK:          return &s->depth_mask;
+        /* Same value as GL_FRAMEBUFFER_BINDING */
+        case GL_DRAW_FRAMEBUFFER_BINDING: return &s->draw_framebuffer;
+        case GL_READ_FRAMEBUFFER_BINDING: return &s->read_framebuffer;
+        default: break;
+    }
+
+    int index = buffer_binding_index(pname);
+    if (index >= 0) return &s->buffers[index];
+
+    index = pixel_store_index(pname);
+    if (index >= 0) return &s->pixel_store[index];
+
+    index = texture_binding_index(pname);
+    if (index >= 0 && s->active_unit != SHADOW_UNKNOWN) {
+        return &s->textures[s->active_unit - 1][index];
+    }
+    return NULL;
+}
+
+/* Copy the shadowed value of `pname` to `out`; returns the value count, 0 if unknown */
+static int shadow_lookup(StateShadow* s, GLenum pname, GLint* out) {
+    int cap = cap_index(pname);
+    if (cap >= 0) {
+        uint32_t bit = 1u << cap;
+        if (!(s->caps_known & bit)) return 0;
+        out[0] = (s->caps_enabled & bit) ? 1 : 0;
+        return 1;
+    }
+
+    switch (pname) {
+        case GL_ACTIVE_TEXTURE:
+            if (s->active_unit == SHADOW_UNKNOWN) return 0;
+            out[0] = (GLint)(GL_TEXTURE0 + s->active_unit - 1);
+            return 1;
+        case GL_VIEWPORT:
+            if (!s->viewport_known) return 0;
+            memcpy(out, s->viewport, sizeof(s->viewport));
+            return 4;
+        case GL_SCISSOR_BOX:
+            if (!s->scissor_known) return 0;
+            memcpy(out, s->scissor, sizeof(s->scissor));
+            return 4;
+        case GL_BLEND_SRC_RGB:   if (!s->blend_known) return 0; out[0] = (GLint)s->blend[0]; return 1;
+        case GL_BLEND_DST_RGB:   if (!s->blend_known) return 0; out[0] = (GLint)s->blend[1]; return 1;
+        case GL_BLEND_SRC_ALPHA: if (!s->blend_known) return 0; out[0] = (GLint)s->blend[2]; return 1;
+        case GL_BLEND_DST_ALPHA: if (!s->blend_known) return 0; out[0] = (GLint)s->blend[3]; return 1;
+        default: break;
+    }
+
+    GLuint* slot = scalar_slot(s, pname);
+    if (!slot || *slot == SHADOW_UNKNOWN) return 0;
+    out[0] = (GLint)(*slot - 1);
+    return 1;
+}
+
+/* Remember a value read back from the driver */
+static void shadow_store(StateShadow* s, GLenum pname, const GLint* values) {
+    int cap = cap_index(pname);
+    if (cap >= 0) {
+        uint32_t bit = 1u << cap;
+        s->caps_known |= bit;
+        if (values[0]) s->caps_enabled |= bit;
+        else s->caps_enabled &= ~bit;
+        return;
+    }
+
+    switch (pname) {
+        case GL_ACTIVE_TEXTURE: {
+            GLuint index = (GLuint)values[0] - GL_TEXTURE0;
+            s->active_unit = index < SHADOW_TEXTURE_UNITS ? SHADOW_VALUE(index) : SHADOW_UNKNOWN;
+            return;
+        }
+        case GL_VIEWPORT:
+            memcpy(s->viewport, values, sizeof(s->viewport));
+            s->viewport_known = true;
+            return;
+        case GL_SCISSOR_BOX:
+            memcpy(s->scissor, values, sizeof(s->scissor));
+            s->scissor_known = true;
+            return;
+        default:
+            break;
+    }
+
+    GLuint* slot = scalar_slot(s, pname);
+    if (slot) *slot = SHADOW_VALUE(values[0]);
+}
+
+void state_shadow_get_integerv(GLenum pname, GLint* params) {
+    StateShadow* s = current_shadow();
+    GLint shadow[4];
+    int count = shadow_lookup(s, pname, shadow);
+
+    if (count > 0 && !g_validate) {
+        memcpy(params, shadow, (size_t)count * sizeof(GLint));
+        return;
+    }
+
+    glGetIntegerv(pname, params);
+
+    if (count > 0 && memcmp(shadow, params, (size_t)count * sizeof(GLint)) != 0) {
+        LOGW("Shadow mismatch for 0x%04x: shadow %d, driver %d", pname, shadow[0], params[0]);
+    }
+    shadow_store(s, pname, params);
+}
+
+bool state_shadow_peek_integerv(GLenum pname, GLint* params) {
+    GLint shadow[4];
+    int count = shadow_lookup(current_shadow(), pname, shadow);
+    if (count > 0) memcpy(params, shadow, (size_t)count * sizeof(GLint));
+    return count > 0;
+}
+
+GLboolean state_shadow_is_enabled(GLenum cap) {
+    if (cap_index(cap) < 0) return glIsEnabled(cap);
+
+    GLint value = 0;
+    state_shadow_get_integerv(cap, &value);
+    return value ? GL_TRUE : GL_FALSE;
+}
+
+void state_shadow_set_validation(bool enable) {
+    g_validate = enable;
+    LOGI("State shadow validation %s", enable ? "enabled" : "disabled");
+}
+
+/* ===== Draw keys ===== */
+
+void state_shadow_capture_key(StateDrawKey* key) {
+    StateShadow* s = current_shadow();
+
+    key->program = s->program;
+    key->vertex_array = s->vertex_array;
+    for (int u = 0; u < STATE_KEY_TEXTURE_UNITS; u++) {
+        key->textures[u] = s->textures[u][TEX_2D];
+    }
+    key->depth_mask = s->depth_mask;
+    for (int i = 0; i < 4; i++) {
+        key->blend[i] = s->blend_known ? s->blend[i] : 0;
+    }
+    key->blend_known = s->blend_known;
+    key->caps_known = s->caps_known;
+    key->caps_enabled = s->caps_enabled & s->caps_known;
+}
+
+bool state_shadow_key_has_cap(GLenum cap) {
+    return cap_index(cap) >= 0;
+}
+
+bool state_shadow_key_has_texture(GLenum target) {
+    StateShadow* s = current_shadow();
+    return target == GL_TEXTURE_2D && s->active_unit != SHADOW_UNKNOWN &&
+           s->active_unit - 1 < STATE_KEY_TEXTURE_UNITS;
+}
+
+void state_shadow_apply_key(const StateDrawKey* key) {
+    StateShadow* s = current_shadow();
+
+    if (key->program != SHADOW_UNKNOWN) state_shadow_use_program(key->program - 1);
+    if (key->vertex_array != SHADOW_UNKNOWN) state_shadow_bind_vertex_array(key->vertex_array - 1);
+    if (key->depth_mask != SHADOW_UNKNOWN) state_shadow_depth_mask((GLboolean)(key->depth_mask - 1));
+    if (key->blend_known) {
+        state_shadow_blend_func(key->blend[0], key->blend[1], key->blend[2], key->blend[3]);
+    }
+
+    uint32_t caps_changed = key->caps_known &
+        (~s->caps_known | (s->caps_enabled ^ key->caps_enabled));
+    for (int i = 0; caps_changed && i < CAP_COUNT; i++) {
+        uint32_t bit = 1u << i;
+        if (caps_changed & bit) {
+            state_shadow_enable(g_cap_enums[i], (key->caps_enabled & bit) != 0);
+            caps_changed &= ~bit;
+        }
+    }
+
+    /* Texture rebinds need a known active unit to return to */
+    GLuint active = s->active_unit;
+    if (active == SHADOW_UNKNOWN) return;
+    for (int u = 0; u < STATE_KEY_TEXTURE_UNITS; u++) {
+        if (key->textures[u] == SHADOW_UNKNOWN || s->textures[u][TEX_2D] == key->textures[u]) {
+            continue;
+        }
+        state_shadow_active_texture(GL_TEXTURE0 + (GLenum)u);
+        state_shadow_bind_texture(GL_TEXTURE_2D, key->textures[u] - 1);
+    }
+    state_shadow_active_texture(GL_TEXTURE0 + (active - 1));
+}
+
+bool state_shadow_key_opaque(const StateDrawKey* key) {
+    uint32_t blend = 1u << CAP_BLEND;
+    uint32_t depth = 1u << CAP_DEPTH_TEST;
+    return (key->caps_known & (blend | depth)) == (blend | depth) &&
+           (key->caps_enabled & (blend | depth)) == depth;
+}
+
+/* ===== Statistics ===== */
+
+void state_shadow_frame_end(void) {
+    StateShadow* s = current_shadow();
+
+    s->last = s->frame;
+    s->frame.filtered = 0;
+    s->frame.forwarded = 0;
+    s->frames++;
+    g_last_frame = s->last;
+
+    if (s->frames % SHADOW_STATS_LOG_INTERVAL == 0) {
+        uint32_t total = s->last.filtered + s->last.forwarded;
+        LOGI("State calls last frame: %u filtered, %u forwarded (%.1f%% redundant)",
+             s->last.filtered, s->last.forwarded,
+             total ? 100.0f * (float)s->last.filtered / (float)total : 0.0f);
+    }
+}
+
+void state_shadow_get_stats(StateShadowStats* out) {
+    *out = g_last_frame;
+}
@@ -0,0 +1,86 @@
+/*
+ * PrismGL Stream Buffer
+ * Unsynchronized append into a GL buffer, orphaned on wrap-around, so
+ * per-draw uploads never wait for the GPU to finish with older data.
+ */
+
+#include "stream_buffer.h"
+#include "state_shadow.h"
+
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Stream"
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+
+#define STREAM_ALIGNMENT 16
+
+bool stream_buffer_init(StreamBuffer* sb, GLenum target, GLsizeiptr size) {
+    memset(sb, 0, sizeof(*sb));
+    sb->target = target;
+    sb->size = size;
+
+    glGenBuffers(1, &sb->buffer);
+    if (!sb->buffer) return false;
+    state_shadow_bind_buffer(target, sb->buffer);
+    glBufferData(target, size, NULL, GL_STREAM_DRAW);
+    return true;
+}
+
+void stream_buffer_destroy(StreamBuffer* sb) {
+    if (sb->buffer) {
+        state_shadow_delete_buffers(1, &sb->buffer);
+    }
+    memset(sb, 0, sizeof(*sb));
+}
+
+void* stream_buffer_map(StreamBuffer* sb, GLsizeiptr size, GLsizeiptr* out_offset) {
+    if (!sb->buffer || size <= 0) return NULL;
+
+    state_shadow_bind_buffer(sb->target, sb->buffer);
+
+    GLbitfield access = GL_MAP_WRITE_BIT;
+    GLsizeiptr offset = (sb->offset + STREAM_ALIGNMENT - 1) & ~(GLsizeiptr)(STREAM_ALIGNMENT - 1);
+
+    if (size > sb->size) {
+        /* Grow: reallocate storage large enough for this and future requests */
+        GLsizeiptr new_size = sb->size;
+        while (new_size < size) new_size *= 2;
+        glBufferData(sb->target, new_size, NULL, GL_STREAM_DRAW);
+        sb->size = new_size;
+        offset = 0;
+        access |= GL_MAP_INVALIDATE_BUFFER_BIT;
+    } else if (offset + size > sb->size) {
+        /* Wrap: orphan the storage so in-flight draws keep the old copy */
+        offset = 0;
+        access |= GL_MAP_INVALIDATE_BUFFER_BIT;
+    } else {
+        access |= GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    }
+
+    void* ptr = glMapBufferRange(sb->target, offset, size, access);
+    if (!ptr) {
+        LOGE("Stream buffer map failed (%ld bytes at %ld)", (long)size, (long)offset);
+        return NULL;
+    }
+
+    sb->mapped = true;
+    sb->offset = offset + size;
+    *out_offset = offset;
+    return ptr;
+}
+
+void stream_buffer_unmap(StreamBuffer* sb) {
+    if (!sb->mapped) return;
+    glUnmapBuffer(sb->target);
+    sb->mapped = false;
+}
+
+GLsizeiptr stream_buffer_upload(StreamBuffer* sb, const void* data, GLsizeiptr size) {
+    GLsizeiptr offset;
+    void* dst = stream_buffer_map(sb, size, &offset);
+    if (!dst) return -1;
+    memcpy(dst, data, (size_t)size);
+    stream_buffer_unmap(sb);
+    return offset;
+}
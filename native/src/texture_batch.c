@@ -0,0 +1,439 @@
+/*
+ * PrismGL Texture Upload Batching
+ * Animated textures (water, lava, portals, modded sprites) are re-uploaded
+ * into the atlas every tick, one glTexSubImage2D per sprite and mip level.
+ * Each call is validated and copied by the driver on its own, and some
+ * drivers wait for earlier draws sampling the atlas before writing to it.
+ *
+ * Small uploads of client memory are copied into per-context staging
+ * memory instead. At a flush point they are sorted by texture and level,
+ * uploads superseded by a later one of the same rectangle are dropped, and
+ * neighbours are merged: first sprites side by side with the same rows,
+ * then the resulting strips stacked on the same columns. Everything is
+ * written into one pixel unpack buffer, orphaned each flush, and submitted
+ * as a burst of buffer-offset uploads.
+ *
+ * A group whose rectangles overlap is not merged and keeps submission
+ * order, so a later upload still wins.
+ */
+
+#include "texture_batch.h"
+#include "texture_registry.h"
+#include "texture_convert.h"
+#include "state_shadow.h"
+#include "context.h"
+#include "prismgl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-TexBatch"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define TEXBATCH_MAX_UPLOAD_BYTES   (64 * 1024)         /* Larger uploads gain nothing */
+#define TEXBATCH_MAX_STAGED_BYTES   (4 * 1024 * 1024)   /* Flush early past this */
+#define TEXBATCH_INITIAL_CAPACITY   64
+#define TEXBATCH_STATS_LOG_INTERVAL 600
+
+typedef struct {
+    GLuint texture;
+    GLenum target;          /* As passed: GL_TEXTURE_2D or a cube face */
+    GLint level;
+    GLenum format;
+    GLenum type;
+    GLint x, y;
+    GLsizei width, height;
+    size_t pixel;           /* Bytes per pixel */
+    size_t offset;          /* Tight copy in the staging memory */
+    uint32_t order;         /* Submission order, the last sort key */
+    int next;               /* Next upload of the same merged rectangle, -1 at the end */
+} StagedUpload;
+
+typedef struct {
+    GLint x, y;
+    GLsizei width, height;
+    int first, last;        /* Chain of StagedUpload.next */
+    uint32_t order;         /* Earliest upload merged into it */
+    size_t offset;          /* In the unpack buffer */
+} UploadRect;
+
+typedef struct {
+    StagedUpload* uploads;
+    int count;
+    int capacity;
+    UploadRect* rects;
+    int rect_capacity;
+    uint8_t* staging;
+    size_t staged;
+    size_t staging_capacity;
+    GLuint buffer;
+    GLsizeiptr buffer_size;
+    TextureBatchStats frame;
+    TextureBatchStats last;
+    uint64_t frames;
+} TextureBatchState;
+
+/* Counters of the last frame presented by any context, for JNI readers */
+static TextureBatchStats g_last_frame;
+
+static inline TextureBatchState* batch_state(void) {
+    return (TextureBatchState*)prismgl_context_state(PRISMGL_STATE_TEXTURE_BATCH);
+}
+
+void* texture_batch_create_state(void) {
+    return calloc(1, sizeof(TextureBatchState));
+}
+
+void texture_batch_destroy_state(void* state) {
+    TextureBatchState* s = (TextureBatchState*)state;
+    /* The buffer goes with the context */
+    free(s->uploads);
+    free(s->rects);
+    free(s->staging);
+    free(s);
+}
+
+/* ===== Staging ===== */
+
+static bool reserve(TextureBatchState* s, size_t bytes) {
+    if (s->count == s->capacity) {
+        int capacity = s->capacity ? s->capacity * 2 : TEXBATCH_INITIAL_CAPACITY;
+        StagedUpload* uploads = (StagedUpload*)realloc(s->uploads,
+                                                       (size_t)capacity * sizeof(StagedUpload));
+        if (!uploads) return false;
+        s->uploads = uploads;
+        s->capacity = capacity;
+    }
+    if (s->staged + bytes > s->staging_capacity) {
+        size_t capacity = s->staging_capacity ? s->staging_capacity : TEXBATCH_MAX_UPLOAD_BYTES;
+        while (capacity < s->staged + bytes) capacity *= 2;
+        uint8_t* staging = (uint8_t*)realloc(s->staging, capacity);
+        if (!staging) return false;
+        s->staging = staging;
+        s->staging_capacity = capacity;
+    }
+    return true;
+}
+
+static void flush(TextureBatchState* s);
+
+bool texture_batch_sub_image_2d(GLuint texture, GLenum target, GLint level, GLint xoffset,
+                                GLint yoffset, GLsizei width, GLsizei height, GLenum format,
+                                GLenum type, const void* pixels) {
+    if (!prismgl_get_config()->texture_upload_batching) return false;
+    if (texture == 0 || !pixels || width <= 0 || height <= 0) return false;
+
+    GLenum bind = texture_registry_binding_target(target);
+    if (bind != GL_TEXTURE_2D && bind != GL_TEXTURE_CUBE_MAP) return false;
+    size_t pixel = texture_pixel_size(format, type);
+    size_t row_bytes = (size_t)width * pixel;
+    size_t bytes = row_bytes * (size_t)height;
+    if (pixel == 0 || bytes > TEXBATCH_MAX_UPLOAD_BYTES) return false;
+
+    /* Data already in a buffer is offset-based anyway */
+    GLint unpack_buffer = 0;
+    state_shadow_get_integerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack_buffer);
+    if (unpack_buffer != 0) return false;
+
+    TextureBatchState* s = batch_state();
+    if (s->staged + bytes > TEXBATCH_MAX_STAGED_BYTES) flush(s);
+    if (!reserve(s, bytes)) return false;
+
+    GLint alignment = 4, row_length = 0, skip_rows = 0, skip_pixels = 0;
+    state_shadow_get_integerv(GL_UNPACK_ALIGNMENT, &alignment);
+    state_shadow_get_integerv(GL_UNPACK_ROW_LENGTH, &row_length);
+    state_shadow_get_integerv(GL_UNPACK_SKIP_ROWS, &skip_rows);
+    state_shadow_get_integerv(GL_UNPACK_SKIP_PIXELS, &skip_pixels);
+
+    size_t row_pixels = row_length > 0 ? (size_t)row_length : (size_t)width;
+    size_t align = alignment > 0 ? (size_t)alignment : 4;
+    size_t stride = (row_pixels * pixel + align - 1) / align * align;
+    const uint8_t* src = (const uint8_t*)pixels + (size_t)skip_rows * stride +
+                         (size_t)skip_pixels * pixel;
+    uint8_t* dst = s->staging + s->staged;
+    if (stride == row_bytes) {
+        memcpy(dst, src, bytes);
+    } else {
+        for (GLsizei y = 0; y < height; y++) {
+            memcpy(dst + (size_t)y * row_bytes, src + (size_t)y * stride, row_bytes);
+        }
+    }
+
+    StagedUpload* u = &s->uploads[s->count];
+    u->texture = texture;
+    u->target = target;
+    u->level = level;
+    u->format = format;
+    u->type = type;
+    u->x = xoffset;
+    u->y = yoffset;
+    u->width = width;
+    u->height = height;
+    u->pixel = pixel;
+    u->offset = s->staged;
+    u->order = (uint32_t)s->count;
+    u->next = -1;
+
+    s->count++;
+    s->staged += bytes;
+    s->frame.uploads_in++;
+    return true;
+}
+
+/* ===== Merging ===== */
+
+static bool same_group(const StagedUpload* a, const StagedUpload* b) {
+    return a->texture == b->texture && a->target == b->target && a->level == b->level &&
+           a->format == b->format && a->type == b->type;
+}
+
+#define COMPARE(a, b) do { if ((a) != (b)) return (a) < (b) ? -1 : 1; } while (0)
+
+/* Group, then rows (y, height), then x; submission order breaks ties */
+static int compare_uploads(const void* pa, const void* pb) {
+    const StagedUpload* a = (const StagedUpload*)pa;
+    const StagedUpload* b = (const StagedUpload*)pb;
+    COMPARE(a->texture, b->texture);
+    COMPARE(a->target, b->target);
+    COMPARE(a->level, b->level);
+    COMPARE(a->format, b->format);
+    COMPARE(a->type, b->type);
+    COMPARE(a->y, b->y);
+    COMPARE(a->height, b->height);
+    COMPARE(a->x, b->x);
+    COMPARE(a->width, b->width);
+    COMPARE(a->order, b->order);
+    return 0;
+}
+
+/* Columns (x, width), then y */
+static int compare_columns(const void* pa, const void* pb) {
+    const UploadRect* a = (const UploadRect*)pa;
+    const UploadRect* b = (const UploadRect*)pb;
+    COMPARE(a->x, b->x);
+    COMPARE(a->width, b->width);
+    COMPARE(a->y, b->y);
+    return 0;
+}
+
+static int compare_order(const void* pa, const void* pb) {
+    const UploadRect* a = (const UploadRect*)pa;
+    const UploadRect* b = (const UploadRect*)pb;
+    COMPARE(a->order, b->order);
+    return 0;
+}
+
+#undef COMPARE
+
+/* Uploads sorted by y; true if any two of them overlap */
+static bool overlapping(const StagedUpload* u, int count) {
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count && u[j].y < u[i].y + u[i].height; j++) {
+            if (u[j].x < u[i].x + u[i].width && u[i].x < u[j].x + u[j].width) return true;
+        }
+    }
+    return false;
+}
+
+static void append(StagedUpload* uploads, UploadRect* a, const UploadRect* b, bool across) {
+    uploads[a->last].next = b->first;
+    a->last = b->last;
+    if (across) {
+        a->width += b->width;
+    } else {
+        a->height += b->height;
+    }
+    if (b->order < a->order) a->order = b->order;
+}
+
+/* Merge the sorted uploads [start, end) of one group into rects; returns how many */
+static int merge_group(TextureBatchState* s, int start, int end, UploadRect* r) {
+    StagedUpload* u = s->uploads;
+    int n = 0;
+    for (int i = start; i < end; i++) {
+        u[i].next = -1;
+        r[n++] = (UploadRect){ u[i].x, u[i].y, u[i].width, u[i].height, i, i, u[i].order, 0 };
+    }
+    if (overlapping(u + start, end - start)) {
+        qsort(r, (size_t)n, sizeof(UploadRect), compare_order);
+        return n;
+    }
+
+    /* Side by side on the same rows; the uploads are already in row order */
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        UploadRect* prev = m > 0 ? &r[m - 1] : NULL;
+        if (prev && prev->y == r[i].y && prev->height == r[i].height &&
+            prev->x + prev->width == r[i].x) {
+            append(u, prev, &r[i], true);
+        } else {
+            r[m++] = r[i];
+        }
+    }
+
+    /* Strips stacked on the same columns */
+    qsort(r, (size_t)m, sizeof(UploadRect), compare_columns);
+    int k = 0;
+    for (int i = 0; i < m; i++) {
+        UploadRect* prev = k > 0 ? &r[k - 1] : NULL;
+        if (prev && prev->x == r[i].x && prev->width == r[i].width &&
+            prev->y + prev->height == r[i].y) {
+            append(u, prev, &r[i], false);
+        } else {
+            r[k++] = r[i];
+        }
+    }
+    return k;
+}
+
+/* ===== Submission ===== */
+
+/* Write the pieces of `rect` into its place in the mapped buffer */
+static void compose(const TextureBatchState* s, const UploadRect* rect, uint8_t* mapped) {
+    size_t pixel = s->uploads[rect->first].pixel;
+    size_t rect_row = (size_t)rect->width * pixel;
+    for (int i = rect->first; i >= 0; i = s->uploads[i].next) {
+        const StagedUpload* u = &s->uploads[i];
+        size_t row_bytes = (size_t)u->width * pixel;
+        uint8_t* dst = mapped + rect->offset + (size_t)(u->y - rect->y) * rect_row +
+                       (size_t)(u->x - rect->x) * pixel;
+        const uint8_t* src = s->staging + u->offset;
+        for (GLsizei y = 0; y < u->height; y++) {
+            memcpy(dst + (size_t)y * rect_row, src + (size_t)y * row_bytes, row_bytes);
+        }
+    }
+}
+
+/* Map the unpack buffer and fill it; false leaves the buffer unbound */
+static bool fill_buffer(TextureBatchState* s, const UploadRect* rects, int count, size_t total) {
+    if (!s->buffer) glGenBuffers(1, &s->buffer);
+    state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, s->buffer);
+    if ((GLsizeiptr)total > s->buffer_size) {
+        GLsizeiptr size = s->buffer_size ? s->buffer_size : TEXBATCH_MAX_UPLOAD_BYTES;
+        while (size < (GLsizeiptr)total) size *= 2;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        s->buffer_size = size;
+    }
+
+    /* Invalidating lets the driver hand out fresh memory instead of waiting */
+    uint8_t* mapped = (uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)total,
+                                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped) {
+        for (int i = 0; i < count; i++) compose(s, &rects[i], mapped);
+        if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) return true;
+    }
+    LOGW("Could not fill the upload buffer, submitting %d uploads from client memory", s->count);
+    state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return false;
+}
+
+static void flush(TextureBatchState* s) {
+    if (s->count == 0) return;
+    qsort(s->uploads, (size_t)s->count, sizeof(StagedUpload), compare_uploads);
+
+    /* A rectangle uploaded again later in the batch only needs the last copy */
+    int live = 0;
+    for (int i = 0; i < s->count; i++) {
+        const StagedUpload* u = &s->uploads[i];
+        const StagedUpload* n = i + 1 < s->count ? &s->uploads[i + 1] : NULL;
+        if (n && same_group(u, n) && u->x == n->x && u->y == n->y &&
+            u->width == n->width && u->height == n->height) {
+            continue;
+        }
+        s->uploads[live++] = *u;
+    }
+    s->count = live;
+
+    if (live > s->rect_capacity) {
+        UploadRect* rects = (UploadRect*)realloc(s->rects, (size_t)live * sizeof(UploadRect));
+        if (!rects) {
+            /* Leave them staged; the next flush tries again */
+            LOGW("Out of memory submitting %d texture uploads", live);
+            return;
+        }
+        s->rects = rects;
+        s->rect_capacity = live;
+    }
+
+    int count = 0;
+    for (int start = 0; start < live;) {
+        int end = start + 1;
+        while (end < live && same_group(&s->uploads[start], &s->uploads[end])) end++;
+        count += merge_group(s, start, end, s->rects + count);
+        start = end;
+    }
+
+    /* Offsets stay aligned for any component type */
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        UploadRect* r = &s->rects[i];
+        r->offset = total;
+        total += ((size_t)r->width * (size_t)r->height * s->uploads[r->first].pixel + 3) & ~(size_t)3;
+    }
+
+    GLint unpack_buffer = 0;
+    state_shadow_get_integerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack_buffer);
+    GLuint bound_2d = texture_registry_bound(GL_TEXTURE_2D);
+    GLuint bound_cube = texture_registry_bound(GL_TEXTURE_CUBE_MAP);
+    TextureUnpackState unpack;
+    texture_convert_unpack_tight(&unpack);
+
+    if (fill_buffer(s, s->rects, count, total)) {
+        for (int i = 0; i < count; i++) {
+            const UploadRect* r = &s->rects[i];
+            const StagedUpload* u = &s->uploads[r->first];
+            state_shadow_bind_texture(texture_registry_binding_target(u->target), u->texture);
+            glTexSubImage2D(u->target, u->level, r->x, r->y, r->width, r->height, u->format,
+                            u->type, (const void*)(uintptr_t)r->offset);
+        }
+        s->frame.uploads_out += (uint32_t)count;
+        s->frame.bytes += (uint32_t)total;
+    } else {
+        for (int i = 0; i < count; i++) {
+            for (int j = s->rects[i].first; j >= 0; j = s->uploads[j].next) {
+                const StagedUpload* u = &s->uploads[j];
+                state_shadow_bind_texture(texture_registry_binding_target(u->target), u->texture);
+                glTexSubImage2D(u->target, u->level, u->x, u->y, u->width, u->height, u->format,
+                                u->type, s->staging + u->offset);
+                s->frame.uploads_out++;
+                s->frame.bytes += (uint32_t)((size_t)u->width * (size_t)u->height * u->pixel);
+            }
+        }
+    }
+
+    texture_convert_unpack_restore(&unpack);
+    state_shadow_bind_texture(GL_TEXTURE_2D, bound_2d);
+    state_shadow_bind_texture(GL_TEXTURE_CUBE_MAP, bound_cube);
+    state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, (GLuint)unpack_buffer);
+
+    s->count = 0;
+    s->staged = 0;
+}
+
+void texture_batch_flush(void) {
+    TextureBatchState* s = batch_state();
+    if (s->count > 0) flush(s);
+}
+
+/* ===== Stats ===== */
+
+void texture_batch_frame_end(void) {
+    TextureBatchState* s = batch_state();
+    flush(s);
+
+    s->last = s->frame;
+    memset(&s->frame, 0, sizeof(s->frame));
+    s->frames++;
+    g_last_frame = s->last;
+
+    if (s->frames % TEXBATCH_STATS_LOG_INTERVAL == 0 && s->last.uploads_in > 0) {
+        LOGI("Texture uploads last frame: %u staged, %u submitted, %u bytes",
+             s->last.uploads_in, s->last.uploads_out, s->last.bytes);
+    }
+}
+
+void texture_batch_get_stats(TextureBatchStats* out) {
+    *out = g_last_frame;
+}
@@ -0,0 +1,125 @@
+/*
+ * PrismGL Texture Budget
+ * Resource packs with 512x textures fill the memory of low-end devices,
+ * where the driver then fails allocations or the system kills the game.
+ * The registry estimates what every texture occupies (texture_registry.h);
+ * this module compares the total against a budget and reacts in two ways:
+ *
+ *  - A promoted chain (texture_storage.h) that would exceed the budget is
+ *    allocated a level smaller. Its level 0 is downsampled on upload and
+ *    every other level moves up one.
+ *  - While over budget, the largest texture not bound for COLD_FRAMES has
+ *    its top level dropped, at most one texture every EVICT_INTERVAL frames.
+ *
+ * Bind times live in a small direct-mapped table indexed by name. A
+ * collision only makes a texture look recently used, never cold.
+ */
+
+#include "texture_budget.h"
+#include "texture_registry.h"
+#include "texture_storage.h"
+#include "state_shadow.h"
+#include "prismgl.h"
+
+#include <stdatomic.h>
+#include <unistd.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Budget"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+
+#define BUDGET_MIN_BYTES   ((size_t)96 << 20)
+#define BUDGET_MAX_BYTES   ((size_t)2048 << 20)
+#define BUDGET_FALLBACK    ((size_t)256 << 20)     /* RAM unknown */
+#define TOUCH_SLOTS        4096                    /* Power of two */
+#define COLD_FRAMES        300u
+#define EVICT_INTERVAL     30u
+
+static struct {
+    size_t auto_bytes;
+    bool can_evict;                         /* glCopyImageSubData available */
+    atomic_uint frame;
+    atomic_uint last_use[TOUCH_SLOTS];
+} g;
+
+/* ===== Budget ===== */
+
+void texture_budget_init(const GPUInfo* info) {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t ram = pages > 0 && page_size > 0 ? (size_t)pages * (size_t)page_size : 0;
+
+    /* Textures share RAM with the game and the system; faster GPUs come with more of it */
+    size_t divisor;
+    switch (info->tier) {
+        case GPU_TIER_LOW:  divisor = 8; break;
+        case GPU_TIER_MID:  divisor = 6; break;
+        case GPU_TIER_HIGH: divisor = 5; break;
+        default:            divisor = 4; break;
+    }
+    size_t bytes = ram ? ram / divisor : BUDGET_FALLBACK;
+    if (bytes < BUDGET_MIN_BYTES) bytes = BUDGET_MIN_BYTES;
+    if (bytes > BUDGET_MAX_BYTES) bytes = BUDGET_MAX_BYTES;
+
+    g.auto_bytes = bytes;
+    g.can_evict = info->gl_major > 3 || (info->gl_major == 3 && info->gl_minor >= 2);
+    atomic_store(&g.frame, 0);
+    for (int i = 0; i < TOUCH_SLOTS; i++) atomic_store_explicit(&g.last_use[i], 0, memory_order_relaxed);
+
+    LOGI("Texture budget %zu MB of %zu MB RAM%s", bytes >> 20, ram >> 20,
+         g.can_evict ? "" : ", no eviction (needs ES 3.2)");
+}
+
+size_t texture_budget_bytes(void) {
+    int mb = prismgl_get_config()->texture_budget_mb;
+    if (mb < 0) return 0;
+    return mb > 0 ? (size_t)mb << 20 : g.auto_bytes;
+}
+
+bool texture_budget_should_reduce(GLenum internal_format, GLsizei width, GLsizei height) {
+    size_t budget = texture_budget_bytes();
+    if (budget == 0) return false;
+    if (width < TEXTURE_BUDGET_MIN_SIZE && height < TEXTURE_BUDGET_MIN_SIZE) return false;
+
+    /* A full chain is a third larger than its top level */
+    size_t bytes = texture_level_bytes(internal_format, width, height, 1);
+    bytes += bytes / 3;
+    size_t usage = 0;
+    texture_registry_get_usage(&usage, NULL);
+    return usage + bytes > budget;
+}
+
+/* ===== Eviction ===== */
+
+void texture_budget_touch(GLuint texture) {
+    unsigned frame = atomic_load_explicit(&g.frame, memory_order_relaxed);
+    atomic_store_explicit(&g.last_use[texture & (TOUCH_SLOTS - 1)], frame, memory_order_relaxed);
+}
+
+static bool cold(const TextureInfo* info, void* ctx) {
+    unsigned frame = *(const unsigned*)ctx;
+    unsigned last = atomic_load_explicit(&g.last_use[info->name & (TOUCH_SLOTS - 1)],
+                                         memory_order_relaxed);
+    /* Only promoted 2D chains can be reallocated; one level is the most dropped */
+    return info->promoted && info->dropped == 0 && info->target == GL_TEXTURE_2D &&
+           info->levels[1].width > 0 &&
+           (info->levels[0].width >= TEXTURE_BUDGET_MIN_SIZE ||
+            info->levels[0].height >= TEXTURE_BUDGET_MIN_SIZE) &&
+           frame - last > COLD_FRAMES && !state_shadow_texture_bound(info->name);
+}
+
+void texture_budget_frame_end(void) {
+    unsigned frame = atomic_fetch_add_explicit(&g.frame, 1, memory_order_relaxed) + 1;
+    if (!g.can_evict || frame % EVICT_INTERVAL != 0) return;
+
+    size_t budget = texture_budget_bytes();
+    size_t usage = 0;
+    texture_registry_get_usage(&usage, NULL);
+    if (budget == 0 || usage <= budget) return;
+
+    GLuint texture = texture_registry_largest(cold, &frame);
+    if (texture != 0 && texture_storage_drop_level(texture)) {
+        LOGI("Over budget (%zu of %zu MB), dropped the top level of texture %u",
+             usage >> 20, budget >> 20, texture);
+    }
+}
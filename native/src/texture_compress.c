@@ -0,0 +1,608 @@
+/*
+ * PrismGL Texture Compression
+ * Atlases are uploaded as RGBA8, four times the memory and bandwidth of
+ * ETC2, which every ES 3.0 device decodes in hardware. Eligible uploads
+ * are encoded on a worker instead, with an sRGB-correct mip chain
+ * (texture_mips.h).
+ *
+ * The encoder uses the ETC1-compatible individual and differential modes
+ * of ETC2, with an EAC block for alpha. For both sub-block orientations it
+ * quantises each half's average colour and searches the eight modifier
+ * tables; the per-table error over a half's eight pixels is the hot loop
+ * and runs four pixels at a time (NEON/SSE2). Alpha is encoded exactly
+ * for constant blocks and by a table search otherwise.
+ *
+ * Chains are cached in <cache_dir>/textures, named by a hash of the source
+ * pixels, dimensions and format, so each atlas is encoded once.
+ */
+
+#include "texture_compress.h"
+#include "texture_mips.h"
+#include "prismgl_internal.h"
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Compress"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define CACHE_MAGIC     0x43544750u     /* "PGTC" */
+#define CACHE_VERSION   2u              /* Bump when the encoder output changes */
+#define CACHE_FILE_EXT  ".etc2"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t size;
+} CacheHeader;
+
+static struct {
+    bool supported;
+    bool cache_enabled;
+    char cache_dir[600];
+} g;
+
+/* ETC1/ETC2 intensity modifiers, in pixel index order */
+static const int g_etc_modifiers[8][4] = {
+    {   2,   8,   -2,   -8 },
+    {   5,  17,   -5,  -17 },
+    {   9,  29,   -9,  -29 },
+    {  13,  42,  -13,  -42 },
+    {  18,  60,  -18,  -60 },
+    {  24,  80,  -24,  -80 },
+    {  33, 106,  -33, -106 },
+    {  47, 183,  -47, -183 },
+};
+
+static const int g_eac_modifiers[16][8] = {
+    { -3, -6,  -9, -15, 2, 5, 8, 14 },
+    { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5,  -8, -13, 1, 4, 7, 12 },
+    { -2, -4,  -6, -13, 1, 3, 5, 12 },
+    { -3, -6,  -8, -12, 2, 5, 7, 11 },
+    { -3, -7,  -9, -11, 2, 6, 8, 10 },
+    { -4, -7,  -8, -11, 3, 6, 7, 10 },
+    { -3, -5,  -8, -11, 2, 4, 7, 10 },
+    { -2, -6,  -8, -10, 1, 5, 7,  9 },
+    { -2, -5,  -8, -10, 1, 4, 7,  9 },
+    { -2, -4,  -8, -10, 1, 3, 7,  9 },
+    { -2, -5,  -7, -10, 1, 4, 6,  9 },
+    { -3, -4,  -7, -10, 2, 3, 6,  9 },
+    { -1, -2,  -3, -10, 0, 1, 2,  9 },
+    { -4, -6,  -8,  -9, 3, 5, 7,  8 },
+    { -3, -5,  -7,  -9, 2, 4, 6,  8 },
+};
+
+static inline int clamp255(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline void store_be64(uint8_t out[8], uint64_t v) {
+    for (int i = 0; i < 8; i++) out[i] = (uint8_t)(v >> (56 - 8 * i));
+}
+
+/* ===== ETC2 colour ===== */
+
+/* One half of a block, channels split for the error kernel */
+typedef struct {
+    float r[8], g[8], b[8];
+    int pixels[8];              /* Block positions, x * 4 + y */
+    float avg[3];
+} SubBlock;
+
+/*
+ * Squared error of the best modifier per pixel, summed over the half.
+ * `colors` holds the four clamped candidates base + modifier.
+ */
+static float subblock_error(const SubBlock* sb, const float colors[4][3]) {
+#if defined(PRISMGL_HAVE_NEON)
+    float32x4_t r0 = vld1q_f32(sb->r), r1 = vld1q_f32(sb->r + 4);
+    float32x4_t g0 = vld1q_f32(sb->g), g1 = vld1q_f32(sb->g + 4);
+    float32x4_t b0 = vld1q_f32(sb->b), b1 = vld1q_f32(sb->b + 4);
+    float32x4_t best0 = vdupq_n_f32(FLT_MAX), best1 = best0;
+    for (int k = 0; k < 4; k++) {
+        float32x4_t cr = vdupq_n_f32(colors[k][0]);
+        float32x4_t cg = vdupq_n_f32(colors[k][1]);
+        float32x4_t cb = vdupq_n_f32(colors[k][2]);
+        float32x4_t d0 = vsubq_f32(r0, cr), d1 = vsubq_f32(r1, cr);
+        float32x4_t e0 = vmulq_f32(d0, d0), e1 = vmulq_f32(d1, d1);
+        d0 = vsubq_f32(g0, cg);
+        d1 = vsubq_f32(g1, cg);
+        e0 = vmlaq_f32(e0, d0, d0);
+        e1 = vmlaq_f32(e1, d1, d1);
+        d0 = vsubq_f32(b0, cb);
+        d1 = vsubq_f32(b1, cb);
+        e0 = vmlaq_f32(e0, d0, d0);
+        e1 = vmlaq_f32(e1, d1, d1);
+        best0 = vminq_f32(best0, e0);
+        best1 = vminq_f32(best1, e1);
+    }
+    float32x4_t sum = vaddq_f32(best0, best1);
+    float32x2_t half = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    return vget_lane_f32(vpadd_f32(half, half), 0);
+#elif defined(PRISMGL_HAVE_SSE2)
+    __m128 r0 = _mm_loadu_ps(sb->r), r1 = _mm_loadu_ps(sb->r + 4);
+    __m128 g0 = _mm_loadu_ps(sb->g), g1 = _mm_loadu_ps(sb->g + 4);
+    __m128 b0 = _mm_loadu_ps(sb->b), b1 = _mm_loadu_ps(sb->b + 4);
+    __m128 best0 = _mm_set1_ps(FLT_MAX), best1 = best0;
+    for (int k = 0; k < 4; k++) {
+        __m128 cr = _mm_set1_ps(colors[k][0]);
+        __m128 cg = _mm_set1_ps(colors[k][1]);
+        __m128 cb = _mm_set1_ps(colors[k][2]);
+        __m128 d0 = _mm_sub_ps(r0, cr), d1 = _mm_sub_ps(r1, cr);
+        __m128 e0 = _mm_mul_ps(d0, d0), e1 = _mm_mul_ps(d1, d1);
+        d0 = _mm_sub_ps(g0, cg);
+        d1 = _mm_sub_ps(g1, cg);
+        e0 = _mm_add_ps(e0, _mm_mul_ps(d0, d0));
+        e1 = _mm_add_ps(e1, _mm_mul_ps(d1, d1));
+        d0 = _mm_sub_ps(b0, cb);
+        d1 = _mm_sub_ps(b1, cb);
+        e0 = _mm_add_ps(e0, _mm_mul_ps(d0, d0));
+        e1 = _mm_add_ps(e1, _mm_mul_ps(d1, d1));
+        best0 = _mm_min_ps(best0, e0);
+        best1 = _mm_min_ps(best1, e1);
+    }
+    __m128 sum = _mm_add_ps(best0, best1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+#else
+    float total = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        float best = FLT_MAX;
+        for (int k = 0; k < 4; k++) {
+            float dr = sb->r[i] - colors[k][0];
+            float dg = sb->g[i] - colors[k][1];
+            float db = sb->b[i] - colors[k][2];
+            float e = dr * dr + dg * dg + db * db;
+            if (e < best) best = e;
+        }
+        total += best;
+    }
+    return total;
+#endif
+}
+
+static void candidates(const int base[3], int table, float colors[4][3]) {
+    for (int k = 0; k < 4; k++) {
+        for (int c = 0; c < 3; c++) {
+            colors[k][c] = (float)clamp255(base[c] + g_etc_modifiers[table][k]);
+        }
+    }
+}
+
+/* Best modifier table for a half with the given expanded base colour */
+static float best_table(const SubBlock* sb, const int base[3], int* table) {
+    float best = FLT_MAX;
+    float colors[4][3];
+    for (int t = 0; t < 8; t++) {
+        candidates(base, t, colors);
+        float e = subblock_error(sb, colors);
+        if (e < best) {
+            best = e;
+            *table = t;
+        }
+    }
+    return best;
+}
+
+static void split_block(const uint8_t block[16][4], bool flip, SubBlock halves[2]) {
+    int counts[2] = { 0, 0 };
+    memset(halves, 0, 2 * sizeof(SubBlock));
+    for (int x = 0; x < 4; x++) {
+        for (int y = 0; y < 4; y++) {
+            int p = x * 4 + y;
+            int h = flip ? (y >= 2) : (x >= 2);
+            SubBlock* sb = &halves[h];
+            int i = counts[h]++;
+            sb->r[i] = block[p][0];
+            sb->g[i] = block[p][1];
+            sb->b[i] = block[p][2];
+            sb->pixels[i] = p;
+            sb->avg[0] += block[p][0];
+            sb->avg[1] += block[p][1];
+            sb->avg[2] += block[p][2];
+        }
+    }
+    for (int h = 0; h < 2; h++) {
+        for (int c = 0; c < 3; c++) halves[h].avg[c] /= 8.0f;
+    }
+}
+
+static inline int quantize(float v, int max) {
+    int q = (int)(v * (float)max / 255.0f + 0.5f);
+    return q < 0 ? 0 : (q > max ? max : q);
+}
+
+typedef struct {
+    float error;
+    bool flip;
+    bool diff;
+    int codes[2][3];            /* Quantised base colours as stored */
+    int bases[2][3];            /* Expanded to 8 bits */
+    int tables[2];
+} ColorChoice;
+
+static void try_mode(const SubBlock halves[2], bool flip, bool diff, ColorChoice* best) {
+    ColorChoice c;
+    memset(&c, 0, sizeof(c));
+    c.flip = flip;
+    c.diff = diff;
+
+    for (int h = 0; h < 2; h++) {
+        for (int ch = 0; ch < 3; ch++) {
+            if (diff) {
+                int q = quantize(halves[h].avg[ch], 31);
+                c.codes[h][ch] = q;
+                c.bases[h][ch] = (q << 3) | (q >> 2);
+            } else {
+                int q = quantize(halves[h].avg[ch], 15);
+                c.codes[h][ch] = q;
+                c.bases[h][ch] = (q << 4) | q;
+            }
+        }
+    }
+    if (diff) {
+        for (int ch = 0; ch < 3; ch++) {
+            int d = c.codes[1][ch] - c.codes[0][ch];
+            if (d < -4 || d > 3) return;
+        }
+    }
+
+    c.error = best_table(&halves[0], c.bases[0], &c.tables[0]);
+    if (c.error >= best->error) return;
+    c.error += best_table(&halves[1], c.bases[1], &c.tables[1]);
+    if (c.error < best->error) *best = c;
+}
+
+void texture_compress_etc2_rgb(const uint8_t block[16][4], uint8_t out[8]) {
+    ColorChoice best;
+    memset(&best, 0, sizeof(best));
+    best.error = FLT_MAX;
+
+    SubBlock halves[2][2];
+    for (int flip = 0; flip < 2; flip++) {
+        split_block(block, flip != 0, halves[flip]);
+        try_mode(halves[flip], flip != 0, true, &best);
+        try_mode(halves[flip], flip != 0, false, &best);
+    }
+
+    uint32_t hi;
+    if (best.diff) {
+        hi = (uint32_t)best.codes[0][0] << 27 |
+             (uint32_t)((best.codes[1][0] - best.codes[0][0]) & 7) << 24 |
+             (uint32_t)best.codes[0][1] << 19 |
+             (uint32_t)((best.codes[1][1] - best.codes[0][1]) & 7) << 16 |
+             (uint32_t)best.codes[0][2] << 11 |
+             (uint32_t)((best.codes[1][2] - best.codes[0][2]) & 7) << 8;
+    } else {
+        hi = (uint32_t)best.codes[0][0] << 28 | (uint32_t)best.codes[1][0] << 24 |
+             (uint32_t)best.codes[0][1] << 20 | (uint32_t)best.codes[1][1] << 16 |
+             (uint32_t)best.codes[0][2] << 12 | (uint32_t)best.codes[1][2] << 8;
+    }
+    hi |= (uint32_t)best.tables[0] << 5 | (uint32_t)best.tables[1] << 2 |
+          (uint32_t)best.diff << 1 | (uint32_t)best.flip;
+
+    /* Pixel indices: most significant bits in the upper half-word */
+    uint32_t lo = 0;
+    const SubBlock* halves_used = halves[best.flip];
+    for (int h = 0; h < 2; h++) {
+        const SubBlock* sb = &halves_used[h];
+        float colors[4][3];
+        candidates(best.bases[h], best.tables[h], colors);
+        for (int i = 0; i < 8; i++) {
+            int index = 0;
+            float min = FLT_MAX;
+            for (int k = 0; k < 4; k++) {
+                float dr = sb->r[i] - colors[k][0];
+                float dg = sb->g[i] - colors[k][1];
+                float db = sb->b[i] - colors[k][2];
+                float e = dr * dr + dg * dg + db * db;
+                if (e < min) {
+                    min = e;
+                    index = k;
+                }
+            }
+            int p = sb->pixels[i];
+            lo |= (uint32_t)(index >> 1) << (16 + p) | (uint32_t)(index & 1) << p;
+        }
+    }
+
+    store_be64(out, (uint64_t)hi << 32 | lo);
+}
+
+/* ===== EAC alpha ===== */
+
+static int alpha_error(const uint8_t block[16][4], int base, int mult, int table,
+                       int limit, uint64_t* indices) {
+    int total = 0;
+    uint64_t bits = 0;
+    for (int p = 0; p < 16; p++) {
+        int a = block[p][3];
+        int best = 0x7fffffff, index = 0;
+        for (int k = 0; k < 8; k++) {
+            int d = a - clamp255(base + g_eac_modifiers[table][k] * mult);
+            if (d * d < best) {
+                best = d * d;
+                index = k;
+            }
+        }
+        total += best;
+        if (total >= limit) return total;
+        bits |= (uint64_t)index << (45 - 3 * p);
+    }
+    *indices = bits;
+    return total;
+}
+
+void texture_compress_eac_alpha(const uint8_t block[16][4], uint8_t out[8]) {
+    int lo = 255, hi = 0;
+    for (int p = 0; p < 16; p++) {
+        int a = block[p][3];
+        if (a < lo) lo = a;
+        if (a > hi) hi = a;
+    }
+
+    if (lo == hi) {
+        /* Table 13 has a zero modifier at index 4: every pixel decodes to base */
+        uint64_t v = (uint64_t)lo << 56 | (uint64_t)1 << 52 | (uint64_t)13 << 48;
+        for (int p = 0; p < 16; p++) v |= (uint64_t)4 << (45 - 3 * p);
+        store_be64(out, v);
+        return;
+    }
+
+    int best = 0x7fffffff;
+    uint64_t best_bits = 0;
+    for (int t = 0; t < 16 && best > 0; t++) {
+        int low = g_eac_modifiers[t][3], high = g_eac_modifiers[t][7];
+        int span = high - low;
+        int estimate = (hi - lo + span / 2) / span;
+        for (int m = estimate - 1; m <= estimate + 1; m++) {
+            if (m < 1 || m > 15) continue;
+            int base = clamp255((lo + hi - (low + high) * m + 1) / 2);
+            uint64_t indices = 0;
+            int e = alpha_error(block, base, m, t, best, &indices);
+            if (e < best) {
+                best = e;
+                best_bits = (uint64_t)base << 56 | (uint64_t)m << 52 |
+                            (uint64_t)t << 48 | indices;
+            }
+        }
+    }
+    store_be64(out, best_bits);
+}
+
+/* ===== Mip chain ===== */
+
+/* Gather a 4x4 block in encoder order, repeating edge pixels past the border */
+static void fetch_block(const uint8_t* pixels, int width, int height, int bpp,
+                        int bx, int by, uint8_t block[16][4]) {
+    for (int x = 0; x < 4; x++) {
+        int sx = bx + x < width ? bx + x : width - 1;
+        for (int y = 0; y < 4; y++) {
+            int sy = by + y < height ? by + y : height - 1;
+            const uint8_t* src = pixels + ((size_t)sy * (size_t)width + (size_t)sx) * (size_t)bpp;
+            uint8_t* dst = block[x * 4 + y];
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            dst[3] = bpp == 4 ? src[3] : 255;
+        }
+    }
+}
+
+static uint8_t* encode_level(const uint8_t* pixels, int width, int height, int bpp,
+                             bool alpha, uint8_t* out) {
+    uint8_t block[16][4];
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            fetch_block(pixels, width, height, bpp, bx, by, block);
+            if (alpha) {
+                texture_compress_eac_alpha(block, out);
+                out += 8;
+            }
+            texture_compress_etc2_rgb(block, out);
+            out += 8;
+        }
+    }
+    return out;
+}
+
+static bool encode_chain(const uint8_t* pixels, int width, int height, int bpp,
+                         uint8_t* out) {
+    bool alpha = bpp == 4;
+    int levels = texture_compress_levels(width, height);
+
+    out = encode_level(pixels, width, height, bpp, alpha, out);
+    if (levels == 1) return true;
+
+    /* Two scratch levels, the first a quarter of the source */
+    size_t scratch = (size_t)((width + 1) / 2) * (size_t)((height + 1) / 2) * (size_t)bpp;
+    uint8_t* buffers[2] = { (uint8_t*)malloc(scratch), (uint8_t*)malloc(scratch) };
+    if (!buffers[0] || !buffers[1]) {
+        free(buffers[0]);
+        free(buffers[1]);
+        return false;
+    }
+
+    const uint8_t* src = pixels;
+    for (int level = 1; level < levels; level++) {
+        int w = width > 1 ? width / 2 : 1;
+        int h = height > 1 ? height / 2 : 1;
+        uint8_t* dst = buffers[level & 1];
+        texture_mips_downsample(src, width, height, bpp, true, dst);
+        out = encode_level(dst, w, h, bpp, alpha, out);
+        src = dst;
+        width = w;
+        height = h;
+    }
+
+    free(buffers[0]);
+    free(buffers[1]);
+    return true;
+}
+
+/* ===== Disk cache ===== */
+
+static inline uint64_t rotl64(uint64_t v, int s) {
+    return (v << s) | (v >> (64 - s));
+}
+
+/* Eight bytes per step; only needs to tell textures apart, not resist attacks */
+static uint64_t hash_pixels(const uint8_t* data, size_t size, int width, int height,
+                            GLenum format) {
+    const uint64_t k1 = 0x9E3779B185EBCA87ull, k2 = 0xC2B2AE3D27D4EB4Full;
+    uint64_t h = 0x27D4EB2F165667C5ull ^ (uint64_t)size;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        memcpy(&w, data + i, 8);
+        h = rotl64(h ^ (w * k2), 31) * k1;
+    }
+    for (; i < size; i++) h = rotl64(h ^ (data[i] * k1), 11) * k2;
+
+    h ^= (uint64_t)width << 32 | (uint64_t)height;
+    h = rotl64(h * k2, 29) ^ ((uint64_t)format << 8 | CACHE_VERSION);
+    h ^= h >> 33;
+    h *= k2;
+    h ^= h >> 29;
+    return h;
+}
+
+static void cache_build_path(char* path, size_t path_size, uint64_t hash) {
+    snprintf(path, path_size, "%s/%016llx%s", g.cache_dir, (unsigned long long)hash,
+             CACHE_FILE_EXT);
+}
+
+static bool cache_load(uint64_t hash, const CacheHeader* expect, void* out) {
+    char path[700];
+    cache_build_path(path, sizeof(path), hash);
+
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+
+    CacheHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 &&
+              memcmp(&header, expect, sizeof(header)) == 0 &&
+              fread(out, 1, expect->size, f) == expect->size;
+    fclose(f);
+    if (!ok) LOGW("Discarding stale compressed texture %s", path);
+    return ok;
+}
+
+static void cache_store(uint64_t hash, const CacheHeader* header, const void* data) {
+    char path[700], temp[720];
+    cache_build_path(path, sizeof(path), hash);
+    /* Workers may write the same entry; publish complete files only */
+    snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long)gettid());
+
+    FILE* f = fopen(temp, "wb");
+    if (!f) return;
+    bool ok = fwrite(header, sizeof(*header), 1, f) == 1 &&
+              fwrite(data, 1, header->size, f) == header->size;
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok || rename(temp, path) != 0) {
+        LOGW("Failed to write compressed texture %s", path);
+        unlink(temp);
+    }
+}
+
+/* ===== Public API ===== */
+
+void texture_compress_init(const GPUInfo* info, const char* cache_dir) {
+    g.supported = info->supports_etc2;
+    g.cache_enabled = false;
+
+    if (cache_dir && cache_dir[0]) {
+        struct stat st;
+        snprintf(g.cache_dir, sizeof(g.cache_dir), "%s/textures", cache_dir);
+        if (stat(g.cache_dir, &st) == 0 || mkdir(g.cache_dir, 0755) == 0) {
+            g.cache_enabled = true;
+        } else {
+            LOGW("Failed to create texture cache directory: %s", g.cache_dir);
+        }
+    }
+
+    LOGI("Texture compression: %s, cache %s", g.supported ? "ETC2" : "unavailable",
+         g.cache_enabled ? g.cache_dir : "disabled");
+}
+
+bool texture_compress_eligible(int width, int height, GLenum format) {
+    return g.supported && prismgl_get_config()->texture_compression &&
+           (format == GL_RGB || format == GL_RGBA) &&
+           width >= TEXTURE_COMPRESS_MIN_SIZE && height >= TEXTURE_COMPRESS_MIN_SIZE;
+}
+
+GLenum texture_compress_format(GLenum format) {
+    return format == GL_RGB ? GL_COMPRESSED_RGB8_ETC2 : GL_COMPRESSED_RGBA8_ETC2_EAC;
+}
+
+int texture_compress_levels(int width, int height) {
+    return texture_mips_levels(width, height);
+}
+
+size_t texture_compress_level_size(int width, int height, GLenum format) {
+    size_t blocks = (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4);
+    return blocks * (format == GL_RGB ? 8u : 16u);
+}
+
+size_t texture_compress_chain_size(int width, int height, GLenum format) {
+    size_t size = 0;
+    int levels = texture_compress_levels(width, height);
+    for (int level = 0; level < levels; level++) {
+        size += texture_compress_level_size(width, height, format);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    return size;
+}
+
+bool texture_compress_chain(const void* pixels, int width, int height, GLenum format,
+                            void* out, size_t size) {
+    if (!pixels || !out || width <= 0 || height <= 0) return false;
+    if (format != GL_RGB && format != GL_RGBA) return false;
+    if (size < texture_compress_chain_size(width, height, format)) return false;
+
+    int bpp = format == GL_RGB ? 3 : 4;
+    size_t source_size = (size_t)width * (size_t)height * (size_t)bpp;
+    size_t chain_size = texture_compress_chain_size(width, height, format);
+
+    CacheHeader header = {
+        .magic = CACHE_MAGIC,
+        .version = CACHE_VERSION,
+        .width = (uint32_t)width,
+        .height = (uint32_t)height,
+        .format = (uint32_t)format,
+        .size = (uint32_t)chain_size,
+    };
+    uint64_t hash = 0;
+    if (g.cache_enabled) {
+        hash = hash_pixels((const uint8_t*)pixels, source_size, width, height, format);
+        if (cache_load(hash, &header, out)) return true;
+    }
+
+    if (!g.cache_enabled) return encode_chain((const uint8_t*)pixels, width, height, bpp,
+                                              (uint8_t*)out);
+
+    /* `out` is usually a mapped buffer; encode elsewhere rather than read it back */
+    uint8_t* encoded = (uint8_t*)malloc(chain_size);
+    if (!encoded) return false;
+    bool ok = encode_chain((const uint8_t*)pixels, width, height, bpp, encoded);
+    if (ok) {
+        memcpy(out, encoded, chain_size);
+        cache_store(hash, &header, encoded);
+    }
+    free(encoded);
+    return ok;
+}
@@ -0,0 +1,394 @@
+/*
+ * PrismGL Texture Convert
+ * ES 3 rejects several pixel layouts desktop callers upload. Where the
+ * bytes already sit in an ES layout only the enums change and the
+ * texture's swizzle makes sampling match: BGRA textures are stored with
+ * red and blue swapped, luminance/alpha/intensity ones as R8/RG8. Sub
+ * uploads follow whatever the texture was defined with, so an RGBA update
+ * of a BGRA-stored texture is swapped on the CPU instead.
+ *
+ * Everything else goes through a row-by-row kernel into a tightly packed
+ * copy: 32-bit byte permutations for the 8_8_8_8 packings, 16-to-8-bit
+ * narrowing with exact rounding, and a 5_6_5_REV field swap. The word
+ * permutations and the 565 swap are plain C the compiler vectorizes as
+ * well as hand-written intrinsics did; the narrowing keeps its NEON/SSE2
+ * path, which is several times faster.
+ */
+
+#include "texture_convert.h"
+#include "prismgl_internal.h"
+#include "state_shadow.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Convert"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+/* ===== Kernels ===== */
+
+static inline uint32_t load32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline void store32(uint8_t* p, uint32_t v) {
+    memcpy(p, &v, 4);
+}
+
+static void swap_rb32(const uint8_t* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t v = load32(src + i * 4);
+        store32(dst + i * 4, (v & 0xFF00FF00u) | ((v >> 16) & 0xFFu) | ((v & 0xFFu) << 16));
+    }
+}
+
+static void swap_rb24(const uint8_t* src, uint8_t* dst, size_t count) {
+    size_t i = 0;
+#if defined(PRISMGL_HAVE_NEON)
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x3_t v = vld3q_u8(src + i * 3);
+        uint8x16_t r = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = r;
+        vst3q_u8(dst + i * 3, v);
+    }
+#endif
+    for (; i < count; i++) {
+        uint8_t r = src[i * 3], g = src[i * 3 + 1], b = src[i * 3 + 2];
+        dst[i * 3] = b;
+        dst[i * 3 + 1] = g;
+        dst[i * 3 + 2] = r;
+    }
+}
+
+/* Bytes ABGR to RGBA: a full byte swap of each pixel */
+static void reverse32(const uint8_t* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        store32(dst + i * 4, __builtin_bswap32(load32(src + i * 4)));
+    }
+}
+
+/* Bytes ARGB to RGBA: rotate each pixel down by one byte */
+static void rotate32(const uint8_t* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t v = load32(src + i * 4);
+        store32(dst + i * 4, (v >> 8) | (v << 24));
+    }
+}
+
+/*
+ * v * 255 / 65535 rounded to nearest, in 16 bits: t = v + 128 saturated,
+ * then (t - (t >> 8)) >> 8. Exact for every input.
+ */
+static void narrow16(const uint8_t* src, uint8_t* dst, size_t count) {
+    size_t i = 0;
+#if defined(PRISMGL_HAVE_NEON)
+    const uint16x8_t half = vdupq_n_u16(128);
+    for (; i + 16 <= count; i += 16) {
+        uint16x8_t a = vqaddq_u16(vreinterpretq_u16_u8(vld1q_u8(src + i * 2)), half);
+        uint16x8_t b = vqaddq_u16(vreinterpretq_u16_u8(vld1q_u8(src + i * 2 + 16)), half);
+        a = vsubq_u16(a, vshrq_n_u16(a, 8));
+        b = vsubq_u16(b, vshrq_n_u16(b, 8));
+        vst1q_u8(dst + i, vcombine_u8(vshrn_n_u16(a, 8), vshrn_n_u16(b, 8)));
+    }
+#elif defined(PRISMGL_HAVE_SSE2)
+    const __m128i half = _mm_set1_epi16(128);
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_adds_epu16(_mm_loadu_si128((const __m128i*)(src + i * 2)), half);
+        __m128i b = _mm_adds_epu16(_mm_loadu_si128((const __m128i*)(src + i * 2 + 16)), half);
+        a = _mm_srli_epi16(_mm_sub_epi16(a, _mm_srli_epi16(a, 8)), 8);
+        b = _mm_srli_epi16(_mm_sub_epi16(b, _mm_srli_epi16(b, 8)), 8);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(a, b));
+    }
+#endif
+    for (; i < count; i++) {
+        uint16_t v;
+        memcpy(&v, src + i * 2, 2);
+        uint32_t t = v < 65408 ? v + 128u : 65535u;
+        dst[i] = (uint8_t)((t - (t >> 8)) >> 8);
+    }
+}
+
+/* 5_6_5_REV keeps red in the low bits; 5_6_5 in the high ones */
+static void swap565(const uint8_t* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint16_t v;
+        memcpy(&v, src + i * 2, 2);
+        v = (uint16_t)((v << 11) | (v & 0x07E0) | (v >> 11));
+        memcpy(dst + i * 2, &v, 2);
+    }
+}
+
+void texture_convert_pixels(TextureConvertKernel kernel, const void* src, void* dst,
+                            size_t count, int components) {
+    const uint8_t* s = (const uint8_t*)src;
+    uint8_t* d = (uint8_t*)dst;
+    switch (kernel) {
+        case TEXTURE_CONVERT_SWAP_RB:     swap_rb32(s, d, count); break;
+        case TEXTURE_CONVERT_SWAP_RB_RGB: swap_rb24(s, d, count); break;
+        case TEXTURE_CONVERT_REVERSE:     reverse32(s, d, count); break;
+        case TEXTURE_CONVERT_ROTATE:      rotate32(s, d, count); break;
+        case TEXTURE_CONVERT_NARROW16:    narrow16(s, d, count * (size_t)components); break;
+        case TEXTURE_CONVERT_SWAP_565:    swap565(s, d, count); break;
+        case TEXTURE_CONVERT_NONE:
+            if (s != d) memmove(d, s, count * (size_t)components);
+            break;
+    }
+}
+
+/* ===== Planning ===== */
+
+/* The ES internal format for a desktop one, unchanged if ES knows it */
+static GLint plain_internal_format(GLint internalformat) {
+    switch (internalformat) {
+        case 1:                         return GL_LUMINANCE;
+        case 2:                         return GL_LUMINANCE_ALPHA;
+        case 3: case GL_BGR:            return GL_RGB;
+        case 4: case GL_BGRA:           return GL_RGBA;
+        case GL_R16:                    return GL_R8;
+        case GL_RG16:                   return GL_RG8;
+        case GL_RGB16:                  return GL_RGB8;
+        case GL_RGBA16:                 return GL_RGBA8;
+        case GL_ALPHA8: case GL_ALPHA16:
+        case GL_LUMINANCE8: case GL_LUMINANCE16:
+        case GL_INTENSITY: case GL_INTENSITY8: case GL_INTENSITY16:
+            return GL_R8;
+        case GL_LUMINANCE8_ALPHA8: case GL_LUMINANCE16_ALPHA16:
+            return GL_RG8;
+        default:
+            return internalformat;
+    }
+}
+
+/* Sized luminance-family formats become R8/RG8 behind a swizzle */
+static TextureSwizzle luminance_swizzle(GLint internalformat) {
+    switch (internalformat) {
+        case GL_LUMINANCE8: case GL_LUMINANCE16:
+            return TEXTURE_SWIZZLE_LUMINANCE;
+        case GL_ALPHA8: case GL_ALPHA16:
+            return TEXTURE_SWIZZLE_ALPHA;
+        case GL_LUMINANCE8_ALPHA8: case GL_LUMINANCE16_ALPHA16:
+            return TEXTURE_SWIZZLE_LUMINANCE_ALPHA;
+        case GL_INTENSITY: case GL_INTENSITY8: case GL_INTENSITY16:
+            return TEXTURE_SWIZZLE_INTENSITY;
+        default:
+            return TEXTURE_SWIZZLE_NONE;
+    }
+}
+
+static bool is_luminance_swizzle(TextureSwizzle swizzle) {
+    return swizzle != TEXTURE_SWIZZLE_NONE && swizzle != TEXTURE_SWIZZLE_BGRA;
+}
+
+bool texture_convert_plan(GLint internalformat, GLenum format, GLenum type,
+                          TextureSwizzle stored, bool define, TextureUploadPlan* out) {
+    TextureUploadPlan p = {
+        .internal_format = plain_internal_format(internalformat),
+        .format = format,
+        .type = type,
+        .kernel = TEXTURE_CONVERT_NONE,
+        .swizzle = define ? TEXTURE_SWIZZLE_NONE : stored,
+    };
+    bool swapped = false;       /* Source has red and blue swapped */
+
+    /* 8_8_8_8_REV is byte order on little-endian */
+    if (type == GL_UNSIGNED_INT_8_8_8_8_REV) p.type = GL_UNSIGNED_BYTE;
+
+    switch (format) {
+        case GL_BGRA:
+        case GL_BGR:
+            p.format = format == GL_BGRA ? GL_RGBA : GL_RGB;
+            if (p.type == GL_UNSIGNED_BYTE) {
+                swapped = true;
+            } else if (format == GL_BGRA && type == GL_UNSIGNED_INT_8_8_8_8) {
+                p.kernel = TEXTURE_CONVERT_ROTATE;
+                p.type = GL_UNSIGNED_BYTE;
+            } else if (format == GL_BGR && type == GL_UNSIGNED_SHORT_5_6_5) {
+                p.kernel = TEXTURE_CONVERT_SWAP_565;
+            } else if (format == GL_BGR && type == GL_UNSIGNED_SHORT_5_6_5_REV) {
+                p.type = GL_UNSIGNED_SHORT_5_6_5;
+            } else {
+                return false;
+            }
+            break;
+        case GL_RGBA:
+            if (type == GL_UNSIGNED_INT_8_8_8_8) {
+                p.kernel = TEXTURE_CONVERT_REVERSE;
+                p.type = GL_UNSIGNED_BYTE;
+            } else if (type == GL_UNSIGNED_SHORT) {
+                p.kernel = TEXTURE_CONVERT_NARROW16;
+                p.type = GL_UNSIGNED_BYTE;
+            }
+            break;
+        case GL_RGB:
+            if (type == GL_UNSIGNED_SHORT_5_6_5_REV) {
+                p.kernel = TEXTURE_CONVERT_SWAP_565;
+                p.type = GL_UNSIGNED_SHORT_5_6_5;
+            } else if (type == GL_UNSIGNED_SHORT) {
+                p.kernel = TEXTURE_CONVERT_NARROW16;
+                p.type = GL_UNSIGNED_BYTE;
+            }
+            break;
+        case GL_RG:
+        case GL_RED:
+            if (type == GL_UNSIGNED_SHORT) {
+                p.kernel = TEXTURE_CONVERT_NARROW16;
+                p.type = GL_UNSIGNED_BYTE;
+            }
+            break;
+        case GL_LUMINANCE:
+        case GL_ALPHA:
+        case GL_LUMINANCE_ALPHA: {
+            if (type == GL_UNSIGNED_SHORT) {
+                p.kernel = TEXTURE_CONVERT_NARROW16;
+                p.type = GL_UNSIGNED_BYTE;
+            }
+            TextureSwizzle swizzle = define ? luminance_swizzle(internalformat) : stored;
+            if (is_luminance_swizzle(swizzle)) {
+                p.format = format == GL_LUMINANCE_ALPHA ? GL_RG : GL_RED;
+                p.swizzle = swizzle;
+            } else {
+                /* ES takes these unsized, with a matching internal format */
+                p.internal_format = (GLint)format;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    /* A BGRA definition costs nothing behind a swizzle */
+    if (define && swapped && p.kernel == TEXTURE_CONVERT_NONE) p.swizzle = TEXTURE_SWIZZLE_BGRA;
+
+    if (swapped != (p.swizzle == TEXTURE_SWIZZLE_BGRA)) {
+        if (p.kernel == TEXTURE_CONVERT_REVERSE) {
+            p.kernel = TEXTURE_CONVERT_ROTATE;
+        } else if (p.kernel == TEXTURE_CONVERT_ROTATE) {
+            p.kernel = TEXTURE_CONVERT_REVERSE;
+        } else if (p.kernel == TEXTURE_CONVERT_NONE && p.type == GL_UNSIGNED_BYTE) {
+            if (p.format == GL_RGBA) p.kernel = TEXTURE_CONVERT_SWAP_RB;
+            else if (p.format == GL_RGB) p.kernel = TEXTURE_CONVERT_SWAP_RB_RGB;
+        }
+    }
+
+    *out = p;
+    return p.kernel != TEXTURE_CONVERT_NONE || p.format != format || p.type != type ||
+           p.internal_format != internalformat || p.swizzle != stored;
+}
+
+GLenum texture_convert_storage_format(GLenum internalformat, TextureSwizzle* swizzle) {
+    *swizzle = luminance_swizzle((GLint)internalformat);
+    return (GLenum)plain_internal_format((GLint)internalformat);
+}
+
+void texture_convert_set_swizzle(GLuint texture, GLenum target, TextureSwizzle swizzle) {
+    static const GLint k_swizzles[][4] = {
+        [TEXTURE_SWIZZLE_NONE]            = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA },
+        [TEXTURE_SWIZZLE_BGRA]            = { GL_BLUE, GL_GREEN, GL_RED, GL_ALPHA },
+        [TEXTURE_SWIZZLE_LUMINANCE]       = { GL_RED, GL_RED, GL_RED, GL_ONE },
+        [TEXTURE_SWIZZLE_ALPHA]           = { GL_ZERO, GL_ZERO, GL_ZERO, GL_RED },
+        [TEXTURE_SWIZZLE_LUMINANCE_ALPHA] = { GL_RED, GL_RED, GL_RED, GL_GREEN },
+        [TEXTURE_SWIZZLE_INTENSITY]       = { GL_RED, GL_RED, GL_RED, GL_RED },
+    };
+    GLenum bind = texture_registry_binding_target(target);
+    const GLint* s = k_swizzles[swizzle];
+    glTexParameteri(bind, GL_TEXTURE_SWIZZLE_R, s[0]);
+    glTexParameteri(bind, GL_TEXTURE_SWIZZLE_G, s[1]);
+    glTexParameteri(bind, GL_TEXTURE_SWIZZLE_B, s[2]);
+    glTexParameteri(bind, GL_TEXTURE_SWIZZLE_A, s[3]);
+    texture_registry_set_swizzle(texture, target, swizzle);
+}
+
+/* ===== Converted uploads ===== */
+
+void texture_convert_unpack_tight(TextureUnpackState* saved) {
+    if (saved) {
+        state_shadow_get_integerv(GL_UNPACK_ALIGNMENT, &saved->alignment);
+        state_shadow_get_integerv(GL_UNPACK_ROW_LENGTH, &saved->row_length);
+        state_shadow_get_integerv(GL_UNPACK_SKIP_ROWS, &saved->skip_rows);
+        state_shadow_get_integerv(GL_UNPACK_SKIP_PIXELS, &saved->skip_pixels);
+    }
+    state_shadow_pixel_store(GL_UNPACK_ALIGNMENT, 1);
+    state_shadow_pixel_store(GL_UNPACK_ROW_LENGTH, 0);
+    state_shadow_pixel_store(GL_UNPACK_SKIP_ROWS, 0);
+    state_shadow_pixel_store(GL_UNPACK_SKIP_PIXELS, 0);
+}
+
+void texture_convert_unpack_restore(const TextureUnpackState* saved) {
+    state_shadow_pixel_store(GL_UNPACK_ALIGNMENT, saved->alignment);
+    state_shadow_pixel_store(GL_UNPACK_ROW_LENGTH, saved->row_length);
+    state_shadow_pixel_store(GL_UNPACK_SKIP_ROWS, saved->skip_rows);
+    state_shadow_pixel_store(GL_UNPACK_SKIP_PIXELS, saved->skip_pixels);
+}
+
+bool texture_convert_begin(const TextureUploadPlan* plan, GLenum format, GLenum type,
+                           GLsizei width, GLsizei height, const void* pixels,
+                           void** out, TextureUnpackState* saved) {
+    *out = NULL;
+    size_t src_pixel = texture_pixel_size(format, type);
+    size_t dst_pixel = texture_pixel_size(plan->format, plan->type);
+    if (src_pixel == 0 || dst_pixel == 0) return false;
+    if (width <= 0 || height <= 0) return true;
+
+    state_shadow_get_integerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &saved->buffer);
+    if (!pixels && saved->buffer == 0) return true;     /* Storage only */
+
+    state_shadow_get_integerv(GL_UNPACK_ALIGNMENT, &saved->alignment);
+    state_shadow_get_integerv(GL_UNPACK_ROW_LENGTH, &saved->row_length);
+    state_shadow_get_integerv(GL_UNPACK_SKIP_ROWS, &saved->skip_rows);
+    state_shadow_get_integerv(GL_UNPACK_SKIP_PIXELS, &saved->skip_pixels);
+
+    size_t row_pixels = saved->row_length > 0 ? (size_t)saved->row_length : (size_t)width;
+    size_t align = saved->alignment > 0 ? (size_t)saved->alignment : 4;
+    size_t stride = (row_pixels * src_pixel + align - 1) / align * align;
+    size_t first = (size_t)saved->skip_rows * stride + (size_t)saved->skip_pixels * src_pixel;
+    size_t span = (size_t)(height - 1) * stride + (size_t)width * src_pixel;
+
+    const uint8_t* src;
+    if (saved->buffer) {
+        src = (const uint8_t*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                                               (GLintptr)pixels + (GLintptr)first,
+                                               (GLsizeiptr)span, GL_MAP_READ_BIT);
+        if (!src) {
+            LOGW("Could not map the unpack buffer to convert 0x%x/0x%x", format, type);
+            return false;
+        }
+    } else {
+        src = (const uint8_t*)pixels + first;
+    }
+
+    size_t row_bytes = (size_t)width * dst_pixel;
+    uint8_t* dst = (uint8_t*)malloc(row_bytes * (size_t)height);
+    if (dst) {
+        int components = (int)texture_pixel_size(format, GL_UNSIGNED_BYTE);
+        for (GLsizei y = 0; y < height; y++) {
+            texture_convert_pixels(plan->kernel, src + (size_t)y * stride,
+                                   dst + (size_t)y * row_bytes, (size_t)width, components);
+        }
+    }
+    if (saved->buffer) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    if (!dst) {
+        LOGW("Out of memory converting a %dx%d upload", width, height);
+        if (saved->buffer) state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, (GLuint)saved->buffer);
+        return false;
+    }
+
+    /* The copy is tightly packed */
+    texture_convert_unpack_tight(NULL);
+    *out = dst;
+    return true;
+}
+
+void texture_convert_end(void* converted, const TextureUnpackState* saved) {
+    if (!converted) return;
+    free(converted);
+
+    texture_convert_unpack_restore(saved);
+    if (saved->buffer) state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, (GLuint)saved->buffer);
+}
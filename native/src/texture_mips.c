@@ -0,0 +1,253 @@
+/*
+ * PrismGL Texture Mips
+ * glGenerateMipmap is a readback or a chain of render passes on several
+ * mobile drivers, all on the GL thread. Chains are built here on the
+ * upload workers instead and uploaded with the base level.
+ *
+ * Plain levels average 2x2 texels four source pixels at a time with
+ * NEON/SSE2. sRGB levels decode through a table to 16-bit linear values,
+ * average rows with SIMD rounding halving adds, and re-encode through a
+ * 4096 entry table indexed by the top 12 bits.
+ */
+
+#include "texture_mips.h"
+#include "prismgl_internal.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SRGB_ENCODE_BITS 12
+
+static uint16_t g_srgb_to_linear[256];
+static uint8_t g_linear_to_srgb[1 << SRGB_ENCODE_BITS];
+static pthread_once_t g_tables_once = PTHREAD_ONCE_INIT;
+
+static void build_tables(void) {
+    for (int i = 0; i < 256; i++) {
+        double c = i / 255.0;
+        double l = c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+        g_srgb_to_linear[i] = (uint16_t)lround(l * 65535.0);
+    }
+    const int shift = 16 - SRGB_ENCODE_BITS;
+    for (int i = 0; i < (1 << SRGB_ENCODE_BITS); i++) {
+        /* Centre of the bucket of linear values sharing these top bits */
+        double l = ((i << shift) + (1 << (shift - 1))) / 65535.0;
+        double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+        g_linear_to_srgb[i] = (uint8_t)lround(c * 255.0);
+    }
+}
+
+/* ===== Levels ===== */
+
+int texture_mips_levels(int width, int height) {
+    int size = width > height ? width : height;
+    int levels = 1;
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+void texture_mips_level_size(int width, int height, int level, int* level_width,
+                             int* level_height) {
+    int w = width >> level, h = height >> level;
+    *level_width = w > 0 ? w : 1;
+    *level_height = h > 0 ? h : 1;
+}
+
+size_t texture_mips_chain_size(int width, int height, int bpp) {
+    size_t size = 0;
+    int levels = texture_mips_levels(width, height);
+    for (int level = 0; level < levels; level++) {
+        int w, h;
+        texture_mips_level_size(width, height, level, &w, &h);
+        size += (size_t)w * (size_t)h * (size_t)bpp;
+    }
+    return size;
+}
+
+/* ===== Plain filter ===== */
+
+/* Two output RGBA texels from four source texels of two rows */
+static inline void average_rgba4(const uint8_t* a, const uint8_t* b, uint8_t* out) {
+#if defined(PRISMGL_HAVE_NEON)
+    uint8x16_t top = vld1q_u8(a), bottom = vld1q_u8(b);
+    uint16x8_t left = vaddl_u8(vget_low_u8(top), vget_low_u8(bottom));
+    uint16x8_t right = vaddl_u8(vget_high_u8(top), vget_high_u8(bottom));
+    uint16x4_t p0 = vadd_u16(vget_low_u16(left), vget_high_u16(left));
+    uint16x4_t p1 = vadd_u16(vget_low_u16(right), vget_high_u16(right));
+    vst1_u8(out, vrshrn_n_u16(vcombine_u16(p0, p1), 2));
+#elif defined(PRISMGL_HAVE_SSE2)
+    __m128i zero = _mm_setzero_si128();
+    __m128i top = _mm_loadu_si128((const __m128i*)a);
+    __m128i bottom = _mm_loadu_si128((const __m128i*)b);
+    __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+    __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+    left = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+    right = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+    __m128i sum = _mm_unpacklo_epi64(left, right);
+    sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+    _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(sum, sum));
+#else
+    for (int c = 0; c < 8; c++) {
+        out[c] = (uint8_t)((a[c] + a[c + 4] + b[c] + b[c + 4] + 2) >> 2);
+    }
+#endif
+}
+
+static void downsample_plain(const uint8_t* src, int width, int height, int bpp,
+                             uint8_t* dst, int dst_width, int dst_height) {
+    size_t stride = (size_t)width * (size_t)bpp;
+    for (int y = 0; y < dst_height; y++) {
+        const uint8_t* a = src + (size_t)(y * 2) * stride;
+        const uint8_t* b = y * 2 + 1 < height ? a + stride : a;
+        uint8_t* o = dst + (size_t)y * (size_t)dst_width * (size_t)bpp;
+
+        int x = 0;
+        if (bpp == 4) {
+            /* Whole pairs only; an odd last column is folded by the tail */
+            for (; x + 2 <= dst_width && x * 2 + 4 <= width; x += 2) {
+                average_rgba4(a + (size_t)x * 8, b + (size_t)x * 8, o + (size_t)x * 4);
+            }
+        }
+        for (; x < dst_width; x++) {
+            int x0 = x * 2, x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+            for (int c = 0; c < bpp; c++) {
+                o[x * bpp + c] = (uint8_t)((a[x0 * bpp + c] + a[x1 * bpp + c] +
+                                            b[x0 * bpp + c] + b[x1 * bpp + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+/* ===== sRGB filter ===== */
+
+static void decode_row(const uint8_t* src, int count, int bpp, uint16_t* out) {
+    if (bpp == 4) {
+        for (int i = 0; i < count; i++, src += 4, out += 4) {
+            out[0] = g_srgb_to_linear[src[0]];
+            out[1] = g_srgb_to_linear[src[1]];
+            out[2] = g_srgb_to_linear[src[2]];
+            out[3] = (uint16_t)(src[3] * 257);
+        }
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        for (int c = 0; c < bpp; c++) {
+            uint8_t v = src[i * bpp + c];
+            out[i * bpp + c] = c < 3 ? g_srgb_to_linear[v] : (uint16_t)(v * 257);
+        }
+    }
+}
+
+/* out = (a + b + 1) / 2, lane by lane */
+static void average_rows(const uint16_t* a, const uint16_t* b, size_t count, uint16_t* out) {
+    size_t i = 0;
+#if defined(PRISMGL_HAVE_NEON)
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u16(out + i, vrhaddq_u16(vld1q_u16(a + i), vld1q_u16(b + i)));
+    }
+#elif defined(PRISMGL_HAVE_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_avg_epu16(va, vb));
+    }
+#endif
+    for (; i < count; i++) out[i] = (uint16_t)((a[i] + b[i] + 1) >> 1);
+}
+
+static void downsample_srgb(const uint8_t* src, int width, int height, int bpp,
+                            uint8_t* dst, int dst_width, int dst_height) {
+    size_t count = (size_t)width * (size_t)bpp;
+    uint16_t* rows = (uint16_t*)malloc(3 * count * sizeof(uint16_t));
+    if (!rows) {
+        downsample_plain(src, width, height, bpp, dst, dst_width, dst_height);
+        return;
+    }
+    uint16_t* top = rows;
+    uint16_t* bottom = rows + count;
+    uint16_t* mean = rows + 2 * count;
+    const int shift = 16 - SRGB_ENCODE_BITS;
+
+    for (int y = 0; y < dst_height; y++) {
+        int y1 = y * 2 + 1 < height ? y * 2 + 1 : y * 2;
+        decode_row(src + (size_t)(y * 2) * count, width, bpp, top);
+        decode_row(src + (size_t)y1 * count, width, bpp, bottom);
+        average_rows(top, bottom, count, mean);
+
+        uint8_t* o = dst + (size_t)y * (size_t)dst_width * (size_t)bpp;
+        int x = 0;
+        if (bpp == 4) {
+            for (; x * 2 + 1 < width; x++) {
+                const uint16_t* m = mean + x * 8;
+                o[x * 4 + 0] = g_linear_to_srgb[(m[0] + m[4] + 1u) >> (shift + 1)];
+                o[x * 4 + 1] = g_linear_to_srgb[(m[1] + m[5] + 1u) >> (shift + 1)];
+                o[x * 4 + 2] = g_linear_to_srgb[(m[2] + m[6] + 1u) >> (shift + 1)];
+                o[x * 4 + 3] = (uint8_t)((((m[3] + m[7] + 1u) >> 1) * 255u + 32767u) / 65535u);
+            }
+        }
+        for (; x < dst_width; x++) {
+            int x0 = x * 2, x1 = x * 2 + 1 < width ? x * 2 + 1 : x * 2;
+            for (int c = 0; c < bpp; c++) {
+                unsigned v = (mean[x0 * bpp + c] + mean[x1 * bpp + c] + 1u) >> 1;
+                o[x * bpp + c] = c < 3 ? g_linear_to_srgb[v >> shift]
+                                       : (uint8_t)((v * 255u + 32767u) / 65535u);
+            }
+        }
+    }
+    free(rows);
+}
+
+void texture_mips_downsample(const uint8_t* src, int width, int height, int bpp,
+                             bool srgb, uint8_t* dst) {
+    int dst_width = width > 1 ? width / 2 : 1;
+    int dst_height = height > 1 ? height / 2 : 1;
+    if (srgb) {
+        pthread_once(&g_tables_once, build_tables);
+        downsample_srgb(src, width, height, bpp, dst, dst_width, dst_height);
+    } else {
+        downsample_plain(src, width, height, bpp, dst, dst_width, dst_height);
+    }
+}
+
+bool texture_mips_build_chain(const uint8_t* pixels, int width, int height, int bpp,
+                              bool srgb, uint8_t* out) {
+    size_t size = (size_t)width * (size_t)height * (size_t)bpp;
+    int levels = texture_mips_levels(width, height);
+
+    /* `out` is usually a mapped buffer; filter between private levels instead */
+    size_t scratch = (size_t)((width + 1) / 2) * (size_t)((height + 1) / 2) * (size_t)bpp;
+    uint8_t* buffers[2] = { NULL, NULL };
+    if (levels > 1) {
+        buffers[0] = (uint8_t*)malloc(scratch);
+        buffers[1] = (uint8_t*)malloc(scratch);
+        if (!buffers[0] || !buffers[1]) {
+            free(buffers[0]);
+            free(buffers[1]);
+            return false;
+        }
+    }
+
+    memcpy(out, pixels, size);
+    out += size;
+
+    const uint8_t* src = pixels;
+    for (int level = 1; level < levels; level++) {
+        uint8_t* dst = buffers[level & 1];
+        texture_mips_downsample(src, width, height, bpp, srgb, dst);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        size = (size_t)width * (size_t)height * (size_t)bpp;
+        memcpy(out, dst, size);
+        out += size;
+        src = dst;
+    }
+
+    free(buffers[0]);
+    free(buffers[1]);
+    return true;
+}
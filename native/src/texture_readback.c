@@ -0,0 +1,325 @@
+/*
+ * PrismGL Texture Readback
+ * ES has no glGetTexImage. The level is attached to a framebuffer owned
+ * by PrismGL, bound to GL_READ_FRAMEBUFFER only so the draw binding is
+ * untouched, and read with glReadPixels at the size the texture registry
+ * recorded. The attachment is dropped afterwards so a deleted texture is
+ * not kept alive by it.
+ *
+ * The asynchronous variant reads into a pooled pixel pack buffer and
+ * inserts a fence; the buffer is mapped at the end of a later frame, once
+ * the fence has signalled, so neither call waits for the GPU.
+ *
+ * ES reads RGBA only, so BGRA requests are read as RGBA and red and blue
+ * are swapped wherever the rows end up: in client memory, in the
+ * application's pack buffer, or in the pooled buffer once it is mapped.
+ */
+
+#include "texture_readback.h"
+#include "texture_registry.h"
+#include "texture_convert.h"
+#include "state_shadow.h"
+#include "context.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Readback"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define READBACK_POOL_SIZE 4
+
+typedef struct {
+    GLuint buffer;
+    GLsizeiptr capacity;
+} ReadbackBuffer;
+
+typedef struct {
+    ReadbackBuffer buffer;
+    GLsizeiptr size;
+    GLint width;                /* Of the tightly packed rows, for the swap */
+    bool swap;                  /* Red and blue to be swapped on map */
+    GLsync fence;
+    prismgl_readback_callback cb;
+    void* userdata;
+} PendingReadback;
+
+typedef struct {
+    GLuint framebuffer;
+    ReadbackBuffer pool[READBACK_POOL_SIZE];
+    int pool_count;
+    PendingReadback* pending;
+    int pending_count;
+    int pending_capacity;
+} ReadbackState;
+
+static inline ReadbackState* readback_state(void) {
+    return (ReadbackState*)prismgl_context_state(PRISMGL_STATE_READBACK);
+}
+
+void* texture_readback_create_state(void) {
+    return calloc(1, sizeof(ReadbackState));
+}
+
+void texture_readback_destroy_state(void* state) {
+    ReadbackState* s = (ReadbackState*)state;
+    /* The context is going away; tell waiting callers their reads are lost */
+    for (int i = 0; i < s->pending_count; i++) {
+        if (s->pending[i].cb) s->pending[i].cb(NULL, 0, s->pending[i].userdata);
+    }
+    free(s->pending);
+    free(s);
+}
+
+/* ===== Reading a level ===== */
+
+static bool layered(GLenum target) {
+    return target == GL_TEXTURE_3D || target == GL_TEXTURE_2D_ARRAY;
+}
+
+/* Registry first; textures defined behind PrismGL's back are asked for once */
+static bool level_size(GLuint texture, GLenum target, GLint level, TextureLevel* out) {
+    if (texture_registry_level(texture, level, out)) return true;
+
+    GLint width = 0, height = 0, depth = 1, format = 0;
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
+    if (layered(target)) glGetTexLevelParameteriv(target, level, GL_TEXTURE_DEPTH, &depth);
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    if (width <= 0 || height <= 0) return false;
+
+    texture_registry_define(texture, target, level, (GLenum)format, width, height, depth);
+    out->width = width;
+    out->height = height;
+    out->depth = depth > 0 ? depth : 1;
+    out->internal_format = (GLenum)format;
+    return true;
+}
+
+/* Bytes between rows with the current pack state */
+static size_t row_stride(const TextureLevel* l, GLenum format, GLenum type) {
+    GLint alignment = 4, row_length = 0;
+    state_shadow_get_integerv(GL_PACK_ALIGNMENT, &alignment);
+    state_shadow_get_integerv(GL_PACK_ROW_LENGTH, &row_length);
+
+    size_t pixel = texture_pixel_size(format, type);
+    size_t row_pixels = row_length > 0 ? (size_t)row_length : (size_t)l->width;
+    size_t align = alignment > 0 ? (size_t)alignment : 4;
+    return (row_pixels * pixel + align - 1) / align * align;
+}
+
+/* Every layer of `level` into `dst`, a client pointer or pack buffer offset */
+static void read_level(ReadbackState* s, GLuint texture, GLenum target, GLint level,
+                       const TextureLevel* l, GLenum format, GLenum type, uint8_t* dst) {
+    GLint previous = 0;
+    state_shadow_get_integerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+
+    if (!s->framebuffer) glGenFramebuffers(1, &s->framebuffer);
+    state_shadow_bind_framebuffer(GL_READ_FRAMEBUFFER, s->framebuffer);
+
+    int layers = layered(target) ? l->depth : 1;
+    size_t stride = layers > 1 ? row_stride(l, format, type) * (size_t)l->height : 0;
+
+    for (int layer = 0; layer < layers; layer++) {
+        if (layered(target)) {
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture,
+                                      level, layer);
+        } else {
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, target,
+                                   texture, level);
+        }
+        if (layer == 0) {
+            GLenum status = glCheckFramebufferStatus(GL_READ_FRAMEBUFFER);
+            if (status != GL_FRAMEBUFFER_COMPLETE) {
+                LOGW("glGetTexImage: texture %u level %d not readable (0x%x)",
+                     texture, level, status);
+                break;
+            }
+        }
+        glReadPixels(0, 0, l->width, l->height, format, type, dst + (size_t)layer * stride);
+    }
+
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    state_shadow_bind_framebuffer(GL_READ_FRAMEBUFFER, (GLuint)previous);
+}
+
+/*
+ * BGRA textures are stored swapped (texture_convert), so a BGRA read of
+ * one, or an RGBA read of any other, needs no swap. Turns `format` into
+ * the one glReadPixels accepts; true if the rows read need a swap.
+ */
+static bool read_format(GLuint texture, GLenum* format, GLenum type) {
+    if (type != GL_UNSIGNED_BYTE || (*format != GL_BGRA && *format != GL_RGBA)) return false;
+    bool stored_bgra = texture_registry_swizzle(texture) == TEXTURE_SWIZZLE_BGRA;
+    bool swap = (*format == GL_BGRA) != stored_bgra;
+    *format = GL_RGBA;
+    return swap;
+}
+
+static void swap_rows(uint8_t* pixels, size_t stride, size_t rows, GLint width) {
+    for (size_t y = 0; y < rows; y++) {
+        uint8_t* row = pixels + y * stride;
+        texture_convert_pixels(TEXTURE_CONVERT_SWAP_RB, row, row, (size_t)width, 4);
+    }
+}
+
+void texture_readback_get_image(GLenum target, GLint level, GLenum format, GLenum type,
+                                void* pixels) {
+    GLint pack_buffer = 0;
+    state_shadow_get_integerv(GL_PIXEL_PACK_BUFFER_BINDING, &pack_buffer);
+    /* NULL is offset 0 when a pack buffer is bound */
+    if (!pixels && pack_buffer == 0) return;
+
+    GLuint texture = texture_registry_bound(target);
+    if (texture == 0) {
+        LOGW("glGetTexImage: no texture bound to 0x%x", target);
+        return;
+    }
+    TextureLevel l;
+    if (!level_size(texture, target, level, &l)) {
+        LOGW("glGetTexImage: level %d of texture %u is undefined", level, texture);
+        return;
+    }
+
+    bool swap = read_format(texture, &format, type);
+    read_level(readback_state(), texture, target, level, &l, format, type, (uint8_t*)pixels);
+    if (!swap) return;
+
+    size_t stride = row_stride(&l, format, type);
+    size_t rows = (size_t)l.height * (size_t)(layered(target) ? l.depth : 1);
+    if (pack_buffer == 0) {
+        swap_rows((uint8_t*)pixels, stride, rows, l.width);
+        return;
+    }
+
+    /* The rows are in the application's pack buffer, so swap them there */
+    GLsizeiptr length = (GLsizeiptr)((rows - 1) * stride + (size_t)l.width * 4);
+    uint8_t* mapped = (uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER,
+                                                 (GLintptr)(uintptr_t)pixels, length,
+                                                 GL_MAP_READ_BIT | GL_MAP_WRITE_BIT);
+    if (!mapped) {
+        LOGW("glGetTexImage: pack buffer %d not mappable, BGRA rows left as RGBA", pack_buffer);
+        return;
+    }
+    swap_rows(mapped, stride, rows, l.width);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+}
+
+/* ===== Asynchronous reads ===== */
+
+static ReadbackBuffer take_buffer(ReadbackState* s, GLsizeiptr size) {
+    /* Smallest pooled buffer that fits, else grow the largest */
+    int best = -1;
+    for (int i = 0; i < s->pool_count; i++) {
+        if (s->pool[i].capacity >= size &&
+            (best < 0 || s->pool[i].capacity < s->pool[best].capacity)) {
+            best = i;
+        }
+    }
+    if (best < 0 && s->pool_count > 0) best = s->pool_count - 1;
+
+    ReadbackBuffer b = { 0, 0 };
+    if (best >= 0) {
+        b = s->pool[best];
+        s->pool[best] = s->pool[--s->pool_count];
+    } else {
+        glGenBuffers(1, &b.buffer);
+    }
+    state_shadow_bind_buffer(GL_PIXEL_PACK_BUFFER, b.buffer);
+    if (b.capacity < size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        b.capacity = size;
+    }
+    return b;
+}
+
+static void return_buffer(ReadbackState* s, ReadbackBuffer b) {
+    if (s->pool_count < READBACK_POOL_SIZE) {
+        s->pool[s->pool_count++] = b;
+    } else {
+        state_shadow_delete_buffers(1, &b.buffer);
+    }
+}
+
+bool texture_readback_async(GLenum target, GLint level, GLenum format, GLenum type,
+                            prismgl_readback_callback cb, void* userdata) {
+    if (!cb) return false;
+    size_t pixel = texture_pixel_size(format, type);
+    GLuint texture = texture_registry_bound(target);
+    TextureLevel l;
+    if (pixel == 0 || texture == 0 || !level_size(texture, target, level, &l)) return false;
+
+    ReadbackState* s = readback_state();
+    if (s->pending_count == s->pending_capacity) {
+        int capacity = s->pending_capacity ? s->pending_capacity * 2 : 8;
+        PendingReadback* pending = (PendingReadback*)realloc(s->pending,
+                                                             (size_t)capacity * sizeof(PendingReadback));
+        if (!pending) return false;
+        s->pending = pending;
+        s->pending_capacity = capacity;
+    }
+
+    int layers = layered(target) ? l.depth : 1;
+    GLsizeiptr size = (GLsizeiptr)((size_t)l.width * (size_t)l.height * (size_t)layers * pixel);
+
+    /* Tightly packed rows, whatever the application set */
+    GLint pack_buffer = 0, alignment = 4, row_length = 0;
+    state_shadow_get_integerv(GL_PIXEL_PACK_BUFFER_BINDING, &pack_buffer);
+    state_shadow_get_integerv(GL_PACK_ALIGNMENT, &alignment);
+    state_shadow_get_integerv(GL_PACK_ROW_LENGTH, &row_length);
+    state_shadow_pixel_store(GL_PACK_ALIGNMENT, 1);
+    state_shadow_pixel_store(GL_PACK_ROW_LENGTH, 0);
+
+    bool swap = read_format(texture, &format, type);
+    ReadbackBuffer b = take_buffer(s, size);
+    read_level(s, texture, target, level, &l, format, type, (uint8_t*)0);
+
+    state_shadow_pixel_store(GL_PACK_ALIGNMENT, alignment);
+    state_shadow_pixel_store(GL_PACK_ROW_LENGTH, row_length);
+    state_shadow_bind_buffer(GL_PIXEL_PACK_BUFFER, (GLuint)pack_buffer);
+
+    PendingReadback* r = &s->pending[s->pending_count++];
+    r->buffer = b;
+    r->size = size;
+    r->width = l.width;
+    r->swap = swap;
+    r->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    r->cb = cb;
+    r->userdata = userdata;
+    return true;
+}
+
+void texture_readback_frame_end(void) {
+    ReadbackState* s = readback_state();
+    if (s->pending_count == 0) return;
+
+    GLint pack_buffer = 0;
+    state_shadow_get_integerv(GL_PIXEL_PACK_BUFFER_BINDING, &pack_buffer);
+
+    /* Fences signal in order, so reads are delivered in the order they were issued */
+    int kept = 0;
+    for (int i = 0; i < s->pending_count; i++) {
+        PendingReadback r = s->pending[i];
+        if (r.fence && glClientWaitSync(r.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            s->pending[kept++] = r;
+            continue;
+        }
+        if (r.fence) glDeleteSync(r.fence);
+
+        state_shadow_bind_buffer(GL_PIXEL_PACK_BUFFER, r.buffer.buffer);
+        GLbitfield access = GL_MAP_READ_BIT | (r.swap ? GL_MAP_WRITE_BIT : 0);
+        void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, r.size, access);
+        if (data && r.swap) {
+            size_t stride = (size_t)r.width * 4;
+            swap_rows((uint8_t*)data, stride, (size_t)r.size / stride, r.width);
+        }
+        r.cb(data, data ? (size_t)r.size : 0, r.userdata);
+        if (data) glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        return_buffer(s, r.buffer);
+    }
+    s->pending_count = kept;
+
+    state_shadow_bind_buffer(GL_PIXEL_PACK_BUFFER, (GLuint)pack_buffer);
+}
@@ -0,0 +1,481 @@
+/*
+ * PrismGL Texture Registry
+ * Texture names belong to a share group, and loaders define textures from
+ * other threads' contexts, so the registry is global: an open-addressing
+ * table keyed by name behind one mutex. Lookups are rare (readback and
+ * accounting), definitions happen once per level.
+ */
+
+#include "texture_registry.h"
+#include "prismgl.h"
+#include "state_shadow.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Textures"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define REGISTRY_INITIAL_CAPACITY 256   /* Power of two */
+#define REGISTRY_TOMBSTONE        UINT32_MAX
+
+static struct {
+    pthread_mutex_t lock;
+    TextureInfo* slots;         /* name 0 is empty, REGISTRY_TOMBSTONE deleted */
+    size_t capacity;
+    size_t used;                /* Live entries plus tombstones */
+    atomic_int swizzled;        /* Entries with a swizzle, lets lookups skip the lock */
+    atomic_int dropped;         /* Entries with dropped levels, likewise */
+    size_t usage;               /* Sum of every entry's bytes */
+    size_t peak;
+} g = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static inline size_t slot_hash(GLuint name) {
+    uint32_t h = name * 0x9E3779B1u;
+    return (size_t)(h ^ (h >> 16));
+}
+
+/* ===== Table ===== */
+
+static TextureInfo* find(GLuint name) {
+    if (!g.slots) return NULL;
+    size_t mask = g.capacity - 1;
+    for (size_t i = slot_hash(name) & mask;; i = (i + 1) & mask) {
+        if (g.slots[i].name == name) return &g.slots[i];
+        if (g.slots[i].name == 0) return NULL;
+    }
+}
+
+static bool grow(void) {
+    size_t capacity = g.capacity ? g.capacity * 2 : REGISTRY_INITIAL_CAPACITY;
+    TextureInfo* slots = (TextureInfo*)calloc(capacity, sizeof(TextureInfo));
+    if (!slots) return false;
+
+    size_t used = 0;
+    for (size_t i = 0; i < g.capacity; i++) {
+        TextureInfo* old = &g.slots[i];
+        if (old->name == 0 || old->name == REGISTRY_TOMBSTONE) continue;
+        size_t j = slot_hash(old->name) & (capacity - 1);
+        while (slots[j].name != 0) j = (j + 1) & (capacity - 1);
+        slots[j] = *old;
+        used++;
+    }
+    free(g.slots);
+    g.slots = slots;
+    g.capacity = capacity;
+    g.used = used;
+    return true;
+}
+
+/* Existing entry or a fresh one for `name`, NULL when out of memory */
+static TextureInfo* find_or_insert(GLuint name) {
+    TextureInfo* info = find(name);
+    if (info) return info;
+
+    if ((g.used + 1) * 4 > g.capacity * 3 && !grow()) return NULL;
+
+    size_t mask = g.capacity - 1;
+    size_t i = slot_hash(name) & mask;
+    while (g.slots[i].name != 0 && g.slots[i].name != REGISTRY_TOMBSTONE) i = (i + 1) & mask;
+    if (g.slots[i].name == 0) g.used++;
+
+    info = &g.slots[i];
+    memset(info, 0, sizeof(*info));
+    info->name = name;
+    return info;
+}
+
+/* Recompute the bytes of `info` after its levels changed */
+static void account(TextureInfo* info) {
+    size_t bytes = 0;
+    for (int i = 0; i < TEXTURE_REGISTRY_MAX_LEVELS; i++) {
+        const TextureLevel* l = &info->levels[i];
+        if (l->width > 0) bytes += texture_level_bytes(l->internal_format, l->width, l->height, l->depth);
+    }
+    if (info->target == GL_TEXTURE_CUBE_MAP) bytes *= 6;
+
+    g.usage = g.usage - info->bytes + bytes;
+    if (g.usage > g.peak) g.peak = g.usage;
+    info->bytes = bytes;
+}
+
+static void set_dropped(TextureInfo* info, GLint dropped) {
+    if ((info->dropped != 0) != (dropped != 0)) atomic_fetch_add(&g.dropped, dropped ? 1 : -1);
+    info->dropped = dropped;
+}
+
+/* ===== Definitions ===== */
+
+GLenum texture_registry_binding_target(GLenum target) {
+    switch (target) {
+        case GL_TEXTURE_CUBE_MAP_POSITIVE_X:
+        case GL_TEXTURE_CUBE_MAP_NEGATIVE_X:
+        case GL_TEXTURE_CUBE_MAP_POSITIVE_Y:
+        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Y:
+        case GL_TEXTURE_CUBE_MAP_POSITIVE_Z:
+        case GL_TEXTURE_CUBE_MAP_NEGATIVE_Z:
+            return GL_TEXTURE_CUBE_MAP;
+        default:
+            return target;
+    }
+}
+
+GLuint texture_registry_bound(GLenum target) {
+    GLenum pname;
+    switch (texture_registry_binding_target(target)) {
+        case GL_TEXTURE_2D:             pname = GL_TEXTURE_BINDING_2D; break;
+        case GL_TEXTURE_3D:             pname = GL_TEXTURE_BINDING_3D; break;
+        case GL_TEXTURE_2D_ARRAY:       pname = GL_TEXTURE_BINDING_2D_ARRAY; break;
+        case GL_TEXTURE_CUBE_MAP:       pname = GL_TEXTURE_BINDING_CUBE_MAP; break;
+        case GL_TEXTURE_CUBE_MAP_ARRAY: pname = GL_TEXTURE_BINDING_CUBE_MAP_ARRAY; break;
+        default:                        return 0;
+    }
+    GLint texture = 0;
+    state_shadow_get_integerv(pname, &texture);
+    return (GLuint)texture;
+}
+
+void texture_registry_define(GLuint texture, GLenum target, GLint level,
+                             GLenum internal_format, GLsizei width, GLsizei height,
+                             GLsizei depth) {
+    if (texture == 0 || level < 0 || level >= TEXTURE_REGISTRY_MAX_LEVELS) return;
+
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = find_or_insert(texture);
+    if (info) {
+        info->target = texture_registry_binding_target(target);
+        TextureLevel* l = &info->levels[level];
+        l->width = width;
+        l->height = height;
+        l->depth = depth > 0 ? depth : 1;
+        l->internal_format = internal_format;
+        account(info);
+    } else {
+        LOGW("Out of memory recording texture %u", texture);
+    }
+    pthread_mutex_unlock(&g.lock);
+}
+
+void texture_registry_define_storage(GLuint texture, GLenum target, GLsizei levels,
+                                     GLenum internal_format, GLsizei width,
+                                     GLsizei height, GLsizei depth) {
+    if (texture == 0 || levels <= 0) return;
+    if (levels > TEXTURE_REGISTRY_MAX_LEVELS) levels = TEXTURE_REGISTRY_MAX_LEVELS;
+
+    /* Only 3D textures halve their depth; array layers stay */
+    bool halve_depth = target == GL_TEXTURE_3D;
+    if (depth <= 0) depth = 1;
+
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = find_or_insert(texture);
+    if (info) {
+        memset(info->levels, 0, sizeof(info->levels));
+        info->target = texture_registry_binding_target(target);
+        info->immutable = true;
+        for (GLsizei i = 0; i < levels; i++) {
+            TextureLevel* l = &info->levels[i];
+            l->width = width > 1 ? width : 1;
+            l->height = height > 1 ? height : 1;
+            l->depth = depth > 1 ? depth : 1;
+            l->internal_format = internal_format;
+            width >>= 1;
+            height >>= 1;
+            if (halve_depth) depth >>= 1;
+        }
+        account(info);
+    } else {
+        LOGW("Out of memory recording texture %u", texture);
+    }
+    pthread_mutex_unlock(&g.lock);
+}
+
+void texture_registry_generate_mipmaps(GLuint texture) {
+    if (texture == 0) return;
+
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = find(texture);
+    if (info && info->levels[0].width > 0) {
+        bool halve_depth = info->target == GL_TEXTURE_3D;
+        for (int i = 1; i < TEXTURE_REGISTRY_MAX_LEVELS; i++) {
+            const TextureLevel* p = &info->levels[i - 1];
+            if (p->width == 1 && p->height == 1 && (!halve_depth || p->depth == 1)) break;
+            TextureLevel* l = &info->levels[i];
+            l->width = p->width > 1 ? p->width >> 1 : 1;
+            l->height = p->height > 1 ? p->height >> 1 : 1;
+            l->depth = halve_depth && p->depth > 1 ? p->depth >> 1 : p->depth;
+            l->internal_format = p->internal_format;
+        }
+        account(info);
+    }
+    pthread_mutex_unlock(&g.lock);
+}
+
+void texture_registry_set_swizzle(GLuint texture, GLenum target, TextureSwizzle swizzle) {
+    if (texture == 0) return;
+
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = find_or_insert(texture);
+    if (info) {
+        info->target = texture_registry_binding_target(target);
+        if ((info->swizzle != TEXTURE_SWIZZLE_NONE) != (swizzle != TEXTURE_SWIZZLE_NONE)) {
+            atomic_fetch_add(&g.swizzled, swizzle != TEXTURE_SWIZZLE_NONE ? 1 : -1);
+        }
+        info->swizzle = swizzle;
+    }
+    pthread_mutex_unlock(&g.lock);
+}
+
+void texture_registry_set_max_level(GLuint texture, GLenum target, GLint max_level) {
+    if (texture == 0) return;
+
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = find_or_insert(texture);
+    if (info) {
+        info->target = texture_registry_binding_target(target);
+        info->max_level_set = true;
+        info->max_level = max_level;
+    }
+    pthread_mutex_unlock(&g.lock);
+}
+
+void texture_registry_set_promoted(GLuint texture, bool promoted) {
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = texture ? find(texture) : NULL;
+    if (info) {
+        info->promoted = promoted;
+        if (!promoted) {
+            info->immutable = false;
+            memset(info->levels, 0, sizeof(info->levels));
+            set_dropped(info, 0);
+            account(info);
+        }
+    }
+    pthread_mutex_unlock(&g.lock);
+}
+
+void texture_registry_set_dropped(GLuint texture, GLint dropped) {
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = texture ? find(texture) : NULL;
+    if (info) set_dropped(info, dropped);
+    pthread_mutex_unlock(&g.lock);
+}
+
+/* ===== Queries ===== */
+
+GLint texture_registry_dropped(GLuint texture) {
+    if (texture == 0 || atomic_load(&g.dropped) == 0) return 0;
+
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = find(texture);
+    GLint dropped = info ? info->dropped : 0;
+    pthread_mutex_unlock(&g.lock);
+    return dropped;
+}
+
+TextureSwizzle texture_registry_swizzle(GLuint texture) {
+    if (texture == 0 || atomic_load(&g.swizzled) == 0) return TEXTURE_SWIZZLE_NONE;
+
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = find(texture);
+    TextureSwizzle swizzle = info ? info->swizzle : TEXTURE_SWIZZLE_NONE;
+    pthread_mutex_unlock(&g.lock);
+    return swizzle;
+}
+
+bool texture_registry_lookup(GLuint texture, TextureInfo* out) {
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = texture ? find(texture) : NULL;
+    if (info) *out = *info;
+    pthread_mutex_unlock(&g.lock);
+    return info != NULL;
+}
+
+bool texture_registry_level(GLuint texture, GLint level, TextureLevel* out) {
+    if (level < 0 || level >= TEXTURE_REGISTRY_MAX_LEVELS) return false;
+
+    pthread_mutex_lock(&g.lock);
+    TextureInfo* info = texture ? find(texture) : NULL;
+    bool found = info && info->levels[level].width > 0;
+    if (found) *out = info->levels[level];
+    pthread_mutex_unlock(&g.lock);
+    return found;
+}
+
+void texture_registry_delete(GLsizei n, const GLuint* textures) {
+    if (n <= 0 || !textures) return;
+
+    pthread_mutex_lock(&g.lock);
+    for (GLsizei i = 0; i < n; i++) {
+        TextureInfo* info = textures[i] ? find(textures[i]) : NULL;
+        if (!info) continue;
+        if (info->swizzle != TEXTURE_SWIZZLE_NONE) atomic_fetch_sub(&g.swizzled, 1);
+        if (info->dropped != 0) atomic_fetch_sub(&g.dropped, 1);
+        g.usage -= info->bytes;
+        info->name = REGISTRY_TOMBSTONE;
+    }
+    pthread_mutex_unlock(&g.lock);
+}
+
+void texture_registry_shutdown(void) {
+    pthread_mutex_lock(&g.lock);
+    free(g.slots);
+    g.slots = NULL;
+    g.capacity = 0;
+    g.used = 0;
+    atomic_store(&g.swizzled, 0);
+    atomic_store(&g.dropped, 0);
+    g.usage = 0;
+    g.peak = 0;
+    pthread_mutex_unlock(&g.lock);
+}
+
+void texture_registry_get_usage(size_t* usage, size_t* peak) {
+    pthread_mutex_lock(&g.lock);
+    if (usage) *usage = g.usage;
+    if (peak) *peak = g.peak;
+    pthread_mutex_unlock(&g.lock);
+}
+
+GLuint texture_registry_largest(bool (*filter)(const TextureInfo* info, void* ctx), void* ctx) {
+    GLuint largest = 0;
+    size_t largest_bytes = 0;
+
+    pthread_mutex_lock(&g.lock);
+    for (size_t i = 0; i < g.capacity; i++) {
+        const TextureInfo* info = &g.slots[i];
+        if (info->name == 0 || info->name == REGISTRY_TOMBSTONE) continue;
+        if (info->bytes <= largest_bytes || !filter(info, ctx)) continue;
+        largest = info->name;
+        largest_bytes = info->bytes;
+    }
+    pthread_mutex_unlock(&g.lock);
+    return largest;
+}
+
+/* ===== Pixel sizes ===== */
+
+size_t texture_pixel_size(GLenum format, GLenum type) {
+    size_t components;
+    switch (format) {
+        case GL_RED: case GL_RED_INTEGER: case GL_ALPHA: case GL_LUMINANCE:
+        case GL_DEPTH_COMPONENT:
+            components = 1; break;
+        case GL_RG: case GL_RG_INTEGER: case GL_LUMINANCE_ALPHA:
+            components = 2; break;
+        case GL_RGB: case GL_RGB_INTEGER: case GL_BGR:
+            components = 3; break;
+        case GL_RGBA: case GL_RGBA_INTEGER: case GL_BGRA:
+            components = 4; break;
+        default:
+            return 0;
+    }
+    switch (type) {
+        case GL_UNSIGNED_BYTE: case GL_BYTE:
+            return components;
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:
+            return components * 2;
+        case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT:
+            return components * 4;
+        case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_4_4_4_4:
+        case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_5_6_5_REV:
+            return 2;
+        case GL_UNSIGNED_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_10F_11F_11F_REV:
+        case GL_UNSIGNED_INT_5_9_9_9_REV: case GL_UNSIGNED_INT_24_8:
+        case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+/* ===== Memory estimates ===== */
+
+/* Block width/height of an ASTC format, 0 if not ASTC */
+static void astc_block(GLenum format, int* bw, int* bh) {
+    static const unsigned char k_blocks[14][2] = {
+        {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6},
+        {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12},
+    };
+    unsigned index;
+    if (format >= GL_COMPRESSED_RGBA_ASTC_4x4 && format <= GL_COMPRESSED_RGBA_ASTC_12x12) {
+        index = format - GL_COMPRESSED_RGBA_ASTC_4x4;
+    } else if (format >= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4 &&
+               format <= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12) {
+        index = format - GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4;
+    } else {
+        *bw = *bh = 0;
+        return;
+    }
+    *bw = k_blocks[index][0];
+    *bh = k_blocks[index][1];
+}
+
+/* Bytes per texel as drivers store it; three-component formats are padded */
+static size_t texel_bytes(GLenum format) {
+    switch (format) {
+        case GL_R8: case GL_R8_SNORM: case GL_R8UI: case GL_R8I: case GL_STENCIL_INDEX8:
+        case GL_ALPHA: case GL_LUMINANCE:
+            return 1;
+        case GL_RG8: case GL_RG8_SNORM: case GL_RG8UI: case GL_RG8I:
+        case GL_R16F: case GL_R16UI: case GL_R16I:
+        case GL_RGB565: case GL_RGBA4: case GL_RGB5_A1:
+        case GL_DEPTH_COMPONENT16: case GL_LUMINANCE_ALPHA:
+            return 2;
+        case GL_RG16F: case GL_RG16UI: case GL_RG16I:
+        case GL_R32F: case GL_R32UI: case GL_R32I:
+        case GL_RGB10_A2: case GL_RGB10_A2UI: case GL_R11F_G11F_B10F: case GL_RGB9_E5:
+        case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F: case GL_DEPTH24_STENCIL8:
+            return 4;
+        case GL_RGB16F: case GL_RGB16UI: case GL_RGB16I:
+        case GL_RGBA16F: case GL_RGBA16UI: case GL_RGBA16I:
+        case GL_RG32F: case GL_RG32UI: case GL_RG32I:
+        case GL_DEPTH32F_STENCIL8:
+            return 8;
+        case GL_RGB32F: case GL_RGB32UI: case GL_RGB32I:
+        case GL_RGBA32F: case GL_RGBA32UI: case GL_RGBA32I:
+            return 16;
+        default:
+            return 4;   /* RGB(A)8, sRGB and unsized RGB(A) */
+    }
+}
+
+size_t texture_level_bytes(GLenum internal_format, GLsizei width, GLsizei height,
+                           GLsizei depth) {
+    if (width <= 0 || height <= 0) return 0;
+    if (depth <= 0) depth = 1;
+
+    size_t block_bytes = 0;
+    int bw = 4, bh = 4;
+    switch (internal_format) {
+        case GL_COMPRESSED_RGB8_ETC2:
+        case GL_COMPRESSED_SRGB8_ETC2:
+        case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+        case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+        case GL_COMPRESSED_R11_EAC:
+        case GL_COMPRESSED_SIGNED_R11_EAC:
+            block_bytes = 8;
+            break;
+        case GL_COMPRESSED_RGBA8_ETC2_EAC:
+        case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+        case GL_COMPRESSED_RG11_EAC:
+        case GL_COMPRESSED_SIGNED_RG11_EAC:
+            block_bytes = 16;
+            break;
+        default:
+            astc_block(internal_format, &bw, &bh);
+            if (bw != 0) block_bytes = 16;
+            break;
+    }
+
+    if (block_bytes) {
+        size_t blocks = (size_t)((width + bw - 1) / bw) * (size_t)((height + bh - 1) / bh);
+        return blocks * block_bytes * (size_t)depth;
+    }
+    return (size_t)width * (size_t)height * (size_t)depth * texel_bytes(internal_format);
+}
@@ -0,0 +1,332 @@
+/*
+ * PrismGL Texture Storage
+ * Minecraft allocates every texture by setting GL_TEXTURE_MAX_LEVEL and
+ * then calling glTexImage2D once per level. Each call re-validates a
+ * mutable texture and some drivers reallocate as levels arrive. Once
+ * GL_TEXTURE_MAX_LEVEL is known, level 0 allocates the whole chain with
+ * glTexStorage and every level that fits it becomes a glTexSubImage.
+ *
+ * Textures are only promoted before any level exists, since ES cannot turn
+ * a mutable texture immutable in place. When level 0 is redefined at a
+ * size or format the storage does not have (an atlas resized on reload)
+ * the name is deleted and rebound, which gives a fresh texture under the
+ * same name; its sampling parameters, unit bindings and framebuffer
+ * attachments are carried over. A stray smaller level that does not fit
+ * is left out instead, keeping the levels already uploaded.
+ *
+ * A chain the memory budget (texture_budget.h) cannot afford is allocated
+ * one level smaller: level N of the application lands in storage level
+ * N - 1 and level 0 is downsampled on the CPU when its format allows, or
+ * left to level 1 otherwise. Cold textures can lose their top level later;
+ * their smaller levels are copied into the recreated texture.
+ */
+
+#include "texture_storage.h"
+#include "texture_registry.h"
+#include "texture_budget.h"
+#include "texture_convert.h"
+#include "texture_mips.h"
+#include "state_shadow.h"
+#include "prismgl.h"
+
+#include <stdlib.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Storage"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+/* ===== Formats ===== */
+
+/* Sized format ES storage needs for an unsized definition, 0 if none */
+static GLenum sized_format(GLint internalformat, GLenum type) {
+    switch (internalformat) {
+        case GL_RGBA:
+            switch (type) {
+                case GL_UNSIGNED_BYTE:          return GL_RGBA8;
+                case GL_UNSIGNED_SHORT_4_4_4_4: return GL_RGBA4;
+                case GL_UNSIGNED_SHORT_5_5_5_1: return GL_RGB5_A1;
+                case GL_HALF_FLOAT:             return GL_RGBA16F;
+                case GL_FLOAT:                  return GL_RGBA32F;
+                default:                        return 0;
+            }
+        case GL_RGB:
+            switch (type) {
+                case GL_UNSIGNED_BYTE:          return GL_RGB8;
+                case GL_UNSIGNED_SHORT_5_6_5:   return GL_RGB565;
+                case GL_HALF_FLOAT:             return GL_RGB16F;
+                case GL_FLOAT:                  return GL_RGB32F;
+                default:                        return 0;
+            }
+        case GL_LUMINANCE:
+        case GL_ALPHA:
+        case GL_LUMINANCE_ALPHA:
+        case GL_DEPTH_COMPONENT:
+        case GL_DEPTH_STENCIL:
+            return 0;
+        default:
+            return (GLenum)internalformat;
+    }
+}
+
+static int chain_levels(GLsizei width, GLsizei height, GLsizei depth) {
+    GLsizei size = width > height ? width : height;
+    if (depth > size) size = depth;
+    int levels = 1;
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+/* ===== Recreation ===== */
+
+static const GLenum k_int_params[] = {
+    GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER,
+    GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R,
+    GL_TEXTURE_BASE_LEVEL, GL_TEXTURE_MAX_LEVEL,
+    GL_TEXTURE_COMPARE_MODE, GL_TEXTURE_COMPARE_FUNC,
+    GL_TEXTURE_SWIZZLE_R, GL_TEXTURE_SWIZZLE_G, GL_TEXTURE_SWIZZLE_B, GL_TEXTURE_SWIZZLE_A,
+};
+
+static const GLenum k_float_params[] = {
+    GL_TEXTURE_MIN_LOD, GL_TEXTURE_MAX_LOD,
+};
+
+#define INT_PARAMS   (sizeof(k_int_params) / sizeof(k_int_params[0]))
+#define FLOAT_PARAMS (sizeof(k_float_params) / sizeof(k_float_params[0]))
+
+/*
+ * Replace the texture bound to `bind` with a fresh one of the same name,
+ * bound and attached where the old one was
+ */
+static void recreate(GLuint texture, GLenum bind) {
+    GLint ints[INT_PARAMS];
+    GLfloat floats[FLOAT_PARAMS];
+    for (size_t i = 0; i < INT_PARAMS; i++) glGetTexParameteriv(bind, k_int_params[i], &ints[i]);
+    for (size_t i = 0; i < FLOAT_PARAMS; i++) glGetTexParameterfv(bind, k_float_params[i], &floats[i]);
+
+    state_shadow_recreate_texture(bind, texture);
+
+    for (size_t i = 0; i < INT_PARAMS; i++) glTexParameteri(bind, k_int_params[i], ints[i]);
+    for (size_t i = 0; i < FLOAT_PARAMS; i++) glTexParameterf(bind, k_float_params[i], floats[i]);
+    texture_registry_set_promoted(texture, false);
+}
+
+/* ===== Definitions ===== */
+
+static bool fits(const TextureInfo* info, GLint level, GLenum sized, GLsizei width,
+                 GLsizei height, GLsizei depth) {
+    /* Storage of a reduced texture starts at the application's level 1 */
+    if (info->dropped && level > 0) {
+        level -= info->dropped;
+    } else if (info->dropped) {
+        width = width > 1 ? width >> 1 : 1;
+        height = height > 1 ? height >> 1 : 1;
+    }
+    if (level < 0 || level >= TEXTURE_REGISTRY_MAX_LEVELS) return false;
+    const TextureLevel* l = &info->levels[level];
+    return l->width == width && l->height == height && l->depth == depth &&
+           l->internal_format == sized;
+}
+
+/*
+ * Upload level 0 of a texture allocated a level smaller at half size.
+ * Needs 8-bit RGB(A) at even offsets; anything else is left to level 1.
+ */
+static void upload_halved(GLenum target, GLint xoffset, GLint yoffset, GLsizei width,
+                          GLsizei height, GLenum format, GLenum type, const void* pixels,
+                          bool srgb) {
+    int bpp = format == GL_RGBA ? 4 : format == GL_RGB ? 3 : 0;
+    if (bpp == 0 || type != GL_UNSIGNED_BYTE || (xoffset & 1) || (yoffset & 1)) return;
+
+    /* A tight client copy, whatever the unpack state or buffer */
+    TextureUploadPlan plan = { 0, format, type, TEXTURE_CONVERT_NONE, TEXTURE_SWIZZLE_NONE };
+    void* copy = NULL;
+    TextureUnpackState unpack;
+    if (!texture_convert_begin(&plan, format, type, width, height, pixels, &copy, &unpack) ||
+        !copy) {
+        return;
+    }
+
+    GLsizei half_width = width > 1 ? width / 2 : 1;
+    GLsizei half_height = height > 1 ? height / 2 : 1;
+    uint8_t* half = (uint8_t*)malloc((size_t)half_width * (size_t)half_height * (size_t)bpp);
+    if (half) {
+        texture_mips_downsample((const uint8_t*)copy, width, height, bpp, srgb, half);
+        glTexSubImage2D(target, 0, xoffset / 2, yoffset / 2, half_width, half_height,
+                        format, type, half);
+        free(half);
+    }
+    texture_convert_end(copy, &unpack);
+}
+
+static void upload(GLenum target, GLint level, GLsizei width, GLsizei height, GLsizei depth,
+                   GLenum format, GLenum type, const void* pixels, bool volume,
+                   const TextureInfo* info) {
+    GLint unpack_buffer = 0;
+    if (!pixels) state_shadow_get_integerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack_buffer);
+    /* A NULL definition leaves the contents undefined; the storage already is */
+    if (!pixels && unpack_buffer == 0) return;
+
+    if (info->dropped) {
+        if (level == 0) {
+            upload_halved(target, 0, 0, width, height, format, type, pixels,
+                          info->levels[0].internal_format == GL_SRGB8_ALPHA8);
+            return;
+        }
+        level -= info->dropped;
+    }
+
+    if (volume) {
+        glTexSubImage3D(target, level, 0, 0, 0, width, height, depth, format, type, pixels);
+    } else {
+        glTexSubImage2D(target, level, 0, 0, width, height, format, type, pixels);
+    }
+}
+
+static bool image(GLuint texture, GLenum target, GLint level, GLint internalformat,
+                  GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format,
+                  GLenum type, const void* pixels, bool volume) {
+    if (!prismgl_get_config()->immutable_textures) return false;
+    if (texture == 0 || border != 0 || width <= 0 || height <= 0 || depth <= 0) return false;
+
+    TextureInfo info;
+    if (!texture_registry_lookup(texture, &info)) return false;
+    GLenum bind = texture_registry_binding_target(target);
+    GLenum sized = sized_format(internalformat, type);
+
+    if (info.promoted) {
+        if (sized && fits(&info, level, sized, width, height, depth)) {
+            upload(target, level, width, height, depth, format, type, pixels, volume, &info);
+            return true;
+        }
+        if (level != 0) {
+            /* Recreating would throw away every level uploaded so far */
+            LOGW("Texture %u level %d (%dx%d) does not fit its storage, left out",
+                 texture, level, width, height);
+            return true;
+        }
+        LOGI("Texture %u redefined at %dx%d, recreating its storage", texture, width, height);
+        recreate(texture, bind);
+        texture_registry_lookup(texture, &info);
+    }
+
+    /* Only before any level exists, and with the chain length known */
+    if (level != 0 || sized == 0 || !info.max_level_set || info.immutable ||
+        info.levels[0].width != 0) {
+        return false;
+    }
+
+    int levels = chain_levels(width, height, bind == GL_TEXTURE_3D ? depth : 1);
+    if (info.max_level >= 0 && info.max_level + 1 < levels) levels = info.max_level + 1;
+
+    /* Over budget, a chain with smaller levels to fall back on starts at level 1 */
+    GLsizei storage_width = width, storage_height = height;
+    if (bind == GL_TEXTURE_2D && levels > 1 &&
+        texture_budget_should_reduce(sized, width, height)) {
+        LOGI("Texture %u (%dx%d) allocated a level smaller to stay within budget",
+             texture, width, height);
+        levels--;
+        storage_width = width > 1 ? width >> 1 : 1;
+        storage_height = height > 1 ? height >> 1 : 1;
+        info.dropped = 1;
+    }
+
+    if (volume) {
+        glTexStorage3D(bind, levels, sized, width, height, depth);
+    } else {
+        glTexStorage2D(bind, levels, sized, storage_width, storage_height);
+    }
+    texture_registry_define_storage(texture, bind, levels, sized, storage_width,
+                                    storage_height, depth);
+    texture_registry_set_promoted(texture, true);
+    if (info.dropped) texture_registry_set_dropped(texture, info.dropped);
+
+    info.levels[0].internal_format = sized;
+    upload(target, level, width, height, depth, format, type, pixels, volume, &info);
+    return true;
+}
+
+bool texture_storage_image_2d(GLuint texture, GLenum target, GLint level,
+                              GLint internalformat, GLsizei width, GLsizei height,
+                              GLint border, GLenum format, GLenum type, const void* pixels) {
+    GLenum bind = texture_registry_binding_target(target);
+    if (bind != GL_TEXTURE_2D && bind != GL_TEXTURE_CUBE_MAP) return false;
+    return image(texture, target, level, internalformat, width, height, 1, border,
+                 format, type, pixels, false);
+}
+
+bool texture_storage_image_3d(GLuint texture, GLenum target, GLint level,
+                              GLint internalformat, GLsizei width, GLsizei height,
+                              GLsizei depth, GLint border, GLenum format, GLenum type,
+                              const void* pixels) {
+    if (target != GL_TEXTURE_3D && target != GL_TEXTURE_2D_ARRAY) return false;
+    return image(texture, target, level, internalformat, width, height, depth, border,
+                 format, type, pixels, true);
+}
+
+bool texture_storage_sub_image_2d(GLuint texture, GLenum target, GLint level, GLint xoffset,
+                                  GLint yoffset, GLsizei width, GLsizei height, GLenum format,
+                                  GLenum type, const void* pixels) {
+    GLint dropped = texture_registry_dropped(texture);
+    if (dropped == 0) return false;
+
+    if (level > 0) {
+        glTexSubImage2D(target, level - dropped, xoffset, yoffset, width, height, format, type,
+                        pixels);
+    } else {
+        TextureLevel top;
+        bool srgb = texture_registry_level(texture, 0, &top) &&
+                    top.internal_format == GL_SRGB8_ALPHA8;
+        upload_halved(target, xoffset, yoffset, width, height, format, type, pixels, srgb);
+    }
+    return true;
+}
+
+/* ===== Eviction ===== */
+
+static void copy_levels(GLuint src, GLint src_first, GLuint dst, GLint dst_first, int count,
+                        const TextureLevel* sizes) {
+    for (int i = 0; i < count; i++) {
+        glCopyImageSubData(src, GL_TEXTURE_2D, src_first + i, 0, 0, 0,
+                           dst, GL_TEXTURE_2D, dst_first + i, 0, 0, 0,
+                           sizes[i].width, sizes[i].height, 1);
+    }
+}
+
+bool texture_storage_drop_level(GLuint texture) {
+    TextureInfo info;
+    if (!texture_registry_lookup(texture, &info) || !info.promoted || info.dropped != 0 ||
+        info.target != GL_TEXTURE_2D) {
+        return false;
+    }
+    int levels = 0;
+    while (levels < TEXTURE_REGISTRY_MAX_LEVELS && info.levels[levels].width > 0) levels++;
+    if (levels < 2) return false;
+
+    const TextureLevel* kept = &info.levels[1];
+    GLuint previous = texture_registry_bound(GL_TEXTURE_2D);
+
+    /* Park the smaller levels, since recreating the name discards them */
+    GLuint scratch = 0;
+    glGenTextures(1, &scratch);
+    state_shadow_bind_texture(GL_TEXTURE_2D, scratch);
+    glTexStorage2D(GL_TEXTURE_2D, levels - 1, kept->internal_format, kept->width, kept->height);
+    copy_levels(texture, 1, scratch, 0, levels - 1, kept);
+
+    state_shadow_bind_texture(GL_TEXTURE_2D, texture);
+    recreate(texture, GL_TEXTURE_2D);
+    glTexStorage2D(GL_TEXTURE_2D, levels - 1, kept->internal_format, kept->width, kept->height);
+    copy_levels(scratch, 0, texture, 0, levels - 1, kept);
+    state_shadow_delete_textures(1, &scratch);
+
+    texture_registry_define_storage(texture, GL_TEXTURE_2D, levels - 1, kept->internal_format,
+                                    kept->width, kept->height, 1);
+    texture_registry_set_promoted(texture, true);
+    texture_registry_set_dropped(texture, 1);
+
+    state_shadow_bind_texture(GL_TEXTURE_2D, previous);
+    return true;
+}
@@ -0,0 +1,306 @@
+/*
+ * PrismGL Texture Upload
+ * Each upload is one GL job that advances a stage every time it runs:
+ *
+ *   MAP      create and map a pixel unpack buffer, hand it to a worker
+ *   COPYING  the worker writes the mip chain of the caller's pixels into
+ *            the mapping (texture_mips.h), ETC2 encoded when eligible
+ *   COPIED   unmap, create every level from the buffer, insert a fence
+ *   UPLOADED wait for the fence without blocking, then report the texture
+ *
+ * Jobs run on whichever context ends a frame first, so the texture lives
+ * in that context's share group. Once a job has created its buffer it only
+ * advances on that context; if the context is destroyed first, the job
+ * starts over on the next one. Nothing here blocks the render thread on
+ * the copy or on the GPU.
+ */
+
+#include "texture_upload.h"
+#include "texture_compress.h"
+#include "texture_convert.h"
+#include "texture_mips.h"
+#include "texture_registry.h"
+#include "gl_jobs.h"
+#include "worker_pool.h"
+#include "state_shadow.h"
+#include "context.h"
+
+#include <EGL/egl.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Upload"
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+typedef enum {
+    UPLOAD_MAP = 0,
+    UPLOAD_COPYING,
+    UPLOAD_COPIED,
+    UPLOAD_UPLOADED
+} UploadStage;
+
+typedef struct {
+    const void* data;
+    int width;
+    int height;
+    GLenum format;
+    size_t size;                /* Of the buffer: the chain, plain or compressed */
+    bool compress;
+    bool ready;                 /* Set by the worker when the chain was written */
+    prismgl_texture_callback cb;
+    void* userdata;
+
+    atomic_int stage;
+    EGLDisplay display;         /* Context that owns buffer and fence */
+    EGLContext context;
+    GLuint buffer;
+    void* mapped;               /* Written by the worker between MAP and COPIED */
+    GLuint texture;
+    GLsync fence;
+} TextureUpload;
+
+/* ===== Worker side ===== */
+
+static void build_levels(void* data) {
+    TextureUpload* u = (TextureUpload*)data;
+    if (u->compress) {
+        u->ready = texture_compress_chain(u->data, u->width, u->height, u->format,
+                                          u->mapped, u->size);
+    } else {
+        u->ready = texture_mips_build_chain((const uint8_t*)u->data, u->width, u->height,
+                                            u->format == GL_RGB ? 3 : 4, true,
+                                            (uint8_t*)u->mapped);
+    }
+    atomic_store_explicit(&u->stage, UPLOAD_COPIED, memory_order_release);
+}
+
+/* ===== GL side ===== */
+
+/* Without a prepared chain, from client memory */
+static GLuint create_texture(TextureUpload* u, const void* pixels) {
+    GLint previous = 0;
+    state_shadow_get_integerv(GL_TEXTURE_BINDING_2D, &previous);
+
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    state_shadow_bind_texture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, (GLint)u->format, u->width, u->height, 0,
+                 u->format, GL_UNSIGNED_BYTE, pixels);
+
+    glGenerateMipmap(GL_TEXTURE_2D);
+    texture_registry_define(tex, GL_TEXTURE_2D, 0, u->format, u->width, u->height, 1);
+    texture_registry_generate_mipmaps(tex);
+    state_shadow_bind_texture(GL_TEXTURE_2D, (GLuint)previous);
+    return tex;
+}
+
+/* The plain chain from the bound unpack buffer, level 0 at offset 0 */
+static GLuint create_texture_levels(TextureUpload* u) {
+    GLint previous = 0;
+    state_shadow_get_integerv(GL_TEXTURE_BINDING_2D, &previous);
+
+    int bpp = u->format == GL_RGB ? 3 : 4;
+    int levels = texture_mips_levels(u->width, u->height);
+
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    state_shadow_bind_texture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GLenum internal = u->format == GL_RGB ? GL_RGB8 : GL_RGBA8;
+    glTexStorage2D(GL_TEXTURE_2D, levels, internal, u->width, u->height);
+    texture_registry_define_storage(tex, GL_TEXTURE_2D, levels, internal,
+                                    u->width, u->height, 1);
+
+    size_t offset = 0;
+    for (int level = 0; level < levels; level++) {
+        int w, h;
+        texture_mips_level_size(u->width, u->height, level, &w, &h);
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, w, h, u->format, GL_UNSIGNED_BYTE,
+                        (const void*)(uintptr_t)offset);
+        offset += (size_t)w * (size_t)h * (size_t)bpp;
+    }
+
+    state_shadow_bind_texture(GL_TEXTURE_2D, (GLuint)previous);
+    return tex;
+}
+
+/* The compressed chain from the bound unpack buffer, level 0 at offset 0 */
+static GLuint create_compressed_texture(TextureUpload* u) {
+    GLint previous = 0;
+    state_shadow_get_integerv(GL_TEXTURE_BINDING_2D, &previous);
+
+    GLenum internal = texture_compress_format(u->format);
+    int levels = texture_compress_levels(u->width, u->height);
+
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    state_shadow_bind_texture(GL_TEXTURE_2D, tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexStorage2D(GL_TEXTURE_2D, levels, internal, u->width, u->height);
+    texture_registry_define_storage(tex, GL_TEXTURE_2D, levels, internal,
+                                    u->width, u->height, 1);
+
+    size_t offset = 0;
+    int w = u->width, h = u->height;
+    for (int level = 0; level < levels; level++) {
+        size_t size = texture_compress_level_size(w, h, u->format);
+        glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, w, h, internal,
+                                  (GLsizei)size, (const void*)(uintptr_t)offset);
+        offset += size;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    state_shadow_bind_texture(GL_TEXTURE_2D, (GLuint)previous);
+    return tex;
+}
+
+static void map_buffer(TextureUpload* u) {
+    u->display = eglGetCurrentDisplay();
+    u->context = eglGetCurrentContext();
+    glGenBuffers(1, &u->buffer);
+    state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, u->buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)u->size, NULL, GL_STREAM_DRAW);
+    u->mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)u->size,
+                                 GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!u->mapped) {
+        /* Upload straight from the caller's memory instead */
+        glDeleteBuffers(1, &u->buffer);
+        u->buffer = 0;
+        atomic_store(&u->stage, UPLOAD_COPIED);
+        return;
+    }
+
+    atomic_store(&u->stage, UPLOAD_COPYING);
+    if (!worker_pool_submit(build_levels, u)) build_levels(u);
+}
+
+static void upload_texture(TextureUpload* u) {
+    /* Runs at a frame end, under whatever unpack state the application left */
+    TextureUnpackState unpack;
+    texture_convert_unpack_tight(&unpack);
+    GLint unpack_buffer = 0;
+    state_shadow_get_integerv(GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack_buffer);
+
+    if (u->buffer) {
+        state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, u->buffer);
+        bool intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+        if (intact && u->ready) {
+            u->texture = u->compress ? create_compressed_texture(u) : create_texture_levels(u);
+        } else if (intact) {
+            LOGW("Building levels of %dx%d failed, uploading from client memory",
+                 u->width, u->height);
+        }
+        state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        /* The driver keeps the storage alive until the copy has been consumed */
+        glDeleteBuffers(1, &u->buffer);
+        u->buffer = 0;
+        u->mapped = NULL;
+        if (!intact) {
+            LOGW("Unpack buffer contents lost, uploading %dx%d from client memory",
+                 u->width, u->height);
+        }
+    }
+    if (!u->texture) {
+        /* From client memory, so no unpack buffer may be bound */
+        state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        u->texture = create_texture(u, u->data);
+    }
+    state_shadow_bind_buffer(GL_PIXEL_UNPACK_BUFFER, (GLuint)unpack_buffer);
+    texture_convert_unpack_restore(&unpack);
+
+    /* Without a buffer this may be a different context than the one mapping */
+    u->display = eglGetCurrentDisplay();
+    u->context = eglGetCurrentContext();
+    u->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    atomic_store(&u->stage, UPLOAD_UPLOADED);
+}
+
+/*
+ * The buffer and fence are only valid on the context that created them.
+ * False while that context lives and another one is current; if it was
+ * destroyed, its objects went with it and the job restarts here.
+ */
+static bool on_owner(TextureUpload* u) {
+    if (!u->buffer && !u->fence) return true;
+    if (eglGetCurrentContext() == u->context) return true;
+    if (prismgl_context_alive(u->display, u->context)) return false;
+
+    LOGW("Context of the %dx%d upload was destroyed, starting over", u->width, u->height);
+    u->buffer = 0;
+    u->mapped = NULL;
+    u->texture = 0;
+    u->fence = NULL;
+    u->ready = false;
+    atomic_store(&u->stage, UPLOAD_MAP);
+    return true;
+}
+
+static GLJobStatus run_upload(void* data) {
+    TextureUpload* u = (TextureUpload*)data;
+
+    UploadStage stage = (UploadStage)atomic_load_explicit(&u->stage, memory_order_acquire);
+    if ((stage == UPLOAD_COPIED || stage == UPLOAD_UPLOADED) && !on_owner(u)) {
+        return GL_JOB_RETRY;
+    }
+
+    switch ((UploadStage)atomic_load_explicit(&u->stage, memory_order_acquire)) {
+        case UPLOAD_MAP:
+            map_buffer(u);
+            return GL_JOB_RETRY;
+        case UPLOAD_COPYING:
+            return GL_JOB_RETRY;
+        case UPLOAD_COPIED:
+            upload_texture(u);
+            return u->fence ? GL_JOB_RETRY : GL_JOB_DONE;
+        case UPLOAD_UPLOADED:
+            if (u->fence) {
+                if (glClientWaitSync(u->fence, 0, 0) == GL_TIMEOUT_EXPIRED) return GL_JOB_RETRY;
+                glDeleteSync(u->fence);
+                u->fence = NULL;
+            }
+            return GL_JOB_DONE;
+    }
+    return GL_JOB_DONE;
+}
+
+static void upload_done(void* data, bool completed) {
+    TextureUpload* u = (TextureUpload*)data;
+    /* Dropped uploads hold GL objects of a context going away; leave them to it */
+    if (u->cb) u->cb(completed ? u->texture : 0, u->userdata);
+    free(u);
+}
+
+bool texture_upload_submit(const void* data, int width, int height, GLenum format,
+                           prismgl_texture_callback cb, void* userdata) {
+    if (!data || width <= 0 || height <= 0) return false;
+
+    TextureUpload* u = (TextureUpload*)calloc(1, sizeof(TextureUpload));
+    if (!u) return false;
+    u->data = data;
+    u->width = width;
+    u->height = height;
+    u->format = format == GL_RGB ? GL_RGB : GL_RGBA;
+    u->compress = texture_compress_eligible(width, height, u->format);
+    u->size = u->compress ? texture_compress_chain_size(width, height, u->format)
+                          : texture_mips_chain_size(width, height, u->format == GL_RGB ? 3 : 4);
+    u->cb = cb;
+    u->userdata = userdata;
+    atomic_init(&u->stage, UPLOAD_MAP);
+
+    if (!gl_job_post(run_upload, upload_done, u)) {
+        free(u);
+        return false;
+    }
+    return true;
+}
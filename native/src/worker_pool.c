@@ -0,0 +1,129 @@
+/*
+ * PrismGL Worker Pool
+ * A mutex protected FIFO shared by up to WORKER_MAX_THREADS threads, one
+ * fewer than the online cores so the render thread keeps a core to itself.
+ * Tasks are coarse (a texture's worth of pixels), so the lock is cold.
+ */
+
+#include "worker_pool.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <android/log.h>
+
+#define LOG_TAG "PrismGL-Workers"
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+
+#define WORKER_MAX_THREADS 4
+
+typedef struct WorkerTask {
+    struct WorkerTask* next;
+    WorkerFunc func;
+    void* data;
+} WorkerTask;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    WorkerTask* head;
+    WorkerTask* tail;
+    pthread_t threads[WORKER_MAX_THREADS];
+    int thread_count;
+    bool started;
+    bool quit;
+} g = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void* worker_main(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&g.lock);
+    for (;;) {
+        while (!g.head && !g.quit) pthread_cond_wait(&g.cond, &g.lock);
+        WorkerTask* task = g.head;
+        if (!task) break;   /* Quitting with nothing left */
+
+        g.head = task->next;
+        if (!g.head) g.tail = NULL;
+        pthread_mutex_unlock(&g.lock);
+
+        task->func(task->data);
+        free(task);
+
+        pthread_mutex_lock(&g.lock);
+    }
+    pthread_mutex_unlock(&g.lock);
+    return NULL;
+}
+
+/* Called with the lock held */
+static void start_workers(void) {
+    g.started = true;
+    g.quit = false;
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int wanted = cores > 1 ? (int)cores - 1 : 1;
+    if (wanted > WORKER_MAX_THREADS) wanted = WORKER_MAX_THREADS;
+
+    for (int i = 0; i < wanted; i++) {
+        if (pthread_create(&g.threads[g.thread_count], NULL, worker_main, NULL) != 0) {
+            LOGW("Failed to start worker %d", i);
+            break;
+        }
+        g.thread_count++;
+    }
+    if (g.thread_count > 0) LOGI("Started %d workers", g.thread_count);
+}
+
+bool worker_pool_submit(WorkerFunc func, void* data) {
+    if (!func) return false;
+
+    WorkerTask* task = (WorkerTask*)malloc(sizeof(WorkerTask));
+    if (!task) return false;
+    task->next = NULL;
+    task->func = func;
+    task->data = data;
+
+    pthread_mutex_lock(&g.lock);
+    if (!g.started) start_workers();
+    if (g.thread_count == 0 || g.quit) {
+        pthread_mutex_unlock(&g.lock);
+        free(task);
+        return false;
+    }
+    if (g.tail) g.tail->next = task;
+    else g.head = task;
+    g.tail = task;
+    pthread_cond_signal(&g.cond);
+    pthread_mutex_unlock(&g.lock);
+    return true;
+}
+
+int worker_pool_size(void) {
+    pthread_mutex_lock(&g.lock);
+    int count = g.thread_count;
+    pthread_mutex_unlock(&g.lock);
+    return count;
+}
+
+void worker_pool_shutdown(void) {
+    pthread_mutex_lock(&g.lock);
+    if (!g.started) {
+        pthread_mutex_unlock(&g.lock);
+        return;
+    }
+    g.quit = true;
+    pthread_cond_broadcast(&g.cond);
+    int count = g.thread_count;
+    pthread_mutex_unlock(&g.lock);
+
+    for (int i = 0; i < count; i++) pthread_join(g.threads[i], NULL);
+
+    pthread_mutex_lock(&g.lock);
+    g.thread_count = 0;
+    g.started = false;
+    pthread_mutex_unlock(&g.lock);
+}
@@ -0,0 +1,103 @@
+/*
+ * Immediate-mode driver call counts
+ * Draws through glBegin/glEnd against the mock GL and checks that, once
+ * the layout VAOs exist, a draw is a VAO bind, a stream offset update and
+ * the draw itself, with no per-draw attribute pointer setup.
+ */
+
+#include "prismgl.h"
+#include "mock_gl.h"
+
+#include <stdio.h>
+
+/*
+ * glEnd used to spend about 17 driver calls around every draw. Now: map and
+ * unmap the stream, bind the layout VAO, update the offset, set up to three
+ * constant attributes, draw and unbind.
+ */
+#define MAX_CALLS_PER_DRAW 9
+
+static int g_failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        g_failures++; \
+    } \
+} while (0)
+
+static void triangle(void) {
+    prismgl_glBegin(GL_TRIANGLES);
+    prismgl_glColor4f(1.0f, 0.0f, 0.0f, 1.0f);
+    prismgl_glVertex3f(0.0f, 0.0f, 0.0f);
+    prismgl_glColor4f(0.0f, 1.0f, 0.0f, 1.0f);
+    prismgl_glVertex3f(1.0f, 0.0f, 0.0f);
+    prismgl_glColor4f(0.0f, 0.0f, 1.0f, 1.0f);
+    prismgl_glVertex3f(0.0f, 1.0f, 0.0f);
+    prismgl_glEnd();
+}
+
+static void flat_triangle(void) {
+    prismgl_glColor4f(0.5f, 0.5f, 0.5f, 1.0f);
+    prismgl_glBegin(GL_TRIANGLES);
+    prismgl_glVertex3f(0.0f, 0.0f, 0.0f);
+    prismgl_glVertex3f(1.0f, 0.0f, 0.0f);
+    prismgl_glVertex3f(0.0f, 1.0f, 0.0f);
+    prismgl_glEnd();
+}
+
+static void textured_quad(void) {
+    prismgl_glBegin(GL_QUADS);
+    prismgl_glTexCoord2f(0.0f, 0.0f);
+    prismgl_glVertex3f(0.0f, 0.0f, 0.0f);
+    prismgl_glTexCoord2f(1.0f, 0.0f);
+    prismgl_glVertex3f(1.0f, 0.0f, 0.0f);
+    prismgl_glTexCoord2f(1.0f, 1.0f);
+    prismgl_glVertex3f(1.0f, 1.0f, 0.0f);
+    prismgl_glTexCoord2f(0.0f, 1.0f);
+    prismgl_glVertex3f(0.0f, 1.0f, 0.0f);
+    prismgl_glEnd();
+}
+
+/* Warm up, then count one draw. The first draw creates the layout VAOs and
+ * quad indices; the second rebinds the stream after the index upload. */
+static void check_draw(const char* name, void (*draw)(void), const char* draw_call) {
+    int failures = g_failures;
+    draw();
+    draw();
+    mock_gl_reset();
+    draw();
+
+    unsigned total = mock_gl_total();
+    printf("%-16s %u driver calls per draw\n", name, total);
+
+    CHECK(total <= MAX_CALLS_PER_DRAW);
+    CHECK(mock_gl_calls(draw_call) == 1);
+    CHECK(mock_gl_calls("glDrawArrays") + mock_gl_calls("glDrawElements") == 1);
+    CHECK(mock_gl_calls("glBindVertexBuffer") == 1);
+    CHECK(mock_gl_calls("glVertexAttribPointer") == 0);
+    CHECK(mock_gl_calls("glEnableVertexAttribArray") == 0);
+    CHECK(mock_gl_calls("glDisableVertexAttribArray") == 0);
+    CHECK(mock_gl_calls("glVertexAttribFormat") == 0);
+    CHECK(mock_gl_calls("glBufferData") == 0);
+    CHECK(mock_gl_calls("glBindBuffer") == 0);
+
+    if (g_failures != failures) mock_gl_dump();
+}
+
+int main(void) {
+    check_draw("colored", triangle, "glDrawArrays");
+    check_draw("flat", flat_triangle, "glDrawArrays");
+    check_draw("textured quad", textured_quad, "glDrawElements");
+
+    /* Constant attributes come from current values, not the stream */
+    mock_gl_reset();
+    flat_triangle();
+    CHECK(mock_gl_calls("glVertexAttrib4f") == 3);
+
+    if (g_failures) {
+        fprintf(stderr, "%d checks failed\n", g_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * Matrix stack microbenchmark
+ * Matrix ops per second through the matrix_stack API against the bare
+ * scalar kernels it is built on, so the gap is the per-call cost of the
+ * context lookup and stack bookkeeping. Both run the same op sequence and
+ * must end on the same matrix.
+ */
+
+#include "prismgl.h"
+#include "matrix_stack.h"
+#include "context.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define ITERATIONS 4000000
+
+/* ===== Scalar reference (column-major, m = m * op) ===== */
+
+__attribute__((noinline))
+static void ref_multiply(GLfloat* m, const GLfloat* b) {
+    GLfloat tmp[16];
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            tmp[j * 4 + i] = m[0 * 4 + i] * b[j * 4 + 0] +
+                             m[1 * 4 + i] * b[j * 4 + 1] +
+                             m[2 * 4 + i] * b[j * 4 + 2] +
+                             m[3 * 4 + i] * b[j * 4 + 3];
+        }
+    }
+    memcpy(m, tmp, sizeof(tmp));
+}
+
+__attribute__((noinline))
+static void ref_rotate(GLfloat* m, GLfloat angle, GLfloat x, GLfloat y, GLfloat z) {
+    GLfloat len = sqrtf(x * x + y * y + z * z);
+    x /= len; y /= len; z /= len;
+    GLfloat rad = angle * (float)(M_PI / 180.0);
+    GLfloat c = cosf(rad);
+    GLfloat s = sinf(rad);
+    GLfloat ic = 1.0f - c;
+    const GLfloat r[16] = {
+        x * x * ic + c,     y * x * ic + z * s, x * z * ic - y * s, 0.0f,
+        x * y * ic - z * s, y * y * ic + c,     y * z * ic + x * s, 0.0f,
+        x * z * ic + y * s, y * z * ic - x * s, z * z * ic + c,     0.0f,
+        0.0f,               0.0f,               0.0f,               1.0f
+    };
+    ref_multiply(m, r);
+}
+
+__attribute__((noinline))
+static void ref_translate(GLfloat* m, GLfloat x, GLfloat y, GLfloat z) {
+    const GLfloat t[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        x,    y,    z,    1.0f
+    };
+    ref_multiply(m, t);
+}
+
+__attribute__((noinline))
+static void ref_scale(GLfloat* m, GLfloat x, GLfloat y, GLfloat z) {
+    const GLfloat s[16] = {
+        x,    0.0f, 0.0f, 0.0f,
+        0.0f, y,    0.0f, 0.0f,
+        0.0f, 0.0f, z,    0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+    ref_multiply(m, s);
+}
+
+/* ===== Op sequences ===== */
+
+/* 90 degrees about z, so repeated products stay bounded */
+static const GLfloat g_rotation[16] = {
+     0.0f, 1.0f, 0.0f, 0.0f,
+    -1.0f, 0.0f, 0.0f, 0.0f,
+     0.0f, 0.0f, 1.0f, 0.0f,
+     0.0f, 0.0f, 0.0f, 1.0f
+};
+
+typedef enum { OP_MULTIPLY, OP_ROTATE, OP_TRANSLATE, OP_SCALE, OP_COUNT } Op;
+
+static const char* g_op_names[OP_COUNT] = { "multiply", "rotate", "translate", "scale" };
+
+/* Each op alternates with its inverse so the matrix does not drift */
+static void run_stack(Op op, int n) {
+    matrix_stack_load_identity();
+    for (int i = 0; i < n; i++) {
+        float sign = (i & 1) ? -1.0f : 1.0f;
+        switch (op) {
+            case OP_MULTIPLY:  matrix_stack_mult(g_rotation); break;
+            case OP_ROTATE:    matrix_stack_rotate(sign * 30.0f, 1.0f, 2.0f, 3.0f); break;
+            case OP_TRANSLATE: matrix_stack_translate(sign, 2.0f * sign, 3.0f * sign); break;
+            case OP_SCALE:     matrix_stack_scale((i & 1) ? 0.5f : 2.0f, (i & 1) ? 2.0f : 0.5f, 1.0f); break;
+            default: break;
+        }
+    }
+}
+
+static void run_reference(Op op, int n, GLfloat* m) {
+    static const GLfloat identity[16] = {
+        1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f
+    };
+    memcpy(m, identity, sizeof(identity));
+    for (int i = 0; i < n; i++) {
+        float sign = (i & 1) ? -1.0f : 1.0f;
+        switch (op) {
+            case OP_MULTIPLY:  ref_multiply(m, g_rotation); break;
+            case OP_ROTATE:    ref_rotate(m, sign * 30.0f, 1.0f, 2.0f, 3.0f); break;
+            case OP_TRANSLATE: ref_translate(m, sign, 2.0f * sign, 3.0f * sign); break;
+            case OP_SCALE:     ref_scale(m, (i & 1) ? 0.5f : 2.0f, (i & 1) ? 2.0f : 0.5f, 1.0f); break;
+            default: break;
+        }
+    }
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+int main(void) {
+    int mismatches = 0;
+
+    /* Bind a context so state lookups take the TLS fast path, as on a device */
+    prismgl_context_make_current((EGLDisplay)1, (EGLContext)1);
+    matrix_stack_set_mode(GL_MODELVIEW);
+
+    printf("%-10s %14s %14s %8s\n", "op", "stack Mops/s", "scalar Mops/s", "speedup");
+    for (int op = 0; op < OP_COUNT; op++) {
+        GLfloat ref[16];
+
+        double start = now_seconds();
+        run_stack((Op)op, ITERATIONS);
+        double stack_time = now_seconds() - start;
+
+        start = now_seconds();
+        run_reference((Op)op, ITERATIONS, ref);
+        double ref_time = now_seconds() - start;
+
+        const GLfloat* top = matrix_stack_top(GL_MODELVIEW);
+        float max_diff = 0.0f;
+        for (int i = 0; i < 16; i++) {
+            float diff = fabsf(top[i] - ref[i]);
+            if (diff > max_diff) max_diff = diff;
+        }
+        if (max_diff > 1e-3f) {
+            fprintf(stderr, "%s: results differ by %g\n", g_op_names[op], max_diff);
+            mismatches++;
+        }
+
+        printf("%-10s %14.1f %14.1f %7.2fx\n", g_op_names[op],
+               ITERATIONS / stack_time * 1e-6, ITERATIONS / ref_time * 1e-6,
+               ref_time / stack_time);
+    }
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,466 @@
+/*
+ * PrismGL Mock GL
+ * Every entry point PrismGL links against, each counting its calls in a
+ * static record that joins the list on first use. Entry points with
+ * outputs PrismGL reads back are written out by hand below; the rest
+ * only count.
+ */
+
+#include "mock_gl.h"
+
+#include <GLES3/gl32.h>
+#include <EGL/egl.h>
+#include <android/log.h>
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct MockCall {
+    const char* name;
+    unsigned count;
+    bool listed;
+    struct MockCall* next;
+} MockCall;
+
+static MockCall* g_calls;
+static unsigned g_total;
+static GLuint g_next_name = 1;
+static void* g_mapped;
+static size_t g_mapped_size;
+
+static void mock_count(MockCall* call) {
+    if (!call->listed) {
+        call->next = g_calls;
+        g_calls = call;
+        call->listed = true;
+    }
+    call->count++;
+    /* EGL calls are PrismGL finding its context, not driver work */
+    if (strncmp(call->name, "gl", 2) == 0) g_total++;
+}
+
+#define COUNT(fn) \
+    static MockCall call_ = { #fn, 0, false, NULL }; \
+    mock_count(&call_)
+
+#define MOCK(fn, params) void fn params { COUNT(fn); }
+
+void mock_gl_reset(void) {
+    for (MockCall* c = g_calls; c; c = c->next) c->count = 0;
+    g_total = 0;
+}
+
+unsigned mock_gl_total(void) {
+    return g_total;
+}
+
+unsigned mock_gl_calls(const char* name) {
+    for (MockCall* c = g_calls; c; c = c->next) {
+        if (strcmp(c->name, name) == 0) return c->count;
+    }
+    return 0;
+}
+
+void mock_gl_dump(void) {
+    for (MockCall* c = g_calls; c; c = c->next) {
+        if (c->count) fprintf(stderr, "  %-32s %u\n", c->name, c->count);
+    }
+}
+
+int __android_log_print(int prio, const char* tag, const char* fmt, ...) {
+    /* Quiet unless asked for, tests print their own results */
+    if (!getenv("PRISMGL_TEST_LOG")) return 0;
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s: ", tag);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+    return 1;
+}
+
+/* ===== EGL ===== */
+
+/* No context is ever current, so PrismGL keeps its state in the fallback */
+EGLContext eglGetCurrentContext(void) { COUNT(eglGetCurrentContext); return EGL_NO_CONTEXT; }
+EGLDisplay eglGetCurrentDisplay(void) { COUNT(eglGetCurrentDisplay); return EGL_NO_DISPLAY; }
+EGLSurface eglGetCurrentSurface(EGLint readdraw) { COUNT(eglGetCurrentSurface); return EGL_NO_SURFACE; }
+EGLint eglGetError(void) { COUNT(eglGetError); return EGL_SUCCESS; }
+
+__eglMustCastToProperFunctionPointerType eglGetProcAddress(const char* procname) {
+    COUNT(eglGetProcAddress);
+    return NULL;
+}
+
+EGLContext eglCreateContext(EGLDisplay dpy, EGLConfig config, EGLContext share_context,
+                            const EGLint* attrib_list) {
+    COUNT(eglCreateContext);
+    return EGL_NO_CONTEXT;
+}
+
+EGLBoolean eglDestroyContext(EGLDisplay dpy, EGLContext ctx) {
+    COUNT(eglDestroyContext);
+    return EGL_TRUE;
+}
+
+EGLBoolean eglMakeCurrent(EGLDisplay dpy, EGLSurface draw, EGLSurface read, EGLContext ctx) {
+    COUNT(eglMakeCurrent);
+    return EGL_TRUE;
+}
+
+EGLBoolean eglSwapBuffers(EGLDisplay dpy, EGLSurface surface) {
+    COUNT(eglSwapBuffers);
+    return EGL_TRUE;
+}
+
+/* ===== Object names ===== */
+
+static void gen_names(GLsizei n, GLuint* names) {
+    for (GLsizei i = 0; i < n; i++) names[i] = g_next_name++;
+}
+
+void glGenBuffers(GLsizei n, GLuint* buffers) { COUNT(glGenBuffers); gen_names(n, buffers); }
+void glGenFramebuffers(GLsizei n, GLuint* framebuffers) { COUNT(glGenFramebuffers); gen_names(n, framebuffers); }
+void glGenQueries(GLsizei n, GLuint* ids) { COUNT(glGenQueries); gen_names(n, ids); }
+void glGenRenderbuffers(GLsizei n, GLuint* renderbuffers) { COUNT(glGenRenderbuffers); gen_names(n, renderbuffers); }
+void glGenTextures(GLsizei n, GLuint* textures) { COUNT(glGenTextures); gen_names(n, textures); }
+void glGenVertexArrays(GLsizei n, GLuint* arrays) { COUNT(glGenVertexArrays); gen_names(n, arrays); }
+GLuint glCreateProgram(void) { COUNT(glCreateProgram); return g_next_name++; }
+GLuint glCreateShader(GLenum type) { COUNT(glCreateShader); return g_next_name++; }
+GLsync glFenceSync(GLenum condition, GLbitfield flags) { COUNT(glFenceSync); return (GLsync)(uintptr_t)g_next_name++; }
+
+/* ===== Buffers ===== */
+
+/* One scratch allocation serves every mapping */
+void* glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    COUNT(glMapBufferRange);
+    if ((size_t)length > g_mapped_size) {
+        void* mapped = realloc(g_mapped, (size_t)length);
+        if (!mapped) return NULL;
+        g_mapped = mapped;
+        g_mapped_size = (size_t)length;
+    }
+    return g_mapped;
+}
+
+GLboolean glUnmapBuffer(GLenum target) { COUNT(glUnmapBuffer); return GL_TRUE; }
+
+/* ===== Queries ===== */
+
+static int value_count(GLenum pname) {
+    switch (pname) {
+        case GL_VIEWPORT:
+        case GL_SCISSOR_BOX:
+        case GL_COLOR_WRITEMASK:
+        case GL_BLEND_COLOR:
+        case GL_COLOR_CLEAR_VALUE:
+            return 4;
+        case GL_DEPTH_RANGE:
+        case GL_MAX_VIEWPORT_DIMS:
+        case GL_ALIASED_POINT_SIZE_RANGE:
+        case GL_ALIASED_LINE_WIDTH_RANGE:
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+/* Initial values and limits PrismGL sizes things by; everything else is 0 */
+static GLint64 integer_value(GLenum pname) {
+    switch (pname) {
+        case GL_UNPACK_ALIGNMENT:
+        case GL_PACK_ALIGNMENT:                     return 4;
+        case GL_MAX_TEXTURE_SIZE:                   return 4096;
+        case GL_MAX_VERTEX_ATTRIBS:                 return 16;
+        case GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS:   return 32;
+        case GL_MAX_TEXTURE_IMAGE_UNITS:            return 16;
+        case GL_MAX_UNIFORM_BUFFER_BINDINGS:        return 24;
+        case GL_MAX_COLOR_ATTACHMENTS:              return 4;
+        case GL_MAX_DRAW_BUFFERS:                   return 4;
+        default:                                    return 0;
+    }
+}
+
+void glGetIntegerv(GLenum pname, GLint* data) {
+    COUNT(glGetIntegerv);
+    for (int i = 0; i < value_count(pname); i++) data[i] = (GLint)integer_value(pname);
+}
+
+void glGetInteger64v(GLenum pname, GLint64* data) {
+    COUNT(glGetInteger64v);
+    for (int i = 0; i < value_count(pname); i++) data[i] = integer_value(pname);
+}
+
+void glGetFloatv(GLenum pname, GLfloat* data) {
+    COUNT(glGetFloatv);
+    for (int i = 0; i < value_count(pname); i++) data[i] = (GLfloat)integer_value(pname);
+}
+
+void glGetBooleanv(GLenum pname, GLboolean* data) {
+    COUNT(glGetBooleanv);
+    for (int i = 0; i < value_count(pname); i++) data[i] = integer_value(pname) ? GL_TRUE : GL_FALSE;
+}
+
+GLboolean glIsEnabled(GLenum cap) { COUNT(glIsEnabled); return cap == GL_DITHER ? GL_TRUE : GL_FALSE; }
+GLenum glGetError(void) { COUNT(glGetError); return GL_NO_ERROR; }
+GLenum glCheckFramebufferStatus(GLenum target) { COUNT(glCheckFramebufferStatus); return GL_FRAMEBUFFER_COMPLETE; }
+
+GLenum glClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    COUNT(glClientWaitSync);
+    return GL_ALREADY_SIGNALED;
+}
+
+const GLubyte* glGetString(GLenum name) {
+    COUNT(glGetString);
+    switch (name) {
+        case GL_VENDOR:                   return (const GLubyte*)"PrismGL";
+        case GL_RENDERER:                 return (const GLubyte*)"Mock GL";
+        case GL_VERSION:                  return (const GLubyte*)"OpenGL ES 3.2 Mock";
+        case GL_SHADING_LANGUAGE_VERSION: return (const GLubyte*)"OpenGL ES GLSL ES 3.20";
+        case GL_EXTENSIONS:               return (const GLubyte*)"";
+        default:                          return NULL;
+    }
+}
+
+void glGetQueryObjectuiv(GLuint id, GLenum pname, GLuint* params) {
+    COUNT(glGetQueryObjectuiv);
+    *params = pname == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+}
+
+/* Programs and shaders compile, link and have no active resources */
+void glGetProgramiv(GLuint program, GLenum pname, GLint* params) {
+    COUNT(glGetProgramiv);
+    *params = pname == GL_LINK_STATUS || pname == GL_VALIDATE_STATUS ? GL_TRUE : 0;
+}
+
+void glGetShaderiv(GLuint shader, GLenum pname, GLint* params) {
+    COUNT(glGetShaderiv);
+    *params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+
+static void empty_string(GLsizei buf_size, GLsizei* length, GLchar* out) {
+    if (length) *length = 0;
+    if (out && buf_size > 0) out[0] = '\0';
+}
+
+void glGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+    COUNT(glGetProgramInfoLog);
+    empty_string(bufSize, length, infoLog);
+}
+
+void glGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+    COUNT(glGetShaderInfoLog);
+    empty_string(bufSize, length, infoLog);
+}
+
+void glGetShaderSource(GLuint shader, GLsizei bufSize, GLsizei* length, GLchar* source) {
+    COUNT(glGetShaderSource);
+    empty_string(bufSize, length, source);
+}
+
+void glGetActiveAttrib(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length,
+                       GLint* size, GLenum* type, GLchar* name) {
+    COUNT(glGetActiveAttrib);
+    *size = 0;
+    *type = 0;
+    empty_string(bufSize, length, name);
+}
+
+void glGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize, GLsizei* length,
+                        GLint* size, GLenum* type, GLchar* name) {
+    COUNT(glGetActiveUniform);
+    *size = 0;
+    *type = 0;
+    empty_string(bufSize, length, name);
+}
+
+void glGetActiveUniformBlockName(GLuint program, GLuint uniformBlockIndex, GLsizei bufSize,
+                                 GLsizei* length, GLchar* uniformBlockName) {
+    COUNT(glGetActiveUniformBlockName);
+    empty_string(bufSize, length, uniformBlockName);
+}
+
+void glGetActiveUniformBlockiv(GLuint program, GLuint uniformBlockIndex, GLenum pname,
+                               GLint* params) {
+    COUNT(glGetActiveUniformBlockiv);
+    *params = 0;
+}
+
+void glGetAttachedShaders(GLuint program, GLsizei maxCount, GLsizei* count_out, GLuint* shaders) {
+    COUNT(glGetAttachedShaders);
+    if (count_out) *count_out = 0;
+}
+
+void glGetProgramBinary(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat,
+                        void* binary) {
+    COUNT(glGetProgramBinary);
+    if (length) *length = 0;
+    *binaryFormat = 0;
+}
+
+GLint glGetAttribLocation(GLuint program, const GLchar* name) { COUNT(glGetAttribLocation); return -1; }
+GLint glGetUniformLocation(GLuint program, const GLchar* name) { COUNT(glGetUniformLocation); return -1; }
+
+GLuint glGetUniformBlockIndex(GLuint program, const GLchar* uniformBlockName) {
+    COUNT(glGetUniformBlockIndex);
+    return GL_INVALID_INDEX;
+}
+
+void glGetTexLevelParameteriv(GLenum target, GLint level, GLenum pname, GLint* params) {
+    COUNT(glGetTexLevelParameteriv);
+    *params = 0;
+}
+
+void glGetTexParameteriv(GLenum target, GLenum pname, GLint* params) { COUNT(glGetTexParameteriv); *params = 0; }
+void glGetTexParameterfv(GLenum target, GLenum pname, GLfloat* params) { COUNT(glGetTexParameterfv); *params = 0.0f; }
+void glGetUniformfv(GLuint program, GLint location, GLfloat* params) { COUNT(glGetUniformfv); *params = 0.0f; }
+void glGetUniformiv(GLuint program, GLint location, GLint* params) { COUNT(glGetUniformiv); *params = 0; }
+void glGetUniformuiv(GLuint program, GLint location, GLuint* params) { COUNT(glGetUniformuiv); *params = 0; }
+void glGetVertexAttribiv(GLuint index, GLenum pname, GLint* params) { COUNT(glGetVertexAttribiv); *params = 0; }
+
+/* ===== Everything else only counts ===== */
+
+MOCK(glActiveTexture, (GLenum texture))
+MOCK(glAttachShader, (GLuint program, GLuint shader))
+MOCK(glBeginQuery, (GLenum target, GLuint id))
+MOCK(glBindAttribLocation, (GLuint program, GLuint index, const GLchar* name))
+MOCK(glBindBuffer, (GLenum target, GLuint buffer))
+MOCK(glBindBufferBase, (GLenum target, GLuint index, GLuint buffer))
+MOCK(glBindBufferRange, (GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size))
+MOCK(glBindFramebuffer, (GLenum target, GLuint framebuffer))
+MOCK(glBindRenderbuffer, (GLenum target, GLuint renderbuffer))
+MOCK(glBindSampler, (GLuint unit, GLuint sampler))
+MOCK(glBindTexture, (GLenum target, GLuint texture))
+MOCK(glBindVertexArray, (GLuint array))
+MOCK(glBindVertexBuffer, (GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride))
+MOCK(glBlendColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha))
+MOCK(glBlendEquation, (GLenum mode))
+MOCK(glBlendEquationSeparate, (GLenum modeRGB, GLenum modeAlpha))
+MOCK(glBlendFuncSeparate, (GLenum sfactorRGB, GLenum dfactorRGB, GLenum sfactorAlpha, GLenum dfactorAlpha))
+MOCK(glBlitFramebuffer, (GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter))
+MOCK(glBufferData, (GLenum target, GLsizeiptr size, const void* data, GLenum usage))
+MOCK(glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data))
+MOCK(glClear, (GLbitfield mask))
+MOCK(glClearColor, (GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha))
+MOCK(glClearDepthf, (GLfloat d))
+MOCK(glClearStencil, (GLint s))
+MOCK(glColorMask, (GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha))
+MOCK(glCompileShader, (GLuint shader))
+MOCK(glCompressedTexImage2D, (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void* data))
+MOCK(glCompressedTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void* data))
+MOCK(glCopyBufferSubData, (GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size))
+MOCK(glCopyImageSubData, (GLuint srcName, GLenum srcTarget, GLint srcLevel, GLint srcX, GLint srcY, GLint srcZ, GLuint dstName, GLenum dstTarget, GLint dstLevel, GLint dstX, GLint dstY, GLint dstZ, GLsizei srcWidth, GLsizei srcHeight, GLsizei srcDepth))
+MOCK(glCopyTexImage2D, (GLenum target, GLint level, GLenum internalformat, GLint x, GLint y, GLsizei width, GLsizei height, GLint border))
+MOCK(glCopyTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height))
+MOCK(glCullFace, (GLenum mode))
+MOCK(glDeleteBuffers, (GLsizei n, const GLuint* buffers))
+MOCK(glDeleteFramebuffers, (GLsizei n, const GLuint* framebuffers))
+MOCK(glDeleteProgram, (GLuint program))
+MOCK(glDeleteQueries, (GLsizei n, const GLuint* ids))
+MOCK(glDeleteRenderbuffers, (GLsizei n, const GLuint* renderbuffers))
+MOCK(glDeleteShader, (GLuint shader))
+MOCK(glDeleteSync, (GLsync sync))
+MOCK(glDeleteTextures, (GLsizei n, const GLuint* textures))
+MOCK(glDeleteVertexArrays, (GLsizei n, const GLuint* arrays))
+MOCK(glDepthFunc, (GLenum func))
+MOCK(glDepthMask, (GLboolean flag))
+MOCK(glDepthRangef, (GLfloat n, GLfloat f))
+MOCK(glDetachShader, (GLuint program, GLuint shader))
+MOCK(glDisable, (GLenum cap))
+MOCK(glDisableVertexAttribArray, (GLuint index))
+MOCK(glDrawArrays, (GLenum mode, GLint first, GLsizei count))
+MOCK(glDrawArraysInstanced, (GLenum mode, GLint first, GLsizei count, GLsizei instancecount))
+MOCK(glDrawBuffers, (GLsizei n, const GLenum* bufs))
+MOCK(glDrawElements, (GLenum mode, GLsizei count, GLenum type, const void* indices))
+MOCK(glDrawElementsBaseVertex, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLint basevertex))
+MOCK(glDrawElementsInstanced, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount))
+MOCK(glDrawElementsInstancedBaseVertex, (GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount, GLint basevertex))
+MOCK(glDrawRangeElements, (GLenum mode, GLuint start, GLuint end, GLsizei count, GLenum type, const void* indices))
+MOCK(glEnable, (GLenum cap))
+MOCK(glEnableVertexAttribArray, (GLuint index))
+MOCK(glEndQuery, (GLenum target))
+MOCK(glFinish, (void))
+MOCK(glFlush, (void))
+MOCK(glFlushMappedBufferRange, (GLenum target, GLintptr offset, GLsizeiptr length))
+MOCK(glFramebufferRenderbuffer, (GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer))
+MOCK(glFramebufferTexture2D, (GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level))
+MOCK(glFramebufferTextureLayer, (GLenum target, GLenum attachment, GLuint texture, GLint level, GLint layer))
+MOCK(glFrontFace, (GLenum mode))
+MOCK(glGenerateMipmap, (GLenum target))
+MOCK(glHint, (GLenum target, GLenum mode))
+MOCK(glLinkProgram, (GLuint program))
+MOCK(glMemoryBarrier, (GLbitfield barriers))
+MOCK(glPixelStorei, (GLenum pname, GLint param))
+MOCK(glPolygonOffset, (GLfloat factor, GLfloat units))
+MOCK(glProgramBinary, (GLuint program, GLenum binaryFormat, const void* binary, GLsizei length))
+MOCK(glProgramUniform1fv, (GLuint program, GLint location, GLsizei count, const GLfloat* value))
+MOCK(glProgramUniform1iv, (GLuint program, GLint location, GLsizei count, const GLint* value))
+MOCK(glProgramUniform1ui, (GLuint program, GLint location, GLuint v0))
+MOCK(glProgramUniform1uiv, (GLuint program, GLint location, GLsizei count, const GLuint* value))
+MOCK(glProgramUniform2fv, (GLuint program, GLint location, GLsizei count, const GLfloat* value))
+MOCK(glProgramUniform2iv, (GLuint program, GLint location, GLsizei count, const GLint* value))
+MOCK(glProgramUniform2uiv, (GLuint program, GLint location, GLsizei count, const GLuint* value))
+MOCK(glProgramUniform3fv, (GLuint program, GLint location, GLsizei count, const GLfloat* value))
+MOCK(glProgramUniform3iv, (GLuint program, GLint location, GLsizei count, const GLint* value))
+MOCK(glProgramUniform3uiv, (GLuint program, GLint location, GLsizei count, const GLuint* value))
+MOCK(glProgramUniform4fv, (GLuint program, GLint location, GLsizei count, const GLfloat* value))
+MOCK(glProgramUniform4iv, (GLuint program, GLint location, GLsizei count, const GLint* value))
+MOCK(glProgramUniform4uiv, (GLuint program, GLint location, GLsizei count, const GLuint* value))
+MOCK(glProgramUniformMatrix2fv, (GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glProgramUniformMatrix2x3fv, (GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glProgramUniformMatrix2x4fv, (GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glProgramUniformMatrix3fv, (GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glProgramUniformMatrix3x2fv, (GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glProgramUniformMatrix3x4fv, (GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glProgramUniformMatrix4fv, (GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glProgramUniformMatrix4x2fv, (GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glProgramUniformMatrix4x3fv, (GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glReadBuffer, (GLenum src))
+MOCK(glReadPixels, (GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels))
+MOCK(glRenderbufferStorage, (GLenum target, GLenum internalformat, GLsizei width, GLsizei height))
+MOCK(glSamplerParameteri, (GLuint sampler, GLenum pname, GLint param))
+MOCK(glScissor, (GLint x, GLint y, GLsizei width, GLsizei height))
+MOCK(glShaderSource, (GLuint shader, GLsizei count, const GLchar* const*string, const GLint* length))
+MOCK(glStencilFunc, (GLenum func, GLint ref, GLuint mask))
+MOCK(glStencilMask, (GLuint mask))
+MOCK(glStencilOp, (GLenum fail, GLenum zfail, GLenum zpass))
+MOCK(glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels))
+MOCK(glTexImage3D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels))
+MOCK(glTexParameterf, (GLenum target, GLenum pname, GLfloat param))
+MOCK(glTexParameteri, (GLenum target, GLenum pname, GLint param))
+MOCK(glTexStorage2D, (GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height))
+MOCK(glTexStorage3D, (GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth))
+MOCK(glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels))
+MOCK(glTexSubImage3D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels))
+MOCK(glUniform1f, (GLint location, GLfloat v0))
+MOCK(glUniform1fv, (GLint location, GLsizei count, const GLfloat* value))
+MOCK(glUniform1i, (GLint location, GLint v0))
+MOCK(glUniform1iv, (GLint location, GLsizei count, const GLint* value))
+MOCK(glUniform2f, (GLint location, GLfloat v0, GLfloat v1))
+MOCK(glUniform2fv, (GLint location, GLsizei count, const GLfloat* value))
+MOCK(glUniform2i, (GLint location, GLint v0, GLint v1))
+MOCK(glUniform2iv, (GLint location, GLsizei count, const GLint* value))
+MOCK(glUniform3f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2))
+MOCK(glUniform3fv, (GLint location, GLsizei count, const GLfloat* value))
+MOCK(glUniform3i, (GLint location, GLint v0, GLint v1, GLint v2))
+MOCK(glUniform3iv, (GLint location, GLsizei count, const GLint* value))
+MOCK(glUniform4f, (GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3))
+MOCK(glUniform4fv, (GLint location, GLsizei count, const GLfloat* value))
+MOCK(glUniform4i, (GLint location, GLint v0, GLint v1, GLint v2, GLint v3))
+MOCK(glUniform4iv, (GLint location, GLsizei count, const GLint* value))
+MOCK(glUniformBlockBinding, (GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding))
+MOCK(glUniformMatrix2fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glUniformMatrix3fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value))
+MOCK(glUseProgram, (GLuint program))
+MOCK(glVertexAttrib4f, (GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w))
+MOCK(glVertexAttribBinding, (GLuint attribindex, GLuint bindingindex))
+MOCK(glVertexAttribDivisor, (GLuint index, GLuint divisor))
+MOCK(glVertexAttribFormat, (GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset))
+MOCK(glVertexAttribIPointer, (GLuint index, GLint size, GLenum type, GLsizei stride, const void* pointer))
+MOCK(glVertexAttribPointer, (GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer))
+MOCK(glViewport, (GLint x, GLint y, GLsizei width, GLsizei height))
+MOCK(glWaitSync, (GLsync sync, GLbitfield flags, GLuint64 timeout))
@@ -0,0 +1,31 @@
+/*
+ * PrismGL Mock GL
+ * Host stand-in for libGLESv3 and libEGL that counts every driver call,
+ * so tests can check what reaches the driver. Generated names and mapped
+ * buffers behave well enough for PrismGL's own bookkeeping; nothing is
+ * drawn and queries answer 0.
+ */
+
+#ifndef PRISMGL_MOCK_GL_H
+#define PRISMGL_MOCK_GL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Forget the counts so far */
+void mock_gl_reset(void);
+
+/* GL calls since the last reset, all of them or those of one entry point,
+ * which may also be an EGL one */
+unsigned mock_gl_total(void);
+unsigned mock_gl_calls(const char* name);
+
+/* Print the calls since the last reset, one entry point per line */
+void mock_gl_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PRISMGL_MOCK_GL_H */